@@ -13,6 +13,10 @@
 #include <util/config-file.h>
 #include "../win-spout-config.h"
 #include "../win-spout.h"
+#include "../win-spout-yuv.h"
+
+// the format combo box's items, in the order of enum win_spout_yuv_format
+static const char *const yuv_formats[] = {"bgra", "nv12", "p010"};
 
 win_spout_output_settings::win_spout_output_settings(QWidget *parent)
 	: QDialog(parent),
@@ -25,18 +29,27 @@ win_spout_output_settings::win_spout_output_settings(QWidget *parent)
 	win_spout_config *config = win_spout_config::get();
 
 	ui->checkBox_auto->setChecked(config->auto_start);
-	ui->lineEdit_spoutname->setText(config->spout_output_name);
+	ui->lineEdit_spoutname->setText(QString::fromStdString(config->spout_output_name));
 
-	set_started_button_state(true);
-	if (config->auto_start)
-		on_start();
+	enum win_spout_yuv_format yuv_format = WIN_SPOUT_YUV_NONE;
+	enum win_spout_yuv_matrix yuv_matrix = WIN_SPOUT_YUV_709;
+	win_spout_yuv_parse_format(config->output_yuv_format.c_str(), &yuv_format);
+	win_spout_yuv_parse_matrix(config->output_yuv_matrix.c_str(), &yuv_matrix);
+	ui->comboBox_yuvformat->setCurrentIndex((int)yuv_format);
+	ui->comboBox_yuvmatrix->setCurrentIndex(yuv_matrix == WIN_SPOUT_YUV_2020 ? 1 : 0);
+
+	// auto-start is handled at module load, just reflect the output state
+	set_started_button_state(!spout_output_active());
 }
 
 void win_spout_output_settings::save_settings()
 {
 	win_spout_config *config = win_spout_config::get();
 	config->auto_start = ui->checkBox_auto->isChecked();
-	config->spout_output_name = ui->lineEdit_spoutname->text();
+	config->spout_output_name = ui->lineEdit_spoutname->text().toStdString();
+	int yuv_format = ui->comboBox_yuvformat->currentIndex();
+	config->output_yuv_format = yuv_formats[yuv_format > 0 && yuv_format <= WIN_SPOUT_YUV_P010 ? yuv_format : 0];
+	config->output_yuv_matrix = ui->comboBox_yuvmatrix->currentIndex() == 1 ? "2020" : "709";
 	win_spout_config::get()->save();
 }
 
@@ -0,0 +1,139 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "win-spout-alloc-track.h"
+
+#ifdef WIN_SPOUT_ENABLE_ALLOC_TRACK
+
+#include <stdlib.h>
+#include <new>
+#include <obs-module.h>
+#include <util/threading.h>
+#include "win-spout.h"
+
+// more scopes than this aren't tracked
+#define ALLOC_MAX_SCOPES 32
+// after the first, allocating frames are only logged this often
+#define ALLOC_WARN_EVERY 1000
+
+struct alloc_scope_stats {
+	const char *name;
+	uint64_t frames;
+	uint64_t allocations;
+	uint64_t allocating_frames;
+};
+
+// allocations made by the plugin on this thread
+static thread_local uint64_t alloc_count;
+
+static pthread_mutex_t alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct alloc_scope_stats alloc_scopes[ALLOC_MAX_SCOPES];
+static size_t alloc_scope_count;
+
+/* Only the plugin's own module is affected, libobs keeps its allocator */
+
+void *operator new(size_t size)
+{
+	alloc_count++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	alloc_count++;
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void win_spout_alloc_begin(uint64_t *start)
+{
+	*start = alloc_count;
+}
+
+void win_spout_alloc_end(const char *name, uint64_t start)
+{
+	uint64_t allocations = alloc_count - start;
+
+	pthread_mutex_lock(&alloc_mutex);
+
+	struct alloc_scope_stats *stats = nullptr;
+	for (size_t i = 0; i < alloc_scope_count && !stats; i++) {
+		if (alloc_scopes[i].name == name)
+			stats = &alloc_scopes[i];
+	}
+	if (!stats && alloc_scope_count < ALLOC_MAX_SCOPES) {
+		stats = &alloc_scopes[alloc_scope_count++];
+		stats->name = name;
+	}
+
+	if (stats && ++stats->frames > WIN_SPOUT_ALLOC_WARMUP_FRAMES && allocations) {
+		stats->allocations += allocations;
+		if (stats->allocating_frames++ % ALLOC_WARN_EVERY == 0) {
+			blog(LOG_WARNING, "%s allocated %llu times in frame %llu, after warm-up", name,
+			     (unsigned long long)allocations, (unsigned long long)stats->frames);
+		}
+	}
+
+	pthread_mutex_unlock(&alloc_mutex);
+}
+
+uint64_t win_spout_alloc_thread_count()
+{
+	return alloc_count;
+}
+
+void win_spout_alloc_report()
+{
+	pthread_mutex_lock(&alloc_mutex);
+	for (size_t i = 0; i < alloc_scope_count; i++) {
+		struct alloc_scope_stats *stats = &alloc_scopes[i];
+		uint64_t warm = stats->frames > WIN_SPOUT_ALLOC_WARMUP_FRAMES
+					? stats->frames - WIN_SPOUT_ALLOC_WARMUP_FRAMES
+					: 0;
+		blog(stats->allocating_frames ? LOG_WARNING : LOG_INFO,
+		     "%s: %llu allocations in %llu of %llu frames after warm-up", stats->name,
+		     (unsigned long long)stats->allocations, (unsigned long long)stats->allocating_frames,
+		     (unsigned long long)warm);
+	}
+	pthread_mutex_unlock(&alloc_mutex);
+}
+
+#endif // WIN_SPOUT_ENABLE_ALLOC_TRACK
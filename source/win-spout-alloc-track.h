@@ -0,0 +1,66 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTALLOCTRACK_H
+#define WINSPOUTALLOCTRACK_H
+
+/**
+ * Optional check that the per-frame paths don't allocate once warmed up,
+ * enabled with the ENABLE_ALLOC_TRACKING build option. Compiled out
+ * completely otherwise.
+ *
+ * The build replaces the plugin's operator new/delete to count
+ * allocations per thread. Each scope counts the allocations made on its
+ * thread while it runs; after WIN_SPOUT_ALLOC_WARMUP_FRAMES a frame that
+ * allocates is logged as a warning, and every scope's totals are logged
+ * on unload.
+ *
+ * Scope names must be string literals, scopes are told apart by pointer.
+ * Tasks the send pool runs on its workers are scoped there, as
+ * win_spout_send_worker.
+ *
+ * Allocations libobs makes (bmalloc, DARRAY growth) aren't seen here:
+ * libobs only counts them process wide. The headless tests count those
+ * per frame instead (tests/test-alloc.cpp).
+ */
+#ifdef WIN_SPOUT_ENABLE_ALLOC_TRACK
+
+#include <stdint.h>
+
+#define WIN_SPOUT_ALLOC_WARMUP_FRAMES 300
+
+void win_spout_alloc_begin(uint64_t *start);
+void win_spout_alloc_end(const char *name, uint64_t start);
+void win_spout_alloc_report();
+// Allocations made by the plugin on the calling thread so far
+uint64_t win_spout_alloc_thread_count();
+
+class win_spout_alloc_scope {
+public:
+	explicit win_spout_alloc_scope(const char *name) : name(name) { win_spout_alloc_begin(&start); }
+	~win_spout_alloc_scope() { win_spout_alloc_end(name, start); }
+
+private:
+	const char *name;
+	uint64_t start;
+};
+
+#define WIN_SPOUT_ALLOC_CONCAT_(a, b) a##b
+#define WIN_SPOUT_ALLOC_CONCAT(a, b) WIN_SPOUT_ALLOC_CONCAT_(a, b)
+#define WIN_SPOUT_ALLOC_SCOPE(name) win_spout_alloc_scope WIN_SPOUT_ALLOC_CONCAT(alloc_scope_, __LINE__)(name)
+#define WIN_SPOUT_ALLOC_REPORT() win_spout_alloc_report()
+
+#else
+
+#define WIN_SPOUT_ALLOC_SCOPE(name) ((void)0)
+#define WIN_SPOUT_ALLOC_REPORT() ((void)0)
+
+#endif // WIN_SPOUT_ENABLE_ALLOC_TRACK
+
+#endif // WINSPOUTALLOCTRACK_H
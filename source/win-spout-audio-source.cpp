@@ -0,0 +1,337 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-audio.h"
+
+#include "SpoutDX.h"
+
+#define info(message, ...) blog(LOG_INFO, "[%s] " message, obs_source_get_name(context->source), ##__VA_ARGS__)
+
+#define SPOUT_SENDER_LIST "spoutsenders"
+#define USE_FIRST_AVAILABLE_SENDER "usefirstavailablesender"
+
+// how often the worker drains the ring
+#define AUDIO_POLL_NS 5000000ULL
+// how often to look for a sender that doesn't share audio (yet)
+#define AUDIO_RETRY_NS 1000000000ULL
+// a ring that hasn't moved for this long has lost its writer without closing it (eg. a crash)
+#define AUDIO_STALE_NS 3000000000ULL
+#define AUDIO_READ_FRAMES 1024
+
+struct spout_audio_source {
+	obs_source_t *source;
+
+	// mutex guards the [SHARED] fields, written from update()
+	pthread_mutex_t mutex;
+
+	// [SHARED]
+	char senderName[256];
+	bool useFirstSender;
+	bool senderChanged;
+
+	// [THREAD] receive worker
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *stop_event;
+};
+
+static void win_spout_audio_source_destroy(void *data);
+
+static enum speaker_layout win_spout_audio_source_layout(uint32_t channels)
+{
+	switch (channels) {
+	case 1:
+		return SPEAKERS_MONO;
+	case 2:
+		return SPEAKERS_STEREO;
+	case 3:
+		return SPEAKERS_2POINT1;
+	case 4:
+		return SPEAKERS_4POINT0;
+	case 5:
+		return SPEAKERS_4POINT1;
+	case 6:
+		return SPEAKERS_5POINT1;
+	case 8:
+		return SPEAKERS_7POINT1;
+	default:
+		return SPEAKERS_UNKNOWN;
+	}
+}
+
+// Opens the sender's ring if its writer is still there
+static struct win_spout_audio *win_spout_audio_source_open_alive(const char *senderName)
+{
+	struct win_spout_audio *audio = win_spout_audio_open(senderName);
+	if (audio && !win_spout_audio_shared_alive(win_spout_audio_get_shared(audio))) {
+		win_spout_audio_destroy(audio);
+		return nullptr;
+	}
+	return audio;
+}
+
+/**
+ * Finds the sender to play audio for, the first sender that shares audio
+ * when none is selected
+ */
+static struct win_spout_audio *win_spout_audio_source_open(struct spout_audio_source *context)
+{
+	pthread_mutex_lock(&context->mutex);
+	bool useFirstSender = context->useFirstSender;
+	char senderName[256];
+	memcpy(senderName, context->senderName, sizeof(senderName));
+	context->senderChanged = false;
+	pthread_mutex_unlock(&context->mutex);
+
+	if (!useFirstSender) {
+		return win_spout_audio_source_open_alive(senderName);
+	}
+
+	spoutDX spout;
+	int totalSenders = spout.GetSenderCount();
+	for (int index = 0; index < totalSenders; index++) {
+		if (spout.GetSender(index, senderName, 256)) {
+			struct win_spout_audio *audio = win_spout_audio_source_open_alive(senderName);
+			if (audio) {
+				return audio;
+			}
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Receive worker. Drains the sender's audio ring and passes it to OBS with
+ * the sender's timestamps, so it lines up with video captured from the
+ * same sender; OBS resamples it to the output format.
+ */
+static void *win_spout_audio_source_thread(void *data)
+{
+	struct spout_audio_source *context = (spout_audio_source *)data;
+	os_set_thread_name("spout-audio-source");
+
+	float *planes[WIN_SPOUT_AUDIO_MAX_CHANNELS];
+	for (int ch = 0; ch < WIN_SPOUT_AUDIO_MAX_CHANNELS; ch++) {
+		planes[ch] = (float *)bmalloc(AUDIO_READ_FRAMES * sizeof(float));
+	}
+
+	struct win_spout_audio *audio = nullptr;
+	struct win_spout_audio_reader reader = {};
+	uint64_t reported_overruns = 0;
+	uint64_t next_retry = 0;
+	uint64_t last_write_pos = 0;
+	uint64_t last_write_time = 0;
+
+	while (os_event_timedwait(context->stop_event, (unsigned long)(AUDIO_POLL_NS / 1000000)) == ETIMEDOUT) {
+		pthread_mutex_lock(&context->mutex);
+		bool changed = context->senderChanged;
+		pthread_mutex_unlock(&context->mutex);
+
+		if (changed) {
+			win_spout_audio_destroy(audio);
+			audio = nullptr;
+			next_retry = 0;
+		}
+
+		uint64_t now = os_gettime_ns();
+		if (!audio) {
+			if (now < next_retry) {
+				continue;
+			}
+			next_retry = now + AUDIO_RETRY_NS;
+
+			audio = win_spout_audio_source_open(context);
+			if (!audio) {
+				continue;
+			}
+			reader = {};
+			reported_overruns = 0;
+			last_write_pos = 0;
+			last_write_time = now;
+			info("Receiving shared audio");
+		}
+
+		// the reader's mapping keeps the ring around after its writer
+		// has gone, so notice that and look for the sender again
+		struct win_spout_audio_shared *shared = win_spout_audio_get_shared(audio);
+		uint64_t write_pos = win_spout_audio_shared_write_pos(shared);
+		if (write_pos != last_write_pos) {
+			last_write_pos = write_pos;
+			last_write_time = now;
+		}
+		if (!win_spout_audio_shared_alive(shared) || now - last_write_time > AUDIO_STALE_NS) {
+			info("Shared audio has gone away");
+			win_spout_audio_destroy(audio);
+			audio = nullptr;
+			continue;
+		}
+
+		uint32_t sample_rate, channels;
+		if (!win_spout_audio_shared_format(shared, &sample_rate, &channels)) {
+			continue;
+		}
+
+		uint64_t timestamp;
+		uint32_t frames;
+		while ((frames = win_spout_audio_shared_read(shared, &reader, planes, AUDIO_READ_FRAMES, &timestamp))) {
+			struct obs_source_audio out = {};
+			for (uint32_t ch = 0; ch < channels; ch++) {
+				out.data[ch] = (const uint8_t *)planes[ch];
+			}
+			out.frames = frames;
+			out.speakers = win_spout_audio_source_layout(channels);
+			out.format = AUDIO_FORMAT_FLOAT_PLANAR;
+			out.samples_per_sec = sample_rate;
+			out.timestamp = timestamp;
+			obs_source_output_audio(context->source, &out);
+		}
+
+		if (reader.overruns != reported_overruns) {
+			info("Fell behind the shared audio, skipped ahead (%llu times)",
+			     (unsigned long long)reader.overruns);
+			reported_overruns = reader.overruns;
+		}
+	}
+
+	win_spout_audio_destroy(audio);
+	for (int ch = 0; ch < WIN_SPOUT_AUDIO_MAX_CHANNELS; ch++) {
+		bfree(planes[ch]);
+	}
+
+	return NULL;
+}
+
+static const char *win_spout_audio_source_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("audiosourcename");
+}
+
+static void win_spout_audio_source_update(void *data, obs_data_t *settings)
+{
+	struct spout_audio_source *context = (spout_audio_source *)data;
+
+	const char *selectedSender = obs_data_get_string(settings, SPOUT_SENDER_LIST);
+
+	pthread_mutex_lock(&context->mutex);
+	if (strcmp(selectedSender, USE_FIRST_AVAILABLE_SENDER) == 0) {
+		context->useFirstSender = true;
+	} else {
+		context->useFirstSender = false;
+		memset(context->senderName, 0, 256);
+		strncpy(context->senderName, selectedSender, 255);
+	}
+	context->senderChanged = true;
+	pthread_mutex_unlock(&context->mutex);
+}
+
+static void *win_spout_audio_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct spout_audio_source *context = (spout_audio_source *)bzalloc(sizeof(spout_audio_source));
+	context->source = source;
+	context->useFirstSender = true;
+	context->thread_active = false;
+
+	pthread_mutex_init_value(&context->mutex);
+	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Failed to create mutex for spout audio source!");
+		win_spout_audio_source_destroy(context);
+		return nullptr;
+	}
+
+	if (os_event_init(&context->stop_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		blog(LOG_ERROR, "Failed to create event for spout audio source!");
+		win_spout_audio_source_destroy(context);
+		return nullptr;
+	}
+
+	win_spout_audio_source_update(context, settings);
+
+	if (pthread_create(&context->thread, NULL, win_spout_audio_source_thread, context) != 0) {
+		blog(LOG_ERROR, "Failed to create thread for spout audio source!");
+		win_spout_audio_source_destroy(context);
+		return nullptr;
+	}
+	context->thread_active = true;
+
+	return context;
+}
+
+static void win_spout_audio_source_destroy(void *data)
+{
+	struct spout_audio_source *context = (spout_audio_source *)data;
+
+	if (!context) {
+		return;
+	}
+
+	if (context->thread_active) {
+		os_event_signal(context->stop_event);
+		pthread_join(context->thread, NULL);
+		context->thread_active = false;
+	}
+
+	os_event_destroy(context->stop_event);
+	pthread_mutex_destroy(&context->mutex);
+	bfree(context);
+}
+
+static void win_spout_audio_source_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, SPOUT_SENDER_LIST, USE_FIRST_AVAILABLE_SENDER);
+}
+
+static obs_properties_t *win_spout_audio_source_properties(void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_property_t *sender_list = obs_properties_add_list(props, SPOUT_SENDER_LIST, obs_module_text("SpoutSenders"),
+							      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+
+	obs_property_list_add_string(sender_list, obs_module_text("usefirstavailablesender"),
+				     USE_FIRST_AVAILABLE_SENDER);
+
+	// only senders sharing audio are worth listing
+	spoutDX spout;
+	int totalSenders = spout.GetSenderCount();
+	for (int index = 0; index < totalSenders; index++) {
+		char senderName[256];
+		if (spout.GetSender(index, senderName, 256)) {
+			struct win_spout_audio *audio = win_spout_audio_source_open_alive(senderName);
+			if (audio) {
+				obs_property_list_add_string(sender_list, senderName, senderName);
+				win_spout_audio_destroy(audio);
+			}
+		}
+	}
+
+	return props;
+}
+
+struct obs_source_info create_spout_audio_source_info()
+{
+	struct obs_source_info spout_audio_source_info = {};
+	spout_audio_source_info.id = "spout_audio_capture";
+	spout_audio_source_info.type = OBS_SOURCE_TYPE_INPUT;
+	spout_audio_source_info.output_flags = OBS_SOURCE_AUDIO;
+	spout_audio_source_info.get_name = win_spout_audio_source_get_name;
+	spout_audio_source_info.create = win_spout_audio_source_create;
+	spout_audio_source_info.destroy = win_spout_audio_source_destroy;
+	spout_audio_source_info.update = win_spout_audio_source_update;
+	spout_audio_source_info.get_defaults = win_spout_audio_source_defaults;
+	spout_audio_source_info.get_properties = win_spout_audio_source_properties;
+
+	return spout_audio_source_info;
+}
@@ -0,0 +1,310 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+#include <atomic>
+#include <string.h>
+#include "win-spout.h"
+#include "win-spout-audio.h"
+#include "win-spout-shm.h"
+
+#define AUDIO_SUFFIX "_OBSAudio"
+#define AUDIO_MASK (WIN_SPOUT_AUDIO_CAPACITY - 1)
+#define AUDIO_ANCHORS 16
+// OBS's audio timestamps follow the sample count, anything further out is a jump
+#define AUDIO_JUMP_NS 2000000ULL
+// room for the packet the writer may be copying while a reader checks its position
+#define AUDIO_WRITE_MARGIN 4096
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be lock-free across processes");
+
+// Maps a ring position to a timestamp, the newest anchor at or before a
+// position applies to it
+struct audio_anchor {
+	std::atomic<uint64_t> pos;
+	std::atomic<uint64_t> timestamp;
+};
+
+// Shared layout, version is only set once the rest of the header is valid
+struct win_spout_audio_shared {
+	std::atomic<uint32_t> version;
+	// cleared by the writer when it goes away, the section itself can outlive it
+	std::atomic<uint32_t> active;
+	uint32_t sample_rate;
+	uint32_t channels;
+	std::atomic<uint64_t> session;
+	std::atomic<uint64_t> write_pos;
+	std::atomic<uint64_t> anchor_count;
+	struct audio_anchor anchors[AUDIO_ANCHORS];
+	float samples[WIN_SPOUT_AUDIO_MAX_CHANNELS][WIN_SPOUT_AUDIO_CAPACITY];
+};
+
+struct win_spout_audio {
+	struct win_spout_shm_section *section;
+	struct win_spout_audio_shared *shared;
+	bool writer;
+};
+
+size_t win_spout_audio_shared_size()
+{
+	return sizeof(struct win_spout_audio_shared);
+}
+
+void win_spout_audio_shared_init(struct win_spout_audio_shared *shared, uint32_t sample_rate, uint32_t channels,
+				 uint64_t session)
+{
+	shared->version.store(0, std::memory_order_release);
+
+	shared->sample_rate = sample_rate;
+	shared->channels = channels < WIN_SPOUT_AUDIO_MAX_CHANNELS ? channels : WIN_SPOUT_AUDIO_MAX_CHANNELS;
+	shared->write_pos.store(0, std::memory_order_relaxed);
+	shared->anchor_count.store(0, std::memory_order_relaxed);
+	// readers seeing a new session restart from the writer's position
+	shared->session.store(session, std::memory_order_relaxed);
+	shared->active.store(1, std::memory_order_relaxed);
+
+	shared->version.store(WIN_SPOUT_AUDIO_VERSION, std::memory_order_release);
+}
+
+void win_spout_audio_shared_close(struct win_spout_audio_shared *shared)
+{
+	shared->active.store(0, std::memory_order_release);
+}
+
+bool win_spout_audio_shared_alive(struct win_spout_audio_shared *shared)
+{
+	return shared->version.load(std::memory_order_acquire) == WIN_SPOUT_AUDIO_VERSION &&
+	       shared->active.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t win_spout_audio_shared_write_pos(struct win_spout_audio_shared *shared)
+{
+	return shared->write_pos.load(std::memory_order_acquire);
+}
+
+bool win_spout_audio_shared_format(struct win_spout_audio_shared *shared, uint32_t *sample_rate,
+				   uint32_t *channels)
+{
+	if (shared->version.load(std::memory_order_acquire) != WIN_SPOUT_AUDIO_VERSION || !shared->sample_rate) {
+		return false;
+	}
+
+	*sample_rate = shared->sample_rate;
+	*channels = shared->channels;
+	return true;
+}
+
+/**
+ * Newest anchor at or before pos. When next_pos isn't null it receives the
+ * position of the anchor after it, or UINT64_MAX if there is none.
+ */
+static bool audio_find_anchor(struct win_spout_audio_shared *shared, uint64_t pos, uint64_t *anchor_pos,
+			      uint64_t *anchor_ts, uint64_t *next_pos)
+{
+	uint64_t count = shared->anchor_count.load(std::memory_order_acquire);
+	uint64_t first = count > AUDIO_ANCHORS ? count - AUDIO_ANCHORS : 0;
+
+	if (next_pos) {
+		*next_pos = UINT64_MAX;
+	}
+
+	for (uint64_t i = count; i > first; i--) {
+		struct audio_anchor *anchor = &shared->anchors[(i - 1) % AUDIO_ANCHORS];
+		uint64_t candidate = anchor->pos.load(std::memory_order_relaxed);
+		if (candidate <= pos) {
+			*anchor_pos = candidate;
+			*anchor_ts = anchor->timestamp.load(std::memory_order_relaxed);
+			return true;
+		}
+		if (next_pos) {
+			*next_pos = candidate;
+		}
+	}
+	return false;
+}
+
+static uint64_t audio_pos_to_ts(uint32_t sample_rate, uint64_t anchor_pos, uint64_t anchor_ts, uint64_t pos)
+{
+	return anchor_ts + util_mul_div64(pos - anchor_pos, 1000000000ULL, sample_rate);
+}
+
+void win_spout_audio_shared_write(struct win_spout_audio_shared *shared, const float *const *planes,
+				  uint32_t frames, uint64_t timestamp)
+{
+	if (!frames) {
+		return;
+	}
+
+	// only the newest samples of an oversized packet fit
+	if (frames > WIN_SPOUT_AUDIO_CAPACITY - AUDIO_WRITE_MARGIN) {
+		uint32_t skipped = frames - (WIN_SPOUT_AUDIO_CAPACITY - AUDIO_WRITE_MARGIN);
+		timestamp += util_mul_div64(skipped, 1000000000ULL, shared->sample_rate);
+		frames -= skipped;
+
+		const float *offset[WIN_SPOUT_AUDIO_MAX_CHANNELS];
+		for (uint32_t ch = 0; ch < shared->channels; ch++) {
+			offset[ch] = planes[ch] + skipped;
+		}
+		win_spout_audio_shared_write(shared, offset, frames, timestamp);
+		return;
+	}
+
+	uint64_t pos = shared->write_pos.load(std::memory_order_relaxed);
+
+	uint64_t anchor_pos, anchor_ts;
+	bool anchored = audio_find_anchor(shared, pos, &anchor_pos, &anchor_ts, nullptr);
+	uint64_t expected = anchored ? audio_pos_to_ts(shared->sample_rate, anchor_pos, anchor_ts, pos) : 0;
+	uint64_t drift = expected > timestamp ? expected - timestamp : timestamp - expected;
+
+	if (!anchored || drift > AUDIO_JUMP_NS) {
+		uint64_t count = shared->anchor_count.load(std::memory_order_relaxed);
+		struct audio_anchor *anchor = &shared->anchors[count % AUDIO_ANCHORS];
+		anchor->pos.store(pos, std::memory_order_relaxed);
+		anchor->timestamp.store(timestamp, std::memory_order_relaxed);
+		shared->anchor_count.store(count + 1, std::memory_order_release);
+	}
+
+	uint32_t start = (uint32_t)(pos & AUDIO_MASK);
+	uint32_t first = frames < WIN_SPOUT_AUDIO_CAPACITY - start ? frames : WIN_SPOUT_AUDIO_CAPACITY - start;
+	for (uint32_t ch = 0; ch < shared->channels; ch++) {
+		memcpy(&shared->samples[ch][start], planes[ch], first * sizeof(float));
+		memcpy(&shared->samples[ch][0], planes[ch] + first, (frames - first) * sizeof(float));
+	}
+
+	shared->write_pos.store(pos + frames, std::memory_order_release);
+}
+
+uint32_t win_spout_audio_shared_read(struct win_spout_audio_shared *shared, struct win_spout_audio_reader *reader,
+				     float **planes, uint32_t max_frames, uint64_t *timestamp)
+{
+	if (shared->version.load(std::memory_order_acquire) != WIN_SPOUT_AUDIO_VERSION) {
+		return 0;
+	}
+
+	uint64_t session = shared->session.load(std::memory_order_acquire);
+	uint64_t write_pos = shared->write_pos.load(std::memory_order_acquire);
+
+	// a new writer (or one we've somehow got ahead of) starts us over
+	if (reader->session != session || reader->read_pos > write_pos) {
+		reader->session = session;
+		reader->read_pos = write_pos;
+		return 0;
+	}
+
+	// fell too far behind, drop to a quarter of the ring behind the writer
+	if (write_pos - reader->read_pos > WIN_SPOUT_AUDIO_CAPACITY * 3 / 4) {
+		reader->read_pos = write_pos - WIN_SPOUT_AUDIO_CAPACITY / 4;
+		reader->overruns++;
+	}
+
+	uint64_t pos = reader->read_pos;
+	uint64_t available = write_pos - pos;
+	uint32_t frames = available < max_frames ? (uint32_t)available : max_frames;
+	if (!frames) {
+		return 0;
+	}
+
+	uint64_t anchor_pos, anchor_ts, next_anchor;
+	if (!audio_find_anchor(shared, pos, &anchor_pos, &anchor_ts, &next_anchor)) {
+		// the anchor for these samples is gone, skip ahead to what we can place
+		reader->read_pos = write_pos;
+		reader->overruns++;
+		return 0;
+	}
+
+	// stop at the next timestamp jump so each read is continuous
+	if (next_anchor - pos < frames) {
+		frames = (uint32_t)(next_anchor - pos);
+	}
+
+	uint32_t channels = shared->channels;
+	uint32_t start = (uint32_t)(pos & AUDIO_MASK);
+	uint32_t first = frames < WIN_SPOUT_AUDIO_CAPACITY - start ? frames : WIN_SPOUT_AUDIO_CAPACITY - start;
+	for (uint32_t ch = 0; ch < channels; ch++) {
+		memcpy(planes[ch], &shared->samples[ch][start], first * sizeof(float));
+		memcpy(planes[ch] + first, &shared->samples[ch][0], (frames - first) * sizeof(float));
+	}
+
+	// the writer may have lapped us while we were copying
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t after = shared->write_pos.load(std::memory_order_relaxed);
+	if (shared->session.load(std::memory_order_relaxed) != session ||
+	    after - pos + AUDIO_WRITE_MARGIN > WIN_SPOUT_AUDIO_CAPACITY) {
+		reader->read_pos = after;
+		reader->overruns++;
+		return 0;
+	}
+
+	*timestamp = audio_pos_to_ts(shared->sample_rate, anchor_pos, anchor_ts, pos);
+	reader->read_pos = pos + frames;
+	return frames;
+}
+
+static struct win_spout_audio *win_spout_audio_map(const char *sender_name, bool create)
+{
+	if (!sender_name || !*sender_name) {
+		return nullptr;
+	}
+
+	struct dstr name = {};
+	dstr_printf(&name, "%s" AUDIO_SUFFIX, sender_name);
+	struct win_spout_shm_section *section =
+		create ? win_spout_shm_section_create(name.array, sizeof(struct win_spout_audio_shared))
+		       : win_spout_shm_section_open(name.array, sizeof(struct win_spout_audio_shared), true);
+	dstr_free(&name);
+
+	if (!section) {
+		return nullptr;
+	}
+
+	struct win_spout_audio *audio = (win_spout_audio *)bzalloc(sizeof(win_spout_audio));
+	audio->section = section;
+	audio->shared = (struct win_spout_audio_shared *)win_spout_shm_section_data(section);
+	audio->writer = create;
+	return audio;
+}
+
+struct win_spout_audio *win_spout_audio_create(const char *sender_name, uint32_t sample_rate, uint32_t channels)
+{
+	struct win_spout_audio *audio = win_spout_audio_map(sender_name, true);
+	if (!audio) {
+		blog(LOG_WARNING, "Failed to create shared audio for sender %s", sender_name);
+		return nullptr;
+	}
+
+	win_spout_audio_shared_init(audio->shared, sample_rate, channels, os_gettime_ns());
+	return audio;
+}
+
+struct win_spout_audio *win_spout_audio_open(const char *sender_name)
+{
+	return win_spout_audio_map(sender_name, false);
+}
+
+void win_spout_audio_destroy(struct win_spout_audio *audio)
+{
+	if (!audio) {
+		return;
+	}
+
+	// readers keep the section open, tell them there's nothing more coming
+	if (audio->writer) {
+		win_spout_audio_shared_close(audio->shared);
+	}
+	win_spout_shm_section_destroy(audio->section);
+	bfree(audio);
+}
+
+struct win_spout_audio_shared *win_spout_audio_get_shared(struct win_spout_audio *audio)
+{
+	return audio ? audio->shared : nullptr;
+}
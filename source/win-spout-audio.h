@@ -0,0 +1,74 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTAUDIO_H
+#define WINSPOUTAUDIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WIN_SPOUT_AUDIO_VERSION 2
+#define WIN_SPOUT_AUDIO_MAX_CHANNELS 8
+// ~1.3s at 48kHz, a power of two so positions wrap with a mask
+#define WIN_SPOUT_AUDIO_CAPACITY 65536
+
+/**
+ * Single producer ring of planar float PCM shared next to a sender in a
+ * named shared memory section ("<sender name>_OBSAudio").
+ *
+ * Positions are running frame counts: the writer copies the samples and
+ * then publishes its new position, readers keep their own position and
+ * check after copying that the writer hasn't lapped them. Timestamps are
+ * os_gettime_ns() values derived from an anchor that the writer moves
+ * whenever OBS's audio timestamps jump.
+ *
+ * The win_spout_audio_shared_* functions only touch the block they are
+ * given, so they work on any memory, mapped or not.
+ */
+struct win_spout_audio_shared;
+
+struct win_spout_audio_reader {
+	uint64_t session;
+	uint64_t read_pos;
+	uint64_t overruns;
+};
+
+size_t win_spout_audio_shared_size();
+void win_spout_audio_shared_init(struct win_spout_audio_shared *shared, uint32_t sample_rate, uint32_t channels,
+				 uint64_t session);
+void win_spout_audio_shared_write(struct win_spout_audio_shared *shared, const float *const *planes,
+				  uint32_t frames, uint64_t timestamp);
+// Marks the ring as abandoned by its writer
+void win_spout_audio_shared_close(struct win_spout_audio_shared *shared);
+// false once the writer has closed the ring, or if it isn't a valid ring (yet)
+bool win_spout_audio_shared_alive(struct win_spout_audio_shared *shared);
+// The writer's running frame count, to tell whether it's still writing
+uint64_t win_spout_audio_shared_write_pos(struct win_spout_audio_shared *shared);
+// Returns false if the block isn't a valid ring (yet)
+bool win_spout_audio_shared_format(struct win_spout_audio_shared *shared, uint32_t *sample_rate,
+				   uint32_t *channels);
+/**
+ * Copies up to max_frames of the oldest unread samples into planes
+ * (one per channel). Returns the number of frames read and the
+ * timestamp of the first one. A new reader starts at the newest sample.
+ */
+uint32_t win_spout_audio_shared_read(struct win_spout_audio_shared *shared, struct win_spout_audio_reader *reader,
+				     float **planes, uint32_t max_frames, uint64_t *timestamp);
+
+struct win_spout_audio;
+
+// Sender side: creates (or takes over) the section for the sender name, destroying it closes the ring
+struct win_spout_audio *win_spout_audio_create(const char *sender_name, uint32_t sample_rate, uint32_t channels);
+// Receiver side: returns nullptr if the sender doesn't share audio
+struct win_spout_audio *win_spout_audio_open(const char *sender_name);
+void win_spout_audio_destroy(struct win_spout_audio *audio);
+
+struct win_spout_audio_shared *win_spout_audio_get_shared(struct win_spout_audio *audio);
+
+#endif // WINSPOUTAUDIO_H
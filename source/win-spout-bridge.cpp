@@ -0,0 +1,883 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifdef _WIN32
+// winsock2 has to come before anything that pulls in windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+// BSD sockets, so the bridge also runs over loopback on Linux (see tests/test-bridge.cpp)
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <limits.h>
+#include <stdio.h>
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-bridge.h"
+#include "win-spout-codec.h"
+#include "win-spout-frame-pool.h"
+
+#define BRIDGE_MAGIC 0x52425053 // "SPBR"
+#define BRIDGE_MAX_SLICES 16
+#define BRIDGE_MIN_SLICE_ROWS 32
+#define BRIDGE_MAX_DIMENSION 16384
+// a stuck receiver is dropped, slow ones only skip frames
+#define BRIDGE_IO_TIMEOUT_MS 1000
+// how often the thread goes back to receivers it's part way through sending to
+#define BRIDGE_PUMP_MS 2
+#define BRIDGE_RECONNECT_NS 1000000000ULL
+#define BRIDGE_STATS_NS 10000000000ULL
+
+#ifdef _WIN32
+#define BRIDGE_SEND_FLAGS 0
+
+static bool bridge_startup()
+{
+	WSADATA wsa;
+	return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+}
+
+static void bridge_cleanup()
+{
+	WSACleanup();
+}
+
+static int bridge_last_error()
+{
+	return WSAGetLastError();
+}
+
+static bool bridge_would_block()
+{
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+#else
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+// a receiver going away mid-send is an error from send(), not SIGPIPE
+#define BRIDGE_SEND_FLAGS MSG_NOSIGNAL
+#define closesocket close
+
+static bool bridge_startup()
+{
+	return true;
+}
+
+static void bridge_cleanup() {}
+
+static int bridge_last_error()
+{
+	return errno;
+}
+
+static bool bridge_would_block()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+#endif
+
+// Sent ahead of every frame, followed by one uint32_t size per slice and
+// then the slices themselves. Both ends are little endian.
+#pragma pack(push, 1)
+struct bridge_frame_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slices;
+	uint32_t width;
+	uint32_t height;
+	uint64_t frame_number;
+	uint64_t send_time;
+};
+#pragma pack(pop)
+
+// Work for one slice, shared by encode and decode
+struct bridge_slice {
+	uint32_t first_row;
+	uint32_t rows;
+	uint8_t *data;
+	size_t size;
+	uint64_t time_ns;
+	bool ok;
+};
+
+struct bridge_job {
+	uint8_t *pixels;
+	uint32_t width;
+	uint32_t pitch;
+	struct bridge_slice slices[BRIDGE_MAX_SLICES];
+};
+
+static inline size_t min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
+static uint32_t bridge_slice_count(uint32_t height)
+{
+	uint32_t slices = height / BRIDGE_MIN_SLICE_ROWS;
+	if (slices > BRIDGE_MAX_SLICES)
+		slices = BRIDGE_MAX_SLICES;
+	return slices ? slices : 1;
+}
+
+static void bridge_layout_slices(struct bridge_job *job, uint32_t height, uint32_t count)
+{
+	uint32_t rows = (height + count - 1) / count;
+	for (uint32_t i = 0; i < count; i++) {
+		struct bridge_slice *slice = &job->slices[i];
+		slice->first_row = i * rows;
+		uint32_t left = slice->first_row < height ? height - slice->first_row : 0;
+		slice->rows = left < rows ? left : rows;
+	}
+}
+
+static struct win_spout_slice_pool *bridge_create_pool()
+{
+	// the calling thread takes a share of the slices too
+	int threads = os_get_logical_cores() - 1;
+	if (threads > BRIDGE_MAX_SLICES - 1)
+		threads = BRIDGE_MAX_SLICES - 1;
+	return win_spout_slice_pool_create(threads > 0 ? (uint32_t)threads : 0);
+}
+
+// send and recv take an int length
+static int bridge_io_size(size_t size)
+{
+	return size < (size_t)INT_MAX ? (int)size : INT_MAX;
+}
+
+static bool bridge_recv_all(SOCKET sock, uint8_t *data, size_t size)
+{
+	while (size) {
+		int received = recv(sock, (char *)data, bridge_io_size(size), 0);
+		if (received <= 0)
+			return false;
+		data += received;
+		size -= (size_t)received;
+	}
+	return true;
+}
+
+// The sender writes to its receivers without blocking, so one slow receiver can't hold up the others
+static void bridge_set_nonblocking(SOCKET sock)
+{
+	int nodelay = 1;
+#ifdef _WIN32
+	u_long nonblocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+}
+
+static void bridge_set_timeouts(SOCKET sock)
+{
+#ifdef _WIN32
+	DWORD timeout = BRIDGE_IO_TIMEOUT_MS;
+#else
+	timeval timeout = {BRIDGE_IO_TIMEOUT_MS / 1000, (BRIDGE_IO_TIMEOUT_MS % 1000) * 1000};
+#endif
+	int nodelay = 1;
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+}
+
+// A connected receiver and the frame it's being sent, which it has a copy of
+struct bridge_client {
+	SOCKET sock;
+	uint8_t *packet;
+	size_t capacity;
+	size_t size;
+	size_t sent;
+	uint64_t last_progress;
+};
+
+struct win_spout_bridge_sender {
+	char name[256];
+	SOCKET listener;
+
+	// mutex guards the [SHARED] fields, written from send()
+	pthread_mutex_t mutex;
+
+	// [SHARED] newest frame not yet picked up by the thread
+	struct win_spout_frame_buffer *pending;
+	uint32_t pending_pitch;
+	uint32_t pending_width;
+	uint32_t pending_height;
+	uint64_t pending_send_time;
+	bool has_pending;
+	uint64_t dropped;
+
+	// [THREAD]
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *stop_event;
+	os_event_t *frame_event;
+	DARRAY(struct bridge_client) clients;
+	struct win_spout_slice_pool *pool;
+	struct win_spout_frame_buffer *frame;
+	uint8_t *packet;
+	size_t packet_capacity;
+	uint64_t frame_number;
+
+	// [THREAD] stats since the last report
+	uint64_t stats_start;
+	uint64_t stats_frames;
+	uint64_t stats_raw_bytes;
+	uint64_t stats_coded_bytes;
+	uint64_t stats_slices;
+	uint64_t stats_slice_ns;
+	uint64_t stats_client_skips; // frames a receiver missed while still taking the previous one
+};
+
+static void bridge_encode_slice(void *param, uint32_t index)
+{
+	struct bridge_job *job = (bridge_job *)param;
+	struct bridge_slice *slice = &job->slices[index];
+
+	uint64_t start = os_gettime_ns();
+	slice->size = win_spout_codec_encode(job->pixels + (size_t)slice->first_row * job->pitch, job->pitch,
+					     job->width, slice->rows, slice->data);
+	slice->time_ns = os_gettime_ns() - start;
+}
+
+static void bridge_sender_accept(struct win_spout_bridge_sender *sender)
+{
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(sender->listener, &readable);
+	timeval no_wait = {};
+
+	// winsock ignores select's first argument, elsewhere it's the highest socket + 1
+	while (select((int)sender->listener + 1, &readable, NULL, NULL, &no_wait) > 0) {
+		struct bridge_client client = {};
+		client.sock = accept(sender->listener, NULL, NULL);
+		if (client.sock == INVALID_SOCKET)
+			break;
+
+		bridge_set_nonblocking(client.sock);
+		da_push_back(sender->clients, &client);
+		blog(LOG_INFO, "[%s] Bridge receiver connected (%zu total)", sender->name, sender->clients.num);
+
+		FD_ZERO(&readable);
+		FD_SET(sender->listener, &readable);
+	}
+}
+
+static void bridge_sender_report(struct win_spout_bridge_sender *sender, uint64_t now)
+{
+	pthread_mutex_lock(&sender->mutex);
+	uint64_t dropped = sender->dropped;
+	sender->dropped = 0;
+	pthread_mutex_unlock(&sender->mutex);
+
+	if (sender->stats_frames) {
+		blog(LOG_INFO,
+		     "[%s] Bridge sent %llu frames (%llu skipped, %llu skipped by slow receivers) to %zu receivers, "
+		     "ratio %.2f:1, %.1f MB/s, encode %.0f us/slice",
+		     sender->name, (unsigned long long)sender->stats_frames, (unsigned long long)dropped,
+		     (unsigned long long)sender->stats_client_skips, sender->clients.num,
+		     sender->stats_coded_bytes ? (double)sender->stats_raw_bytes / sender->stats_coded_bytes : 0.0,
+		     (double)sender->stats_coded_bytes / ((double)(now - sender->stats_start) / 1000.0),
+		     sender->stats_slices ? (double)sender->stats_slice_ns / sender->stats_slices / 1000.0 : 0.0);
+	}
+
+	sender->stats_start = now;
+	sender->stats_frames = 0;
+	sender->stats_raw_bytes = 0;
+	sender->stats_coded_bytes = 0;
+	sender->stats_slices = 0;
+	sender->stats_slice_ns = 0;
+	sender->stats_client_skips = 0;
+}
+
+static inline bool bridge_client_busy(const struct bridge_client *client)
+{
+	return client->sent < client->size;
+}
+
+// Sends as much of the client's frame as its socket takes, false if the client has to go
+static bool bridge_client_pump(struct bridge_client *client, uint64_t now)
+{
+	while (bridge_client_busy(client)) {
+		int sent = send(client->sock, (const char *)client->packet + client->sent,
+				bridge_io_size(client->size - client->sent), BRIDGE_SEND_FLAGS);
+		if (sent > 0) {
+			client->sent += (size_t)sent;
+			client->last_progress = now;
+		} else if (sent < 0 && bridge_would_block()) {
+			return now - client->last_progress < (uint64_t)BRIDGE_IO_TIMEOUT_MS * 1000000;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void bridge_sender_pump(struct win_spout_bridge_sender *sender)
+{
+	uint64_t now = os_gettime_ns();
+	for (size_t i = sender->clients.num; i > 0; i--) {
+		struct bridge_client *client = &sender->clients.array[i - 1];
+		if (!bridge_client_pump(client, now)) {
+			closesocket(client->sock);
+			bfree(client->packet);
+			da_erase(sender->clients, i - 1);
+			blog(LOG_INFO, "[%s] Bridge receiver disconnected (%zu left)", sender->name,
+			     sender->clients.num);
+		}
+	}
+}
+
+static bool bridge_sender_busy(struct win_spout_bridge_sender *sender)
+{
+	for (size_t i = 0; i < sender->clients.num; i++) {
+		if (bridge_client_busy(&sender->clients.array[i]))
+			return true;
+	}
+	return false;
+}
+
+static void bridge_sender_send_frame(struct win_spout_bridge_sender *sender, uint32_t width, uint32_t height,
+				     uint32_t pitch, uint64_t send_time)
+{
+	struct bridge_job job = {};
+	job.pixels = sender->frame->data;
+	job.width = width;
+	job.pitch = pitch;
+
+	uint32_t count = bridge_slice_count(height);
+	bridge_layout_slices(&job, height, count);
+
+	// one packet holding the header, slice sizes and the worst case of every slice
+	size_t offset = sizeof(struct bridge_frame_header) + count * sizeof(uint32_t);
+	size_t needed = offset;
+	for (uint32_t i = 0; i < count; i++)
+		needed += win_spout_codec_max_size(width, job.slices[i].rows);
+	if (needed > sender->packet_capacity) {
+		sender->packet = (uint8_t *)brealloc(sender->packet, needed);
+		sender->packet_capacity = needed;
+	}
+
+	// slices are coded into place and packed down afterwards
+	size_t slot = offset;
+	for (uint32_t i = 0; i < count; i++) {
+		job.slices[i].data = sender->packet + slot;
+		slot += win_spout_codec_max_size(width, job.slices[i].rows);
+	}
+
+	win_spout_slice_pool_run(sender->pool, bridge_encode_slice, &job, count);
+
+	struct bridge_frame_header header = {};
+	header.magic = BRIDGE_MAGIC;
+	header.version = WIN_SPOUT_BRIDGE_VERSION;
+	header.slices = (uint16_t)count;
+	header.width = width;
+	header.height = height;
+	header.frame_number = ++sender->frame_number;
+	header.send_time = send_time;
+	memcpy(sender->packet, &header, sizeof(header));
+
+	uint32_t *sizes = (uint32_t *)(sender->packet + sizeof(header));
+	size_t size = offset;
+	for (uint32_t i = 0; i < count; i++) {
+		struct bridge_slice *slice = &job.slices[i];
+		sizes[i] = (uint32_t)slice->size;
+		memmove(sender->packet + size, slice->data, slice->size);
+		size += slice->size;
+
+		sender->stats_slices++;
+		sender->stats_slice_ns += slice->time_ns;
+	}
+
+	// a receiver still taking the last frame skips this one
+	uint64_t now = os_gettime_ns();
+	for (size_t i = 0; i < sender->clients.num; i++) {
+		struct bridge_client *client = &sender->clients.array[i];
+		if (bridge_client_busy(client)) {
+			sender->stats_client_skips++;
+			continue;
+		}
+		if (size > client->capacity) {
+			client->packet = (uint8_t *)brealloc(client->packet, size);
+			client->capacity = size;
+		}
+		memcpy(client->packet, sender->packet, size);
+		client->size = size;
+		client->sent = 0;
+		client->last_progress = now;
+	}
+	bridge_sender_pump(sender);
+
+	sender->stats_frames++;
+	sender->stats_raw_bytes += (uint64_t)width * height * 4;
+	sender->stats_coded_bytes += size;
+}
+
+static void *bridge_sender_thread(void *data)
+{
+	struct win_spout_bridge_sender *sender = (win_spout_bridge_sender *)data;
+	os_set_thread_name("spout-bridge-sender");
+
+	sender->stats_start = os_gettime_ns();
+
+	while (os_event_try(sender->stop_event) == EAGAIN) {
+		bridge_sender_accept(sender);
+
+		uint64_t now = os_gettime_ns();
+		if (now - sender->stats_start >= BRIDGE_STATS_NS) {
+			bridge_sender_report(sender, now);
+		}
+
+		// part sent frames are carried on with while waiting for the next
+		bridge_sender_pump(sender);
+		if (os_event_timedwait(sender->frame_event, bridge_sender_busy(sender) ? BRIDGE_PUMP_MS : 100) != 0) {
+			continue;
+		}
+
+		// swap the pending frame for our buffer, send() reuses the old one
+		pthread_mutex_lock(&sender->mutex);
+		bool has_frame = sender->has_pending;
+		uint32_t width = sender->pending_width;
+		uint32_t height = sender->pending_height;
+		uint32_t pitch = sender->pending_pitch;
+		uint64_t send_time = sender->pending_send_time;
+		if (has_frame) {
+			struct win_spout_frame_buffer *frame = sender->frame;
+			sender->frame = sender->pending;
+			sender->pending = frame;
+			sender->has_pending = false;
+		}
+		pthread_mutex_unlock(&sender->mutex);
+
+		if (has_frame && sender->clients.num) {
+			bridge_sender_send_frame(sender, width, height, pitch, send_time);
+		}
+	}
+
+	for (size_t i = 0; i < sender->clients.num; i++) {
+		closesocket(sender->clients.array[i].sock);
+		bfree(sender->clients.array[i].packet);
+	}
+	da_free(sender->clients);
+
+	return NULL;
+}
+
+/**
+ * Listens on address, a host name or IP address. "::" takes IPv4
+ * receivers on the same socket as IPv6 ones.
+ */
+static SOCKET bridge_listen(const char *address, uint16_t port)
+{
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *result = nullptr;
+	if (getaddrinfo(address, service, &hints, &result) != 0) {
+		return INVALID_SOCKET;
+	}
+
+	SOCKET listener = INVALID_SOCKET;
+	for (addrinfo *ai = result; ai && listener == INVALID_SOCKET; ai = ai->ai_next) {
+		listener = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (listener == INVALID_SOCKET)
+			continue;
+
+		if (ai->ai_family == AF_INET6) {
+			int v6only = 0;
+			setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6only, sizeof(v6only));
+		}
+		if (bind(listener, ai->ai_addr, (int)ai->ai_addrlen) != 0 || listen(listener, 4) != 0) {
+			closesocket(listener);
+			listener = INVALID_SOCKET;
+		}
+	}
+	freeaddrinfo(result);
+	return listener;
+}
+
+struct win_spout_bridge_sender *win_spout_bridge_sender_create(const char *name, const char *address,
+							       uint16_t port)
+{
+	if (!bridge_startup()) {
+		blog(LOG_ERROR, "Failed to start Winsock for the Spout bridge");
+		return nullptr;
+	}
+
+	struct win_spout_bridge_sender *sender = (win_spout_bridge_sender *)bzalloc(sizeof(win_spout_bridge_sender));
+	strncpy(sender->name, name ? name : "", sizeof(sender->name) - 1);
+	sender->listener = INVALID_SOCKET;
+	da_init(sender->clients);
+
+	pthread_mutex_init_value(&sender->mutex);
+	if (pthread_mutex_init(&sender->mutex, NULL) != 0 ||
+	    os_event_init(&sender->stop_event, OS_EVENT_TYPE_MANUAL) != 0 ||
+	    os_event_init(&sender->frame_event, OS_EVENT_TYPE_AUTO) != 0) {
+		blog(LOG_ERROR, "Failed to create sync objects for the Spout bridge!");
+		win_spout_bridge_sender_destroy(sender);
+		return nullptr;
+	}
+
+	if (!address || !*address) {
+		address = WIN_SPOUT_BRIDGE_DEFAULT_ADDRESS;
+	}
+	sender->listener = bridge_listen(address, port);
+	if (sender->listener == INVALID_SOCKET) {
+		blog(LOG_ERROR, "[%s] Failed to listen for bridge receivers on %s port %u (%d)", sender->name, address,
+		     port, bridge_last_error());
+		win_spout_bridge_sender_destroy(sender);
+		return nullptr;
+	}
+
+	sender->pool = bridge_create_pool();
+	if (!sender->pool || pthread_create(&sender->thread, NULL, bridge_sender_thread, sender) != 0) {
+		blog(LOG_ERROR, "Failed to create thread for the Spout bridge!");
+		win_spout_bridge_sender_destroy(sender);
+		return nullptr;
+	}
+	sender->thread_active = true;
+
+	blog(LOG_INFO, "[%s] Bridge listening on %s port %u", sender->name, address, port);
+	return sender;
+}
+
+void win_spout_bridge_sender_destroy(struct win_spout_bridge_sender *sender)
+{
+	if (!sender) {
+		return;
+	}
+
+	if (sender->thread_active) {
+		os_event_signal(sender->stop_event);
+		pthread_join(sender->thread, NULL);
+		sender->thread_active = false;
+	}
+
+	if (sender->listener != INVALID_SOCKET) {
+		closesocket(sender->listener);
+	}
+
+	win_spout_slice_pool_destroy(sender->pool);
+	os_event_destroy(sender->frame_event);
+	os_event_destroy(sender->stop_event);
+	pthread_mutex_destroy(&sender->mutex);
+	win_spout_frame_pool_release(sender->pending);
+	win_spout_frame_pool_release(sender->frame);
+	bfree(sender->packet);
+	bfree(sender);
+
+	bridge_cleanup();
+}
+
+void win_spout_bridge_sender_send(struct win_spout_bridge_sender *sender, const uint8_t *pixels, uint32_t pitch,
+				  uint32_t width, uint32_t height)
+{
+	if (!sender || !width || !height) {
+		return;
+	}
+
+	size_t row_size = (size_t)width * 4;
+	uint32_t dst_pitch = win_spout_frame_pool_pitch((uint32_t)row_size);
+
+	pthread_mutex_lock(&sender->mutex);
+
+	// the thread hasn't picked up the last one yet
+	if (sender->has_pending) {
+		sender->dropped++;
+	}
+
+	sender->pending = win_spout_frame_pool_resize(sender->pending, (size_t)dst_pitch * height);
+	if (!sender->pending) {
+		sender->has_pending = false;
+		pthread_mutex_unlock(&sender->mutex);
+		return;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(sender->pending->data + (size_t)y * dst_pitch, pixels + (size_t)y * pitch, row_size);
+	}
+	sender->pending_pitch = dst_pitch;
+	sender->pending_width = width;
+	sender->pending_height = height;
+	sender->pending_send_time = os_gettime_ns();
+	sender->has_pending = true;
+
+	pthread_mutex_unlock(&sender->mutex);
+
+	os_event_signal(sender->frame_event);
+}
+
+struct win_spout_bridge_receiver {
+	char host[256];
+	char port[16];
+	SOCKET sock;
+	uint64_t next_connect;
+
+	struct win_spout_slice_pool *pool;
+	uint8_t *data;
+	size_t data_capacity;
+	struct win_spout_frame_buffer *pixels;
+
+	// stats since the last report
+	uint64_t stats_start;
+	uint64_t stats_frames;
+	uint64_t stats_coded_bytes;
+	uint64_t stats_slices;
+	uint64_t stats_slice_ns;
+	uint64_t stats_latency_ns;
+};
+
+static void bridge_decode_slice(void *param, uint32_t index)
+{
+	struct bridge_job *job = (bridge_job *)param;
+	struct bridge_slice *slice = &job->slices[index];
+
+	uint64_t start = os_gettime_ns();
+	slice->ok = win_spout_codec_decode(slice->data, slice->size, job->width, slice->rows,
+					   job->pixels + (size_t)slice->first_row * job->width * 4);
+	slice->time_ns = os_gettime_ns() - start;
+}
+
+static void bridge_receiver_disconnect(struct win_spout_bridge_receiver *receiver)
+{
+	if (receiver->sock != INVALID_SOCKET) {
+		closesocket(receiver->sock);
+		receiver->sock = INVALID_SOCKET;
+		blog(LOG_INFO, "Disconnected from bridge %s:%s", receiver->host, receiver->port);
+	}
+}
+
+static bool bridge_receiver_connect(struct win_spout_bridge_receiver *receiver)
+{
+	uint64_t now = os_gettime_ns();
+	if (now < receiver->next_connect) {
+		return false;
+	}
+	receiver->next_connect = now + BRIDGE_RECONNECT_NS;
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo *result = NULL;
+	if (getaddrinfo(receiver->host, receiver->port, &hints, &result) != 0) {
+		return false;
+	}
+
+	for (addrinfo *ai = result; ai; ai = ai->ai_next) {
+		SOCKET sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock == INVALID_SOCKET)
+			continue;
+		if (connect(sock, ai->ai_addr, (int)ai->ai_addrlen) == 0) {
+			bridge_set_timeouts(sock);
+			receiver->sock = sock;
+			break;
+		}
+		closesocket(sock);
+	}
+	freeaddrinfo(result);
+
+	if (receiver->sock != INVALID_SOCKET) {
+		blog(LOG_INFO, "Connected to bridge %s:%s", receiver->host, receiver->port);
+	}
+	return receiver->sock != INVALID_SOCKET;
+}
+
+static void bridge_receiver_report(struct win_spout_bridge_receiver *receiver, uint64_t now)
+{
+	if (receiver->stats_frames) {
+		blog(LOG_INFO,
+		     "Bridge %s:%s received %llu frames, %.1f MB/s, decode %.0f us/slice, latency %.2f ms (same host only)",
+		     receiver->host, receiver->port, (unsigned long long)receiver->stats_frames,
+		     (double)receiver->stats_coded_bytes / ((double)(now - receiver->stats_start) / 1000.0),
+		     receiver->stats_slices ? (double)receiver->stats_slice_ns / receiver->stats_slices / 1000.0 : 0.0,
+		     (double)receiver->stats_latency_ns / receiver->stats_frames / 1000000.0);
+	}
+
+	receiver->stats_start = now;
+	receiver->stats_frames = 0;
+	receiver->stats_coded_bytes = 0;
+	receiver->stats_slices = 0;
+	receiver->stats_slice_ns = 0;
+	receiver->stats_latency_ns = 0;
+}
+
+struct win_spout_bridge_receiver *win_spout_bridge_receiver_create(const char *address)
+{
+	if (!address || !*address) {
+		return nullptr;
+	}
+
+	if (!bridge_startup()) {
+		blog(LOG_ERROR, "Failed to start Winsock for the Spout bridge");
+		return nullptr;
+	}
+
+	struct win_spout_bridge_receiver *receiver =
+		(win_spout_bridge_receiver *)bzalloc(sizeof(win_spout_bridge_receiver));
+	receiver->sock = INVALID_SOCKET;
+
+	// "host:port", IPv6 hosts need brackets to carry a port ("[::1]:9470")
+	snprintf(receiver->port, sizeof(receiver->port), "%d", WIN_SPOUT_BRIDGE_DEFAULT_PORT);
+	const char *port = nullptr;
+	if (address[0] == '[') {
+		const char *bracket = strchr(address, ']');
+		size_t len = bracket ? (size_t)(bracket - address - 1) : strlen(address + 1);
+		strncpy(receiver->host, address + 1, min_size(len, sizeof(receiver->host) - 1));
+		if (bracket && bracket[1] == ':')
+			port = bracket + 2;
+	} else {
+		strncpy(receiver->host, address, sizeof(receiver->host) - 1);
+		char *colon = strchr(receiver->host, ':');
+		// more than one colon is a bare IPv6 address
+		if (colon && !strchr(colon + 1, ':')) {
+			*colon = '\0';
+			port = colon + 1;
+		}
+	}
+	if (port && *port) {
+		strncpy(receiver->port, port, sizeof(receiver->port) - 1);
+	}
+
+	receiver->pool = bridge_create_pool();
+	if (!receiver->pool) {
+		win_spout_bridge_receiver_destroy(receiver);
+		return nullptr;
+	}
+
+	receiver->stats_start = os_gettime_ns();
+	return receiver;
+}
+
+void win_spout_bridge_receiver_destroy(struct win_spout_bridge_receiver *receiver)
+{
+	if (!receiver) {
+		return;
+	}
+
+	bridge_receiver_disconnect(receiver);
+	win_spout_slice_pool_destroy(receiver->pool);
+	bfree(receiver->data);
+	win_spout_frame_pool_release(receiver->pixels);
+	bfree(receiver);
+
+	bridge_cleanup();
+}
+
+bool win_spout_bridge_receiver_read(struct win_spout_bridge_receiver *receiver, struct win_spout_bridge_frame *frame,
+				    uint32_t timeout_ms)
+{
+	uint64_t now = os_gettime_ns();
+	if (now - receiver->stats_start >= BRIDGE_STATS_NS) {
+		bridge_receiver_report(receiver, now);
+	}
+
+	if (receiver->sock == INVALID_SOCKET && !bridge_receiver_connect(receiver)) {
+		os_sleep_ms(timeout_ms);
+		return false;
+	}
+
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(receiver->sock, &readable);
+	timeval wait = {(long)(timeout_ms / 1000), (long)(timeout_ms % 1000) * 1000};
+	if (select((int)receiver->sock + 1, &readable, NULL, NULL, &wait) <= 0) {
+		return false;
+	}
+
+	struct bridge_frame_header header;
+	uint32_t sizes[BRIDGE_MAX_SLICES];
+	if (!bridge_recv_all(receiver->sock, (uint8_t *)&header, sizeof(header)) || header.magic != BRIDGE_MAGIC ||
+	    header.version != WIN_SPOUT_BRIDGE_VERSION || !header.slices || header.slices > BRIDGE_MAX_SLICES ||
+	    !header.width || header.width > BRIDGE_MAX_DIMENSION || !header.height ||
+	    header.height > BRIDGE_MAX_DIMENSION ||
+	    !bridge_recv_all(receiver->sock, (uint8_t *)sizes, header.slices * sizeof(uint32_t))) {
+		bridge_receiver_disconnect(receiver);
+		return false;
+	}
+
+	struct bridge_job job = {};
+	job.width = header.width;
+	bridge_layout_slices(&job, header.height, header.slices);
+
+	size_t total = 0;
+	for (uint32_t i = 0; i < header.slices; i++) {
+		if (sizes[i] > win_spout_codec_max_size(header.width, job.slices[i].rows)) {
+			bridge_receiver_disconnect(receiver);
+			return false;
+		}
+		total += sizes[i];
+	}
+
+	if (total > receiver->data_capacity) {
+		receiver->data = (uint8_t *)brealloc(receiver->data, total);
+		receiver->data_capacity = total;
+	}
+	size_t pixels_size = (size_t)header.width * header.height * 4;
+	receiver->pixels = win_spout_frame_pool_resize(receiver->pixels, pixels_size);
+	if (!receiver->pixels) {
+		bridge_receiver_disconnect(receiver);
+		return false;
+	}
+
+	if (!bridge_recv_all(receiver->sock, receiver->data, total)) {
+		bridge_receiver_disconnect(receiver);
+		return false;
+	}
+
+	job.pixels = receiver->pixels->data;
+	size_t offset = 0;
+	for (uint32_t i = 0; i < header.slices; i++) {
+		job.slices[i].data = receiver->data + offset;
+		job.slices[i].size = sizes[i];
+		offset += sizes[i];
+	}
+
+	win_spout_slice_pool_run(receiver->pool, bridge_decode_slice, &job, header.slices);
+
+	for (uint32_t i = 0; i < header.slices; i++) {
+		if (!job.slices[i].ok) {
+			blog(LOG_WARNING, "Bridge %s:%s sent a corrupt frame", receiver->host, receiver->port);
+			bridge_receiver_disconnect(receiver);
+			return false;
+		}
+		receiver->stats_slices++;
+		receiver->stats_slice_ns += job.slices[i].time_ns;
+	}
+
+	now = os_gettime_ns();
+	receiver->stats_frames++;
+	receiver->stats_coded_bytes += total;
+	receiver->stats_latency_ns += now > header.send_time ? now - header.send_time : 0;
+
+	frame->pixels = receiver->pixels->data;
+	frame->width = header.width;
+	frame->height = header.height;
+	frame->frame_number = header.frame_number;
+	frame->send_time = header.send_time;
+	return true;
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTBRIDGE_H
+#define WINSPOUTBRIDGE_H
+
+#include <stdint.h>
+
+#define WIN_SPOUT_BRIDGE_VERSION 1
+#define WIN_SPOUT_BRIDGE_DEFAULT_PORT 9470
+// frames are unauthenticated, so only this machine can connect unless told otherwise
+#define WIN_SPOUT_BRIDGE_DEFAULT_ADDRESS "127.0.0.1"
+
+/**
+ * Network bridge for frames that need to leave the machine.
+ *
+ * The sender listens on a TCP port and streams the newest BGRA frame to
+ * every connected receiver, coded with win-spout-codec in slices that are
+ * encoded and decoded in parallel. Frames that arrive while the previous
+ * one is still being coded are dropped, so a slow link adds no latency,
+ * and a receiver still taking the previous frame skips the new one, so a
+ * slow receiver doesn't hold up the others.
+ *
+ * Both sides log throughput, compression ratio and per slice coding
+ * times every few seconds. Frames carry their send time, so on a single
+ * host (eg. over loopback) the receiver also reports the added latency.
+ */
+struct win_spout_bridge_sender;
+struct win_spout_bridge_receiver;
+
+struct win_spout_bridge_frame {
+	const uint8_t *pixels; // tightly packed BGRA, valid until the next read
+	uint32_t width;
+	uint32_t height;
+	uint64_t frame_number;
+	uint64_t send_time; // os_gettime_ns() on the sender
+};
+
+// address is the host / IP to listen on, WIN_SPOUT_BRIDGE_DEFAULT_ADDRESS when empty
+struct win_spout_bridge_sender *win_spout_bridge_sender_create(const char *name, const char *address,
+							       uint16_t port);
+void win_spout_bridge_sender_destroy(struct win_spout_bridge_sender *sender);
+// Copies the frame for the sending thread, which may skip it if it's busy
+void win_spout_bridge_sender_send(struct win_spout_bridge_sender *sender, const uint8_t *pixels, uint32_t pitch,
+				  uint32_t width, uint32_t height);
+
+// address is "host[:port]"
+struct win_spout_bridge_receiver *win_spout_bridge_receiver_create(const char *address);
+void win_spout_bridge_receiver_destroy(struct win_spout_bridge_receiver *receiver);
+// Waits up to timeout_ms for the next frame, (re)connecting as needed
+bool win_spout_bridge_receiver_read(struct win_spout_bridge_receiver *receiver, struct win_spout_bridge_frame *frame,
+				    uint32_t timeout_ms);
+
+#endif // WINSPOUTBRIDGE_H
@@ -0,0 +1,286 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <string.h>
+#include "win-spout-codec.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CODEC_SSE2
+#endif
+
+#define OP_INDEX 0x00
+#define OP_DIFF 0x40
+#define OP_LUMA 0x80
+#define OP_RUN 0xc0
+#define OP_RGB 0xfe
+#define OP_RGBA 0xff
+#define OP_MASK 0xc0
+#define MAX_RUN 62
+
+// pixels are little endian BGRA
+#define PX_B(px) ((uint8_t)(px))
+#define PX_G(px) ((uint8_t)((px) >> 8))
+#define PX_R(px) ((uint8_t)((px) >> 16))
+#define PX_A(px) ((uint8_t)((px) >> 24))
+#define PX_MAKE(r, g, b, a)                                                                        \
+	((uint32_t)(uint8_t)(b) | ((uint32_t)(uint8_t)(g) << 8) | ((uint32_t)(uint8_t)(r) << 16) | \
+	 ((uint32_t)(a) << 24))
+
+static inline uint32_t codec_hash(uint32_t px)
+{
+	return (PX_R(px) * 3 + PX_G(px) * 5 + PX_B(px) * 7 + PX_A(px) * 11) % 64;
+}
+
+size_t win_spout_codec_max_size(uint32_t width, uint32_t rows)
+{
+	// worst case every pixel is an RGBA literal
+	return (size_t)width * rows * 5;
+}
+
+/**
+ * Length of the run of prev at the start of a row, up to limit.
+ * Flat areas are where most of the time goes, so compare four pixels at a time.
+ */
+static inline uint32_t codec_run_length(const uint32_t *row, uint32_t limit, uint32_t prev)
+{
+	uint32_t n = 0;
+#ifdef CODEC_SSE2
+	__m128i prev4 = _mm_set1_epi32((int)prev);
+	while (n + 4 <= limit) {
+		__m128i px4 = _mm_loadu_si128((const __m128i *)(row + n));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(px4, prev4)) != 0xffff)
+			break;
+		n += 4;
+	}
+#endif
+	while (n < limit && row[n] == prev)
+		n++;
+	return n;
+}
+
+size_t win_spout_codec_encode(const uint8_t *pixels, uint32_t pitch, uint32_t width, uint32_t rows, uint8_t *out)
+{
+	uint32_t index[64] = {};
+	uint32_t prev = PX_MAKE(0, 0, 0, 255);
+	uint32_t run = 0;
+	uint8_t *p = out;
+
+	for (uint32_t y = 0; y < rows; y++) {
+		const uint32_t *row = (const uint32_t *)(pixels + (size_t)y * pitch);
+		uint32_t x = 0;
+
+		while (x < width) {
+			uint32_t same = codec_run_length(row + x, width - x, prev);
+			x += same;
+			run += same;
+			while (run >= MAX_RUN) {
+				*p++ = OP_RUN | (MAX_RUN - 1);
+				run -= MAX_RUN;
+			}
+			if (x == width)
+				break;
+
+			if (run) {
+				*p++ = OP_RUN | (uint8_t)(run - 1);
+				run = 0;
+			}
+
+			uint32_t px = row[x++];
+			uint32_t h = codec_hash(px);
+			if (index[h] == px) {
+				*p++ = OP_INDEX | (uint8_t)h;
+			} else {
+				index[h] = px;
+
+				if (PX_A(px) == PX_A(prev)) {
+					int8_t vr = (int8_t)(PX_R(px) - PX_R(prev));
+					int8_t vg = (int8_t)(PX_G(px) - PX_G(prev));
+					int8_t vb = (int8_t)(PX_B(px) - PX_B(prev));
+					int8_t vg_r = (int8_t)(vr - vg);
+					int8_t vg_b = (int8_t)(vb - vg);
+
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+						*p++ = OP_DIFF | (uint8_t)((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+					} else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 &&
+						   vg_b < 8) {
+						*p++ = OP_LUMA | (uint8_t)(vg + 32);
+						*p++ = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+					} else {
+						*p++ = OP_RGB;
+						*p++ = PX_R(px);
+						*p++ = PX_G(px);
+						*p++ = PX_B(px);
+					}
+				} else {
+					*p++ = OP_RGBA;
+					*p++ = PX_R(px);
+					*p++ = PX_G(px);
+					*p++ = PX_B(px);
+					*p++ = PX_A(px);
+				}
+			}
+			prev = px;
+		}
+	}
+
+	if (run) {
+		*p++ = OP_RUN | (uint8_t)(run - 1);
+	}
+
+	return (size_t)(p - out);
+}
+
+bool win_spout_codec_decode(const uint8_t *data, size_t size, uint32_t width, uint32_t rows, uint8_t *pixels)
+{
+	uint32_t index[64] = {};
+	uint32_t px = PX_MAKE(0, 0, 0, 255);
+	uint32_t *dst = (uint32_t *)pixels;
+	size_t count = (size_t)width * rows;
+	size_t pos = 0;
+	const uint8_t *p = data;
+	const uint8_t *end = data + size;
+
+	while (pos < count) {
+		if (p >= end)
+			return false;
+
+		uint8_t op = *p++;
+		if (op == OP_RGB) {
+			if (end - p < 3)
+				return false;
+			px = PX_MAKE(p[0], p[1], p[2], PX_A(px));
+			p += 3;
+		} else if (op == OP_RGBA) {
+			if (end - p < 4)
+				return false;
+			px = PX_MAKE(p[0], p[1], p[2], p[3]);
+			p += 4;
+		} else if ((op & OP_MASK) == OP_INDEX) {
+			dst[pos++] = px = index[op];
+			continue;
+		} else if ((op & OP_MASK) == OP_DIFF) {
+			px = PX_MAKE(PX_R(px) + ((op >> 4) & 3) - 2, PX_G(px) + ((op >> 2) & 3) - 2,
+				     PX_B(px) + (op & 3) - 2, PX_A(px));
+		} else if ((op & OP_MASK) == OP_LUMA) {
+			if (p >= end)
+				return false;
+			int vg = (op & 0x3f) - 32;
+			uint8_t b2 = *p++;
+			px = PX_MAKE(PX_R(px) + vg - 8 + ((b2 >> 4) & 0x0f), PX_G(px) + vg,
+				     PX_B(px) + vg - 8 + (b2 & 0x0f), PX_A(px));
+		} else {
+			size_t run = (size_t)(op & 0x3f) + 1;
+			if (run > count - pos)
+				return false;
+			for (size_t i = 0; i < run; i++)
+				dst[pos + i] = px;
+			pos += run;
+			continue;
+		}
+
+		index[codec_hash(px)] = px;
+		dst[pos++] = px;
+	}
+
+	return p == end;
+}
+
+struct win_spout_slice_pool {
+	pthread_t *threads;
+	uint32_t thread_count;
+	os_sem_t *start;
+	os_sem_t *done;
+	volatile bool stop;
+
+	// current job, set before the workers are released
+	win_spout_slice_fn fn;
+	void *param;
+	long count;
+	volatile long next;
+};
+
+static void win_spout_slice_pool_work(struct win_spout_slice_pool *pool)
+{
+	long slice;
+	while ((slice = os_atomic_inc_long(&pool->next) - 1) < pool->count) {
+		pool->fn(pool->param, (uint32_t)slice);
+	}
+}
+
+static void *win_spout_slice_pool_thread(void *data)
+{
+	struct win_spout_slice_pool *pool = (win_spout_slice_pool *)data;
+	os_set_thread_name("spout-slice-worker");
+
+	for (;;) {
+		os_sem_wait(pool->start);
+		if (pool->stop)
+			break;
+		win_spout_slice_pool_work(pool);
+		os_sem_post(pool->done);
+	}
+	return NULL;
+}
+
+struct win_spout_slice_pool *win_spout_slice_pool_create(uint32_t threads)
+{
+	struct win_spout_slice_pool *pool = (win_spout_slice_pool *)bzalloc(sizeof(win_spout_slice_pool));
+
+	if (os_sem_init(&pool->start, 0) != 0 || os_sem_init(&pool->done, 0) != 0) {
+		win_spout_slice_pool_destroy(pool);
+		return nullptr;
+	}
+
+	pool->threads = (pthread_t *)bzalloc(sizeof(pthread_t) * threads);
+	for (uint32_t i = 0; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, win_spout_slice_pool_thread, pool) != 0)
+			break;
+		pool->thread_count++;
+	}
+	return pool;
+}
+
+void win_spout_slice_pool_destroy(struct win_spout_slice_pool *pool)
+{
+	if (!pool) {
+		return;
+	}
+
+	pool->stop = true;
+	for (uint32_t i = 0; i < pool->thread_count; i++) {
+		os_sem_post(pool->start);
+	}
+	for (uint32_t i = 0; i < pool->thread_count; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	os_sem_destroy(pool->start);
+	os_sem_destroy(pool->done);
+	bfree(pool->threads);
+	bfree(pool);
+}
+
+void win_spout_slice_pool_run(struct win_spout_slice_pool *pool, win_spout_slice_fn fn, void *param, uint32_t count)
+{
+	pool->fn = fn;
+	pool->param = param;
+	pool->count = (long)count;
+	os_atomic_set_long(&pool->next, 0);
+
+	for (uint32_t i = 0; i < pool->thread_count; i++) {
+		os_sem_post(pool->start);
+	}
+	win_spout_slice_pool_work(pool);
+	for (uint32_t i = 0; i < pool->thread_count; i++) {
+		os_sem_wait(pool->done);
+	}
+}
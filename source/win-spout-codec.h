@@ -0,0 +1,45 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTCODEC_H
+#define WINSPOUTCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Lossless intra-frame codec for 32-bit pixels, after QOI
+ * (https://qoiformat.org): each pixel is a run, an index into the 64 most
+ * recently seen colours, a small delta from the previous pixel or a
+ * literal. Frames are cut into horizontal slices that are coded
+ * independently, so slices can be encoded and decoded in parallel.
+ */
+
+// Largest possible encoding of a slice
+size_t win_spout_codec_max_size(uint32_t width, uint32_t rows);
+
+// Encodes rows of pixels (line pitch in bytes), returns the bytes written to out
+size_t win_spout_codec_encode(const uint8_t *pixels, uint32_t pitch, uint32_t width, uint32_t rows, uint8_t *out);
+// Decodes a slice into width * rows tightly packed pixels, false if the data is malformed
+bool win_spout_codec_decode(const uint8_t *data, size_t size, uint32_t width, uint32_t rows, uint8_t *pixels);
+
+/**
+ * Fixed set of worker threads that run the slices of a job, the calling
+ * thread works on slices too. Jobs run one at a time.
+ */
+struct win_spout_slice_pool;
+
+typedef void (*win_spout_slice_fn)(void *param, uint32_t slice);
+
+struct win_spout_slice_pool *win_spout_slice_pool_create(uint32_t threads);
+void win_spout_slice_pool_destroy(struct win_spout_slice_pool *pool);
+// Calls fn for every slice in [0, count) and returns once all have finished
+void win_spout_slice_pool_run(struct win_spout_slice_pool *pool, win_spout_slice_fn fn, void *param, uint32_t count);
+
+#endif // WINSPOUTCODEC_H
@@ -8,43 +8,150 @@
  */
 
 #include "win-spout-config.h"
+#include "win-spout-bridge.h"
 
 #include <obs-frontend-api.h>
 #include <util/config-file.h>
+#include <util/platform.h>
 
 #define SECTION_NAME "win_spout"
 #define PARAM_AUTO_START "auto_start"
 #define PARAM_SPOUT_OUTPUT_NAME "spout_output_name"
+#define PARAM_SHARE_DEVICE "share_device"
+#define PARAM_SHARE_AUDIO "share_audio"
+#define PARAM_BRIDGE_PORT "bridge_port"
+#define PARAM_BRIDGE_ADDRESS "bridge_address"
+#define PARAM_LARGE_PAGES "large_pages"
+#define PARAM_MEMORY_SHARE "memory_share"
+#define PARAM_SEND_THREADS "send_threads"
+#define PARAM_SEND_AFFINITY "send_affinity"
+#define PARAM_SEND_PRIORITY "send_priority"
+#define PARAM_GPU_BUDGET_MB "gpu_budget_mb"
+#define PARAM_OUTPUT_CROP "output_crop"
+#define PARAM_OUTPUT_REGIONS "output_regions"
+#define PARAM_OUTPUT_YUV_FORMAT "output_yuv_format"
+#define PARAM_OUTPUT_YUV_MATRIX "output_yuv_matrix"
+#define PARAM_SCENE_SENDERS "scene_senders"
+#define PARAM_PREVIEW_SENDER "preview_sender"
+#define MODULE_CONFIG_FILE "config.ini"
 
 win_spout_config *win_spout_config::_instance = nullptr;
 
-win_spout_config::win_spout_config() : auto_start(false), spout_output_name("OBS_Spout")
+win_spout_config::win_spout_config()
+	: auto_start(false),
+	  share_device(false),
+	  share_audio(false),
+	  bridge_port(0),
+	  bridge_address(WIN_SPOUT_BRIDGE_DEFAULT_ADDRESS),
+	  large_pages(false),
+	  memory_share(false),
+	  send_threads(0),
+	  send_affinity(0),
+	  send_priority(0),
+	  gpu_budget_mb(0),
+	  spout_output_name("OBS_Spout"),
+	  output_yuv_format("bgra"),
+	  output_yuv_matrix("709"),
+	  module_config(nullptr)
 {
-	config_t *obs_config = obs_frontend_get_user_config();
+	config_t *obs_config = get_config();
 
 	if (obs_config) {
 		config_set_default_bool(obs_config, SECTION_NAME, PARAM_AUTO_START, auto_start);
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_SHARE_DEVICE, share_device);
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_SHARE_AUDIO, share_audio);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_BRIDGE_PORT, bridge_port);
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_BRIDGE_ADDRESS, bridge_address.c_str());
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_LARGE_PAGES, large_pages);
+		config_set_default_bool(obs_config, SECTION_NAME, PARAM_MEMORY_SHARE, memory_share);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_SEND_THREADS, send_threads);
+		config_set_default_uint(obs_config, SECTION_NAME, PARAM_SEND_AFFINITY, send_affinity);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_SEND_PRIORITY, send_priority);
+		config_set_default_int(obs_config, SECTION_NAME, PARAM_GPU_BUDGET_MB, gpu_budget_mb);
 		config_set_default_string(obs_config, SECTION_NAME, PARAM_SPOUT_OUTPUT_NAME,
-					  spout_output_name.toUtf8().constData());
+					  spout_output_name.c_str());
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_OUTPUT_CROP, "");
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_OUTPUT_REGIONS, "");
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_FORMAT, output_yuv_format.c_str());
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_MATRIX, output_yuv_matrix.c_str());
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_SCENE_SENDERS, "");
+		config_set_default_string(obs_config, SECTION_NAME, PARAM_PREVIEW_SENDER, "");
 	}
 }
 
-void win_spout_config::load()
+config_t *win_spout_config::get_config()
 {
 	config_t *obs_config = obs_frontend_get_user_config();
+	if (obs_config) {
+		return obs_config;
+	}
+
+	if (!module_config) {
+		char *dir = obs_module_config_path("");
+		if (dir) {
+			os_mkdirs(dir);
+			bfree(dir);
+		}
+
+		char *path = obs_module_config_path(MODULE_CONFIG_FILE);
+		if (path) {
+			if (config_open(&module_config, path, CONFIG_OPEN_ALWAYS) != CONFIG_SUCCESS) {
+				module_config = nullptr;
+			}
+			bfree(path);
+		}
+	}
+	return module_config;
+}
+
+void win_spout_config::load()
+{
+	config_t *obs_config = get_config();
 	if (obs_config) {
 		auto_start = config_get_bool(obs_config, SECTION_NAME, PARAM_AUTO_START);
+		share_device = config_get_bool(obs_config, SECTION_NAME, PARAM_SHARE_DEVICE);
+		share_audio = config_get_bool(obs_config, SECTION_NAME, PARAM_SHARE_AUDIO);
+		bridge_port = (int)config_get_int(obs_config, SECTION_NAME, PARAM_BRIDGE_PORT);
+		bridge_address = config_get_string(obs_config, SECTION_NAME, PARAM_BRIDGE_ADDRESS);
+		large_pages = config_get_bool(obs_config, SECTION_NAME, PARAM_LARGE_PAGES);
+		memory_share = config_get_bool(obs_config, SECTION_NAME, PARAM_MEMORY_SHARE);
+		send_threads = (int)config_get_int(obs_config, SECTION_NAME, PARAM_SEND_THREADS);
+		send_affinity = config_get_uint(obs_config, SECTION_NAME, PARAM_SEND_AFFINITY);
+		send_priority = (int)config_get_int(obs_config, SECTION_NAME, PARAM_SEND_PRIORITY);
+		gpu_budget_mb = (int)config_get_int(obs_config, SECTION_NAME, PARAM_GPU_BUDGET_MB);
 		spout_output_name = config_get_string(obs_config, SECTION_NAME, PARAM_SPOUT_OUTPUT_NAME);
+		output_crop = config_get_string(obs_config, SECTION_NAME, PARAM_OUTPUT_CROP);
+		output_regions = config_get_string(obs_config, SECTION_NAME, PARAM_OUTPUT_REGIONS);
+		output_yuv_format = config_get_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_FORMAT);
+		output_yuv_matrix = config_get_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_MATRIX);
+		scene_senders = config_get_string(obs_config, SECTION_NAME, PARAM_SCENE_SENDERS);
+		preview_sender = config_get_string(obs_config, SECTION_NAME, PARAM_PREVIEW_SENDER);
 	}
 }
 
 void win_spout_config::save()
 {
-	config_t *obs_config = obs_frontend_get_user_config();
+	config_t *obs_config = get_config();
 	if (obs_config) {
 		config_set_bool(obs_config, SECTION_NAME, PARAM_AUTO_START, auto_start);
+		config_set_bool(obs_config, SECTION_NAME, PARAM_SHARE_DEVICE, share_device);
+		config_set_bool(obs_config, SECTION_NAME, PARAM_SHARE_AUDIO, share_audio);
+		config_set_int(obs_config, SECTION_NAME, PARAM_BRIDGE_PORT, bridge_port);
+		config_set_string(obs_config, SECTION_NAME, PARAM_BRIDGE_ADDRESS, bridge_address.c_str());
+		config_set_bool(obs_config, SECTION_NAME, PARAM_LARGE_PAGES, large_pages);
+		config_set_bool(obs_config, SECTION_NAME, PARAM_MEMORY_SHARE, memory_share);
+		config_set_int(obs_config, SECTION_NAME, PARAM_SEND_THREADS, send_threads);
+		config_set_uint(obs_config, SECTION_NAME, PARAM_SEND_AFFINITY, send_affinity);
+		config_set_int(obs_config, SECTION_NAME, PARAM_SEND_PRIORITY, send_priority);
+		config_set_int(obs_config, SECTION_NAME, PARAM_GPU_BUDGET_MB, gpu_budget_mb);
 		config_set_string(obs_config, SECTION_NAME, PARAM_SPOUT_OUTPUT_NAME,
-				  spout_output_name.toUtf8().constData());
+				  spout_output_name.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_OUTPUT_CROP, output_crop.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_OUTPUT_REGIONS, output_regions.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_FORMAT, output_yuv_format.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_OUTPUT_YUV_MATRIX, output_yuv_matrix.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_SCENE_SENDERS, scene_senders.c_str());
+		config_set_string(obs_config, SECTION_NAME, PARAM_PREVIEW_SENDER, preview_sender.c_str());
 		config_save(obs_config);
 	}
 }
@@ -56,3 +163,14 @@ win_spout_config *win_spout_config::get()
 	}
 	return _instance;
 }
+
+void win_spout_config::release()
+{
+	if (!_instance) {
+		return;
+	}
+
+	config_close(_instance->module_config);
+	delete _instance;
+	_instance = nullptr;
+}
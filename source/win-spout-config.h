@@ -10,21 +10,60 @@
 #ifndef WINSPOUTCONFIG_H
 #define WINSPOUTCONFIG_H
 
-#include <QString>
+#include <string>
 #include <obs-module.h>
+#include <util/config-file.h>
 
 class win_spout_config {
 public:
 	win_spout_config();
 	static win_spout_config *get();
+	// Closes the plugin's own config file, if it was opened, and frees the instance
+	static void release();
 	void load();
 	void save();
 
 	bool auto_start;
-	QString spout_output_name;
+	bool share_device;
+	// share program audio in a ring next to the output's sender
+	bool share_audio;
+	// TCP port to stream the output to other machines on, 0 to disable
+	int bridge_port;
+	// address the bridge listens on, loopback only by default as frames are unauthenticated
+	std::string bridge_address;
+	// back CPU frame buffers with large pages, needs "Lock pages in memory"
+	bool large_pages;
+	// share the output's frame in memory as well, sending only changed tiles
+	bool memory_share;
+	// plugin send worker threads, 0 sends on OBS's video thread
+	int send_threads;
+	// cores the send workers are pinned to, one each in turn, 0 for any
+	uint64_t send_affinity;
+	// win_spout_send_priority of the send workers
+	int send_priority;
+	// texture memory the plugin's filters and sources may hold before idle ones release theirs, 0 for no limit
+	int gpu_budget_mb;
+	std::string spout_output_name;
+	// "x,y,WIDTHxHEIGHT" region of the program to share, empty for all of it
+	std::string output_crop;
+	// extra "name@x,y,WIDTHxHEIGHT" senders, separated by semicolons
+	std::string output_regions;
+	// the output's main sender format, "bgra", "nv12" or "p010", and its YUV matrix, "709" or "2020"
+	std::string output_yuv_format;
+	std::string output_yuv_matrix;
+	// scenes sent through their own view, "Scene=Sender[:WIDTHxHEIGHT[:divisor[:nv12|p010[:709|2020]]]]"
+	// separated by semicolons
+	std::string scene_senders;
+	// studio mode preview, "Sender[:WIDTHxHEIGHT[:divisor[:nv12|p010[:709|2020]]]]", empty to disable
+	std::string preview_sender;
 
 private:
 	static win_spout_config *_instance;
+
+	// Falls back to the plugin's own config file when the frontend
+	// has no user config (eg. headless instances)
+	config_t *get_config();
+	config_t *module_config;
 };
 
 #endif // WINSPOUTCONFIG_H
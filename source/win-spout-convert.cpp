@@ -0,0 +1,181 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <string.h>
+#include "win-spout-convert.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#endif
+
+// coefficients in R G B order
+static const int convert_y[3] = {47, 157, 16};
+static const int convert_u[3] = {-26, -86, 112};
+static const int convert_v[3] = {112, -102, -10};
+
+size_t win_spout_convert_frame_size(enum win_spout_convert_format format, uint32_t width, uint32_t height)
+{
+	size_t chroma = (size_t)win_spout_convert_chroma_size(width) * win_spout_convert_chroma_size(height);
+	return format == WIN_SPOUT_CONVERT_NONE ? (size_t)width * height * 4 : (size_t)width * height + chroma * 2;
+}
+
+// px holds the channels in memory order, r / b are their indices
+static inline uint8_t convert_dot(const int *coeffs, const int *px, int r, int b, int offset)
+{
+	return (uint8_t)(((coeffs[0] * px[r] + coeffs[1] * px[1] + coeffs[2] * px[b] + 128) >> 8) + offset);
+}
+
+static void convert_luma_scalar(const uint8_t *src, bool rgba, uint32_t from, uint32_t width, uint8_t *dst)
+{
+	const int r = rgba ? 0 : 2;
+	const int b = rgba ? 2 : 0;
+	for (uint32_t x = from; x < width; x++) {
+		const uint8_t *p = src + (size_t)x * 4;
+		int px[3] = {p[0], p[1], p[2]};
+		dst[x] = convert_dot(convert_y, px, r, b, 16);
+	}
+}
+
+// Chroma blocks from column block from on, rows top and bottom (the same row at an odd bottom edge)
+static void convert_chroma_scalar(const uint8_t *top, const uint8_t *bottom, bool rgba, uint32_t from,
+				  uint32_t width, uint8_t *u, uint8_t *v, uint32_t step)
+{
+	const int r = rgba ? 0 : 2;
+	const int b = rgba ? 2 : 0;
+	const uint32_t blocks = win_spout_convert_chroma_size(width);
+	for (uint32_t c = from; c < blocks; c++) {
+		size_t left = (size_t)c * 2 * 4;
+		size_t right = c * 2 + 1 < width ? left + 4 : left;
+		int avg[3];
+		for (int ch = 0; ch < 3; ch++) {
+			avg[ch] = (top[left + ch] + top[right + ch] + bottom[left + ch] + bottom[right + ch] + 2) >> 2;
+		}
+		u[c * step] = convert_dot(convert_u, avg, r, b, 128);
+		v[c * step] = convert_dot(convert_v, avg, r, b, 128);
+	}
+}
+
+#ifdef CONVERT_SSE2
+
+// Coefficients laid out for two pixels of 16 bit channels in memory order
+static inline __m128i convert_coeffs(const int *coeffs, bool rgba)
+{
+	short c0 = (short)(rgba ? coeffs[0] : coeffs[2]);
+	short c2 = (short)(rgba ? coeffs[2] : coeffs[0]);
+	short c1 = (short)coeffs[1];
+	return _mm_setr_epi16(c0, c1, c2, 0, c0, c1, c2, 0);
+}
+
+// Dot products of four pixels, lo holding the 16 bit channels of the first two and hi of the last two
+static inline __m128i convert_dot4(__m128i lo, __m128i hi, __m128i coeffs)
+{
+	// madd leaves two partial sums a pixel, gather and add them
+	__m128i l = _mm_shuffle_epi32(_mm_madd_epi16(lo, coeffs), _MM_SHUFFLE(3, 1, 2, 0));
+	__m128i h = _mm_shuffle_epi32(_mm_madd_epi16(hi, coeffs), _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_add_epi32(_mm_unpacklo_epi64(l, h), _mm_unpackhi_epi64(l, h));
+}
+
+static inline __m128i convert_finish(__m128i dot, int offset)
+{
+	return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(dot, _mm_set1_epi32(128)), 8), _mm_set1_epi32(offset));
+}
+
+// Returns the number of pixels converted, a multiple of eight
+static uint32_t convert_luma_sse2(const uint8_t *src, bool rgba, uint32_t width, uint8_t *dst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coeffs = convert_coeffs(convert_y, rgba);
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(src + (size_t)x * 4));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(src + (size_t)x * 4 + 16));
+		__m128i y0 = convert_finish(
+			convert_dot4(_mm_unpacklo_epi8(p0, zero), _mm_unpackhi_epi8(p0, zero), coeffs), 16);
+		__m128i y1 = convert_finish(
+			convert_dot4(_mm_unpacklo_epi8(p1, zero), _mm_unpackhi_epi8(p1, zero), coeffs), 16);
+		__m128i y16 = _mm_packs_epi32(y0, y1);
+		_mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(y16, y16));
+	}
+	return x;
+}
+
+// Rounded 2x2 averages of the two blocks in four pixels of top and bottom, in the low and high half
+static inline __m128i convert_block_avg(__m128i top, __m128i bottom)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+	__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+	__m128i sums = _mm_unpacklo_epi64(_mm_add_epi16(left, _mm_srli_si128(left, 8)),
+					  _mm_add_epi16(right, _mm_srli_si128(right, 8)));
+	return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+}
+
+// Returns the number of chroma blocks converted, a multiple of four
+static uint32_t convert_chroma_sse2(const uint8_t *top, const uint8_t *bottom, bool rgba, uint32_t width, uint8_t *u,
+				   uint8_t *v, uint32_t step)
+{
+	const __m128i coeffs_u = convert_coeffs(convert_u, rgba);
+	const __m128i coeffs_v = convert_coeffs(convert_v, rgba);
+	uint32_t c = 0;
+	for (; c * 2 + 8 <= width; c += 4) {
+		const size_t offset = (size_t)c * 8;
+		__m128i avg01 = convert_block_avg(_mm_loadu_si128((const __m128i *)(top + offset)),
+						  _mm_loadu_si128((const __m128i *)(bottom + offset)));
+		__m128i avg23 = convert_block_avg(_mm_loadu_si128((const __m128i *)(top + offset + 16)),
+						  _mm_loadu_si128((const __m128i *)(bottom + offset + 16)));
+
+		__m128i u4 = convert_finish(convert_dot4(avg01, avg23, coeffs_u), 128);
+		__m128i v4 = convert_finish(convert_dot4(avg01, avg23, coeffs_v), 128);
+		// u0 u1 u2 u3 v0 v1 v2 v3
+		__m128i uv = _mm_packus_epi16(_mm_packs_epi32(u4, v4), _mm_setzero_si128());
+
+		if (step == 2) {
+			// u == v - 1, the chroma is interleaved
+			_mm_storel_epi64((__m128i *)(u + c * 2), _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 4)));
+		} else {
+			int u_bytes = _mm_cvtsi128_si32(uv);
+			int v_bytes = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+			memcpy(u + c, &u_bytes, 4);
+			memcpy(v + c, &v_bytes, 4);
+		}
+	}
+	return c;
+}
+
+#endif // CONVERT_SSE2
+
+void win_spout_convert(enum win_spout_convert_format format, const uint8_t *src, uint32_t src_linesize, bool rgba,
+		       uint32_t width, uint32_t height, uint8_t *const *planes, const uint32_t *linesizes)
+{
+	const bool nv12 = format == WIN_SPOUT_CONVERT_NV12;
+	const uint32_t step = nv12 ? 2 : 1;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = src + (size_t)y * src_linesize;
+		uint8_t *dst = planes[0] + (size_t)y * linesizes[0];
+		uint32_t done = 0;
+#ifdef CONVERT_SSE2
+		done = convert_luma_sse2(row, rgba, width, dst);
+#endif
+		convert_luma_scalar(row, rgba, done, width, dst);
+	}
+
+	for (uint32_t r = 0; r < win_spout_convert_chroma_size(height); r++) {
+		const uint8_t *top = src + (size_t)r * 2 * src_linesize;
+		const uint8_t *bottom = r * 2 + 1 < height ? top + src_linesize : top;
+		uint8_t *u = planes[1] + (size_t)r * linesizes[1];
+		uint8_t *v = nv12 ? u + 1 : planes[2] + (size_t)r * linesizes[2];
+		uint32_t done = 0;
+#ifdef CONVERT_SSE2
+		done = convert_chroma_sse2(top, bottom, rgba, width, u, v, step);
+#endif
+		convert_chroma_scalar(top, bottom, rgba, done, width, u, v, step);
+	}
+}
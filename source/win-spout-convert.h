@@ -0,0 +1,52 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTCONVERT_H
+#define WINSPOUTCONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Converts received RGBA / BGRA frames to the planar formats OBS takes
+ * for async frames, so the memory source hands OBS 12 bits a pixel
+ * instead of 32. SSE2 where available, eight pixels at a time.
+ *
+ * Rec.709 limited range in 8 bit fixed point, exactly:
+ *   Y = ((47 R + 157 G + 16 B + 128) >> 8) + 16
+ *   U = ((-26 R - 86 G + 112 B + 128) >> 8) + 128
+ *   V = ((112 R - 102 G - 10 B + 128) >> 8) + 128
+ * with U and V taken from the rounded average ((sum + 2) >> 2) of each
+ * 2x2 block. Odd sizes repeat the last column / row into the block.
+ * Alpha is ignored.
+ */
+enum win_spout_convert_format {
+	WIN_SPOUT_CONVERT_NONE,
+	WIN_SPOUT_CONVERT_NV12,
+	WIN_SPOUT_CONVERT_I420,
+};
+
+// Chroma planes are half size, rounded up
+static inline uint32_t win_spout_convert_chroma_size(uint32_t size)
+{
+	return (size + 1) / 2;
+}
+
+// Bytes a width x height frame takes packed in format
+size_t win_spout_convert_frame_size(enum win_spout_convert_format format, uint32_t width, uint32_t height);
+
+/**
+ * rgba says the source is in R G B A byte order rather than B G R A.
+ * NV12 takes the luma plane in planes[0] and interleaved Cb Cr in
+ * planes[1], I420 the luma, Cb and Cr planes in planes[0] to [2].
+ */
+void win_spout_convert(enum win_spout_convert_format format, const uint8_t *src, uint32_t src_linesize, bool rgba,
+		       uint32_t width, uint32_t height, uint8_t *const *planes, const uint32_t *linesizes);
+
+#endif // WINSPOUTCONVERT_H
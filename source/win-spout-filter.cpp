@@ -9,12 +9,52 @@
 
 #include <obs-module.h>
 #include <obs-frontend-api.h>
+#include <util/platform.h>
 #include <util/threading.h>
+#include <util/darray.h>
 #include <media-io/video-frame.h>
 
 #include "SpoutDX.h"
+#include "win-spout-metadata.h"
+#include "win-spout-region.h"
+#include "win-spout-render.h"
+#include "win-spout-trace.h"
+#include "win-spout-alloc-track.h"
+#include "win-spout-watchdog.h"
+#include "win-spout-governor.h"
+#include "win-spout-gpu-budget.h"
+#include "win-spout-key.h"
+#include "win-spout-yuv.h"
 
 #define FILTER_PROP_NAME "spout_filter_name"
+#define FILTER_PROP_FANOUT "spout_filter_fanout"
+#define FILTER_PROP_CROP "spout_filter_crop"
+#define FILTER_PROP_PRIORITY "spout_filter_priority"
+#define FILTER_PROP_EXEMPT "spout_filter_exempt"
+#define FILTER_PROP_KEY "spout_filter_key"
+#define FILTER_PROP_FILL "spout_filter_fill"
+#define FILTER_PROP_FILL_PREMULTIPLY "spout_filter_fill_premultiply"
+#define FILTER_PROP_YUV "spout_filter_yuv"
+#define FILTER_PROP_YUV_MATRIX "spout_filter_yuv_matrix"
+
+// An extra sender fed from the filter's single render
+struct win_spout_fanout_config {
+	char name[256];
+	uint32_t width; // 0 = same as the source
+	uint32_t height;
+	uint32_t divisor; // send every Nth frame
+	enum gs_color_format format;
+	// region of the filter's main image to send, empty for all of it
+	struct win_spout_region crop;
+};
+
+struct win_spout_fanout_sender {
+	struct win_spout_fanout_config config;
+	spoutDX *sender;
+	gs_texrender_t *texrender_curr;
+	gs_texrender_t *texrender_prev;
+	uint64_t frame_count;
+};
 
 struct win_spout_filter {
 	// mutex guards accesses to fields in SHARED section
@@ -27,12 +67,61 @@ struct win_spout_filter {
 	spoutDX *filter_sender; // owned by the filter
 	obs_source_t *source_context;
 	const char *sender_name; // owned by obs
+	struct win_spout_region crop;
+	// per-frame metadata published alongside the texture, owned by the filter
+	struct win_spout_metadata *metadata;
+	uint64_t frame_number;
 
 	// [RENDER] After creation, only accessed on render thread
 	gs_texrender_t *texrender_curr;		// owned by filter
 	gs_texrender_t *texrender_prev;		// "
 	gs_texrender_t *texrender_intermediate; // "
 	gs_stagesurf_t *stagesurface;		// "
+	// metadata of the frame in texrender_prev, published when that is sent
+	struct win_spout_frame_metadata meta_prev;
+
+	// [SHARED] fan-out config written by update(), picked up on the render thread
+	DARRAY(struct win_spout_fanout_config) fanout_pending;
+	bool fanout_dirty;
+
+	// [RENDER]
+	DARRAY(struct win_spout_fanout_sender) fanout;
+
+	// [RENDER] SendTexture calls that took longer than a frame
+	struct win_spout_send_watch send_watch;
+
+	// [SHARED] lowers this filter's rate / size while OBS lags frames
+	struct win_spout_governor_member *governor;
+	// [RENDER]
+	uint64_t governor_frame;
+	// GPU time of the filter's render and sends, recorded as its cost
+	struct win_spout_gpu_timer gpu_timer;
+
+	// [SHARED] key-only sending: the main sender shares a GS_R8 matte,
+	// and fill_name (if set) an opaque fill from the same render
+	enum win_spout_key_mode key_mode;
+	char fill_name[256];
+	bool fill_premultiply;
+	// [SHARED] or a packed NV12 / P010 frame, unless sending a key
+	enum win_spout_yuv_format yuv_format;
+	enum win_spout_yuv_matrix yuv_matrix;
+	bool format_dirty;
+
+	// [RENDER]
+	enum win_spout_key_mode applied_key_mode;
+	bool applied_fill_premultiply;
+	gs_effect_t *key_effect;
+	spoutDX *fill_sender;
+	gs_texrender_t *fill_curr;
+	gs_texrender_t *fill_prev;
+	enum win_spout_yuv_format applied_yuv_format;
+	enum win_spout_yuv_matrix applied_yuv_matrix;
+	gs_effect_t *yuv_effect;
+	// the frame in BGRA at the send size, keyed or packed from and fed to the fan-out
+	gs_texrender_t *texrender_rgb;
+
+	// texture memory held by the filter, released when idle and over budget
+	struct win_spout_gpu_account *gpu_account;
 
 	// set after we successfully init on render thread
 	bool is_initialised;
@@ -44,18 +133,34 @@ struct win_spout_filter {
 void win_spout_filter_update(void *data, obs_data_t *settings);
 void win_spout_filter_destroy(void *data);
 
+// Format of the texture shared by the main sender
+static enum gs_color_format win_spout_filter_send_format(struct win_spout_filter *context)
+{
+	if (context->applied_key_mode != WIN_SPOUT_KEY_NONE)
+		return GS_R8;
+	if (context->applied_yuv_format != WIN_SPOUT_YUV_NONE)
+		return win_spout_yuv_texture_format(context->applied_yuv_format);
+	return GS_BGRA_UNORM;
+}
+
 bool init_on_render_thread(struct win_spout_filter *context)
 {
+	// Create textures, again after they were released to stay within the GPU budget
+	// or the send format changed
+	// Use a Spout-compatible texture format
+	if (!context->texrender_curr) {
+		enum gs_color_format format = win_spout_filter_send_format(context);
+		context->texrender_curr = gs_texrender_create(format, GS_ZS_NONE);
+		context->texrender_prev = gs_texrender_create(format, GS_ZS_NONE);
+	}
+	if (!context->texrender_intermediate) {
+		context->texrender_intermediate = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	}
+
 	if (context->is_initialised) {
 		return true;
 	}
 
-	// Create textures
-	// Use a Spout-compatible texture format
-	context->texrender_curr = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
-	context->texrender_prev = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
-	context->texrender_intermediate = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
-
 	// Init Spout
 	context->filter_sender->SetMaxSenders(255);
 
@@ -80,6 +185,308 @@ bool init_on_render_thread(struct win_spout_filter *context)
 	return true;
 }
 
+/**
+ * Parses a fan-out entry of the form name[:WIDTHxHEIGHT[:divisor[:format]]][@x,y,WIDTHxHEIGHT]
+ * @return bool success
+ */
+static bool win_spout_fanout_parse(const char *entry, struct win_spout_fanout_config *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->divisor = 1;
+	config->format = GS_BGRA_UNORM;
+
+	char buf[512];
+	strncpy(buf, entry, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	char *crop = strchr(buf, '@');
+	if (crop) {
+		*crop++ = '\0';
+		win_spout_region_parse(crop, &config->crop);
+	}
+
+	char *save = NULL;
+	char *token = strtok_s(buf, ":", &save);
+	if (!token || !*token) {
+		return false;
+	}
+	strncpy(config->name, token, sizeof(config->name) - 1);
+
+	if ((token = strtok_s(NULL, ":", &save)) != NULL) {
+		if (sscanf(token, "%ux%u", &config->width, &config->height) != 2) {
+			config->width = config->height = 0;
+		}
+	}
+	if ((token = strtok_s(NULL, ":", &save)) != NULL) {
+		config->divisor = (uint32_t)strtoul(token, NULL, 10);
+		if (!config->divisor)
+			config->divisor = 1;
+	}
+	if ((token = strtok_s(NULL, ":", &save)) != NULL) {
+		if (_stricmp(token, "rgba") == 0)
+			config->format = GS_RGBA_UNORM;
+		else if (_stricmp(token, "bgrx") == 0)
+			config->format = GS_BGRX_UNORM;
+	}
+	return true;
+}
+
+static void win_spout_fanout_release(struct win_spout_fanout_sender *fanout)
+{
+	if (fanout->sender) {
+		fanout->sender->ReleaseSender();
+		fanout->sender->CloseDirectX11();
+		delete fanout->sender;
+		fanout->sender = nullptr;
+	}
+	gs_texrender_destroy(fanout->texrender_curr);
+	gs_texrender_destroy(fanout->texrender_prev);
+	fanout->texrender_curr = nullptr;
+	fanout->texrender_prev = nullptr;
+}
+
+/**
+ * Rebuilds the fan-out senders from the pending config, on the render thread
+ */
+static void win_spout_fanout_apply(struct win_spout_filter *context)
+{
+	pthread_mutex_lock(&context->mutex);
+	if (!context->fanout_dirty) {
+		pthread_mutex_unlock(&context->mutex);
+		return;
+	}
+	DARRAY(struct win_spout_fanout_config) configs;
+	da_init(configs);
+	da_copy(configs, context->fanout_pending);
+	context->fanout_dirty = false;
+	pthread_mutex_unlock(&context->mutex);
+
+	for (size_t i = 0; i < context->fanout.num; i++)
+		win_spout_fanout_release(&context->fanout.array[i]);
+	da_free(context->fanout);
+
+	ID3D11Device *const d3d_device = (ID3D11Device *)gs_get_device_obj();
+
+	for (size_t i = 0; i < configs.num; i++) {
+		struct win_spout_fanout_sender fanout = {};
+		fanout.config = configs.array[i];
+		fanout.sender = new spoutDX;
+		fanout.sender->SetMaxSenders(255);
+		if (!d3d_device || !fanout.sender->OpenDirectX11(d3d_device)) {
+			blog(LOG_ERROR, "Failed to Open DX11 for fan-out sender %s", fanout.config.name);
+			delete fanout.sender;
+			continue;
+		}
+		fanout.sender->SetSenderName(fanout.config.name);
+		fanout.texrender_curr = gs_texrender_create(fanout.config.format, GS_ZS_NONE);
+		fanout.texrender_prev = gs_texrender_create(fanout.config.format, GS_ZS_NONE);
+		da_push_back(context->fanout, &fanout);
+	}
+
+	// Largest first, so each one can be downscaled from the previous
+	// (mip-chain style) rather than from the full size render
+	for (size_t i = 1; i < context->fanout.num; i++) {
+		for (size_t j = i; j > 0; j--) {
+			struct win_spout_fanout_config *a = &context->fanout.array[j - 1].config;
+			struct win_spout_fanout_config *b = &context->fanout.array[j].config;
+			// unset sizes follow the base render, so sort them first
+			uint64_t area_a = a->width ? (uint64_t)a->width * a->height : UINT64_MAX;
+			uint64_t area_b = b->width ? (uint64_t)b->width * b->height : UINT64_MAX;
+			if (area_a >= area_b)
+				break;
+			da_move_item(context->fanout, j, j - 1);
+		}
+	}
+
+	da_free(configs);
+}
+
+static void win_spout_fill_release(struct win_spout_filter *context)
+{
+	if (context->fill_sender) {
+		context->fill_sender->ReleaseSender();
+		context->fill_sender->CloseDirectX11();
+		delete context->fill_sender;
+		context->fill_sender = nullptr;
+	}
+	gs_texrender_destroy(context->fill_curr);
+	gs_texrender_destroy(context->fill_prev);
+	context->fill_curr = nullptr;
+	context->fill_prev = nullptr;
+}
+
+/**
+ * Picks up key mode, fill and YUV changes on the render thread
+ */
+static void win_spout_filter_apply_format(struct win_spout_filter *context)
+{
+	pthread_mutex_lock(&context->mutex);
+	if (!context->format_dirty) {
+		pthread_mutex_unlock(&context->mutex);
+		return;
+	}
+	context->format_dirty = false;
+	enum win_spout_key_mode mode = context->key_mode;
+	bool premultiply = context->fill_premultiply;
+	char fill_name[256];
+	memcpy(fill_name, context->fill_name, sizeof(fill_name));
+	enum win_spout_yuv_format yuv = mode == WIN_SPOUT_KEY_NONE ? context->yuv_format : WIN_SPOUT_YUV_NONE;
+	enum win_spout_yuv_matrix matrix = context->yuv_matrix;
+	// the sender is created again in the new format
+	bool changed = mode != context->applied_key_mode || yuv != context->applied_yuv_format;
+	if (changed) {
+		context->filter_sender->ReleaseSender();
+	}
+	pthread_mutex_unlock(&context->mutex);
+
+	// init_on_render_thread creates them again in the new format
+	if (changed) {
+		gs_texrender_destroy(context->texrender_curr);
+		gs_texrender_destroy(context->texrender_prev);
+		context->texrender_curr = nullptr;
+		context->texrender_prev = nullptr;
+		context->applied_key_mode = mode;
+		context->applied_yuv_format = yuv;
+	}
+	context->applied_fill_premultiply = premultiply;
+	context->applied_yuv_matrix = matrix;
+
+	if (mode != WIN_SPOUT_KEY_NONE && !context->key_effect) {
+		context->key_effect = win_spout_key_effect_create();
+	}
+
+	if (yuv != WIN_SPOUT_YUV_NONE && !context->yuv_effect) {
+		context->yuv_effect = win_spout_yuv_effect_create();
+	}
+
+	if (mode != WIN_SPOUT_KEY_NONE || yuv != WIN_SPOUT_YUV_NONE) {
+		if (!context->texrender_rgb)
+			context->texrender_rgb = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
+	} else {
+		gs_texrender_destroy(context->texrender_rgb);
+		context->texrender_rgb = nullptr;
+	}
+
+	win_spout_fill_release(context);
+	if (mode == WIN_SPOUT_KEY_NONE || !fill_name[0]) {
+		return;
+	}
+
+	ID3D11Device *const d3d_device = (ID3D11Device *)gs_get_device_obj();
+	context->fill_sender = new spoutDX;
+	context->fill_sender->SetMaxSenders(255);
+	if (!d3d_device || !context->fill_sender->OpenDirectX11(d3d_device)) {
+		blog(LOG_ERROR, "Failed to Open DX11 for fill sender %s", fill_name);
+		delete context->fill_sender;
+		context->fill_sender = nullptr;
+		return;
+	}
+	context->fill_sender->SetSenderName(fill_name);
+	context->fill_curr = gs_texrender_create(GS_BGRX_UNORM, GS_ZS_NONE);
+	context->fill_prev = gs_texrender_create(GS_BGRX_UNORM, GS_ZS_NONE);
+}
+
+/**
+ * Renders the fill from the same render as the key and sends it,
+ * double-buffered like the main sender
+ */
+static void win_spout_fill_render(struct win_spout_filter *context, gs_texture_t *tex,
+				  const struct win_spout_region *crop, uint32_t width, uint32_t height)
+{
+	if (!win_spout_render_effect(context->fill_curr, tex, crop, width, height, context->key_effect,
+				     win_spout_key_fill_technique(context->applied_fill_premultiply))) {
+		return;
+	}
+
+	gs_texture_t *prev_tex = gs_texrender_get_texture(context->fill_prev);
+	if (prev_tex && !context->fill_sender->SendTexture((ID3D11Texture2D *)gs_texture_get_obj(prev_tex))) {
+		blog(LOG_ERROR, "Error calling SendTexture() for the fill sender!");
+	}
+
+	gs_texrender_t *tmp = context->fill_prev;
+	context->fill_prev = context->fill_curr;
+	context->fill_curr = tmp;
+}
+
+/**
+ * Renders each fan-out sender from the base render (or the smallest
+ * already rendered fan-out that's still at least as big) and sends it
+ */
+static void win_spout_fanout_render(struct win_spout_filter *context, gs_texture_t *base, uint32_t base_width,
+				    uint32_t base_height)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+
+	gs_texture_t *source = base;
+	uint32_t source_width = base_width;
+	uint32_t source_height = base_height;
+
+	for (size_t i = 0; i < context->fanout.num; i++) {
+		struct win_spout_fanout_sender *fanout = &context->fanout.array[i];
+
+		if (fanout->frame_count++ % fanout->config.divisor != 0)
+			continue;
+
+		struct win_spout_region crop = fanout->config.crop;
+		win_spout_region_clamp(&crop, base_width, base_height);
+		bool cropped = crop.width != base_width || crop.height != base_height;
+
+		uint32_t width = fanout->config.width ? fanout->config.width : crop.width;
+		uint32_t height = fanout->config.height ? fanout->config.height : crop.height;
+
+		// crops are in base image coordinates, so can't use the mip chain
+		gs_texture_t *input = (!cropped && width <= source_width && height <= source_height) ? source : base;
+
+		gs_texrender_reset(fanout->texrender_curr);
+		if (!gs_texrender_begin(fanout->texrender_curr, width, height))
+			continue;
+
+		struct vec4 background;
+		vec4_zero(&background);
+		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+		gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+		gs_effect_set_texture(image, input);
+		if (cropped) {
+			gs_matrix_push();
+			gs_matrix_scale3f((float)width / (float)crop.width, (float)height / (float)crop.height, 1.0f);
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite_subregion(input, 0, crop.x, crop.y, crop.width, crop.height);
+			gs_matrix_pop();
+		} else {
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(input, 0, width, height);
+		}
+
+		gs_blend_state_pop();
+		gs_texrender_end(fanout->texrender_curr);
+
+		gs_texture_t *prev_tex = gs_texrender_get_texture(fanout->texrender_prev);
+		if (prev_tex && !fanout->sender->SendTexture((ID3D11Texture2D *)gs_texture_get_obj(prev_tex))) {
+			blog(LOG_ERROR, "Error calling SendTexture() for %s!", fanout->config.name);
+		}
+
+		gs_texrender_t *tmp = fanout->texrender_prev;
+		fanout->texrender_prev = fanout->texrender_curr;
+		fanout->texrender_curr = tmp;
+
+		source = gs_texrender_get_texture(fanout->texrender_prev);
+		if (!cropped) {
+			source_width = width;
+			source_height = height;
+		}
+	}
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 const char *win_spout_filter_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -103,12 +510,92 @@ obs_properties_t *win_spout_filter_getproperties(void *unused)
 	obs_properties_add_text(props, FILTER_PROP_NAME, obs_module_text("spoutname"), OBS_TEXT_DEFAULT);
 	obs_properties_add_button(props, "win_spout_apply", obs_module_text("changename"),
 				  win_spout_filter_change_name);
+	obs_properties_add_text(props, FILTER_PROP_CROP, obs_module_text("cropregion"), OBS_TEXT_DEFAULT);
+	obs_properties_add_editable_list(props, FILTER_PROP_FANOUT, obs_module_text("fanoutsenders"),
+					 OBS_EDITABLE_LIST_TYPE_STRINGS, NULL, NULL);
+	obs_properties_add_int_slider(props, FILTER_PROP_PRIORITY, obs_module_text("senderpriority"), 1, 10, 1);
+	obs_properties_add_bool(props, FILTER_PROP_EXEMPT, obs_module_text("senderexempt"));
+
+	obs_property_t *key = obs_properties_add_list(props, FILTER_PROP_KEY, obs_module_text("keymode"),
+						      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(key, obs_module_text("keymodenone"), WIN_SPOUT_KEY_NONE);
+	obs_property_list_add_int(key, obs_module_text("keymodealpha"), WIN_SPOUT_KEY_ALPHA);
+	obs_property_list_add_int(key, obs_module_text("keymodeluma"), WIN_SPOUT_KEY_LUMA);
+	obs_properties_add_text(props, FILTER_PROP_FILL, obs_module_text("fillsender"), OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, FILTER_PROP_FILL_PREMULTIPLY, obs_module_text("fillpremultiply"));
+
+	obs_property_t *yuv = obs_properties_add_list(props, FILTER_PROP_YUV, obs_module_text("yuvformat"),
+						      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(yuv, obs_module_text("yuvformatnone"), WIN_SPOUT_YUV_NONE);
+	obs_property_list_add_int(yuv, "NV12", WIN_SPOUT_YUV_NV12);
+	obs_property_list_add_int(yuv, "P010", WIN_SPOUT_YUV_P010);
+	obs_property_t *matrix = obs_properties_add_list(props, FILTER_PROP_YUV_MATRIX, obs_module_text("yuvmatrix"),
+							 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(matrix, "Rec. 709", WIN_SPOUT_YUV_709);
+	obs_property_list_add_int(matrix, "Rec. 2020", WIN_SPOUT_YUV_2020);
 	return props;
 }
 
 void win_spout_filter_getdefaults(obs_data_t *defaults)
 {
 	obs_data_set_default_string(defaults, FILTER_PROP_NAME, obs_module_text("defaultfiltername"));
+	obs_data_set_default_int(defaults, FILTER_PROP_PRIORITY, 5);
+	obs_data_set_default_bool(defaults, FILTER_PROP_EXEMPT, false);
+	obs_data_set_default_int(defaults, FILTER_PROP_KEY, WIN_SPOUT_KEY_NONE);
+	obs_data_set_default_string(defaults, FILTER_PROP_FILL, "");
+	obs_data_set_default_int(defaults, FILTER_PROP_YUV, WIN_SPOUT_YUV_NONE);
+	obs_data_set_default_int(defaults, FILTER_PROP_YUV_MATRIX, WIN_SPOUT_YUV_709);
+}
+
+/**
+ * Counts the texture memory the filter holds: its render targets, the
+ * sender's shared copy (the size of the sent texture), the fill's and the fan-out's
+ */
+static void win_spout_filter_account(struct win_spout_filter *context)
+{
+	uint64_t bytes = win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->texrender_intermediate));
+	uint64_t sent = win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->texrender_prev));
+	bytes += win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->texrender_curr)) + sent * 2;
+	sent = win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->fill_prev));
+	bytes += win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->fill_curr)) + sent * 2;
+	bytes += win_spout_gpu_texture_bytes(gs_texrender_get_texture(context->texrender_rgb));
+
+	for (size_t i = 0; i < context->fanout.num; i++) {
+		struct win_spout_fanout_sender *fanout = &context->fanout.array[i];
+		sent = win_spout_gpu_texture_bytes(gs_texrender_get_texture(fanout->texrender_prev));
+		bytes += win_spout_gpu_texture_bytes(gs_texrender_get_texture(fanout->texrender_curr)) + sent * 2;
+	}
+
+	win_spout_gpu_account_set(context->gpu_account, bytes, 0);
+}
+
+/**
+ * Releases the render targets and senders of an idle filter, they are
+ * created again when it renders next
+ */
+static void win_spout_filter_evict(struct win_spout_filter *context)
+{
+	gs_texrender_destroy(context->texrender_intermediate);
+	gs_texrender_destroy(context->texrender_prev);
+	gs_texrender_destroy(context->texrender_curr);
+	context->texrender_intermediate = nullptr;
+	context->texrender_prev = nullptr;
+	context->texrender_curr = nullptr;
+	gs_texrender_destroy(context->texrender_rgb);
+	context->texrender_rgb = nullptr;
+
+	for (size_t i = 0; i < context->fanout.num; i++)
+		win_spout_fanout_release(&context->fanout.array[i]);
+	da_free(context->fanout);
+	win_spout_fill_release(context);
+
+	pthread_mutex_lock(&context->mutex);
+	context->filter_sender->ReleaseSender();
+	context->fanout_dirty = true;
+	context->format_dirty = true;
+	pthread_mutex_unlock(&context->mutex);
+
+	win_spout_gpu_account_set(context->gpu_account, 0, 0);
 }
 
 void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
@@ -117,12 +604,32 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 	UNUSED_PARAMETER(cy);
 	struct win_spout_filter *context = (win_spout_filter *)data;
 
+	if (win_spout_gpu_account_evict_requested(context->gpu_account)) {
+		win_spout_filter_evict(context);
+	}
+
 	// We check if video_render has been called since the last offscreen_render
 	if (!context->is_active) {
 		return;
 	}
 	context->is_active = false;
+	win_spout_gpu_account_touch(context->gpu_account);
+
+	win_spout_governor_tick(os_gettime_ns(), obs_get_total_frames(),
+				obs_get_lagged_frames() + video_output_get_skipped_frames(obs_get_video()));
 
+	pthread_mutex_lock(&context->mutex);
+	int level = win_spout_governor_level(context->governor);
+	pthread_mutex_unlock(&context->mutex);
+	if (context->governor_frame++ % win_spout_governor_divisor(level) != 0) {
+		return;
+	}
+
+	WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render");
+	WIN_SPOUT_ALLOC_SCOPE("win_spout_offscreen_render");
+	uint64_t render_start = os_gettime_ns();
+
+	win_spout_filter_apply_format(context);
 	if (!init_on_render_thread(context)) {
 		blog(LOG_ERROR, "Failed to create DX11 context for spout filter!");
 		win_spout_filter_destroy(context);
@@ -131,6 +638,7 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 
 	pthread_mutex_lock(&context->mutex);
 	obs_source_t *source_context = context->source_context;
+	struct win_spout_region crop = context->crop;
 	gs_texrender_t *texrender_intermediate = context->texrender_intermediate;
 	gs_texrender_t *texrender_curr = context->texrender_curr;
 	gs_texrender_t *texrender_prev = context->texrender_prev;
@@ -147,9 +655,24 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 	uint32_t width = obs_source_get_base_width(target);
 	uint32_t height = obs_source_get_base_height(target);
 
+	struct win_spout_frame_metadata meta = {};
+	meta.obs_timestamp = obs_get_video_frame_time();
+	struct obs_video_info ovi;
+	if (obs_get_video_info(&ovi)) {
+		meta.fps_num = ovi.fps_num;
+		meta.fps_den = ovi.fps_den;
+		context->send_watch.budget_ns = util_mul_div64(1000000000ULL, ovi.fps_den, ovi.fps_num);
+	}
+	strncpy(meta.scene_name, obs_source_get_name(parent), sizeof(meta.scene_name) - 1);
+
+	// the cost is what the GPU spends, submitting it takes the CPU next to nothing
+	bool gpu_timed = win_spout_gpu_timer_begin(&context->gpu_timer);
+
 	// Render the target to an intemediate format in sRGB-aware format
 	gs_texrender_reset(texrender_intermediate);
 	if (gs_texrender_begin(texrender_intermediate, width, height)) {
+		WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render: parent");
+
 		struct vec4 background;
 		vec4_zero(&background);
 
@@ -165,42 +688,50 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 		gs_texrender_end(texrender_intermediate);
 	}
 
-	// Use the default effect to render it back into a format Spout accepts
-	gs_texrender_reset(texrender_curr);
-	if (gs_texrender_begin(texrender_curr, width, height)) {
-		struct vec4 background;
-		vec4_zero(&background);
-
-		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-		gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
-
-		gs_blend_state_push();
-		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-		// To get sRGB handling, render with the default effect
-		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
-		gs_texture_t *tex = gs_texrender_get_texture(texrender_intermediate);
-		if (tex) {
-			const bool linear_srgb = gs_get_linear_srgb();
-
-			const bool previous = gs_framebuffer_srgb_enabled();
-			gs_enable_framebuffer_srgb(linear_srgb);
-
-			gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
-			if (linear_srgb)
-				gs_effect_set_texture_srgb(image, tex);
-			else
-				gs_effect_set_texture(image, tex);
-
-			while (gs_effect_loop(effect, "Draw"))
-				gs_draw_sprite(tex, 0, width, height);
+	// Only the region of interest goes through to the shared texture
+	win_spout_region_clamp(&crop, width, height);
+	uint32_t send_width = crop.width;
+	uint32_t send_height = crop.height;
+	// fan-out crops are in the main sender's coordinates, so those keep the size
+	if (win_spout_governor_half_size(level) && !context->fanout.num) {
+		send_width = send_width > 1 ? send_width / 2 : 1;
+		send_height = send_height > 1 ? send_height / 2 : 1;
+	}
+	bool key = context->applied_key_mode != WIN_SPOUT_KEY_NONE && context->key_effect;
+	bool yuv = context->applied_yuv_format != WIN_SPOUT_YUV_NONE && context->yuv_effect;
+	if (yuv) {
+		send_width = win_spout_yuv_even(send_width);
+		send_height = win_spout_yuv_even(send_height);
+		// receivers can't tell a packed frame from a tall gray one
+		meta.pixel_layout = context->applied_yuv_format;
+		meta.yuv_matrix = context->applied_yuv_matrix;
+	}
 
-			gs_enable_framebuffer_srgb(previous);
+	// Use the default effect to render it back into a format Spout accepts
+	gs_texture_t *tex = gs_texrender_get_texture(texrender_intermediate);
+	bool rendered;
+	{
+		WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render: convert");
+		if (key || yuv) {
+			// keyed or converted and packed from the BGRA frame at the send size
+			rendered = win_spout_render_to_spout(context->texrender_rgb, tex, &crop, send_width,
+							     send_height);
+			gs_texture_t *rgb = gs_texrender_get_texture(context->texrender_rgb);
+			if (rendered && key) {
+				struct win_spout_region full = {0, 0, send_width, send_height};
+				rendered = win_spout_render_effect(texrender_curr, rgb, &full, send_width, send_height,
+								   context->key_effect,
+								   win_spout_key_technique(context->applied_key_mode));
+			} else if (rendered) {
+				rendered = win_spout_yuv_render(texrender_curr, context->yuv_effect, rgb,
+								context->applied_yuv_format,
+								context->applied_yuv_matrix);
+			}
+		} else {
+			rendered = win_spout_render_to_spout(texrender_curr, tex, &crop, send_width, send_height);
 		}
-
-		gs_blend_state_pop();
-		gs_texrender_end(texrender_curr);
-
+	}
+	if (rendered) {
 		bool ok = false;
 
 		gs_texture_t *prev_tex = gs_texrender_get_texture(texrender_prev);
@@ -211,7 +742,23 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 		pthread_mutex_lock(&context->mutex);
 
 		if (prev_tex) {
+			WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render: SendTexture");
+			uint64_t send_start = os_gettime_ns();
 			ok = context->filter_sender->SendTexture(prev_tex_d3d11);
+			uint64_t send_time = os_gettime_ns() - send_start;
+
+			// a blocked send stalls the whole render thread, so make it visible
+			if (win_spout_send_watch_record(&context->send_watch, send_time) &&
+			    context->send_watch.over_budget % 100 == 1) {
+				blog(LOG_WARNING,
+				     "SendTexture() for %s took %.1f ms, over the frame budget (%llu times so far)",
+				     context->sender_name, (double)send_time / 1000000.0,
+				     (unsigned long long)context->send_watch.over_budget);
+			}
+
+			context->meta_prev.frame_number = ++context->frame_number;
+			context->meta_prev.send_time = os_gettime_ns();
+			win_spout_metadata_write(context->metadata, &context->meta_prev);
 		}
 
 		// Swap the buffers
@@ -220,13 +767,41 @@ void win_spout_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 
 		context->texrender_curr = texrender_prev;
 		context->texrender_prev = texrender_curr;
+		context->meta_prev = meta;
 
 		pthread_mutex_unlock(&context->mutex);
 
 		if (!ok) {
 			blog(LOG_ERROR, "Error calling SendTexture()!");
 		}
+
+		if (context->fill_sender && context->key_effect) {
+			WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render: fill");
+			win_spout_fill_render(context, tex, &crop, send_width, send_height);
+		}
+
+		// Extra senders share this render rather than rendering the parent again,
+		// in BGRA rather than the key or the packed YUV the main sender shares
+		win_spout_fanout_apply(context);
+		gs_texture_t *base = gs_texrender_get_texture(key || yuv ? context->texrender_rgb : texrender_curr);
+		if (base && context->fanout.num) {
+			WIN_SPOUT_TRACE_SCOPE("win_spout_offscreen_render: fan-out");
+			win_spout_fanout_render(context, base, send_width, send_height);
+		}
+	}
+
+	// CPU time stands in where the device has no timer queries
+	uint64_t cost_ns = os_gettime_ns() - render_start;
+	if (gpu_timed) {
+		win_spout_gpu_timer_end(&context->gpu_timer);
+	}
+	if (!gpu_timed || win_spout_gpu_timer_read(&context->gpu_timer, &cost_ns)) {
+		pthread_mutex_lock(&context->mutex);
+		win_spout_governor_record(context->governor, cost_ns);
+		pthread_mutex_unlock(&context->mutex);
 	}
+
+	win_spout_filter_account(context);
 }
 
 void win_spout_filter_update(void *data, obs_data_t *settings)
@@ -244,6 +819,41 @@ void win_spout_filter_update(void *data, obs_data_t *settings)
 	context->sender_name = sender_name;
 	context->filter_sender->SetSenderName(sender_name);
 
+	win_spout_metadata_destroy(context->metadata);
+	context->metadata = win_spout_metadata_create(sender_name);
+	context->frame_number = 0;
+	win_spout_gpu_account_set_name(context->gpu_account, sender_name);
+
+	win_spout_region_parse(obs_data_get_string(settings, FILTER_PROP_CROP), &context->crop);
+
+	// rejoining starts the sender again at full quality
+	win_spout_governor_leave(context->governor);
+	context->governor = win_spout_governor_join(sender_name,
+						    (int)obs_data_get_int(settings, FILTER_PROP_PRIORITY),
+						    obs_data_get_bool(settings, FILTER_PROP_EXEMPT));
+
+	da_free(context->fanout_pending);
+	obs_data_array_t *fanout = obs_data_get_array(settings, FILTER_PROP_FANOUT);
+	size_t count = obs_data_array_count(fanout);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(fanout, i);
+		struct win_spout_fanout_config config;
+		if (win_spout_fanout_parse(obs_data_get_string(item, "value"), &config)) {
+			da_push_back(context->fanout_pending, &config);
+		}
+		obs_data_release(item);
+	}
+	obs_data_array_release(fanout);
+	context->fanout_dirty = true;
+
+	context->key_mode = (enum win_spout_key_mode)obs_data_get_int(settings, FILTER_PROP_KEY);
+	memset(context->fill_name, 0, sizeof(context->fill_name));
+	strncpy(context->fill_name, obs_data_get_string(settings, FILTER_PROP_FILL), sizeof(context->fill_name) - 1);
+	context->fill_premultiply = obs_data_get_bool(settings, FILTER_PROP_FILL_PREMULTIPLY);
+	context->yuv_format = (enum win_spout_yuv_format)obs_data_get_int(settings, FILTER_PROP_YUV);
+	context->yuv_matrix = (enum win_spout_yuv_matrix)obs_data_get_int(settings, FILTER_PROP_YUV_MATRIX);
+	context->format_dirty = true;
+
 	pthread_mutex_unlock(&context->mutex);
 
 	obs_add_main_render_callback(win_spout_offscreen_render, context);
@@ -256,12 +866,16 @@ void *win_spout_filter_create(obs_data_t *settings, obs_source_t *source)
 	context->filter_sender = nullptr;
 	context->source_context = nullptr;
 	context->sender_name = nullptr;
+	context->metadata = nullptr;
+	context->frame_number = 0;
 	context->texrender_curr = nullptr;
 	context->texrender_prev = nullptr;
 	context->texrender_intermediate = nullptr;
 	context->stagesurface = nullptr;
 	context->is_initialised = false;
 	context->is_active = false;
+	da_init(context->fanout);
+	da_init(context->fanout_pending);
 
 	pthread_mutex_init_value(&context->mutex);
 	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
@@ -275,6 +889,7 @@ void *win_spout_filter_create(obs_data_t *settings, obs_source_t *source)
 	context->sender_name = obs_data_get_string(settings, FILTER_PROP_NAME);
 
 	context->filter_sender = new spoutDX;
+	context->gpu_account = win_spout_gpu_account_create("filter", context->sender_name, true);
 
 	win_spout_filter_update(context, settings);
 
@@ -299,6 +914,28 @@ void win_spout_filter_destroy(void *data)
 		context->filter_sender = nullptr;
 	}
 
+	win_spout_metadata_destroy(context->metadata);
+	context->metadata = nullptr;
+	win_spout_governor_leave(context->governor);
+	context->governor = nullptr;
+	win_spout_gpu_account_destroy(context->gpu_account);
+	context->gpu_account = nullptr;
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < context->fanout.num; i++)
+		win_spout_fanout_release(&context->fanout.array[i]);
+	win_spout_fill_release(context);
+	gs_effect_destroy(context->key_effect);
+	context->key_effect = nullptr;
+	gs_effect_destroy(context->yuv_effect);
+	context->yuv_effect = nullptr;
+	gs_texrender_destroy(context->texrender_rgb);
+	context->texrender_rgb = nullptr;
+	win_spout_gpu_timer_destroy(&context->gpu_timer);
+	obs_leave_graphics();
+	da_free(context->fanout);
+	da_free(context->fanout_pending);
+
 	if (context->stagesurface) {
 		gs_stagesurface_unmap(context->stagesurface);
 		gs_stagesurface_destroy(context->stagesurface);
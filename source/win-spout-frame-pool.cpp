@@ -0,0 +1,253 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-frame-pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define POOL_PAGE_SIZE 4096
+#define POOL_CACHE_LINE 64
+// idle buffers beyond these are freed on release rather than kept
+#define POOL_MAX_IDLE_PER_SIZE 4
+#define POOL_MAX_IDLE_BYTES (512ULL * 1024 * 1024)
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct win_spout_frame_buffer *) pool_idle;
+static struct win_spout_frame_pool_stats pool_stats;
+static bool pool_large_pages;
+static size_t pool_large_page_size;
+
+static size_t pool_round_up(size_t size, size_t align)
+{
+	return (size + align - 1) / align * align;
+}
+
+/* Page allocation is the only platform specific part of the pool */
+
+#ifdef _WIN32
+
+static uint8_t *pool_alloc_pages(size_t size, bool large_pages)
+{
+	DWORD type = MEM_COMMIT | MEM_RESERVE | (large_pages ? MEM_LARGE_PAGES : 0);
+	return (uint8_t *)VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+}
+
+static void pool_free_pages(uint8_t *data, size_t size)
+{
+	UNUSED_PARAMETER(size);
+	VirtualFree(data, 0, MEM_RELEASE);
+}
+
+// Large pages need SeLockMemoryPrivilege, which has to be granted to the user
+static bool pool_enable_lock_memory()
+{
+	HANDLE token;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return false;
+	}
+
+	TOKEN_PRIVILEGES privileges = {};
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+		  AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+		  GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+	return ok;
+}
+
+static size_t pool_get_large_page_size()
+{
+	return pool_enable_lock_memory() ? GetLargePageMinimum() : 0;
+}
+
+#else
+
+static uint8_t *pool_alloc_pages(size_t size, bool large_pages)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | (large_pages ? MAP_HUGETLB : 0);
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	return data != MAP_FAILED ? (uint8_t *)data : nullptr;
+}
+
+static void pool_free_pages(uint8_t *data, size_t size)
+{
+	munmap(data, size);
+}
+
+// the default huge page size, allocations fall back to normal pages if none are reserved
+static size_t pool_get_large_page_size()
+{
+	return 2 * 1024 * 1024;
+}
+
+#endif // _WIN32
+
+uint32_t win_spout_frame_pool_pitch(uint32_t width_bytes)
+{
+	return (uint32_t)pool_round_up(width_bytes, POOL_CACHE_LINE);
+}
+
+void win_spout_frame_pool_set_large_pages(bool enable)
+{
+	pthread_mutex_lock(&pool_mutex);
+
+	pool_large_pages = false;
+	if (enable) {
+		pool_large_page_size = pool_get_large_page_size();
+		if (pool_large_page_size) {
+			pool_large_pages = true;
+			blog(LOG_INFO, "Frame buffers use %zu KB large pages", pool_large_page_size / 1024);
+		} else {
+			blog(LOG_WARNING, "Large pages unavailable (is 'Lock pages in memory' granted?), "
+					  "frame buffers use normal pages");
+		}
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+static struct win_spout_frame_buffer *pool_allocate(size_t size)
+{
+	struct win_spout_frame_buffer *buffer =
+		(win_spout_frame_buffer *)bzalloc(sizeof(struct win_spout_frame_buffer));
+	buffer->size = size;
+
+	// large pages only fit sizes that are a multiple of the large page size
+	if (pool_large_pages && size % pool_large_page_size == 0) {
+		buffer->data = pool_alloc_pages(size, true);
+		buffer->large_pages = buffer->data != nullptr;
+	}
+	if (!buffer->data) {
+		buffer->data = pool_alloc_pages(size, false);
+	}
+	if (!buffer->data) {
+		blog(LOG_ERROR, "Failed to allocate a %zu byte frame buffer", size);
+		bfree(buffer);
+		return nullptr;
+	}
+
+	pool_stats.resident_bytes += size;
+	if (buffer->large_pages) {
+		pool_stats.large_page_bytes += size;
+	}
+	return buffer;
+}
+
+static void pool_destroy(struct win_spout_frame_buffer *buffer)
+{
+	pool_stats.resident_bytes -= buffer->size;
+	if (buffer->large_pages) {
+		pool_stats.large_page_bytes -= buffer->size;
+	}
+
+	pool_free_pages(buffer->data, buffer->size);
+	bfree(buffer);
+}
+
+struct win_spout_frame_buffer *win_spout_frame_pool_acquire(size_t size)
+{
+	if (!size) {
+		return nullptr;
+	}
+
+	pthread_mutex_lock(&pool_mutex);
+
+	size_t align = pool_large_pages && size >= pool_large_page_size ? pool_large_page_size : POOL_PAGE_SIZE;
+	size = pool_round_up(size, align);
+
+	struct win_spout_frame_buffer *buffer = nullptr;
+	for (size_t i = pool_idle.num; i > 0; i--) {
+		if (pool_idle.array[i - 1]->size == size) {
+			buffer = pool_idle.array[i - 1];
+			da_erase(pool_idle, i - 1);
+			break;
+		}
+	}
+
+	if (buffer) {
+		pool_stats.hits++;
+		pool_stats.idle_bytes -= buffer->size;
+	} else {
+		pool_stats.misses++;
+		buffer = pool_allocate(size);
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+	return buffer;
+}
+
+void win_spout_frame_pool_release(struct win_spout_frame_buffer *buffer)
+{
+	if (!buffer) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool_mutex);
+
+	size_t same_size = 0;
+	for (size_t i = 0; i < pool_idle.num; i++) {
+		if (pool_idle.array[i]->size == buffer->size)
+			same_size++;
+	}
+
+	if (same_size < POOL_MAX_IDLE_PER_SIZE && pool_stats.idle_bytes + buffer->size <= POOL_MAX_IDLE_BYTES) {
+		da_push_back(pool_idle, &buffer);
+		pool_stats.idle_bytes += buffer->size;
+	} else {
+		pool_destroy(buffer);
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+struct win_spout_frame_buffer *win_spout_frame_pool_resize(struct win_spout_frame_buffer *buffer, size_t size)
+{
+	if (buffer && buffer->size >= size) {
+		return buffer;
+	}
+
+	win_spout_frame_pool_release(buffer);
+	return win_spout_frame_pool_acquire(size);
+}
+
+void win_spout_frame_pool_get_stats(struct win_spout_frame_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool_mutex);
+	*stats = pool_stats;
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+void win_spout_frame_pool_free_idle()
+{
+	pthread_mutex_lock(&pool_mutex);
+
+	for (size_t i = 0; i < pool_idle.num; i++) {
+		pool_destroy(pool_idle.array[i]);
+	}
+	da_free(pool_idle);
+	pool_stats.idle_bytes = 0;
+
+	if (pool_stats.hits || pool_stats.misses) {
+		blog(LOG_INFO, "Frame buffer pool: %llu hits, %llu misses, %llu bytes still in use",
+		     (unsigned long long)pool_stats.hits, (unsigned long long)pool_stats.misses,
+		     (unsigned long long)pool_stats.resident_bytes);
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTFRAMEPOOL_H
+#define WINSPOUTFRAMEPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Plugin-wide pool of full-frame CPU buffers, so paths that copy frames
+ * don't hit the heap every frame or resize.
+ *
+ * Buffers are page aligned (and so cache line aligned), their size is
+ * rounded up to whole pages and released buffers are kept for reuse by
+ * the next request of the same size. With large pages enabled they are
+ * backed by large pages where the process is allowed to lock memory,
+ * falling back to normal pages otherwise.
+ */
+struct win_spout_frame_buffer {
+	uint8_t *data;
+	size_t size;
+	bool large_pages;
+};
+
+struct win_spout_frame_pool_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t resident_bytes; // allocated, in use or idle
+	uint64_t idle_bytes;
+	uint64_t large_page_bytes;
+};
+
+// Line pitch for a row of width_bytes, padded to whole cache lines
+uint32_t win_spout_frame_pool_pitch(uint32_t width_bytes);
+
+struct win_spout_frame_buffer *win_spout_frame_pool_acquire(size_t size);
+void win_spout_frame_pool_release(struct win_spout_frame_buffer *buffer);
+
+// Keeps buffer if it's already at least size, swaps it for a pooled one otherwise
+struct win_spout_frame_buffer *win_spout_frame_pool_resize(struct win_spout_frame_buffer *buffer, size_t size);
+
+void win_spout_frame_pool_set_large_pages(bool enable);
+void win_spout_frame_pool_get_stats(struct win_spout_frame_pool_stats *stats);
+// Frees every idle buffer and logs the pool's stats
+void win_spout_frame_pool_free_idle();
+
+#endif // WINSPOUTFRAMEPOOL_H
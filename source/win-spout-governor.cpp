@@ -0,0 +1,172 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-governor.h"
+
+// more than this share of a period's frames lagged counts as lagging
+#define GOVERNOR_LAG_PERCENT 1
+
+struct win_spout_governor_member {
+	char name[256];
+	int priority;
+	bool exempt;
+	uint64_t cost_ns;
+	// read by the owner every frame without the lock
+	volatile long level;
+};
+
+// guards the member list and the policy
+static pthread_mutex_t governor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct win_spout_governor_member *) governor_members;
+static DARRAY(struct win_spout_governor_candidate) governor_candidates;
+static struct win_spout_governor_policy governor_policy;
+static uint64_t governor_last_tick;
+
+int win_spout_governor_evaluate(struct win_spout_governor_policy *policy, uint64_t total_frames,
+				uint64_t lagged_frames, const struct win_spout_governor_candidate *candidates,
+				size_t count, int *delta)
+{
+	if (!policy->primed || total_frames < policy->total_frames || lagged_frames < policy->lagged_frames) {
+		policy->primed = true;
+		policy->total_frames = total_frames;
+		policy->lagged_frames = lagged_frames;
+		policy->calm_periods = 0;
+		return -1;
+	}
+
+	uint64_t frames = total_frames - policy->total_frames;
+	uint64_t lagged = lagged_frames - policy->lagged_frames;
+	policy->total_frames = total_frames;
+	policy->lagged_frames = lagged_frames;
+
+	int index = -1;
+	if (lagged && lagged * 100 > frames * GOVERNOR_LAG_PERCENT) {
+		policy->calm_periods = 0;
+
+		// least important first, the most expensive of those
+		for (size_t i = 0; i < count; i++) {
+			const struct win_spout_governor_candidate *c = &candidates[i];
+			if (c->exempt || c->level >= WIN_SPOUT_GOVERNOR_MAX_LEVEL)
+				continue;
+			if (index < 0 || c->priority < candidates[index].priority ||
+			    (c->priority == candidates[index].priority && c->cost_ns > candidates[index].cost_ns))
+				index = (int)i;
+		}
+		*delta = 1;
+		return index;
+	}
+
+	if (lagged || ++policy->calm_periods < WIN_SPOUT_GOVERNOR_CALM_PERIODS) {
+		return -1;
+	}
+	policy->calm_periods = 0;
+
+	// most important first, the cheapest of those
+	for (size_t i = 0; i < count; i++) {
+		const struct win_spout_governor_candidate *c = &candidates[i];
+		if (c->level <= 0)
+			continue;
+		if (index < 0 || c->priority > candidates[index].priority ||
+		    (c->priority == candidates[index].priority && c->cost_ns < candidates[index].cost_ns))
+			index = (int)i;
+	}
+	*delta = -1;
+	return index;
+}
+
+struct win_spout_governor_member *win_spout_governor_join(const char *name, int priority, bool exempt)
+{
+	struct win_spout_governor_member *member =
+		(win_spout_governor_member *)bzalloc(sizeof(struct win_spout_governor_member));
+	strncpy(member->name, name ? name : "", sizeof(member->name) - 1);
+	member->priority = priority;
+	member->exempt = exempt;
+
+	pthread_mutex_lock(&governor_mutex);
+	da_push_back(governor_members, &member);
+	pthread_mutex_unlock(&governor_mutex);
+	return member;
+}
+
+void win_spout_governor_leave(struct win_spout_governor_member *member)
+{
+	if (!member) {
+		return;
+	}
+
+	pthread_mutex_lock(&governor_mutex);
+	da_erase_item(governor_members, &member);
+	if (!governor_members.num) {
+		da_free(governor_members);
+		da_free(governor_candidates);
+		memset(&governor_policy, 0, sizeof(governor_policy));
+	}
+	pthread_mutex_unlock(&governor_mutex);
+
+	bfree(member);
+}
+
+void win_spout_governor_record(struct win_spout_governor_member *member, uint64_t cost_ns)
+{
+	if (!member) {
+		return;
+	}
+
+	pthread_mutex_lock(&governor_mutex);
+	member->cost_ns = member->cost_ns ? (member->cost_ns * 7 + cost_ns) / 8 : cost_ns;
+	pthread_mutex_unlock(&governor_mutex);
+}
+
+int win_spout_governor_level(struct win_spout_governor_member *member)
+{
+	return member ? (int)os_atomic_load_long(&member->level) : 0;
+}
+
+void win_spout_governor_tick(uint64_t now, uint64_t total_frames, uint64_t lagged_frames)
+{
+	pthread_mutex_lock(&governor_mutex);
+
+	if (now - governor_last_tick < WIN_SPOUT_GOVERNOR_PERIOD_NS) {
+		pthread_mutex_unlock(&governor_mutex);
+		return;
+	}
+	governor_last_tick = now;
+
+	da_resize(governor_candidates, governor_members.num);
+	for (size_t i = 0; i < governor_members.num; i++) {
+		struct win_spout_governor_member *member = governor_members.array[i];
+		struct win_spout_governor_candidate *candidate = &governor_candidates.array[i];
+		candidate->priority = member->priority;
+		candidate->exempt = member->exempt;
+		candidate->cost_ns = member->cost_ns;
+		candidate->level = (int)os_atomic_load_long(&member->level);
+	}
+
+	int delta = 0;
+	int index = win_spout_governor_evaluate(&governor_policy, total_frames, lagged_frames,
+						governor_candidates.array, governor_candidates.num, &delta);
+	if (index >= 0) {
+		struct win_spout_governor_member *member = governor_members.array[index];
+		long level = governor_candidates.array[index].level + delta;
+		os_atomic_set_long(&member->level, level);
+
+		if (delta > 0) {
+			blog(LOG_WARNING, "OBS is lagging frames, reducing sender %s to level %ld (%.2f ms per send)",
+			     member->name, level, (double)member->cost_ns / 1000000.0);
+		} else {
+			blog(LOG_INFO, "OBS has caught up, restoring sender %s to level %ld", member->name, level);
+		}
+	}
+
+	pthread_mutex_unlock(&governor_mutex);
+}
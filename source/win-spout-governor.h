@@ -0,0 +1,80 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTGOVERNOR_H
+#define WINSPOUTGOVERNOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Sheds sender work while OBS is lagging or skipping frames.
+ *
+ * Once per period the governor looks at OBS's frame counters. While
+ * frames are being lagged it lowers the least important sender one level
+ * per period (the most expensive one first among equal priorities), and
+ * once rendering has kept up for a few periods it gives levels back, most
+ * important sender first.
+ *
+ * Levels: 0 full, 1 half rate, 2 half rate at half size, 3 quarter rate
+ * at half size. Exempt senders are never lowered, whatever their priority.
+ */
+#define WIN_SPOUT_GOVERNOR_MAX_LEVEL 3
+#define WIN_SPOUT_GOVERNOR_PERIOD_NS 1000000000ULL
+// periods without lag before a level is given back
+#define WIN_SPOUT_GOVERNOR_CALM_PERIODS 3
+
+struct win_spout_governor_member;
+
+struct win_spout_governor_member *win_spout_governor_join(const char *name, int priority, bool exempt);
+void win_spout_governor_leave(struct win_spout_governor_member *member);
+
+// Cost of one full send (GPU time where it can be measured), kept as a moving average
+void win_spout_governor_record(struct win_spout_governor_member *member, uint64_t cost_ns);
+int win_spout_governor_level(struct win_spout_governor_member *member);
+
+// Feeds OBS's frame counters, the policy runs at most once per period
+void win_spout_governor_tick(uint64_t now, uint64_t total_frames, uint64_t lagged_frames);
+
+static inline uint32_t win_spout_governor_divisor(int level)
+{
+	return level >= 3 ? 4 : level >= 1 ? 2 : 1;
+}
+
+static inline bool win_spout_governor_half_size(int level)
+{
+	return level >= 2;
+}
+
+/* Policy, kept apart from the members so it can be fed recorded counters */
+
+struct win_spout_governor_candidate {
+	int priority;
+	bool exempt;
+	uint64_t cost_ns;
+	int level;
+};
+
+struct win_spout_governor_policy {
+	bool primed;
+	uint64_t total_frames;
+	uint64_t lagged_frames;
+	int calm_periods;
+};
+
+/**
+ * Evaluates one period from the cumulative frame counters
+ *
+ * @return index of the candidate to change by *delta (+1 lower, -1 restore), -1 for none
+ */
+int win_spout_governor_evaluate(struct win_spout_governor_policy *policy, uint64_t total_frames,
+				uint64_t lagged_frames, const struct win_spout_governor_candidate *candidates,
+				size_t count, int *delta);
+
+#endif // WINSPOUTGOVERNOR_H
@@ -0,0 +1,229 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-gpu-budget.h"
+
+#define MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
+
+// the budget is checked at most this often when nothing changes size
+#define GPU_CHECK_INTERVAL_NS 1000000000ULL
+
+struct win_spout_gpu_account {
+	const char *kind;
+	char name[256];
+	bool evictable;
+	uint64_t owned_bytes;
+	uint64_t shared_bytes;
+	uint64_t peak_owned_bytes;
+	uint64_t last_used;
+	bool evict_requested;
+};
+
+// guards the account list, the accounts and the totals
+static pthread_mutex_t gpu_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct win_spout_gpu_account *) gpu_accounts;
+static struct win_spout_gpu_totals gpu_totals;
+static uint64_t gpu_budget;
+static uint64_t gpu_last_check;
+static bool gpu_over_budget_logged;
+
+uint64_t win_spout_gpu_texture_bytes(gs_texture_t *texture)
+{
+	if (!texture) {
+		return 0;
+	}
+
+	uint32_t bpp = gs_get_format_bpp(gs_texture_get_color_format(texture));
+	return (uint64_t)gs_texture_get_width(texture) * gs_texture_get_height(texture) * bpp / 8;
+}
+
+/**
+ * Asks the least recently used idle accounts to release their textures
+ * until the requests cover what's over the budget
+ */
+static void gpu_enforce_budget(uint64_t now)
+{
+	gpu_last_check = now;
+	if (!gpu_budget || gpu_totals.owned_bytes <= gpu_budget) {
+		gpu_over_budget_logged = false;
+		return;
+	}
+
+	uint64_t excess = gpu_totals.owned_bytes - gpu_budget;
+	for (size_t i = 0; i < gpu_accounts.num; i++) {
+		struct win_spout_gpu_account *account = gpu_accounts.array[i];
+		if (account->evict_requested) {
+			excess -= account->owned_bytes < excess ? account->owned_bytes : excess;
+		}
+	}
+
+	while (excess) {
+		struct win_spout_gpu_account *oldest = nullptr;
+		for (size_t i = 0; i < gpu_accounts.num; i++) {
+			struct win_spout_gpu_account *account = gpu_accounts.array[i];
+			if (!account->evictable || account->evict_requested || !account->owned_bytes ||
+			    now - account->last_used < WIN_SPOUT_GPU_IDLE_NS)
+				continue;
+			if (!oldest || account->last_used < oldest->last_used)
+				oldest = account;
+		}
+
+		if (!oldest) {
+			if (!gpu_over_budget_logged) {
+				blog(LOG_WARNING, "GPU budget of %.1f MB exceeded by %.1f MB with nothing idle to release",
+				     MB(gpu_budget), MB(excess));
+				gpu_over_budget_logged = true;
+			}
+			break;
+		}
+
+		oldest->evict_requested = true;
+		excess -= oldest->owned_bytes < excess ? oldest->owned_bytes : excess;
+	}
+}
+
+struct win_spout_gpu_account *win_spout_gpu_account_create(const char *kind, const char *name, bool evictable)
+{
+	struct win_spout_gpu_account *account =
+		(win_spout_gpu_account *)bzalloc(sizeof(struct win_spout_gpu_account));
+	account->kind = kind;
+	account->evictable = evictable;
+	account->last_used = os_gettime_ns();
+	win_spout_gpu_account_set_name(account, name);
+
+	pthread_mutex_lock(&gpu_mutex);
+	da_push_back(gpu_accounts, &account);
+	pthread_mutex_unlock(&gpu_mutex);
+	return account;
+}
+
+void win_spout_gpu_account_destroy(struct win_spout_gpu_account *account)
+{
+	if (!account) {
+		return;
+	}
+
+	pthread_mutex_lock(&gpu_mutex);
+	gpu_totals.owned_bytes -= account->owned_bytes;
+	gpu_totals.shared_bytes -= account->shared_bytes;
+	da_erase_item(gpu_accounts, &account);
+	if (!gpu_accounts.num) {
+		da_free(gpu_accounts);
+	}
+	pthread_mutex_unlock(&gpu_mutex);
+
+	if (account->peak_owned_bytes) {
+		blog(LOG_INFO, "GPU memory: %s %s held up to %.1f MB", account->kind, account->name,
+		     MB(account->peak_owned_bytes));
+	}
+	bfree(account);
+}
+
+void win_spout_gpu_account_set_name(struct win_spout_gpu_account *account, const char *name)
+{
+	if (!account) {
+		return;
+	}
+
+	pthread_mutex_lock(&gpu_mutex);
+	memset(account->name, 0, sizeof(account->name));
+	strncpy(account->name, name ? name : "", sizeof(account->name) - 1);
+	pthread_mutex_unlock(&gpu_mutex);
+}
+
+void win_spout_gpu_account_set(struct win_spout_gpu_account *account, uint64_t owned_bytes, uint64_t shared_bytes)
+{
+	if (!account) {
+		return;
+	}
+
+	pthread_mutex_lock(&gpu_mutex);
+
+	if (owned_bytes != account->owned_bytes || shared_bytes != account->shared_bytes) {
+		gpu_totals.owned_bytes = gpu_totals.owned_bytes - account->owned_bytes + owned_bytes;
+		gpu_totals.shared_bytes = gpu_totals.shared_bytes - account->shared_bytes + shared_bytes;
+		account->owned_bytes = owned_bytes;
+		account->shared_bytes = shared_bytes;
+
+		if (owned_bytes > account->peak_owned_bytes)
+			account->peak_owned_bytes = owned_bytes;
+		if (gpu_totals.owned_bytes > gpu_totals.peak_owned_bytes)
+			gpu_totals.peak_owned_bytes = gpu_totals.owned_bytes;
+
+		gpu_enforce_budget(os_gettime_ns());
+	}
+
+	pthread_mutex_unlock(&gpu_mutex);
+}
+
+void win_spout_gpu_account_touch(struct win_spout_gpu_account *account)
+{
+	if (!account) {
+		return;
+	}
+
+	uint64_t now = os_gettime_ns();
+
+	pthread_mutex_lock(&gpu_mutex);
+	account->last_used = now;
+	// other instances only go idle with time, so look again now and then
+	if (now - gpu_last_check >= GPU_CHECK_INTERVAL_NS) {
+		gpu_enforce_budget(now);
+	}
+	pthread_mutex_unlock(&gpu_mutex);
+}
+
+bool win_spout_gpu_account_evict_requested(struct win_spout_gpu_account *account)
+{
+	if (!account) {
+		return false;
+	}
+
+	pthread_mutex_lock(&gpu_mutex);
+	bool requested = account->evict_requested;
+	if (requested) {
+		account->evict_requested = false;
+		gpu_totals.evictions++;
+		blog(LOG_INFO, "GPU memory: releasing %.1f MB held by idle %s %s to stay within the budget",
+		     MB(account->owned_bytes), account->kind, account->name);
+	}
+	pthread_mutex_unlock(&gpu_mutex);
+	return requested;
+}
+
+void win_spout_gpu_budget_set(uint64_t bytes)
+{
+	pthread_mutex_lock(&gpu_mutex);
+	gpu_budget = bytes;
+	gpu_enforce_budget(os_gettime_ns());
+	pthread_mutex_unlock(&gpu_mutex);
+}
+
+void win_spout_gpu_budget_get_totals(struct win_spout_gpu_totals *totals)
+{
+	pthread_mutex_lock(&gpu_mutex);
+	*totals = gpu_totals;
+	pthread_mutex_unlock(&gpu_mutex);
+}
+
+void win_spout_gpu_budget_log()
+{
+	struct win_spout_gpu_totals totals;
+	win_spout_gpu_budget_get_totals(&totals);
+
+	if (totals.peak_owned_bytes) {
+		blog(LOG_INFO, "GPU memory: peak %.1f MB of textures, %llu idle releases, budget %.1f MB (0 = none)",
+		     MB(totals.peak_owned_bytes), (unsigned long long)totals.evictions, MB(gpu_budget));
+	}
+}
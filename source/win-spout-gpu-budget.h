@@ -0,0 +1,61 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTGPUBUDGET_H
+#define WINSPOUTGPUBUDGET_H
+
+#include <stdint.h>
+#include <obs-module.h>
+
+/**
+ * Accounting of the texture memory each plugin instance holds, against
+ * an optional plugin-wide budget.
+ *
+ * Owned bytes are textures the instance created. Shared bytes are
+ * senders' textures it has opened, which don't take memory of their own
+ * and don't count against the budget.
+ *
+ * When owned bytes go over the budget, evictable instances that haven't
+ * been used for WIN_SPOUT_GPU_IDLE_NS are asked to release their
+ * textures, least recently used first. Instances check for that request
+ * on their own graphics thread and recreate what they need when they are
+ * used again.
+ */
+#define WIN_SPOUT_GPU_IDLE_NS 10000000000ULL
+
+struct win_spout_gpu_account;
+
+struct win_spout_gpu_totals {
+	uint64_t owned_bytes;
+	uint64_t shared_bytes;
+	uint64_t peak_owned_bytes;
+	uint64_t evictions;
+};
+
+struct win_spout_gpu_account *win_spout_gpu_account_create(const char *kind, const char *name, bool evictable);
+// Logs the most the instance held
+void win_spout_gpu_account_destroy(struct win_spout_gpu_account *account);
+void win_spout_gpu_account_set_name(struct win_spout_gpu_account *account, const char *name);
+
+void win_spout_gpu_account_set(struct win_spout_gpu_account *account, uint64_t owned_bytes, uint64_t shared_bytes);
+// Marks the instance as used now
+void win_spout_gpu_account_touch(struct win_spout_gpu_account *account);
+// True once if the budget wants the instance's textures back
+bool win_spout_gpu_account_evict_requested(struct win_spout_gpu_account *account);
+
+// 0 for no budget
+void win_spout_gpu_budget_set(uint64_t bytes);
+void win_spout_gpu_budget_get_totals(struct win_spout_gpu_totals *totals);
+// Logs the plugin-wide totals
+void win_spout_gpu_budget_log();
+
+// Size of a texture's top level, 0 for none
+uint64_t win_spout_gpu_texture_bytes(gs_texture_t *texture);
+
+#endif // WINSPOUTGPUBUDGET_H
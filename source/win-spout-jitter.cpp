@@ -0,0 +1,120 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <string.h>
+#include "win-spout-jitter.h"
+
+// Sender timestamps further than this from the video clock mean the
+// sender restarted or the clocks don't match, so we stop waiting on them
+#define JITTER_RESYNC_NS 1000000000ULL
+
+void win_spout_jitter_init(struct win_spout_jitter *jitter, int num_slots, uint64_t delay_ns)
+{
+	memset(jitter, 0, sizeof(*jitter));
+	if (num_slots < 2)
+		num_slots = 2;
+	if (num_slots > WIN_SPOUT_JITTER_MAX_SLOTS)
+		num_slots = WIN_SPOUT_JITTER_MAX_SLOTS;
+	jitter->num_slots = num_slots;
+	jitter->delay_ns = delay_ns;
+	jitter->current_slot = -1;
+}
+
+void win_spout_jitter_reset(struct win_spout_jitter *jitter)
+{
+	win_spout_jitter_init(jitter, jitter->num_slots, jitter->delay_ns);
+}
+
+static struct win_spout_jitter_frame *jitter_at(struct win_spout_jitter *jitter, size_t i)
+{
+	return &jitter->queue[(jitter->head + i) % WIN_SPOUT_JITTER_MAX_SLOTS];
+}
+
+static struct win_spout_jitter_frame jitter_pop(struct win_spout_jitter *jitter)
+{
+	struct win_spout_jitter_frame frame = jitter->queue[jitter->head];
+	jitter->head = (jitter->head + 1) % WIN_SPOUT_JITTER_MAX_SLOTS;
+	jitter->count--;
+	return frame;
+}
+
+static bool jitter_slot_in_use(struct win_spout_jitter *jitter, int slot)
+{
+	if (slot == jitter->current_slot)
+		return true;
+	for (size_t i = 0; i < jitter->count; i++) {
+		if (jitter_at(jitter, i)->slot == slot)
+			return true;
+	}
+	return false;
+}
+
+int win_spout_jitter_push(struct win_spout_jitter *jitter, uint64_t timestamp)
+{
+	// out of order / repeated timestamps: start again from this frame
+	if (jitter->count && timestamp <= jitter_at(jitter, jitter->count - 1)->timestamp) {
+		jitter->late += jitter->count;
+		jitter->head = 0;
+		jitter->count = 0;
+	}
+
+	int slot = -1;
+	for (int i = 0; i < jitter->num_slots; i++) {
+		if (!jitter_slot_in_use(jitter, i)) {
+			slot = i;
+			break;
+		}
+	}
+
+	// full: the oldest queued frame will never be shown, recycle it
+	if (slot < 0) {
+		slot = jitter_pop(jitter).slot;
+		jitter->late++;
+	}
+
+	struct win_spout_jitter_frame *frame = jitter_at(jitter, jitter->count);
+	frame->timestamp = timestamp;
+	frame->slot = slot;
+	jitter->count++;
+
+	return slot;
+}
+
+int win_spout_jitter_present(struct win_spout_jitter *jitter, uint64_t now)
+{
+	uint64_t target = now > jitter->delay_ns ? now - jitter->delay_ns : 0;
+	bool presented = false;
+
+	if (jitter->count) {
+		uint64_t newest = jitter_at(jitter, jitter->count - 1)->timestamp;
+		if (newest > target + JITTER_RESYNC_NS || target > newest + JITTER_RESYNC_NS) {
+			// clocks have drifted apart, show the newest frame and carry on from there
+			while (jitter->count > 1) {
+				jitter_pop(jitter);
+				jitter->late++;
+			}
+			target = newest;
+		}
+	}
+
+	while (jitter->count && jitter_at(jitter, 0)->timestamp <= target) {
+		struct win_spout_jitter_frame frame = jitter_pop(jitter);
+		if (presented)
+			jitter->late++;
+		jitter->current_slot = frame.slot;
+		presented = true;
+	}
+
+	if (presented)
+		jitter->presented++;
+	else if (jitter->current_slot >= 0)
+		jitter->early++;
+
+	return jitter->current_slot;
+}
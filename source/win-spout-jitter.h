@@ -0,0 +1,56 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTJITTER_H
+#define WINSPOUTJITTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WIN_SPOUT_JITTER_MAX_SLOTS 8
+
+/**
+ * Jitter buffer bookkeeping for buffered receive. It only hands out slot
+ * indices and decides which one to present, so it has no graphics
+ * dependencies; the caller owns one texture per slot.
+ */
+struct win_spout_jitter_frame {
+	uint64_t timestamp;
+	int slot;
+};
+
+struct win_spout_jitter {
+	struct win_spout_jitter_frame queue[WIN_SPOUT_JITTER_MAX_SLOTS];
+	size_t head;
+	size_t count;
+	int num_slots;
+	int current_slot;
+	uint64_t delay_ns;
+
+	// stats
+	uint64_t presented;
+	uint64_t late;	// frames dropped because a newer one was already due
+	uint64_t early; // video frames where nothing new was due, so the last one repeats
+};
+
+void win_spout_jitter_init(struct win_spout_jitter *jitter, int num_slots, uint64_t delay_ns);
+void win_spout_jitter_reset(struct win_spout_jitter *jitter);
+
+// Queues a frame and returns the slot it should be written to
+int win_spout_jitter_push(struct win_spout_jitter *jitter, uint64_t timestamp);
+
+// Picks the frame to show at the given video time, -1 if nothing to show yet
+int win_spout_jitter_present(struct win_spout_jitter *jitter, uint64_t now);
+
+static inline size_t win_spout_jitter_depth(const struct win_spout_jitter *jitter)
+{
+	return jitter->count;
+}
+
+#endif // WINSPOUTJITTER_H
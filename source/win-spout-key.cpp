@@ -0,0 +1,69 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include "win-spout.h"
+#include "win-spout-key.h"
+
+void win_spout_key_extract(const uint8_t *bgra, uint32_t bgra_linesize, uint8_t *key, uint32_t key_linesize,
+			   uint32_t width, uint32_t height, enum win_spout_key_mode mode)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *src = bgra + (size_t)y * bgra_linesize;
+		uint8_t *dst = key + (size_t)y * key_linesize;
+		for (uint32_t x = 0; x < width; x++) {
+			dst[x] = win_spout_key_value(mode, src + x * 4);
+		}
+	}
+}
+
+void win_spout_key_fill(const uint8_t *bgra, uint32_t bgra_linesize, uint8_t *bgrx, uint32_t bgrx_linesize,
+			uint32_t width, uint32_t height, bool premultiply)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *src = bgra + (size_t)y * bgra_linesize;
+		uint8_t *dst = bgrx + (size_t)y * bgrx_linesize;
+		for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+			uint8_t a = premultiply ? src[3] : 255;
+			dst[0] = win_spout_key_premultiply(src[0], a);
+			dst[1] = win_spout_key_premultiply(src[1], a);
+			dst[2] = win_spout_key_premultiply(src[2], a);
+			dst[3] = 255;
+		}
+	}
+}
+
+gs_effect_t *win_spout_key_effect_create()
+{
+	char *path = obs_module_file("spout-key.effect");
+	if (!path) {
+		blog(LOG_ERROR, "Can't find spout-key.effect");
+		return nullptr;
+	}
+
+	char *errors = nullptr;
+	gs_effect_t *effect = gs_effect_create_from_file(path, &errors);
+	if (!effect) {
+		blog(LOG_ERROR, "Failed to load %s: %s", path, errors ? errors : "unknown error");
+	}
+
+	bfree(errors);
+	bfree(path);
+	return effect;
+}
+
+const char *win_spout_key_technique(enum win_spout_key_mode mode)
+{
+	return mode == WIN_SPOUT_KEY_LUMA ? "KeyLuma" : "KeyAlpha";
+}
+
+const char *win_spout_key_fill_technique(bool premultiply)
+{
+	return premultiply ? "FillPremultiplied" : "Fill";
+}
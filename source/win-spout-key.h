@@ -0,0 +1,65 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTKEY_H
+#define WINSPOUTKEY_H
+
+#include <stdint.h>
+#include <obs-module.h>
+
+/**
+ * Key-only senders share a single channel matte (GS_R8) instead of the
+ * full BGRA frame, optionally with an opaque fill (GS_BGRX_UNORM) sent
+ * from the same render.
+ *
+ * The GPU work is done by data/spout-key.effect. The CPU functions below
+ * are the reference for its math on 8-bit BGRA as OBS renders it, and
+ * match the effect to within one step of rounding.
+ */
+enum win_spout_key_mode {
+	WIN_SPOUT_KEY_NONE,
+	WIN_SPOUT_KEY_ALPHA,
+	WIN_SPOUT_KEY_LUMA,
+};
+
+// Rec.709 luma weights in 1/10000ths, the same as the effect's
+#define WIN_SPOUT_KEY_LUMA_R 2126
+#define WIN_SPOUT_KEY_LUMA_G 7152
+#define WIN_SPOUT_KEY_LUMA_B 722
+
+static inline uint8_t win_spout_key_value(enum win_spout_key_mode mode, const uint8_t *bgra)
+{
+	if (mode == WIN_SPOUT_KEY_LUMA) {
+		uint32_t y = WIN_SPOUT_KEY_LUMA_B * bgra[0] + WIN_SPOUT_KEY_LUMA_G * bgra[1] +
+			     WIN_SPOUT_KEY_LUMA_R * bgra[2];
+		return (uint8_t)((y + 5000) / 10000);
+	}
+	return bgra[3];
+}
+
+// c * a / 255, rounded to nearest as the GPU's unorm conversion does
+static inline uint8_t win_spout_key_premultiply(uint8_t c, uint8_t a)
+{
+	return (uint8_t)(((uint32_t)c * a * 2 + 255) / 510);
+}
+
+void win_spout_key_extract(const uint8_t *bgra, uint32_t bgra_linesize, uint8_t *key, uint32_t key_linesize,
+			   uint32_t width, uint32_t height, enum win_spout_key_mode mode);
+// Alpha of the fill is always opaque
+void win_spout_key_fill(const uint8_t *bgra, uint32_t bgra_linesize, uint8_t *bgrx, uint32_t bgrx_linesize,
+			uint32_t width, uint32_t height, bool premultiply);
+
+/* Rendering, on the render thread */
+
+// Loads the key effect, nullptr if it can't be
+gs_effect_t *win_spout_key_effect_create();
+const char *win_spout_key_technique(enum win_spout_key_mode mode);
+const char *win_spout_key_fill_technique(bool premultiply);
+
+#endif // WINSPOUTKEY_H
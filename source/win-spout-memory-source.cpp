@@ -0,0 +1,448 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/util_uint64.h>
+#include "win-spout.h"
+#include "win-spout-bridge.h"
+#include "win-spout-convert.h"
+#include "win-spout-frame-pool.h"
+#include "win-spout-metadata.h"
+#include "win-spout-shm-frame.h"
+
+#include "SpoutDX.h"
+
+#define info(message, ...) blog(LOG_INFO, "[%s] " message, obs_source_get_name(context->source), ##__VA_ARGS__)
+#define warn(message, ...) blog(LOG_WARNING, "[%s] " message, obs_source_get_name(context->source), ##__VA_ARGS__)
+
+#define SPOUT_SENDER_LIST "spoutsenders"
+#define USE_FIRST_AVAILABLE_SENDER "usefirstavailablesender"
+#define SPOUT_BRIDGE_ADDRESS "bridgeaddress"
+#define SPOUT_MEMORY_FORMAT "memoryformat"
+// how often to look for a memory share from the sender
+#define SHM_RETRY_NS 1000000000ULL
+
+struct spout_memory_source {
+	obs_source_t *source;
+
+	// mutex guards the [SHARED] fields, written from update()
+	pthread_mutex_t mutex;
+
+	// [SHARED]
+	char senderName[256];
+	bool useFirstSender;
+	bool senderChanged;
+	// receive from a network bridge instead of a local sender when set
+	char bridgeAddress[256];
+	enum win_spout_convert_format format;
+
+	// [THREAD] receive worker, owns its own spoutDX receiver and device
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *stop_event;
+};
+
+// receive worker state for handing frames to OBS
+struct memory_receive {
+	enum win_spout_convert_format format;
+	struct win_spout_frame_buffer *converted;
+
+	// the sender's metadata, for the frames' timestamps
+	char meta_name[256];
+	struct win_spout_metadata *metadata;
+	uint64_t next_meta_try;
+	uint64_t meta_frame;
+	uint64_t last_timestamp;
+};
+
+static void win_spout_memory_source_destroy(void *data);
+
+/**
+ * Timestamp for a frame of sender_name: the OBS timestamp the sender gave
+ * it when the sender publishes metadata (both are os_gettime_ns() values,
+ * so it's the time the frame was made rather than when it got here),
+ * the time of receipt otherwise
+ */
+static uint64_t win_spout_memory_source_timestamp(struct memory_receive *receive, const char *sender_name)
+{
+	uint64_t now = os_gettime_ns();
+
+	if (strcmp(receive->meta_name, sender_name) != 0) {
+		win_spout_metadata_destroy(receive->metadata);
+		receive->metadata = nullptr;
+		receive->next_meta_try = 0;
+		receive->meta_frame = 0;
+		memset(receive->meta_name, 0, sizeof(receive->meta_name));
+		strncpy(receive->meta_name, sender_name, sizeof(receive->meta_name) - 1);
+	}
+
+	if (!receive->metadata && now >= receive->next_meta_try) {
+		receive->next_meta_try = now + SHM_RETRY_NS;
+		receive->metadata = win_spout_metadata_open(sender_name);
+	}
+
+	struct win_spout_frame_metadata meta;
+	if (!win_spout_metadata_read(receive->metadata, &meta) || !meta.obs_timestamp) {
+		return now;
+	}
+
+	// the frame got here before its metadata did, it follows the last one
+	if (meta.frame_number == receive->meta_frame && meta.fps_num) {
+		return receive->last_timestamp + util_mul_div64(1000000000ULL, meta.fps_den, meta.fps_num);
+	}
+
+	receive->meta_frame = meta.frame_number;
+	return meta.obs_timestamp;
+}
+
+static void win_spout_memory_source_output(struct spout_memory_source *context, struct memory_receive *receive,
+					   const uint8_t *pixels, uint32_t pitch, uint32_t width, uint32_t height,
+					   bool rgba, uint64_t timestamp)
+{
+	struct obs_source_frame frame = {};
+	frame.width = width;
+	frame.height = height;
+	frame.timestamp = timestamp;
+	receive->last_timestamp = timestamp;
+
+	if (receive->format == WIN_SPOUT_CONVERT_NONE) {
+		frame.data[0] = (uint8_t *)pixels;
+		frame.linesize[0] = pitch;
+		frame.format = rgba ? VIDEO_FORMAT_RGBA : VIDEO_FORMAT_BGRA;
+		frame.full_range = true;
+		obs_source_output_video(context->source, &frame);
+		return;
+	}
+
+	receive->converted = win_spout_frame_pool_resize(
+		receive->converted, win_spout_convert_frame_size(receive->format, width, height));
+	if (!receive->converted) {
+		return;
+	}
+
+	uint32_t chroma_width = win_spout_convert_chroma_size(width);
+	frame.data[0] = receive->converted->data;
+	frame.linesize[0] = width;
+	frame.data[1] = frame.data[0] + (size_t)width * height;
+	if (receive->format == WIN_SPOUT_CONVERT_NV12) {
+		frame.format = VIDEO_FORMAT_NV12;
+		frame.linesize[1] = chroma_width * 2;
+	} else {
+		frame.format = VIDEO_FORMAT_I420;
+		frame.linesize[1] = chroma_width;
+		frame.data[2] = frame.data[1] + (size_t)chroma_width * win_spout_convert_chroma_size(height);
+		frame.linesize[2] = chroma_width;
+	}
+
+	win_spout_convert(receive->format, pixels, pitch, rgba, width, height, frame.data, frame.linesize);
+	video_format_get_parameters_for_format(VIDEO_CS_709, VIDEO_RANGE_PARTIAL, frame.format, frame.color_matrix,
+					       frame.color_range_min, frame.color_range_max);
+
+	obs_source_output_video(context->source, &frame);
+}
+
+// Opens the memory share of the selected (or active) sender if it has one, senderName receives its name
+static struct win_spout_shm_reader *win_spout_memory_source_open_shm(struct spout_memory_source *context,
+								     spoutDX *receiver, char *senderName)
+{
+	pthread_mutex_lock(&context->mutex);
+	bool useFirstSender = context->useFirstSender;
+	memcpy(senderName, context->senderName, sizeof(context->senderName));
+	pthread_mutex_unlock(&context->mutex);
+
+	if (useFirstSender && !receiver->GetActiveSender(senderName)) {
+		return nullptr;
+	}
+
+	struct win_spout_shm_reader *shm = win_spout_shm_reader_open(senderName);
+	if (shm) {
+		info("Receiving %s through its memory share", senderName);
+	}
+	return shm;
+}
+
+/**
+ * Receive worker, hands frames to OBS as async frames, converted to NV12
+ * or I420 first if the source is set to.
+ *
+ * Senders that share their frame in memory are read from there, copying
+ * only the tiles that changed; this is the only path that works when the
+ * sender renders on another adapter. Otherwise spoutDX opens the
+ * sender's shared texture on a device of our own and reads it back
+ * through a staging texture, which is still a GPU copy and readback, and
+ * like any DX11 shared handle only opens on the sender's adapter. With a
+ * bridge address set frames come from a network bridge instead.
+ */
+static void *win_spout_memory_source_thread(void *data)
+{
+	struct spout_memory_source *context = (spout_memory_source *)data;
+	os_set_thread_name("spout-memory-source");
+
+	spoutDX *receiver = new spoutDX;
+	if (!receiver->OpenDirectX11()) {
+		warn("Failed to Open DX11 for memory receive");
+		delete receiver;
+		return NULL;
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// spoutDX wants somewhere to write before it knows the sender's size
+	struct win_spout_frame_buffer *pixels = win_spout_frame_pool_acquire(4);
+	bool receiving = false;
+	struct win_spout_bridge_receiver *bridge = nullptr;
+	struct win_spout_shm_reader *shm = nullptr;
+	char shmName[256] = {};
+	uint64_t next_shm_try = 0;
+	struct memory_receive receive = {};
+
+	const uint64_t interval = video_output_get_frame_time(obs_get_video());
+	uint64_t next_ts = os_gettime_ns();
+
+	while (os_event_try(context->stop_event) == EAGAIN) {
+		pthread_mutex_lock(&context->mutex);
+		if (context->senderChanged) {
+			receiver->ReleaseReceiver();
+			receiver->SetReceiverName(context->useFirstSender ? nullptr : context->senderName);
+			win_spout_bridge_receiver_destroy(bridge);
+			bridge = win_spout_bridge_receiver_create(context->bridgeAddress);
+			win_spout_shm_reader_destroy(shm);
+			shm = nullptr;
+			next_shm_try = 0;
+			receive.format = context->format;
+			context->senderChanged = false;
+		}
+		pthread_mutex_unlock(&context->mutex);
+
+		// bridge frames are paced by the network, the read waits for the next one
+		if (bridge) {
+			struct win_spout_bridge_frame frame;
+			// another machine's clock, so these are timed on receipt
+			if (win_spout_bridge_receiver_read(bridge, &frame, 100)) {
+				win_spout_memory_source_output(context, &receive, frame.pixels, frame.width * 4,
+							       frame.width, frame.height, false, os_gettime_ns());
+			}
+			continue;
+		}
+
+		next_ts += interval;
+		if (!os_sleepto_ns(next_ts)) {
+			// we fell behind, don't try to catch up with a burst of frames
+			next_ts = os_gettime_ns();
+		}
+
+		if (!obs_source_showing(context->source)) {
+			continue;
+		}
+
+		uint64_t now = os_gettime_ns();
+		if (!shm && now >= next_shm_try) {
+			next_shm_try = now + SHM_RETRY_NS;
+			shm = win_spout_memory_source_open_shm(context, receiver, shmName);
+		}
+
+		if (shm && !win_spout_shm_reader_alive(shm)) {
+			info("Memory share has gone away");
+			win_spout_shm_reader_destroy(shm);
+			shm = nullptr;
+		}
+
+		if (shm) {
+			const uint8_t *data;
+			uint32_t pitch, shm_width, shm_height;
+			if (win_spout_shm_reader_read(shm, &data, &pitch, &shm_width, &shm_height)) {
+				win_spout_memory_source_output(context, &receive, data, pitch, shm_width, shm_height,
+							       false,
+							       win_spout_memory_source_timestamp(&receive, shmName));
+				receiving = true;
+			}
+			continue;
+		}
+
+		if (!pixels) {
+			warn("Failed to allocate a frame buffer for memory receive");
+			break;
+		}
+
+		if (!receiver->ReceiveImage(pixels->data, width, height)) {
+			if (receiving) {
+				info("Sender has gone away");
+				obs_source_output_video(context->source, NULL);
+				receiving = false;
+			}
+			continue;
+		}
+
+		// New connection or sender resized: resize our buffer and pick
+		// the frame up on the next pass
+		if (receiver->IsUpdated()) {
+			width = receiver->GetSenderWidth();
+			height = receiver->GetSenderHeight();
+			pixels = win_spout_frame_pool_resize(pixels, (size_t)width * height * 4);
+			info("Receiving %s (%u x %u) through memory", receiver->GetSenderName(), width, height);
+			continue;
+		}
+
+		if (!receiver->IsFrameNew() || !width || !height) {
+			continue;
+		}
+
+		win_spout_memory_source_output(context, &receive, pixels->data, width * 4, width, height, true,
+					       win_spout_memory_source_timestamp(&receive, receiver->GetSenderName()));
+		receiving = true;
+	}
+
+	win_spout_bridge_receiver_destroy(bridge);
+	win_spout_shm_reader_destroy(shm);
+	receiver->ReleaseReceiver();
+	receiver->CloseDirectX11();
+	delete receiver;
+	win_spout_frame_pool_release(pixels);
+	win_spout_frame_pool_release(receive.converted);
+	win_spout_metadata_destroy(receive.metadata);
+
+	return NULL;
+}
+
+static const char *win_spout_memory_source_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("memorysourcename");
+}
+
+static void win_spout_memory_source_update(void *data, obs_data_t *settings)
+{
+	struct spout_memory_source *context = (spout_memory_source *)data;
+
+	const char *selectedSender = obs_data_get_string(settings, SPOUT_SENDER_LIST);
+
+	pthread_mutex_lock(&context->mutex);
+	if (strcmp(selectedSender, USE_FIRST_AVAILABLE_SENDER) == 0) {
+		context->useFirstSender = true;
+	} else {
+		context->useFirstSender = false;
+		memset(context->senderName, 0, 256);
+		strncpy(context->senderName, selectedSender, 255);
+	}
+	memset(context->bridgeAddress, 0, sizeof(context->bridgeAddress));
+	strncpy(context->bridgeAddress, obs_data_get_string(settings, SPOUT_BRIDGE_ADDRESS),
+		sizeof(context->bridgeAddress) - 1);
+	context->format = (enum win_spout_convert_format)obs_data_get_int(settings, SPOUT_MEMORY_FORMAT);
+	context->senderChanged = true;
+	pthread_mutex_unlock(&context->mutex);
+}
+
+static void *win_spout_memory_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct spout_memory_source *context = (spout_memory_source *)bzalloc(sizeof(spout_memory_source));
+	context->source = source;
+	context->useFirstSender = true;
+	context->thread_active = false;
+
+	pthread_mutex_init_value(&context->mutex);
+	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Failed to create mutex for spout memory source!");
+		win_spout_memory_source_destroy(context);
+		return nullptr;
+	}
+
+	if (os_event_init(&context->stop_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		blog(LOG_ERROR, "Failed to create event for spout memory source!");
+		win_spout_memory_source_destroy(context);
+		return nullptr;
+	}
+
+	win_spout_memory_source_update(context, settings);
+
+	if (pthread_create(&context->thread, NULL, win_spout_memory_source_thread, context) != 0) {
+		blog(LOG_ERROR, "Failed to create thread for spout memory source!");
+		win_spout_memory_source_destroy(context);
+		return nullptr;
+	}
+	context->thread_active = true;
+
+	return context;
+}
+
+static void win_spout_memory_source_destroy(void *data)
+{
+	struct spout_memory_source *context = (spout_memory_source *)data;
+
+	if (!context) {
+		return;
+	}
+
+	if (context->thread_active) {
+		os_event_signal(context->stop_event);
+		pthread_join(context->thread, NULL);
+		context->thread_active = false;
+	}
+
+	os_event_destroy(context->stop_event);
+	pthread_mutex_destroy(&context->mutex);
+	bfree(context);
+}
+
+static void win_spout_memory_source_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, SPOUT_SENDER_LIST, USE_FIRST_AVAILABLE_SENDER);
+	obs_data_set_default_int(settings, SPOUT_MEMORY_FORMAT, WIN_SPOUT_CONVERT_NONE);
+}
+
+static obs_properties_t *win_spout_memory_source_properties(void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_property_t *sender_list = obs_properties_add_list(props, SPOUT_SENDER_LIST, obs_module_text("SpoutSenders"),
+							      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+
+	obs_property_list_add_string(sender_list, obs_module_text("usefirstavailablesender"),
+				     USE_FIRST_AVAILABLE_SENDER);
+
+	obs_properties_add_text(props, SPOUT_BRIDGE_ADDRESS, obs_module_text("bridgeaddress"), OBS_TEXT_DEFAULT);
+
+	obs_property_t *format_list = obs_properties_add_list(props, SPOUT_MEMORY_FORMAT,
+							      obs_module_text("memoryformat"), OBS_COMBO_TYPE_LIST,
+							      OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(format_list, obs_module_text("memoryformat.bgra"), WIN_SPOUT_CONVERT_NONE);
+	obs_property_list_add_int(format_list, obs_module_text("memoryformat.nv12"), WIN_SPOUT_CONVERT_NV12);
+	obs_property_list_add_int(format_list, obs_module_text("memoryformat.i420"), WIN_SPOUT_CONVERT_I420);
+
+	// sender names live in shared memory, no device needed to list them
+	spoutDX spout;
+	int totalSenders = spout.GetSenderCount();
+	for (int index = 0; index < totalSenders; index++) {
+		char senderName[256];
+		if (spout.GetSender(index, senderName, 256)) {
+			obs_property_list_add_string(sender_list, senderName, senderName);
+		}
+	}
+
+	return props;
+}
+
+struct obs_source_info create_spout_memory_source_info()
+{
+	struct obs_source_info spout_memory_source_info = {};
+	spout_memory_source_info.id = "spout_memory_capture";
+	spout_memory_source_info.type = OBS_SOURCE_TYPE_INPUT;
+	spout_memory_source_info.output_flags = OBS_SOURCE_ASYNC_VIDEO;
+	spout_memory_source_info.get_name = win_spout_memory_source_get_name;
+	spout_memory_source_info.create = win_spout_memory_source_create;
+	spout_memory_source_info.destroy = win_spout_memory_source_destroy;
+	spout_memory_source_info.update = win_spout_memory_source_update;
+	spout_memory_source_info.get_defaults = win_spout_memory_source_defaults;
+	spout_memory_source_info.get_properties = win_spout_memory_source_properties;
+
+	return spout_memory_source_info;
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <atomic>
+#include <thread>
+#include "win-spout.h"
+#include "win-spout-shm.h"
+#include "win-spout-metadata.h"
+
+#define METADATA_SUFFIX "_OBSMeta"
+
+// Shared layout. seq is odd while the writer is updating the frame,
+// readers retry until they see the same even value either side of the copy.
+struct shared_metadata {
+	volatile long seq;
+	struct win_spout_frame_metadata frame;
+};
+
+struct win_spout_metadata {
+	struct win_spout_shm_section *section;
+	struct shared_metadata *shared;
+};
+
+static struct win_spout_metadata *win_spout_metadata_wrap(struct win_spout_shm_section *section)
+{
+	if (!section) {
+		return nullptr;
+	}
+
+	struct win_spout_metadata *meta = (win_spout_metadata *)bzalloc(sizeof(win_spout_metadata));
+	meta->section = section;
+	meta->shared = (struct shared_metadata *)win_spout_shm_section_data(section);
+	return meta;
+}
+
+struct win_spout_metadata *win_spout_metadata_create(const char *sender_name)
+{
+	if (!sender_name || !*sender_name) {
+		return nullptr;
+	}
+
+	struct dstr name = {};
+	dstr_printf(&name, "%s" METADATA_SUFFIX, sender_name);
+	struct win_spout_shm_section *section =
+		win_spout_shm_section_create(name.array, sizeof(struct shared_metadata));
+	dstr_free(&name);
+
+	struct win_spout_metadata *meta = win_spout_metadata_wrap(section);
+	if (!meta) {
+		blog(LOG_WARNING, "Failed to create frame metadata for sender %s", sender_name);
+	}
+	return meta;
+}
+
+struct win_spout_metadata *win_spout_metadata_open(const char *sender_name)
+{
+	if (!sender_name || !*sender_name) {
+		return nullptr;
+	}
+
+	struct dstr name = {};
+	dstr_printf(&name, "%s" METADATA_SUFFIX, sender_name);
+	struct win_spout_shm_section *section =
+		win_spout_shm_section_open(name.array, sizeof(struct shared_metadata), false);
+	dstr_free(&name);
+
+	return win_spout_metadata_wrap(section);
+}
+
+void win_spout_metadata_destroy(struct win_spout_metadata *meta)
+{
+	if (!meta) {
+		return;
+	}
+
+	win_spout_shm_section_destroy(meta->section);
+	bfree(meta);
+}
+
+void win_spout_metadata_write(struct win_spout_metadata *meta, const struct win_spout_frame_metadata *frame)
+{
+	if (!meta) {
+		return;
+	}
+
+	os_atomic_inc_long(&meta->shared->seq);
+	meta->shared->frame = *frame;
+	meta->shared->frame.version = WIN_SPOUT_METADATA_VERSION;
+	os_atomic_inc_long(&meta->shared->seq);
+}
+
+bool win_spout_metadata_read(struct win_spout_metadata *meta, struct win_spout_frame_metadata *frame)
+{
+	if (!meta) {
+		return false;
+	}
+
+	for (int attempt = 0; attempt < 4; attempt++) {
+		long before = os_atomic_load_long(&meta->shared->seq);
+		if (before & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		*frame = meta->shared->frame;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (os_atomic_load_long(&meta->shared->seq) == before) {
+			return frame->version == WIN_SPOUT_METADATA_VERSION;
+		}
+	}
+	return false;
+}
+
+void win_spout_metadata_get_program_name(char *name, size_t size)
+{
+	name[0] = '\0';
+
+	obs_source_t *program = obs_get_output_source(0);
+	if (!program) {
+		return;
+	}
+
+	obs_source_t *scene = program;
+	if (obs_source_get_type(program) == OBS_SOURCE_TYPE_TRANSITION) {
+		scene = obs_transition_get_active_source(program);
+		obs_source_release(program);
+	}
+
+	if (scene) {
+		const char *scene_name = obs_source_get_name(scene);
+		if (scene_name) {
+			strncpy(name, scene_name, size - 1);
+			name[size - 1] = '\0';
+		}
+		obs_source_release(scene);
+	}
+}
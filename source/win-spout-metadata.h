@@ -0,0 +1,52 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTMETADATA_H
+#define WINSPOUTMETADATA_H
+
+#include <stdint.h>
+
+#define WIN_SPOUT_METADATA_VERSION 2
+
+/**
+ * Per-frame block written next to each sender's texture in a named
+ * shared memory section ("<sender name>_OBSMeta").
+ * Times are os_gettime_ns() values, which are comparable between
+ * processes on the same machine.
+ */
+struct win_spout_frame_metadata {
+	uint32_t version;
+	uint32_t fps_num;
+	uint32_t fps_den;
+	uint64_t frame_number;
+	uint64_t obs_timestamp; // OBS video timestamp of the frame
+	uint64_t send_time;	// when the frame was handed to Spout
+	char scene_name[256];
+	// 0 when the texture holds pixels in its own format, otherwise the
+	// enum win_spout_yuv_format it is packed in (see win-spout-yuv.h),
+	// with yuv_matrix the enum win_spout_yuv_matrix it was converted with
+	uint32_t pixel_layout;
+	uint32_t yuv_matrix;
+};
+
+struct win_spout_metadata;
+
+// Sender side: creates (or takes over) the section for the sender name
+struct win_spout_metadata *win_spout_metadata_create(const char *sender_name);
+// Receiver side: returns nullptr if the sender doesn't publish metadata
+struct win_spout_metadata *win_spout_metadata_open(const char *sender_name);
+void win_spout_metadata_destroy(struct win_spout_metadata *meta);
+
+void win_spout_metadata_write(struct win_spout_metadata *meta, const struct win_spout_frame_metadata *frame);
+bool win_spout_metadata_read(struct win_spout_metadata *meta, struct win_spout_frame_metadata *frame);
+
+// Current program scene name, safe to call from the video / render threads
+void win_spout_metadata_get_program_name(char *name, size_t size);
+
+#endif // WINSPOUTMETADATA_H
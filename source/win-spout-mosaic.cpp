@@ -0,0 +1,389 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <math.h>
+#include "win-spout.h"
+
+#include "SpoutLibrary.h"
+#pragma comment(lib, "SpoutLibrary.lib")
+
+#define info(message, ...) blog(LOG_INFO, "[%s] " message, obs_source_get_name(context->source), ##__VA_ARGS__)
+
+#define MOSAIC_PROP_SENDERS "mosaicsenders"
+#define MOSAIC_PROP_COLUMNS "mosaiccolumns"
+#define MOSAIC_PROP_WIDTH "mosaicwidth"
+#define MOSAIC_PROP_HEIGHT "mosaicheight"
+#define SPOUT_TICK_SPEED_LIMIT "tickspeedlimit"
+
+struct mosaic_tile {
+	char senderName[256];
+	HANDLE dxHandle;
+	DWORD dxFormat;
+	uint32_t width;
+	uint32_t height;
+	gs_texture_t *texture;
+};
+
+struct spout_mosaic {
+	obs_source_t *source;
+	SPOUTHANDLE spout_receiver_ptr;
+
+	// mutex guards the settings below, which are written from update()
+	pthread_mutex_t mutex;
+	char *patterns;
+	uint32_t columns;
+	uint32_t width;
+	uint32_t height;
+	ULONGLONG tick_speed_limit;
+
+	// [GRAPHICS] only touched from tick / render
+	ULONGLONG lastCheckTick;
+	DARRAY(struct mosaic_tile) tiles;
+};
+
+/**
+ * Matches a sender name against a pattern with * and ? wildcards
+ */
+static bool win_spout_mosaic_match(const char *pattern, const char *name)
+{
+	const char *star = NULL;
+	const char *retry = NULL;
+
+	while (*name) {
+		if (*pattern == '?' || *pattern == *name) {
+			pattern++;
+			name++;
+		} else if (*pattern == '*') {
+			star = pattern++;
+			retry = name;
+		} else if (star) {
+			pattern = star + 1;
+			name = ++retry;
+		} else {
+			return false;
+		}
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return *pattern == '\0';
+}
+
+static void win_spout_mosaic_tile_release(struct mosaic_tile *tile)
+{
+	if (tile->texture) {
+		gs_texture_destroy(tile->texture);
+		tile->texture = NULL;
+	}
+}
+
+static bool win_spout_mosaic_has_tile(const struct mosaic_tile *tiles, size_t num, const char *senderName)
+{
+	for (size_t i = 0; i < num; i++) {
+		if (strcmp(tiles[i].senderName, senderName) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Appends a tile for the sender, reusing the already opened texture
+ * from the previous set of tiles when the shared handle is unchanged
+ */
+static void win_spout_mosaic_add_tile(struct spout_mosaic *context, struct mosaic_tile *old_tiles, size_t old_num,
+				      const char *senderName)
+{
+	struct mosaic_tile tile = {};
+	strncpy(tile.senderName, senderName, sizeof(tile.senderName) - 1);
+
+	unsigned int width, height;
+	if (!context->spout_receiver_ptr->GetSenderInfo(tile.senderName, width, height, tile.dxHandle,
+							tile.dxFormat)) {
+		return;
+	}
+	tile.width = width;
+	tile.height = height;
+
+	for (size_t i = 0; i < old_num; i++) {
+		struct mosaic_tile *old = &old_tiles[i];
+		if (strcmp(old->senderName, tile.senderName) == 0 && old->dxHandle == tile.dxHandle) {
+			tile.texture = old->texture;
+			old->texture = NULL;
+			break;
+		}
+	}
+
+	if (!tile.texture && tile.dxHandle) {
+		tile.texture = gs_texture_open_shared((uint32_t)(uintptr_t)tile.dxHandle);
+	}
+
+	if (tile.texture) {
+		da_push_back(context->tiles, &tile);
+	}
+}
+
+/**
+ * Single discovery pass over all senders, shared by every tile
+ */
+static void win_spout_mosaic_refresh(struct spout_mosaic *context)
+{
+	SPOUTHANDLE spoutptr = context->spout_receiver_ptr;
+
+	int totalSenders = spoutptr->GetSenderCount();
+	DARRAY(char *) names;
+	da_init(names);
+	for (int index = 0; index < totalSenders; index++) {
+		char senderName[256];
+		if (spoutptr->GetSender(index, senderName)) {
+			char *name = bstrdup(senderName);
+			da_push_back(names, &name);
+		}
+	}
+
+	pthread_mutex_lock(&context->mutex);
+	char *patterns = bstrdup(context->patterns ? context->patterns : "");
+	pthread_mutex_unlock(&context->mutex);
+
+	struct mosaic_tile *old_tiles = context->tiles.array;
+	size_t old_num = context->tiles.num;
+	da_init(context->tiles);
+
+	obs_enter_graphics();
+
+	// Tiles are laid out in the order the patterns are listed
+	char *save = NULL;
+	for (char *pattern = strtok_s(patterns, ",\n", &save); pattern; pattern = strtok_s(NULL, ",\n", &save)) {
+		while (*pattern == ' ' || *pattern == '\r')
+			pattern++;
+		size_t len = strlen(pattern);
+		while (len && (pattern[len - 1] == ' ' || pattern[len - 1] == '\r'))
+			pattern[--len] = '\0';
+		if (!len)
+			continue;
+
+		for (size_t i = 0; i < names.num; i++) {
+			if (!win_spout_mosaic_match(pattern, names.array[i]))
+				continue;
+			if (win_spout_mosaic_has_tile(context->tiles.array, context->tiles.num, names.array[i]))
+				continue;
+			win_spout_mosaic_add_tile(context, old_tiles, old_num, names.array[i]);
+		}
+	}
+
+	for (size_t i = 0; i < old_num; i++)
+		win_spout_mosaic_tile_release(&old_tiles[i]);
+
+	obs_leave_graphics();
+
+	bfree(old_tiles);
+	bfree(patterns);
+	for (size_t i = 0; i < names.num; i++)
+		bfree(names.array[i]);
+	da_free(names);
+}
+
+static const char *win_spout_mosaic_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("mosaicname");
+}
+
+static void win_spout_mosaic_update(void *data, obs_data_t *settings)
+{
+	struct spout_mosaic *context = (spout_mosaic *)data;
+
+	pthread_mutex_lock(&context->mutex);
+	bfree(context->patterns);
+	context->patterns = bstrdup(obs_data_get_string(settings, MOSAIC_PROP_SENDERS));
+	context->columns = (uint32_t)obs_data_get_int(settings, MOSAIC_PROP_COLUMNS);
+	context->width = (uint32_t)obs_data_get_int(settings, MOSAIC_PROP_WIDTH);
+	context->height = (uint32_t)obs_data_get_int(settings, MOSAIC_PROP_HEIGHT);
+	context->tick_speed_limit = obs_data_get_int(settings, SPOUT_TICK_SPEED_LIMIT);
+	pthread_mutex_unlock(&context->mutex);
+
+	// force a discovery pass on the next tick
+	context->lastCheckTick = 0;
+}
+
+static void win_spout_mosaic_destroy(void *data);
+
+static void *win_spout_mosaic_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct spout_mosaic *context = (spout_mosaic *)bzalloc(sizeof(spout_mosaic));
+	context->source = source;
+	context->spout_receiver_ptr = GetSpout();
+	context->patterns = nullptr;
+	da_init(context->tiles);
+
+	pthread_mutex_init_value(&context->mutex);
+	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Failed to create mutex for spout mosaic!");
+		win_spout_mosaic_destroy(context);
+		return nullptr;
+	}
+
+	info("initialising spout mosaic");
+	win_spout_mosaic_update(context, settings);
+	return context;
+}
+
+static void win_spout_mosaic_destroy(void *data)
+{
+	struct spout_mosaic *context = (spout_mosaic *)data;
+
+	if (!context) {
+		return;
+	}
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < context->tiles.num; i++)
+		win_spout_mosaic_tile_release(&context->tiles.array[i]);
+	obs_leave_graphics();
+	da_free(context->tiles);
+
+	if (context->spout_receiver_ptr != NULL) {
+		context->spout_receiver_ptr->Release();
+		context->spout_receiver_ptr = nullptr;
+	}
+
+	bfree(context->patterns);
+	pthread_mutex_destroy(&context->mutex);
+	bfree(context);
+}
+
+static void win_spout_mosaic_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, MOSAIC_PROP_SENDERS, "*");
+	obs_data_set_default_int(settings, MOSAIC_PROP_COLUMNS, 0);
+	obs_data_set_default_int(settings, MOSAIC_PROP_WIDTH, 1920);
+	obs_data_set_default_int(settings, MOSAIC_PROP_HEIGHT, 1080);
+	obs_data_set_default_int(settings, SPOUT_TICK_SPEED_LIMIT, 500);
+}
+
+static uint32_t win_spout_mosaic_getwidth(void *data)
+{
+	struct spout_mosaic *context = (spout_mosaic *)data;
+	pthread_mutex_lock(&context->mutex);
+	uint32_t width = context->width;
+	pthread_mutex_unlock(&context->mutex);
+	return width;
+}
+
+static uint32_t win_spout_mosaic_getheight(void *data)
+{
+	struct spout_mosaic *context = (spout_mosaic *)data;
+	pthread_mutex_lock(&context->mutex);
+	uint32_t height = context->height;
+	pthread_mutex_unlock(&context->mutex);
+	return height;
+}
+
+static void win_spout_mosaic_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	struct spout_mosaic *context = (spout_mosaic *)data;
+
+	if (context->spout_receiver_ptr == NULL) {
+		return;
+	}
+
+	if (GetTickCount64() - context->lastCheckTick < context->tick_speed_limit) {
+		return;
+	}
+	context->lastCheckTick = GetTickCount64();
+
+	win_spout_mosaic_refresh(context);
+}
+
+static void win_spout_mosaic_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+	struct spout_mosaic *context = (spout_mosaic *)data;
+
+	pthread_mutex_lock(&context->mutex);
+	uint32_t columns = context->columns;
+	uint32_t width = context->width;
+	uint32_t height = context->height;
+	pthread_mutex_unlock(&context->mutex);
+
+	size_t num = context->tiles.num;
+	if (!num || !width || !height) {
+		return;
+	}
+
+	uint32_t cols = columns ? columns : (uint32_t)ceil(sqrt((double)num));
+	uint32_t rows = (uint32_t)((num + cols - 1) / cols);
+	float cell_cx = (float)width / (float)cols;
+	float cell_cy = (float)height / (float)rows;
+
+	effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+
+	// All tiles are drawn in a single pass, only the image param changes
+	while (gs_effect_loop(effect, "Draw")) {
+		for (size_t i = 0; i < num; i++) {
+			struct mosaic_tile *tile = &context->tiles.array[i];
+			if (!tile->texture || !tile->width || !tile->height)
+				continue;
+
+			// fit the sender into its cell, keeping aspect ratio
+			float scale = fminf(cell_cx / (float)tile->width, cell_cy / (float)tile->height);
+			float cx = (float)tile->width * scale;
+			float cy = (float)tile->height * scale;
+			float x = (float)(i % cols) * cell_cx + (cell_cx - cx) * 0.5f;
+			float y = (float)(i / cols) * cell_cy + (cell_cy - cy) * 0.5f;
+
+			obs_source_draw(tile->texture, (int)x, (int)y, (uint32_t)cx, (uint32_t)cy, false);
+		}
+	}
+}
+
+static obs_properties_t *win_spout_mosaic_properties(void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, MOSAIC_PROP_SENDERS, obs_module_text("mosaicsenders"), OBS_TEXT_MULTILINE);
+	obs_properties_add_int(props, MOSAIC_PROP_COLUMNS, obs_module_text("mosaiccolumns"), 0, 64, 1);
+	obs_properties_add_int(props, MOSAIC_PROP_WIDTH, obs_module_text("mosaicwidth"), 16, 16384, 1);
+	obs_properties_add_int(props, MOSAIC_PROP_HEIGHT, obs_module_text("mosaicheight"), 16, 16384, 1);
+
+	obs_property_t *tick_speed_limit_list = obs_properties_add_list(props, SPOUT_TICK_SPEED_LIMIT,
+									obs_module_text("tickspeedlimit"),
+									OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(tick_speed_limit_list, obs_module_text("tickspeedfast"), 100);
+	obs_property_list_add_int(tick_speed_limit_list, obs_module_text("tickspeednormal"), 500);
+	obs_property_list_add_int(tick_speed_limit_list, obs_module_text("tickspeedslow"), 1000);
+
+	return props;
+}
+
+struct obs_source_info create_spout_mosaic_info()
+{
+	struct obs_source_info spout_mosaic_info = {};
+	spout_mosaic_info.id = "spout_mosaic";
+	spout_mosaic_info.type = OBS_SOURCE_TYPE_INPUT;
+	spout_mosaic_info.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW;
+	spout_mosaic_info.get_name = win_spout_mosaic_get_name;
+	spout_mosaic_info.create = win_spout_mosaic_create;
+	spout_mosaic_info.destroy = win_spout_mosaic_destroy;
+	spout_mosaic_info.update = win_spout_mosaic_update;
+	spout_mosaic_info.get_defaults = win_spout_mosaic_defaults;
+	spout_mosaic_info.get_width = win_spout_mosaic_getwidth;
+	spout_mosaic_info.get_height = win_spout_mosaic_getheight;
+	spout_mosaic_info.video_render = win_spout_mosaic_render;
+	spout_mosaic_info.video_tick = win_spout_mosaic_tick;
+	spout_mosaic_info.get_properties = win_spout_mosaic_properties;
+
+	return spout_mosaic_info;
+}
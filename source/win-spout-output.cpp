@@ -8,16 +8,108 @@
  */
 
 #include <obs-module.h>
+#include <util/platform.h>
 #include <util/threading.h>
+#include <util/darray.h>
 #include "win-spout.h"
+#include "win-spout-metadata.h"
+#include "win-spout-audio.h"
+#include "win-spout-bridge.h"
+#include "win-spout-shm-frame.h"
+#include "win-spout-region.h"
+#include "win-spout-trace.h"
+#include "win-spout-alloc-track.h"
+#include "win-spout-watchdog.h"
+#include "win-spout-send-pool.h"
+#include "win-spout-frame-pool.h"
+#include "win-spout-gpu-budget.h"
+#include "win-spout-yuv.h"
 
 #include "SpoutDX.h"
 
+// one being sent, one waiting and one being filled
+#define OUTPUT_FRAMES 3
+
+struct spout_output;
+
+// One piece of a frame's send work, handed to the send workers
+struct spout_output_job {
+	struct spout_output *context;
+	spoutDX *sender;
+	const uint8_t *data;
+	uint32_t linesize;
+	struct win_spout_region region;
+	uint32_t width;
+	uint32_t height;
+	// packed before it is sent, WIN_SPOUT_YUV_NONE sends BGRA
+	enum win_spout_yuv_format yuv_format;
+	enum win_spout_yuv_matrix yuv_matrix;
+};
+
+/**
+ * A copy of a program frame and the work of sending it. OBS's frame is
+ * only valid during raw_video, so it's copied into a pooled buffer and
+ * the sends are handed to the send workers without waiting for them.
+ * The buffer goes back to the pool once the last of them is done.
+ */
+struct spout_output_frame {
+	struct spout_output *context;
+	struct win_spout_frame_buffer *buffer;
+	struct win_spout_frame_metadata meta;
+	// reused every frame, the first send_jobs are sends to senders
+	DARRAY(struct spout_output_job) jobs;
+	size_t send_jobs;
+	DARRAY(struct win_spout_send_task) tasks;
+	struct win_spout_send_batch batch;
+	uint64_t send_start;
+};
+
+// Extra sender sharing a region of the program frame
+struct spout_output_region {
+	char name[256];
+	struct win_spout_region region;
+	spoutDX *sender;
+};
+
 struct spout_output {
 	spoutDX *sender;
 	obs_output_t *output;
 	const char *senderName;
+	// use OBS's own D3D11 device rather than creating a second one
+	bool share_device;
+	// also share OBS's audio in a ring next to the sender
+	bool share_audio;
+	struct win_spout_audio *audio;
+	// TCP port the program is also streamed on for other machines, 0 for none
+	int bridge_port;
+	char bridge_address[256];
+	struct win_spout_bridge_sender *bridge;
+	// also share the frame in memory for CPU receivers, sending only changed tiles
+	bool memory_share;
+	struct win_spout_shm_writer *shm;
+	// the main sender's texture format, region senders have no metadata to say it so stay BGRA
+	enum win_spout_yuv_format yuv_format;
+	enum win_spout_yuv_matrix yuv_matrix;
 	bool output_started;
+	struct win_spout_metadata *metadata;
+	uint64_t frame_number;
+	// region of the frame the main sender shares, empty for all of it
+	struct win_spout_region crop;
+	DARRAY(struct spout_output_region) regions;
+	// One frame is sent at a time, the newest frame that arrives in the
+	// meantime waits for it and any older one waiting is skipped.
+	// send_mutex guards sending, pending, the send stats and
+	// frame_number; idle is set while nothing is being sent.
+	struct spout_output_frame frames[OUTPUT_FRAMES];
+	struct spout_output_frame *sending;
+	struct spout_output_frame *pending;
+	pthread_mutex_t send_mutex;
+	os_event_t *idle;
+	uint64_t frames_skipped;
+	// sends that took longer than a frame
+	struct win_spout_send_watch send_watch;
+	// the senders' textures, the output is always in use so never evicted
+	struct win_spout_gpu_account *gpu_account;
 	// mutex guards accesses to rest of context variables,
 	// and any methods on spoutDX* sender.
 	// Calling obs methods on obs_output_t* output seems thread-safe.
@@ -27,6 +119,7 @@ struct spout_output {
 
 // Forward decls
 void win_spout_output_destroy(void *data);
+static void win_spout_output_frame_sent(void *param);
 
 bool init_spout(void *data)
 {
@@ -36,10 +129,38 @@ bool init_spout(void *data)
 	// spoututils::EnableSpoutLog();
 	context->sender->SetMaxSenders(255);
 
-	if (!context->sender->OpenDirectX11()) {
+	ID3D11Device *d3d_device = nullptr;
+	if (context->share_device) {
+		obs_enter_graphics();
+		d3d_device = (ID3D11Device *)gs_get_device_obj();
+		obs_leave_graphics();
+
+		if (!d3d_device) {
+			blog(LOG_ERROR, "Failed to retrieve OBS d3d11 device");
+			return false;
+		}
+	}
+
+	if (!context->sender->OpenDirectX11(d3d_device)) {
 		blog(LOG_ERROR, "Failed to Open DX11");
 		return false;
 	}
+	if (context->yuv_format != WIN_SPOUT_YUV_NONE) {
+		context->sender->SetSenderFormat(context->yuv_format == WIN_SPOUT_YUV_P010 ? DXGI_FORMAT_R16_UNORM
+											   : DXGI_FORMAT_R8_UNORM);
+	}
+
+	for (size_t i = 0; i < context->regions.num; i++) {
+		struct spout_output_region *region = &context->regions.array[i];
+		region->sender = new spoutDX;
+		if (!region->sender->OpenDirectX11(d3d_device)) {
+			blog(LOG_ERROR, "Failed to Open DX11 for region sender %s", region->name);
+			delete region->sender;
+			region->sender = nullptr;
+			continue;
+		}
+		region->sender->SetSenderName(region->name);
+	}
 	blog(LOG_INFO, "Opened DX11");
 
 	return true;
@@ -51,10 +172,70 @@ static const char *win_spout_output_get_name(void *unused)
 	return obs_module_text("outputname");
 }
 
+static void win_spout_output_release_regions(spout_output *context)
+{
+	for (size_t i = 0; i < context->regions.num; i++) {
+		spoutDX *sender = context->regions.array[i].sender;
+		if (sender) {
+			sender->ReleaseSender();
+			sender->CloseDirectX11();
+			delete sender;
+			context->regions.array[i].sender = nullptr;
+		}
+	}
+}
+
+/**
+ * Parses region senders of the form "name@x,y,WIDTHxHEIGHT",
+ * separated by semicolons or new lines
+ */
+static void win_spout_output_parse_regions(spout_output *context, const char *str)
+{
+	win_spout_output_release_regions(context);
+	da_free(context->regions);
+
+	char *buf = bstrdup(str);
+	char *save = NULL;
+	for (char *entry = strtok_s(buf, ";\r\n", &save); entry; entry = strtok_s(NULL, ";\r\n", &save)) {
+		char *at = strchr(entry, '@');
+		if (!at)
+			continue;
+		*at++ = '\0';
+
+		struct spout_output_region region = {};
+		strncpy(region.name, entry, sizeof(region.name) - 1);
+		if (*region.name && win_spout_region_parse(at, &region.region)) {
+			da_push_back(context->regions, &region);
+		}
+	}
+	bfree(buf);
+}
+
 static void win_spout_output_update(void *data, obs_data_t *settings)
 {
 	spout_output *context = (spout_output *)data;
+
+	pthread_mutex_lock(&context->mutex);
 	context->senderName = obs_data_get_string(settings, "senderName");
+	win_spout_gpu_account_set_name(context->gpu_account, context->senderName);
+	// the device and audio capture are chosen when the output starts, the
+	// send path takes the graphics lock by share_device on every frame
+	if (!context->output_started) {
+		context->share_device = obs_data_get_bool(settings, "shareDevice");
+		context->share_audio = obs_data_get_bool(settings, "shareAudio");
+		context->bridge_port = (int)obs_data_get_int(settings, "bridgePort");
+		strncpy(context->bridge_address, obs_data_get_string(settings, "bridgeAddress"),
+			sizeof(context->bridge_address) - 1);
+		context->memory_share = obs_data_get_bool(settings, "memoryShare");
+		context->yuv_format = (enum win_spout_yuv_format)obs_data_get_int(settings, "yuvFormat");
+		context->yuv_matrix = (enum win_spout_yuv_matrix)obs_data_get_int(settings, "yuvMatrix");
+	}
+	win_spout_region_parse(obs_data_get_string(settings, "crop"), &context->crop);
+	// region senders are (re)created when the output starts
+	if (!context->output_started) {
+		win_spout_output_parse_regions(context, obs_data_get_string(settings, "regions"));
+	}
+	pthread_mutex_unlock(&context->mutex);
 }
 
 static void *win_spout_output_create(obs_data_t *settings, obs_output_t *output)
@@ -63,20 +244,25 @@ static void *win_spout_output_create(obs_data_t *settings, obs_output_t *output)
 	context->output = output;
 	context->senderName = obs_data_get_string(settings, "senderName");
 	context->output_started = false;
+	// The DirectX device and sender are only created once the output starts
 	context->sender = new spoutDX;
+	da_init(context->regions);
+	context->gpu_account = win_spout_gpu_account_create("output", context->senderName, false);
+	for (size_t i = 0; i < OUTPUT_FRAMES; i++) {
+		context->frames[i].context = context;
+		context->frames[i].batch.done = win_spout_output_frame_sent;
+		context->frames[i].batch.param = &context->frames[i];
+	}
 
 	pthread_mutex_init_value(&context->mutex);
-	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
+	pthread_mutex_init_value(&context->send_mutex);
+	if (pthread_mutex_init(&context->mutex, NULL) != 0 || pthread_mutex_init(&context->send_mutex, NULL) != 0 ||
+	    os_event_init(&context->idle, OS_EVENT_TYPE_MANUAL) != 0) {
 		blog(LOG_ERROR, "Failed to create mutex for spout output!");
 		win_spout_output_destroy(context);
 		return nullptr;
 	}
-
-	if (!init_spout(context)) {
-		blog(LOG_ERROR, "Failed to create spout output!");
-		win_spout_output_destroy(context);
-		return nullptr;
-	}
+	os_event_signal(context->idle);
 
 	win_spout_output_update(context, settings);
 
@@ -92,13 +278,33 @@ static void win_spout_output_destroy(void *data)
 		return;
 	}
 
+	if (context->idle) {
+		os_event_wait(context->idle);
+		os_event_destroy(context->idle);
+	}
+
 	if (context->sender) {
 		context->sender->CloseDirectX11();
 		delete context->sender;
 		context->sender = nullptr;
 	}
 
+	win_spout_metadata_destroy(context->metadata);
+	win_spout_audio_destroy(context->audio);
+	win_spout_bridge_sender_destroy(context->bridge);
+	win_spout_shm_writer_destroy(context->shm);
+
+	win_spout_output_release_regions(context);
+	da_free(context->regions);
+	for (size_t i = 0; i < OUTPUT_FRAMES; i++) {
+		win_spout_frame_pool_release(context->frames[i].buffer);
+		da_free(context->frames[i].jobs);
+		da_free(context->frames[i].tasks);
+	}
+	win_spout_gpu_account_destroy(context->gpu_account);
+
 	pthread_mutex_destroy(&context->mutex);
+	pthread_mutex_destroy(&context->send_mutex);
 	bfree(context);
 }
 
@@ -117,6 +323,7 @@ bool win_spout_output_start(void *data)
 	context->sender->SetSenderName(context->senderName);
 
 	obs_output_t *output = context->output;
+	bool share_audio = context->share_audio;
 
 	pthread_mutex_unlock(&context->mutex);
 
@@ -142,11 +349,71 @@ bool win_spout_output_start(void *data)
 
 	obs_output_set_video_conversion(output, &info);
 
+	// OBS captures the audio of an AV output either way, without sharing
+	// it there is no ring to write it to and raw_audio drops it
+	struct audio_convert_info audio_info = {};
+	if (share_audio) {
+		const struct audio_output_info *aoi = audio_output_get_info(obs_output_audio(output));
+		if (!aoi) {
+			blog(LOG_ERROR, "Trying to share audio with no audio!");
+			return false;
+		}
+		// planar float is what the shared ring holds
+		audio_info.samples_per_sec = aoi->samples_per_sec;
+		audio_info.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		audio_info.speakers = aoi->speakers;
+		obs_output_set_audio_conversion(output, &audio_info);
+	}
+
+	pthread_mutex_lock(&context->mutex);
+	bool ok = init_spout(context);
+	if (ok && share_audio) {
+		context->audio = win_spout_audio_create(context->senderName, audio_info.samples_per_sec,
+							get_audio_channels(audio_info.speakers));
+	}
+	pthread_mutex_unlock(&context->mutex);
+
+	if (!ok) {
+		blog(LOG_ERROR, "Failed to create spout output!");
+		return false;
+	}
+
 	bool started = obs_output_begin_data_capture(output, 0);
 
 	pthread_mutex_lock(&context->mutex);
 
 	context->output_started = started;
+	if (!started) {
+		context->sender->CloseDirectX11();
+		win_spout_output_release_regions(context);
+		win_spout_audio_destroy(context->audio);
+		context->audio = nullptr;
+	} else {
+		// each sender's shared texture is the size of what it shares, in BGRA or packed
+		struct win_spout_region region = context->crop;
+		win_spout_region_clamp(&region, (uint32_t)width, (uint32_t)height);
+		uint64_t bytes = (uint64_t)region.width * region.height * 4;
+		if (context->yuv_format != WIN_SPOUT_YUV_NONE) {
+			bytes = (uint64_t)(region.width & ~1U) * (region.height & ~1U) / 2 * 3 *
+				(context->yuv_format == WIN_SPOUT_YUV_P010 ? 2 : 1);
+		}
+		for (size_t i = 0; i < context->regions.num; i++) {
+			region = context->regions.array[i].region;
+			win_spout_region_clamp(&region, (uint32_t)width, (uint32_t)height);
+			bytes += (uint64_t)region.width * region.height * 4;
+		}
+		win_spout_gpu_account_set(context->gpu_account, bytes, 0);
+
+		context->frame_number = 0;
+		context->metadata = win_spout_metadata_create(context->senderName);
+		if (context->bridge_port > 0 && context->bridge_port <= UINT16_MAX) {
+			context->bridge = win_spout_bridge_sender_create(context->senderName, context->bridge_address,
+									 (uint16_t)context->bridge_port);
+		}
+		if (context->memory_share) {
+			context->shm = win_spout_shm_writer_create(context->senderName);
+		}
+	}
 
 	pthread_mutex_unlock(&context->mutex);
 
@@ -173,16 +440,182 @@ void win_spout_output_stop(void *data, uint64_t ts)
 
 	if (started) {
 		obs_output_end_data_capture(output);
+		// the senders are released below, let the last frames go out first
+		os_event_wait(context->idle);
 
 		pthread_mutex_lock(&context->mutex);
 
 		context->sender->ReleaseSender();
+		context->sender->CloseDirectX11();
+		win_spout_output_release_regions(context);
+		win_spout_metadata_destroy(context->metadata);
+		context->metadata = nullptr;
+		win_spout_audio_destroy(context->audio);
+		context->audio = nullptr;
+		win_spout_bridge_sender_destroy(context->bridge);
+		context->bridge = nullptr;
+		win_spout_shm_writer_destroy(context->shm);
+		context->shm = nullptr;
 		context->output_started = false;
+		win_spout_gpu_account_set(context->gpu_account, 0, 0);
+
+		pthread_mutex_lock(&context->send_mutex);
+		if (context->send_watch.over_budget) {
+			blog(LOG_INFO, "%llu of %llu sends went over the frame budget, longest %.1f ms",
+			     (unsigned long long)context->send_watch.over_budget,
+			     (unsigned long long)context->send_watch.sends,
+			     (double)context->send_watch.over_budget_max_ns / 1000000.0);
+		}
+		if (context->frames_skipped) {
+			blog(LOG_INFO, "%llu frames skipped while the one before was still being sent",
+			     (unsigned long long)context->frames_skipped);
+		}
+		memset(&context->send_watch, 0, sizeof(context->send_watch));
+		context->frames_skipped = 0;
+		pthread_mutex_unlock(&context->send_mutex);
 
 		pthread_mutex_unlock(&context->mutex);
 	}
 }
 
+/**
+ * Shares a region of the frame, SendImage reads it in place using the frame's line pitch
+ */
+static void win_spout_output_send(spoutDX *sender, const uint8_t *frame, uint32_t linesize,
+				  struct win_spout_region region, uint32_t width, uint32_t height)
+{
+	win_spout_region_clamp(&region, width, height);
+	const uint8_t *data = frame + (size_t)region.y * linesize + (size_t)region.x * 4;
+	sender->SendImage(data, region.width, region.height, linesize);
+}
+
+/**
+ * Shares a region of the frame packed as NV12 / P010, into a pooled
+ * buffer. OBS hands the output its frames on the CPU, so they are packed
+ * here with the reference the filter's effect matches rather than by
+ * OBS's own conversion, which has no SDR Rec. 2020 and sites chroma
+ * its own way.
+ */
+static void win_spout_output_send_packed(spoutDX *sender, const uint8_t *frame, uint32_t linesize,
+					 struct win_spout_region region, uint32_t width, uint32_t height,
+					 enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix)
+{
+	win_spout_region_clamp(&region, width, height);
+	if (region.width < 2 || region.height < 2)
+		return;
+	uint32_t send_width = win_spout_yuv_even(region.width);
+	uint32_t send_height = win_spout_yuv_even(region.height);
+
+	uint32_t pitch = win_spout_frame_pool_pitch(send_width * (format == WIN_SPOUT_YUV_P010 ? 2 : 1));
+	struct win_spout_frame_buffer *packed = win_spout_frame_pool_acquire((size_t)pitch * send_height / 2 * 3);
+	if (!packed)
+		return;
+	const uint8_t *data = frame + (size_t)region.y * linesize + (size_t)region.x * 4;
+	win_spout_yuv_pack(data, linesize, send_width, send_height, format, matrix, packed->data, pitch);
+	sender->SendImage(packed->data, send_width, send_height / 2 * 3, pitch);
+	win_spout_frame_pool_release(packed);
+}
+
+static void win_spout_output_send_job(void *param)
+{
+	struct spout_output_job *job = (spout_output_job *)param;
+	if (job->yuv_format != WIN_SPOUT_YUV_NONE) {
+		win_spout_output_send_packed(job->sender, job->data, job->linesize, job->region, job->width,
+					     job->height, job->yuv_format, job->yuv_matrix);
+		return;
+	}
+	win_spout_output_send(job->sender, job->data, job->linesize, job->region, job->width, job->height);
+}
+
+/**
+ * OBS's immediate context must only be used while holding the graphics
+ * lock, so with a shared device one task makes all the sends under it
+ */
+static void win_spout_output_send_shared_job(void *param)
+{
+	struct spout_output_frame *out = (spout_output_frame *)param;
+	obs_enter_graphics();
+	for (size_t i = 0; i < out->send_jobs; i++) {
+		win_spout_output_send_job(&out->jobs.array[i]);
+	}
+	obs_leave_graphics();
+}
+
+static void win_spout_output_copy_job(void *param)
+{
+	struct spout_output_job *job = (spout_output_job *)param;
+	struct win_spout_region crop = job->region;
+	win_spout_region_clamp(&crop, job->width, job->height);
+
+	const uint8_t *data = job->data + (size_t)crop.y * job->linesize + (size_t)crop.x * 4;
+	win_spout_bridge_sender_send(job->context->bridge, data, job->linesize, crop.width, crop.height);
+	win_spout_shm_writer_publish(job->context->shm, data, job->linesize, crop.width, crop.height);
+}
+
+static void win_spout_output_add_job(struct spout_output_frame *out, spoutDX *sender, struct win_spout_region region,
+				     uint32_t width, uint32_t height, enum win_spout_yuv_format yuv_format)
+{
+	struct spout_output_job *job = da_push_back_new(out->jobs);
+	job->context = out->context;
+	job->sender = sender;
+	job->data = out->buffer->data;
+	job->linesize = win_spout_frame_pool_pitch(width * 4);
+	job->region = region;
+	job->width = width;
+	job->height = height;
+	job->yuv_format = yuv_format;
+	job->yuv_matrix = out->context->yuv_matrix;
+}
+
+// Starts sending out, send_mutex held
+static void win_spout_output_start_send(spout_output *context, struct spout_output_frame *out)
+{
+	context->sending = out;
+	out->send_start = os_gettime_ns();
+	os_event_reset(context->idle);
+}
+
+/**
+ * The last of a frame's sends is done: stamps the metadata, gives the
+ * buffer back and sends the frame that was waiting, if any
+ */
+static void win_spout_output_frame_sent(void *param)
+{
+	struct spout_output_frame *out = (spout_output_frame *)param;
+	struct spout_output *context = out->context;
+
+	pthread_mutex_lock(&context->send_mutex);
+
+	uint64_t send_time = os_gettime_ns() - out->send_start;
+	if (win_spout_send_watch_record(&context->send_watch, send_time) &&
+	    context->send_watch.over_budget % 100 == 1) {
+		blog(LOG_WARNING, "Sending took %.1f ms, over the frame budget (%llu times so far)",
+		     (double)send_time / 1000000.0, (unsigned long long)context->send_watch.over_budget);
+	}
+
+	out->meta.frame_number = ++context->frame_number;
+	out->meta.send_time = os_gettime_ns();
+	win_spout_metadata_write(context->metadata, &out->meta);
+
+	win_spout_frame_pool_release(out->buffer);
+	out->buffer = nullptr;
+
+	struct spout_output_frame *next = context->pending;
+	context->pending = nullptr;
+	context->sending = nullptr;
+	if (next) {
+		win_spout_output_start_send(context, next);
+	} else {
+		os_event_signal(context->idle);
+	}
+
+	pthread_mutex_unlock(&context->send_mutex);
+
+	if (next) {
+		win_spout_send_pool_submit(&next->batch, next->tasks.array, next->tasks.num);
+	}
+}
+
 void win_spout_output_rawvideo(void *data, struct video_data *frame)
 {
 	spout_output *context = (spout_output *)data;
@@ -198,13 +631,109 @@ void win_spout_output_rawvideo(void *data, struct video_data *frame)
 		return;
 	}
 
-	int32_t width = (int32_t)obs_output_get_width(output);
-	int32_t height = (int32_t)obs_output_get_height(output);
+	WIN_SPOUT_TRACE_SCOPE("win_spout_output_rawvideo");
+	WIN_SPOUT_ALLOC_SCOPE("win_spout_output_rawvideo");
+
+	uint32_t width = obs_output_get_width(output);
+	uint32_t height = obs_output_get_height(output);
+
+	// the one frame that is neither being sent nor waiting
+	pthread_mutex_lock(&context->send_mutex);
+	struct spout_output_frame *out = nullptr;
+	for (size_t i = 0; i < OUTPUT_FRAMES && !out; i++) {
+		if (&context->frames[i] != context->sending && &context->frames[i] != context->pending) {
+			out = &context->frames[i];
+		}
+	}
+	pthread_mutex_unlock(&context->send_mutex);
+
+	uint32_t linesize = win_spout_frame_pool_pitch(width * 4);
+	out->buffer = win_spout_frame_pool_acquire((size_t)linesize * height);
+	if (!out->buffer) {
+		return;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(out->buffer->data + (size_t)y * linesize, frame->data[0] + (size_t)y * frame->linesize[0],
+		       (size_t)width * 4);
+	}
+
+	out->meta = {};
+	out->meta.obs_timestamp = frame->timestamp;
+	const struct video_output_info *voi = video_output_get_info(obs_output_video(output));
+	if (voi) {
+		out->meta.fps_num = voi->fps_num;
+		out->meta.fps_den = voi->fps_den;
+	}
+	win_spout_metadata_get_program_name(out->meta.scene_name, sizeof(out->meta.scene_name));
 
 	pthread_mutex_lock(&context->mutex);
 
-	context->sender->SendImage(frame->data[0], width, height);
+	da_resize(out->jobs, 0);
+	da_resize(out->tasks, 0);
+	// the metadata tells receivers the main sender's texture is packed
+	out->meta.pixel_layout = context->yuv_format;
+	out->meta.yuv_matrix = context->yuv_matrix;
+	win_spout_output_add_job(out, context->sender, context->crop, width, height, context->yuv_format);
+	for (size_t i = 0; i < context->regions.num; i++) {
+		struct spout_output_region *region = &context->regions.array[i];
+		if (region->sender) {
+			win_spout_output_add_job(out, region->sender, region->region, width, height,
+						 WIN_SPOUT_YUV_NONE);
+		}
+	}
+	out->send_jobs = out->jobs.num;
+	if (context->bridge || context->shm) {
+		win_spout_output_add_job(out, nullptr, context->crop, width, height, WIN_SPOUT_YUV_NONE);
+	}
+
+	if (context->share_device) {
+		struct win_spout_send_task task = {win_spout_output_send_shared_job, out};
+		da_push_back(out->tasks, &task);
+	} else {
+		for (size_t i = 0; i < out->send_jobs; i++) {
+			struct win_spout_send_task task = {win_spout_output_send_job, &out->jobs.array[i]};
+			da_push_back(out->tasks, &task);
+		}
+	}
+	if (out->jobs.num > out->send_jobs) {
+		struct win_spout_send_task task = {win_spout_output_copy_job, &out->jobs.array[out->send_jobs]};
+		da_push_back(out->tasks, &task);
+	}
+
+	pthread_mutex_unlock(&context->mutex);
+
+	pthread_mutex_lock(&context->send_mutex);
+	if (voi) {
+		context->send_watch.budget_ns = util_mul_div64(1000000000ULL, voi->fps_den, voi->fps_num);
+	}
+	bool send_now = !context->sending;
+	if (send_now) {
+		win_spout_output_start_send(context, out);
+	} else {
+		if (context->pending) {
+			win_spout_frame_pool_release(context->pending->buffer);
+			context->pending->buffer = nullptr;
+			context->frames_skipped++;
+		}
+		context->pending = out;
+	}
+	pthread_mutex_unlock(&context->send_mutex);
 
+	// runs inline when there are no send workers
+	if (send_now) {
+		win_spout_send_pool_submit(&out->batch, out->tasks.array, out->tasks.num);
+	}
+}
+
+void win_spout_output_rawaudio(void *data, struct audio_data *frames)
+{
+	spout_output *context = (spout_output *)data;
+
+	pthread_mutex_lock(&context->mutex);
+	if (context->share_audio && context->audio) {
+		win_spout_audio_shared_write(win_spout_audio_get_shared(context->audio),
+					     (const float *const *)frames->data, frames->frames, frames->timestamp);
+	}
 	pthread_mutex_unlock(&context->mutex);
 }
 
@@ -216,6 +745,22 @@ obs_properties_t *win_spout_output_getproperties(void *data)
 	obs_properties_set_flags(props, OBS_PROPERTIES_DEFER_UPDATE);
 
 	obs_properties_add_text(props, "spout_output_name", obs_module_text("outputname"), OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "shareDevice", obs_module_text("sharedevice"));
+	obs_properties_add_bool(props, "shareAudio", obs_module_text("shareaudio"));
+	obs_properties_add_int(props, "bridgePort", obs_module_text("bridgeport"), 0, UINT16_MAX, 1);
+	obs_properties_add_text(props, "bridgeAddress", obs_module_text("bridgelistenaddress"), OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "memoryShare", obs_module_text("memoryshare"));
+	obs_property_t *yuv = obs_properties_add_list(props, "yuvFormat", obs_module_text("outputyuvformat"),
+						      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(yuv, obs_module_text("yuvformatnone"), WIN_SPOUT_YUV_NONE);
+	obs_property_list_add_int(yuv, "NV12", WIN_SPOUT_YUV_NV12);
+	obs_property_list_add_int(yuv, "P010", WIN_SPOUT_YUV_P010);
+	obs_property_t *matrix = obs_properties_add_list(props, "yuvMatrix", obs_module_text("yuvmatrix"),
+							 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(matrix, "Rec. 709", WIN_SPOUT_YUV_709);
+	obs_property_list_add_int(matrix, "Rec. 2020", WIN_SPOUT_YUV_2020);
+	obs_properties_add_text(props, "crop", obs_module_text("cropregion"), OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, "regions", obs_module_text("regionsenders"), OBS_TEXT_MULTILINE);
 
 	return props;
 }
@@ -225,7 +770,7 @@ struct obs_output_info create_spout_output_info()
 	struct obs_output_info spout_output_info = {};
 
 	spout_output_info.id = "spout_output";
-	spout_output_info.flags = OBS_OUTPUT_VIDEO;
+	spout_output_info.flags = OBS_OUTPUT_AV;
 	spout_output_info.get_name = win_spout_output_get_name;
 	spout_output_info.create = win_spout_output_create;
 	spout_output_info.destroy = win_spout_output_destroy;
@@ -233,6 +778,7 @@ struct obs_output_info create_spout_output_info()
 	spout_output_info.update = win_spout_output_update;
 	spout_output_info.stop = win_spout_output_stop;
 	spout_output_info.raw_video = win_spout_output_rawvideo;
+	spout_output_info.raw_audio = win_spout_output_rawaudio;
 	spout_output_info.get_properties = win_spout_output_getproperties;
 
 	return spout_output_info;
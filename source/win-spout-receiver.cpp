@@ -0,0 +1,158 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <string.h>
+#include <util/platform.h>
+#include "win-spout-receiver.h"
+
+void win_spout_receiver_init(struct win_spout_receiver *receiver, const struct win_spout_transport *transport)
+{
+	memset(receiver, 0, sizeof(*receiver));
+	receiver->transport = *transport;
+	receiver->state = WIN_SPOUT_RECEIVER_IDLE;
+	receiver->use_first_sender = true;
+}
+
+void win_spout_receiver_set_sender(struct win_spout_receiver *receiver, const char *name)
+{
+	if (!name || !*name) {
+		receiver->use_first_sender = true;
+		return;
+	}
+
+	receiver->use_first_sender = false;
+	memset(receiver->sender_name, 0, sizeof(receiver->sender_name));
+	strncpy(receiver->sender_name, name, sizeof(receiver->sender_name) - 1);
+}
+
+void win_spout_receiver_reset(struct win_spout_receiver *receiver)
+{
+	receiver->state = WIN_SPOUT_RECEIVER_IDLE;
+	memset(&receiver->desc, 0, sizeof(receiver->desc));
+}
+
+void win_spout_receiver_bound(struct win_spout_receiver *receiver, const struct win_spout_sender_desc *desc)
+{
+	receiver->desc = *desc;
+	receiver->state = WIN_SPOUT_RECEIVER_CONNECTED;
+	receiver->stats.rebinds++;
+}
+
+static bool receiver_desc_equal(const struct win_spout_sender_desc *a, const struct win_spout_sender_desc *b)
+{
+	return a->width == b->width && a->height == b->height && a->format == b->format && a->handle == b->handle;
+}
+
+/**
+ * Finds the sender to receive from and reads its texture details
+ *
+ * @return the state the attempt ended in, CONNECTED on success
+ */
+static enum win_spout_receiver_state receiver_connect(struct win_spout_receiver *receiver,
+						      struct win_spout_sender_desc *desc)
+{
+	const struct win_spout_transport *transport = &receiver->transport;
+	if (!transport->data) {
+		return WIN_SPOUT_RECEIVER_NO_TRANSPORT;
+	}
+
+	int total_senders = transport->get_sender_count(transport->data);
+	if (total_senders <= 0) {
+		return WIN_SPOUT_RECEIVER_NO_SENDERS;
+	}
+
+	if (receiver->use_first_sender) {
+		if (!transport->get_sender(transport->data, 0, receiver->sender_name, sizeof(receiver->sender_name))) {
+			return WIN_SPOUT_RECEIVER_UNNAMED_SENDER;
+		}
+		if (!transport->set_active_sender(transport->data, receiver->sender_name)) {
+			return WIN_SPOUT_RECEIVER_ACTIVATE_FAILED;
+		}
+	} else {
+		char name[256];
+		bool exists = false;
+		for (int index = 0; index < total_senders && !exists; index++) {
+			exists = transport->get_sender(transport->data, index, name, sizeof(name)) &&
+				 strcmp(name, receiver->sender_name) == 0;
+		}
+		if (!exists) {
+			return WIN_SPOUT_RECEIVER_NOT_FOUND;
+		}
+	}
+
+	if (!transport->get_sender_info(transport->data, receiver->sender_name, desc)) {
+		return WIN_SPOUT_RECEIVER_NO_INFO;
+	}
+	return WIN_SPOUT_RECEIVER_CONNECTED;
+}
+
+static enum win_spout_receiver_event receiver_step(struct win_spout_receiver *receiver, uint64_t now_ms, bool forced,
+						   struct win_spout_sender_desc *desc)
+{
+	const struct win_spout_transport *transport = &receiver->transport;
+
+	if (win_spout_receiver_connected(receiver)) {
+		if (!transport->get_sender_info(transport->data, receiver->sender_name, desc) || !desc->handle) {
+			win_spout_receiver_reset(receiver);
+			receiver->lost_ms = now_ms;
+			receiver->stats.losses++;
+			return WIN_SPOUT_RECEIVER_EVENT_LOST;
+		}
+
+		// a pending rebind is dropped if the sender went back to what we have
+		if (receiver_desc_equal(desc, &receiver->desc)) {
+			receiver->state = WIN_SPOUT_RECEIVER_CONNECTED;
+			return WIN_SPOUT_RECEIVER_EVENT_NONE;
+		}
+
+		// the sender is there, so a rebind isn't rate limited, the new
+		// texture is opened on the same poll that sees it
+		receiver->state = WIN_SPOUT_RECEIVER_REBINDING;
+		return WIN_SPOUT_RECEIVER_EVENT_REBIND;
+	}
+
+	if (!forced && now_ms - receiver->last_attempt_ms < receiver->retry_ms) {
+		return WIN_SPOUT_RECEIVER_EVENT_NONE;
+	}
+	receiver->last_attempt_ms = now_ms;
+
+	receiver->state = receiver_connect(receiver, desc);
+	if (receiver->state != WIN_SPOUT_RECEIVER_CONNECTED) {
+		return WIN_SPOUT_RECEIVER_EVENT_NONE;
+	}
+
+	receiver->desc = *desc;
+	receiver->stats.connects++;
+	if (receiver->lost_ms) {
+		uint64_t latency = now_ms - receiver->lost_ms;
+		receiver->stats.reconnects++;
+		receiver->stats.reconnect_total_ms += latency;
+		receiver->stats.reconnect_last_ms = latency;
+		if (latency > receiver->stats.reconnect_max_ms) {
+			receiver->stats.reconnect_max_ms = latency;
+		}
+		receiver->lost_ms = 0;
+	}
+	return WIN_SPOUT_RECEIVER_EVENT_CONNECT;
+}
+
+enum win_spout_receiver_event win_spout_receiver_poll(struct win_spout_receiver *receiver, uint64_t now_ms,
+						      bool forced, struct win_spout_sender_desc *desc)
+{
+	uint64_t start = os_gettime_ns();
+	enum win_spout_receiver_event event = receiver_step(receiver, now_ms, forced, desc);
+	uint64_t cost = os_gettime_ns() - start;
+
+	receiver->stats.polls++;
+	receiver->stats.poll_total_ns += cost;
+	if (cost > receiver->stats.poll_max_ns) {
+		receiver->stats.poll_max_ns = cost;
+	}
+	return event;
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTRECEIVER_H
+#define WINSPOUTRECEIVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Connect / reconnect state machine for receiving a sender's shared
+ * texture. It only decides when the caller should open, rebind or drop
+ * the texture, so it has no graphics dependencies and talks to the
+ * sender registry through a transport.
+ */
+struct win_spout_sender_desc {
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint64_t handle;
+};
+
+struct win_spout_transport {
+	void *data;
+	int (*get_sender_count)(void *data);
+	bool (*get_sender)(void *data, int index, char *name, size_t size);
+	bool (*set_active_sender)(void *data, const char *name);
+	bool (*get_sender_info)(void *data, const char *name, struct win_spout_sender_desc *desc);
+};
+
+enum win_spout_receiver_state {
+	WIN_SPOUT_RECEIVER_IDLE,
+	// failed connection attempts, retried after retry_ms
+	WIN_SPOUT_RECEIVER_NO_TRANSPORT,
+	WIN_SPOUT_RECEIVER_NO_SENDERS,
+	WIN_SPOUT_RECEIVER_UNNAMED_SENDER,
+	WIN_SPOUT_RECEIVER_ACTIVATE_FAILED,
+	WIN_SPOUT_RECEIVER_NOT_FOUND,
+	WIN_SPOUT_RECEIVER_NO_INFO,
+	// bound to desc
+	WIN_SPOUT_RECEIVER_CONNECTED,
+	// still bound to desc, the sender was resized / reformatted and the
+	// new texture hasn't been opened yet
+	WIN_SPOUT_RECEIVER_REBINDING,
+};
+
+enum win_spout_receiver_event {
+	WIN_SPOUT_RECEIVER_EVENT_NONE,
+	// open the texture in desc
+	WIN_SPOUT_RECEIVER_EVENT_CONNECT,
+	// open the texture in desc and call win_spout_receiver_bound if it
+	// worked, keeping the current one until then
+	WIN_SPOUT_RECEIVER_EVENT_REBIND,
+	// the sender has gone away, drop the texture
+	WIN_SPOUT_RECEIVER_EVENT_LOST,
+};
+
+struct win_spout_receiver_stats {
+	uint64_t connects;
+	uint64_t rebinds;
+	uint64_t losses;
+	// time from losing a sender to being connected again
+	uint64_t reconnects;
+	uint64_t reconnect_total_ms;
+	uint64_t reconnect_max_ms;
+	uint64_t reconnect_last_ms;
+	// cost of win_spout_receiver_poll
+	uint64_t polls;
+	uint64_t poll_total_ns;
+	uint64_t poll_max_ns;
+};
+
+struct win_spout_receiver {
+	struct win_spout_transport transport;
+	enum win_spout_receiver_state state;
+	char sender_name[256];
+	bool use_first_sender;
+	struct win_spout_sender_desc desc;
+
+	uint64_t retry_ms;
+	uint64_t last_attempt_ms;
+	uint64_t lost_ms;
+
+	struct win_spout_receiver_stats stats;
+};
+
+void win_spout_receiver_init(struct win_spout_receiver *receiver, const struct win_spout_transport *transport);
+
+// nullptr or "" follows the first available sender
+void win_spout_receiver_set_sender(struct win_spout_receiver *receiver, const char *name);
+
+// Forgets the current sender, the next poll connects again
+void win_spout_receiver_reset(struct win_spout_receiver *receiver);
+
+/**
+ * Checks the sender and returns what the caller has to do with its
+ * texture. Connection attempts are rate limited to one per retry_ms
+ * unless forced, a changed sender is rebound on the poll that sees it.
+ * desc is filled for CONNECT and REBIND.
+ */
+enum win_spout_receiver_event win_spout_receiver_poll(struct win_spout_receiver *receiver, uint64_t now_ms,
+						      bool forced, struct win_spout_sender_desc *desc);
+
+// The texture for desc was opened after a REBIND
+void win_spout_receiver_bound(struct win_spout_receiver *receiver, const struct win_spout_sender_desc *desc);
+
+static inline bool win_spout_receiver_connected(const struct win_spout_receiver *receiver)
+{
+	return receiver->state == WIN_SPOUT_RECEIVER_CONNECTED || receiver->state == WIN_SPOUT_RECEIVER_REBINDING;
+}
+
+#endif // WINSPOUTRECEIVER_H
@@ -0,0 +1,45 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "win-spout-region.h"
+
+bool win_spout_region_parse(const char *str, struct win_spout_region *region)
+{
+	memset(region, 0, sizeof(*region));
+	if (!str || !*str) {
+		return false;
+	}
+
+	if (sscanf(str, " %u , %u , %u x %u", &region->x, &region->y, &region->width, &region->height) != 4) {
+		memset(region, 0, sizeof(*region));
+		return false;
+	}
+	return true;
+}
+
+void win_spout_region_clamp(struct win_spout_region *region, uint32_t frame_width, uint32_t frame_height)
+{
+	if (!region->width || !region->height) {
+		region->x = region->y = 0;
+		region->width = frame_width;
+		region->height = frame_height;
+		return;
+	}
+
+	if (region->x >= frame_width)
+		region->x = frame_width ? frame_width - 1 : 0;
+	if (region->y >= frame_height)
+		region->y = frame_height ? frame_height - 1 : 0;
+	if (region->x + region->width > frame_width)
+		region->width = frame_width - region->x;
+	if (region->y + region->height > frame_height)
+		region->height = frame_height - region->y;
+}
@@ -0,0 +1,29 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTREGION_H
+#define WINSPOUTREGION_H
+
+#include <stdint.h>
+
+// Region of interest within a frame, a zero width or height means the whole frame
+struct win_spout_region {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Parses "x,y,WIDTHxHEIGHT"
+bool win_spout_region_parse(const char *str, struct win_spout_region *region);
+
+// Clamps the region to the frame, resolving "whole frame" to the frame size
+void win_spout_region_clamp(struct win_spout_region *region, uint32_t frame_width, uint32_t frame_height);
+
+#endif // WINSPOUTREGION_H
@@ -0,0 +1,171 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <util/util_uint64.h>
+#include "win-spout-render.h"
+
+bool win_spout_render_to_spout(gs_texrender_t *dst, gs_texture_t *tex, const struct win_spout_region *region,
+			       uint32_t width, uint32_t height)
+{
+	gs_texrender_reset(dst);
+	if (!gs_texrender_begin(dst, width, height)) {
+		return false;
+	}
+
+	struct vec4 background;
+	vec4_zero(&background);
+
+	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	// To get sRGB handling, render with the default effect
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	if (tex) {
+		const bool linear_srgb = gs_get_linear_srgb();
+
+		const bool previous = gs_framebuffer_srgb_enabled();
+		gs_enable_framebuffer_srgb(linear_srgb);
+
+		gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+		if (linear_srgb)
+			gs_effect_set_texture_srgb(image, tex);
+		else
+			gs_effect_set_texture(image, tex);
+
+		gs_matrix_push();
+		gs_matrix_scale3f((float)width / (float)region->width, (float)height / (float)region->height, 1.0f);
+
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite_subregion(tex, 0, region->x, region->y, region->width, region->height);
+
+		gs_matrix_pop();
+
+		gs_enable_framebuffer_srgb(previous);
+	}
+
+	gs_blend_state_pop();
+	gs_texrender_end(dst);
+
+	return true;
+}
+
+bool win_spout_render_effect(gs_texrender_t *dst, gs_texture_t *tex, const struct win_spout_region *region,
+			     uint32_t width, uint32_t height, gs_effect_t *effect, const char *technique)
+{
+	gs_texrender_reset(dst);
+	if (!gs_texrender_begin(dst, width, height)) {
+		return false;
+	}
+
+	struct vec4 background;
+	vec4_zero(&background);
+
+	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (tex) {
+		const bool previous = gs_framebuffer_srgb_enabled();
+		gs_enable_framebuffer_srgb(false);
+
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+
+		gs_matrix_push();
+		gs_matrix_scale3f((float)width / (float)region->width, (float)height / (float)region->height, 1.0f);
+
+		while (gs_effect_loop(effect, technique))
+			gs_draw_sprite_subregion(tex, 0, region->x, region->y, region->width, region->height);
+
+		gs_matrix_pop();
+
+		gs_enable_framebuffer_srgb(previous);
+	}
+
+	gs_blend_state_pop();
+	gs_texrender_end(dst);
+
+	return true;
+}
+
+bool win_spout_gpu_timer_begin(struct win_spout_gpu_timer *timer)
+{
+	if (timer->unavailable) {
+		return false;
+	}
+
+	// an unread measurement this old is dropped
+	size_t slot = timer->next;
+	if (!timer->ranges[slot]) {
+		timer->ranges[slot] = gs_timer_range_create();
+		timer->timers[slot] = gs_timer_create();
+		if (!timer->ranges[slot] || !timer->timers[slot]) {
+			blog(LOG_WARNING, "GPU timer queries are unavailable, timing sends on the CPU");
+			win_spout_gpu_timer_destroy(timer);
+			timer->unavailable = true;
+			return false;
+		}
+	}
+	timer->pending[slot] = false;
+
+	gs_timer_range_begin(timer->ranges[slot]);
+	gs_timer_begin(timer->timers[slot]);
+	return true;
+}
+
+void win_spout_gpu_timer_end(struct win_spout_gpu_timer *timer)
+{
+	size_t slot = timer->next;
+	gs_timer_end(timer->timers[slot]);
+	gs_timer_range_end(timer->ranges[slot]);
+	timer->pending[slot] = true;
+	timer->next = (slot + 1) % WIN_SPOUT_GPU_TIMER_FRAMES;
+}
+
+bool win_spout_gpu_timer_read(struct win_spout_gpu_timer *timer, uint64_t *ns)
+{
+	// oldest first, the GPU finishes them in order
+	for (size_t i = 0; i < WIN_SPOUT_GPU_TIMER_FRAMES; i++) {
+		size_t slot = (timer->next + i) % WIN_SPOUT_GPU_TIMER_FRAMES;
+		if (!timer->pending[slot]) {
+			continue;
+		}
+
+		bool disjoint;
+		uint64_t frequency;
+		uint64_t ticks;
+		if (!gs_timer_range_get_data(timer->ranges[slot], &disjoint, &frequency) ||
+		    !gs_timer_get_data(timer->timers[slot], &ticks)) {
+			return false;
+		}
+		timer->pending[slot] = false;
+
+		if (!disjoint && frequency) {
+			*ns = util_mul_div64(ticks, 1000000000ULL, frequency);
+			return true;
+		}
+	}
+	return false;
+}
+
+void win_spout_gpu_timer_destroy(struct win_spout_gpu_timer *timer)
+{
+	for (size_t i = 0; i < WIN_SPOUT_GPU_TIMER_FRAMES; i++) {
+		gs_timer_range_destroy(timer->ranges[i]);
+		gs_timer_destroy(timer->timers[i]);
+		timer->ranges[i] = nullptr;
+		timer->timers[i] = nullptr;
+		timer->pending[i] = false;
+	}
+	timer->next = 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTRENDER_H
+#define WINSPOUTRENDER_H
+
+#include <obs-module.h>
+#include "win-spout-region.h"
+
+/**
+ * Draws a region of an sRGB-aware render (eg. a GS_BGRA texrender) into
+ * dst at width x height, in the Spout compatible format dst was created
+ * with. Must be called on the render thread.
+ *
+ * @return bool dst was rendered
+ */
+bool win_spout_render_to_spout(gs_texrender_t *dst, gs_texture_t *tex, const struct win_spout_region *region,
+			       uint32_t width, uint32_t height);
+
+/**
+ * Same as win_spout_render_to_spout, drawing with a technique of the given
+ * effect. The texture's values are read and written as they are, without
+ * sRGB conversion.
+ *
+ * @return bool dst was rendered
+ */
+bool win_spout_render_effect(gs_texrender_t *dst, gs_texture_t *tex, const struct win_spout_region *region,
+			     uint32_t width, uint32_t height, gs_effect_t *effect, const char *technique);
+
+/**
+ * GPU time of a stretch of render thread work, from timestamp queries.
+ * The GPU runs frames behind the CPU, so each frame uses the next of a
+ * ring of queries and results are read back once the GPU has got there.
+ */
+#define WIN_SPOUT_GPU_TIMER_FRAMES 4
+
+struct win_spout_gpu_timer {
+	gs_timer_range_t *ranges[WIN_SPOUT_GPU_TIMER_FRAMES];
+	gs_timer_t *timers[WIN_SPOUT_GPU_TIMER_FRAMES];
+	bool pending[WIN_SPOUT_GPU_TIMER_FRAMES];
+	size_t next;
+	// the device can't make timestamp queries
+	bool unavailable;
+};
+
+/**
+ * Starts timing the GPU work submitted until win_spout_gpu_timer_end
+ *
+ * @return bool the work is being timed
+ */
+bool win_spout_gpu_timer_begin(struct win_spout_gpu_timer *timer);
+void win_spout_gpu_timer_end(struct win_spout_gpu_timer *timer);
+
+/**
+ * Oldest finished measurement, measurements the GPU clock was unreliable
+ * for (eg. a power state change) are dropped
+ *
+ * @return bool *ns holds a measurement
+ */
+bool win_spout_gpu_timer_read(struct win_spout_gpu_timer *timer, uint64_t *ns);
+void win_spout_gpu_timer_destroy(struct win_spout_gpu_timer *timer);
+
+#endif // WINSPOUTRENDER_H
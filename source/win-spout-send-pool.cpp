@@ -0,0 +1,322 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <windows.h>
+#include <avrt.h>
+#include "win-spout.h"
+#include "win-spout-alloc-track.h"
+#include "win-spout-send-pool.h"
+
+struct send_item {
+	struct win_spout_send_task task;
+	struct win_spout_send_batch *batch;
+};
+
+struct send_worker {
+	pthread_t thread;
+	bool running;
+	uint32_t index;
+	uint64_t affinity_mask;
+
+	// guards queue and stats
+	pthread_mutex_t mutex;
+	DARRAY(struct send_item) queue;
+	struct win_spout_send_worker_stats stats;
+	uint64_t start_time;
+};
+
+// Workers are started and stopped with the module, not while sending
+static struct send_worker *pool_workers;
+static uint32_t pool_worker_count;
+static os_sem_t *pool_pending; // posted once for every queued task
+static volatile bool pool_stop;
+static volatile long pool_next;
+static enum win_spout_send_priority pool_priority;
+// batches run one at a time and reuse the same event, so a frame doesn't allocate
+static pthread_mutex_t pool_batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static os_event_t *pool_batch_done;
+
+// Returns the mask of the n-th core set in mask, wrapping around
+static uint64_t send_core_mask(uint64_t mask, uint32_t n)
+{
+	uint32_t cores = 0;
+	for (uint32_t bit = 0; bit < 64; bit++) {
+		if (mask & (1ULL << bit))
+			cores++;
+	}
+
+	n %= cores;
+	for (uint32_t bit = 0; bit < 64; bit++) {
+		if ((mask & (1ULL << bit)) && n-- == 0)
+			return 1ULL << bit;
+	}
+	return mask;
+}
+
+/* Scheduling is the only platform specific part of the pool */
+
+static HANDLE send_set_scheduling(struct send_worker *worker)
+{
+	if (worker->affinity_mask && !SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)worker->affinity_mask)) {
+		blog(LOG_WARNING, "Send worker %u: can't set core affinity %llx", worker->index,
+		     (unsigned long long)worker->affinity_mask);
+	}
+
+	HANDLE mmcss = NULL;
+	if (pool_priority == WIN_SPOUT_SEND_PRIORITY_MMCSS) {
+		DWORD task_index = 0;
+		mmcss = AvSetMmThreadCharacteristicsW(L"Playback", &task_index);
+		if (!mmcss) {
+			blog(LOG_WARNING, "Send worker %u: MMCSS unavailable, using above normal priority",
+			     worker->index);
+			SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+		}
+	} else if (pool_priority == WIN_SPOUT_SEND_PRIORITY_ABOVE_NORMAL) {
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+	}
+	return mmcss;
+}
+
+static void send_reset_scheduling(HANDLE mmcss)
+{
+	if (mmcss) {
+		AvRevertMmThreadCharacteristics(mmcss);
+	}
+}
+
+// The owner takes its newest task
+static bool send_pop(struct send_worker *worker, struct send_item *item)
+{
+	pthread_mutex_lock(&worker->mutex);
+	bool found = worker->queue.num > 0;
+	if (found) {
+		*item = worker->queue.array[worker->queue.num - 1];
+		da_pop_back(worker->queue);
+	}
+	pthread_mutex_unlock(&worker->mutex);
+	return found;
+}
+
+// Others take its oldest
+static bool send_steal(struct send_worker *worker, struct send_item *item)
+{
+	pthread_mutex_lock(&worker->mutex);
+	bool found = worker->queue.num > 0;
+	if (found) {
+		*item = worker->queue.array[0];
+		da_erase(worker->queue, 0);
+	}
+	pthread_mutex_unlock(&worker->mutex);
+	return found;
+}
+
+static void *send_worker_thread(void *data)
+{
+	struct send_worker *worker = (send_worker *)data;
+	os_set_thread_name("spout-send-worker");
+	HANDLE mmcss = send_set_scheduling(worker);
+
+	for (;;) {
+		os_sem_wait(pool_pending);
+		if (pool_stop)
+			break;
+
+		// every post comes with a queued task, though another worker
+		// may have to finish taking one before it shows up as taken
+		struct send_item item;
+		bool stolen = false;
+		while (!send_pop(worker, &item)) {
+			for (uint32_t i = 1; i < pool_worker_count && !stolen; i++) {
+				stolen = send_steal(&pool_workers[(worker->index + i) % pool_worker_count], &item);
+			}
+			if (stolen)
+				break;
+			os_sleep_ms(0);
+		}
+
+		// the caller's allocation scope stays on its own thread
+		WIN_SPOUT_ALLOC_SCOPE("win_spout_send_worker");
+		uint64_t start = os_gettime_ns();
+		item.task.fn(item.task.param);
+		uint64_t busy = os_gettime_ns() - start;
+
+		pthread_mutex_lock(&worker->mutex);
+		worker->stats.tasks++;
+		worker->stats.stolen += stolen ? 1 : 0;
+		worker->stats.busy_ns += busy;
+		pthread_mutex_unlock(&worker->mutex);
+
+		if (os_atomic_dec_long(&item.batch->remaining) == 0) {
+			item.batch->done(item.batch->param);
+		}
+	}
+
+	send_reset_scheduling(mmcss);
+	return NULL;
+}
+
+void win_spout_send_pool_start(uint32_t threads, uint64_t affinity_mask, enum win_spout_send_priority priority)
+{
+	win_spout_send_pool_stop();
+	if (!threads) {
+		return;
+	}
+
+	if (os_sem_init(&pool_pending, 0) != 0) {
+		blog(LOG_ERROR, "Failed to create send worker semaphore, sending inline");
+		return;
+	}
+	if (os_event_init(&pool_batch_done, OS_EVENT_TYPE_MANUAL) != 0) {
+		blog(LOG_ERROR, "Failed to create send worker event, sending inline");
+		os_sem_destroy(pool_pending);
+		pool_pending = NULL;
+		return;
+	}
+
+	pool_stop = false;
+	pool_priority = priority;
+	pool_workers = (send_worker *)bzalloc(sizeof(struct send_worker) * threads);
+	for (uint32_t i = 0; i < threads; i++) {
+		struct send_worker *worker = &pool_workers[i];
+		worker->index = i;
+		worker->affinity_mask = affinity_mask ? send_core_mask(affinity_mask, i) : 0;
+		worker->start_time = os_gettime_ns();
+		pthread_mutex_init(&worker->mutex, NULL);
+		da_init(worker->queue);
+	}
+
+	pool_worker_count = threads;
+
+	// tasks queued on a worker that failed to start get stolen by the others
+	uint32_t running = 0;
+	for (uint32_t i = 0; i < threads; i++) {
+		struct send_worker *worker = &pool_workers[i];
+		worker->running = pthread_create(&worker->thread, NULL, send_worker_thread, worker) == 0;
+		running += worker->running ? 1 : 0;
+	}
+
+	blog(LOG_INFO, "Started %u send workers", running);
+	if (!running) {
+		win_spout_send_pool_stop();
+	}
+}
+
+void win_spout_send_pool_stop()
+{
+	if (!pool_workers) {
+		return;
+	}
+
+	pool_stop = true;
+	for (uint32_t i = 0; i < pool_worker_count; i++) {
+		os_sem_post(pool_pending);
+	}
+
+	uint64_t now = os_gettime_ns();
+	for (uint32_t i = 0; i < pool_worker_count; i++) {
+		struct send_worker *worker = &pool_workers[i];
+		if (!worker->running) {
+			continue;
+		}
+		pthread_join(worker->thread, NULL);
+
+		uint64_t up = now - worker->start_time;
+		blog(LOG_INFO, "Send worker %u: %llu tasks, %llu stolen, %.1f%% busy", i,
+		     (unsigned long long)worker->stats.tasks, (unsigned long long)worker->stats.stolen,
+		     up ? 100.0 * (double)worker->stats.busy_ns / (double)up : 0.0);
+	}
+
+	for (uint32_t i = 0; i < pool_worker_count; i++) {
+		pthread_mutex_destroy(&pool_workers[i].mutex);
+		da_free(pool_workers[i].queue);
+	}
+
+	os_sem_destroy(pool_pending);
+	pool_pending = NULL;
+	os_event_destroy(pool_batch_done);
+	pool_batch_done = NULL;
+	bfree(pool_workers);
+	pool_workers = NULL;
+	pool_worker_count = 0;
+}
+
+void win_spout_send_pool_submit(struct win_spout_send_batch *batch, const struct win_spout_send_task *tasks,
+				size_t count)
+{
+	if (!count || !pool_worker_count) {
+		for (size_t i = 0; i < count; i++) {
+			tasks[i].fn(tasks[i].param);
+		}
+		batch->done(batch->param);
+		return;
+	}
+
+	batch->remaining = (long)count;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t index = (uint32_t)((unsigned long)os_atomic_inc_long(&pool_next) % pool_worker_count);
+		struct send_worker *worker = &pool_workers[index];
+
+		struct send_item item = {tasks[i], batch};
+		pthread_mutex_lock(&worker->mutex);
+		da_push_back(worker->queue, &item);
+		pthread_mutex_unlock(&worker->mutex);
+		os_sem_post(pool_pending);
+	}
+}
+
+static void send_batch_signal(void *param)
+{
+	os_event_signal((os_event_t *)param);
+}
+
+void win_spout_send_pool_run(const struct win_spout_send_task *tasks, size_t count)
+{
+	if (!count) {
+		return;
+	}
+
+	if (!pool_worker_count) {
+		for (size_t i = 0; i < count; i++) {
+			tasks[i].fn(tasks[i].param);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool_batch_mutex);
+	os_event_reset(pool_batch_done);
+
+	struct win_spout_send_batch batch = {send_batch_signal, pool_batch_done, 0};
+	win_spout_send_pool_submit(&batch, tasks, count);
+
+	os_event_wait(pool_batch_done);
+	pthread_mutex_unlock(&pool_batch_mutex);
+}
+
+uint32_t win_spout_send_pool_workers()
+{
+	return pool_worker_count;
+}
+
+bool win_spout_send_pool_get_stats(uint32_t worker, struct win_spout_send_worker_stats *stats)
+{
+	if (worker >= pool_worker_count) {
+		return false;
+	}
+
+	struct send_worker *w = &pool_workers[worker];
+	pthread_mutex_lock(&w->mutex);
+	*stats = w->stats;
+	pthread_mutex_unlock(&w->mutex);
+	stats->up_ns = os_gettime_ns() - w->start_time;
+	return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTSENDPOOL_H
+#define WINSPOUTSENDPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Plugin-wide worker threads for CPU send / convert work, so several
+ * senders don't all run on OBS's own video thread.
+ *
+ * Workers can be pinned to a set of cores and raised in priority. Each
+ * task is queued on one worker in turn, and a worker with nothing queued
+ * steals from the others, so uneven frame sizes even out. Without
+ * workers, tasks run inline on the calling thread.
+ */
+enum win_spout_send_priority {
+	WIN_SPOUT_SEND_PRIORITY_NORMAL,
+	WIN_SPOUT_SEND_PRIORITY_ABOVE_NORMAL,
+	// Multimedia Class Scheduler "Playback" task
+	WIN_SPOUT_SEND_PRIORITY_MMCSS,
+};
+
+struct win_spout_send_task {
+	void (*fn)(void *param);
+	void *param;
+};
+
+/**
+ * Tasks handed off without waiting for them. done(param) runs once every
+ * task has, on whichever thread ran the last one. The batch is the
+ * caller's and has to stay valid until then.
+ */
+struct win_spout_send_batch {
+	void (*done)(void *param);
+	void *param;
+	volatile long remaining;
+};
+
+struct win_spout_send_worker_stats {
+	uint64_t tasks;
+	uint64_t stolen;  // tasks taken from another worker's queue
+	uint64_t busy_ns; // time spent running tasks
+	uint64_t up_ns;	  // time since the worker started
+};
+
+/**
+ * Starts threads workers, 0 keeps running tasks inline. Worker i is
+ * pinned to the i-th core set in affinity_mask (wrapping around),
+ * 0 leaves them on every core.
+ */
+void win_spout_send_pool_start(uint32_t threads, uint64_t affinity_mask, enum win_spout_send_priority priority);
+// Stops the workers and logs their utilisation
+void win_spout_send_pool_stop();
+
+// Runs every task and returns once they have all finished
+void win_spout_send_pool_run(const struct win_spout_send_task *tasks, size_t count);
+// Queues every task and returns, without workers they run (and done) before it does
+void win_spout_send_pool_submit(struct win_spout_send_batch *batch, const struct win_spout_send_task *tasks,
+				size_t count);
+
+uint32_t win_spout_send_pool_workers();
+bool win_spout_send_pool_get_stats(uint32_t worker, struct win_spout_send_worker_stats *stats);
+
+#endif // WINSPOUTSENDPOOL_H
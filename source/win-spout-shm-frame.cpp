@@ -0,0 +1,482 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <atomic>
+#include "win-spout.h"
+#include "win-spout-shm.h"
+#include "win-spout-shm-frame.h"
+#include "win-spout-frame-pool.h"
+
+#define SHM_SUFFIX "_OBSFrame"
+#define SHM_TILE WIN_SPOUT_SHM_TILE_SIZE
+#define SHM_MAX_DIMENSION 8192
+#define SHM_MAX_TILES ((SHM_MAX_DIMENSION / SHM_TILE) * (SHM_MAX_DIMENSION / SHM_TILE))
+#define SHM_STATS_NS 10000000000ULL
+
+/**
+ * Shared header, the pixels live in a second section named after the
+ * generation so the frame can be resized while readers hold the old one.
+ * seq is odd while the writer is updating pixels or header, readers
+ * retry until they see the same even value either side of their copy.
+ */
+struct shm_header {
+	volatile long seq;
+	uint32_t version;
+	volatile long active;
+	uint64_t generation;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+	uint64_t frame_number;
+	// frame number each tile last changed in
+	uint64_t tile_frame[SHM_MAX_TILES];
+};
+
+struct shm_stats {
+	uint64_t start;
+	uint64_t frames;
+	uint64_t full_frames;
+	uint64_t bytes_copied;
+};
+
+struct win_spout_shm_writer {
+	char name[256];
+	struct win_spout_shm_section *header_section;
+	struct shm_header *header;
+	struct win_spout_shm_section *pixel_section;
+	uint8_t *pixels;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint64_t frame_number;
+	uint32_t *dirty;
+	bool too_large;
+	struct shm_stats stats;
+};
+
+struct win_spout_shm_reader {
+	char name[256];
+	struct win_spout_shm_section *header_section;
+	struct shm_header *header;
+	struct win_spout_shm_section *pixel_section;
+	const uint8_t *pixels;
+	uint64_t generation;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	struct win_spout_frame_buffer *local;
+	uint32_t local_pitch;
+	uint64_t last_frame;
+	bool corrupt;
+	struct shm_stats stats;
+};
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static void shm_report(const char *name, const char *side, struct shm_stats *stats)
+{
+	uint64_t now = os_gettime_ns();
+	if (now - stats->start < SHM_STATS_NS) {
+		return;
+	}
+
+	if (stats->frames) {
+		blog(LOG_INFO, "[%s] Memory share %s %llu frames (%llu full), %.1f KB copied per frame", name, side,
+		     (unsigned long long)stats->frames, (unsigned long long)stats->full_frames,
+		     (double)stats->bytes_copied / stats->frames / 1024.0);
+	}
+
+	*stats = {};
+	stats->start = now;
+}
+
+static void shm_pixel_name(struct dstr *name, const char *sender_name, uint64_t generation)
+{
+	dstr_printf(name, "%s" SHM_SUFFIX "_%llu", sender_name, (unsigned long long)generation);
+}
+
+static void shm_copy_tile(uint8_t *dst, uint32_t dst_pitch, const uint8_t *src, uint32_t src_pitch, uint32_t x,
+			  uint32_t y, uint32_t width, uint32_t height)
+{
+	uint32_t tile_width = min_u32(SHM_TILE, width - x) * 4;
+	uint32_t rows = min_u32(SHM_TILE, height - y);
+	dst += (size_t)y * dst_pitch + (size_t)x * 4;
+	src += (size_t)y * src_pitch + (size_t)x * 4;
+	for (uint32_t row = 0; row < rows; row++) {
+		memcpy(dst + (size_t)row * dst_pitch, src + (size_t)row * src_pitch, tile_width);
+	}
+}
+
+static bool shm_tile_equal(const uint8_t *a, uint32_t a_pitch, const uint8_t *b, uint32_t b_pitch, uint32_t x,
+			   uint32_t y, uint32_t width, uint32_t height)
+{
+	uint32_t tile_width = min_u32(SHM_TILE, width - x) * 4;
+	uint32_t rows = min_u32(SHM_TILE, height - y);
+	a += (size_t)y * a_pitch + (size_t)x * 4;
+	b += (size_t)y * b_pitch + (size_t)x * 4;
+	for (uint32_t row = 0; row < rows; row++) {
+		if (memcmp(a + (size_t)row * a_pitch, b + (size_t)row * b_pitch, tile_width) != 0)
+			return false;
+	}
+	return true;
+}
+
+struct win_spout_shm_writer *win_spout_shm_writer_create(const char *sender_name)
+{
+	if (!sender_name || !*sender_name) {
+		return nullptr;
+	}
+
+	struct dstr name = {};
+	dstr_printf(&name, "%s" SHM_SUFFIX, sender_name);
+	struct win_spout_shm_section *section = win_spout_shm_section_create(name.array, sizeof(struct shm_header));
+	dstr_free(&name);
+
+	if (!section) {
+		blog(LOG_WARNING, "Failed to create memory share for sender %s", sender_name);
+		return nullptr;
+	}
+
+	struct shm_header *header = (struct shm_header *)win_spout_shm_section_data(section);
+	struct win_spout_shm_writer *writer = (win_spout_shm_writer *)bzalloc(sizeof(win_spout_shm_writer));
+	strncpy(writer->name, sender_name, sizeof(writer->name) - 1);
+	writer->header_section = section;
+	writer->header = header;
+	writer->dirty = (uint32_t *)bmalloc(sizeof(uint32_t) * SHM_MAX_TILES);
+	writer->stats.start = os_gettime_ns();
+
+	// no pixels until the first publish
+	os_atomic_inc_long(&header->seq);
+	header->version = WIN_SPOUT_SHM_FRAME_VERSION;
+	header->generation = 0;
+	header->frame_number = 0;
+	os_atomic_set_long(&header->active, 1);
+	os_atomic_inc_long(&header->seq);
+
+	return writer;
+}
+
+void win_spout_shm_writer_destroy(struct win_spout_shm_writer *writer)
+{
+	if (!writer) {
+		return;
+	}
+
+	os_atomic_set_long(&writer->header->active, 0);
+	win_spout_shm_section_destroy(writer->pixel_section);
+	win_spout_shm_section_destroy(writer->header_section);
+	bfree(writer->dirty);
+	bfree(writer);
+}
+
+// Moves the frame to a new pixel section sized for width x height
+static bool shm_writer_resize(struct win_spout_shm_writer *writer, uint32_t width, uint32_t height)
+{
+	win_spout_shm_section_destroy(writer->pixel_section);
+	writer->pixels = nullptr;
+
+	uint32_t pitch = win_spout_frame_pool_pitch(width * 4);
+	size_t size = (size_t)pitch * height;
+	uint64_t generation = os_gettime_ns();
+
+	struct dstr name = {};
+	shm_pixel_name(&name, writer->name, generation);
+	writer->pixel_section = win_spout_shm_section_create(name.array, size);
+	dstr_free(&name);
+
+	writer->pixels = (uint8_t *)win_spout_shm_section_data(writer->pixel_section);
+	if (!writer->pixels) {
+		return false;
+	}
+
+	writer->width = width;
+	writer->height = height;
+	writer->pitch = pitch;
+
+	struct shm_header *header = writer->header;
+	os_atomic_inc_long(&header->seq);
+	header->generation = generation;
+	header->width = width;
+	header->height = height;
+	header->pitch = pitch;
+	header->tiles_x = (width + SHM_TILE - 1) / SHM_TILE;
+	header->tiles_y = (height + SHM_TILE - 1) / SHM_TILE;
+	os_atomic_inc_long(&header->seq);
+
+	return true;
+}
+
+void win_spout_shm_writer_publish(struct win_spout_shm_writer *writer, const uint8_t *pixels, uint32_t pitch,
+				  uint32_t width, uint32_t height)
+{
+	if (!writer || !width || !height) {
+		return;
+	}
+
+	if (width > SHM_MAX_DIMENSION || height > SHM_MAX_DIMENSION) {
+		if (!writer->too_large) {
+			blog(LOG_WARNING, "[%s] %ux%u is too large to share in memory", writer->name, width, height);
+			writer->too_large = true;
+		}
+		return;
+	}
+
+	bool full = false;
+	if (!writer->pixels || width != writer->width || height != writer->height) {
+		if (!shm_writer_resize(writer, width, height)) {
+			blog(LOG_WARNING, "[%s] Failed to resize memory share to %ux%u", writer->name, width, height);
+			return;
+		}
+		full = true;
+	}
+
+	struct shm_header *header = writer->header;
+	uint32_t tiles_x = header->tiles_x;
+	uint32_t tiles = tiles_x * header->tiles_y;
+
+	// comparing against the last frame only reads, so it happens outside the write
+	uint32_t dirty_count = 0;
+	if (!full) {
+		for (uint32_t i = 0; i < tiles; i++) {
+			uint32_t x = (i % tiles_x) * SHM_TILE;
+			uint32_t y = (i / tiles_x) * SHM_TILE;
+			if (!shm_tile_equal(writer->pixels, writer->pitch, pixels, pitch, x, y, width, height)) {
+				writer->dirty[dirty_count++] = i;
+			}
+		}
+		full = dirty_count * 100 > tiles * WIN_SPOUT_SHM_FULL_FRAME_PERCENT;
+	}
+
+	uint64_t frame_number = ++writer->frame_number;
+	uint64_t copied = 0;
+
+	os_atomic_inc_long(&header->seq);
+
+	if (full) {
+		uint32_t row_size = width * 4;
+		for (uint32_t y = 0; y < height; y++) {
+			memcpy(writer->pixels + (size_t)y * writer->pitch, pixels + (size_t)y * pitch, row_size);
+		}
+		for (uint32_t i = 0; i < tiles; i++) {
+			header->tile_frame[i] = frame_number;
+		}
+		copied = (uint64_t)row_size * height;
+	} else {
+		for (uint32_t d = 0; d < dirty_count; d++) {
+			uint32_t i = writer->dirty[d];
+			uint32_t x = (i % tiles_x) * SHM_TILE;
+			uint32_t y = (i / tiles_x) * SHM_TILE;
+			shm_copy_tile(writer->pixels, writer->pitch, pixels, pitch, x, y, width, height);
+			header->tile_frame[i] = frame_number;
+			copied += (uint64_t)min_u32(SHM_TILE, width - x) * 4 * min_u32(SHM_TILE, height - y);
+		}
+	}
+	header->frame_number = frame_number;
+
+	os_atomic_inc_long(&header->seq);
+
+	writer->stats.frames++;
+	writer->stats.full_frames += full ? 1 : 0;
+	writer->stats.bytes_copied += copied;
+	shm_report(writer->name, "sent", &writer->stats);
+}
+
+struct win_spout_shm_reader *win_spout_shm_reader_open(const char *sender_name)
+{
+	if (!sender_name || !*sender_name) {
+		return nullptr;
+	}
+
+	struct dstr name = {};
+	dstr_printf(&name, "%s" SHM_SUFFIX, sender_name);
+	struct win_spout_shm_section *section = win_spout_shm_section_open(name.array, sizeof(struct shm_header), true);
+	dstr_free(&name);
+
+	struct shm_header *header = (struct shm_header *)win_spout_shm_section_data(section);
+	if (!header) {
+		return nullptr;
+	}
+
+	if (header->version != WIN_SPOUT_SHM_FRAME_VERSION || !os_atomic_load_long(&header->active)) {
+		win_spout_shm_section_destroy(section);
+		return nullptr;
+	}
+
+	struct win_spout_shm_reader *reader = (win_spout_shm_reader *)bzalloc(sizeof(win_spout_shm_reader));
+	strncpy(reader->name, sender_name, sizeof(reader->name) - 1);
+	reader->header_section = section;
+	reader->header = header;
+	reader->stats.start = os_gettime_ns();
+	return reader;
+}
+
+void win_spout_shm_reader_destroy(struct win_spout_shm_reader *reader)
+{
+	if (!reader) {
+		return;
+	}
+
+	win_spout_shm_section_destroy(reader->pixel_section);
+	win_spout_shm_section_destroy(reader->header_section);
+	win_spout_frame_pool_release(reader->local);
+	bfree(reader);
+}
+
+bool win_spout_shm_reader_alive(struct win_spout_shm_reader *reader)
+{
+	return reader && os_atomic_load_long(&reader->header->active) != 0;
+}
+
+/**
+ * The header is written by another process, so its layout is checked
+ * before anything is mapped or indexed with it: tile_frame only has room
+ * for SHM_MAX_DIMENSION square and the pixel section is sized from pitch.
+ */
+static bool shm_header_valid(uint32_t width, uint32_t height, uint32_t pitch, uint32_t tiles_x, uint32_t tiles_y)
+{
+	if (!width || !height || width > SHM_MAX_DIMENSION || height > SHM_MAX_DIMENSION) {
+		return false;
+	}
+	if (pitch < width * 4 || pitch > win_spout_frame_pool_pitch(SHM_MAX_DIMENSION * 4)) {
+		return false;
+	}
+	return tiles_x == (width + SHM_TILE - 1) / SHM_TILE && tiles_y == (height + SHM_TILE - 1) / SHM_TILE;
+}
+
+// Maps the pixel section the header currently points at
+static bool shm_reader_remap(struct win_spout_shm_reader *reader, uint64_t generation, uint32_t width,
+			     uint32_t height, uint32_t pitch)
+{
+	win_spout_shm_section_destroy(reader->pixel_section);
+	reader->pixels = nullptr;
+	reader->generation = 0;
+
+	struct dstr name = {};
+	shm_pixel_name(&name, reader->name, generation);
+	reader->pixel_section = win_spout_shm_section_open(name.array, (size_t)pitch * height, false);
+	dstr_free(&name);
+
+	reader->pixels = (const uint8_t *)win_spout_shm_section_data(reader->pixel_section);
+	if (!reader->pixels) {
+		return false;
+	}
+
+	reader->local_pitch = win_spout_frame_pool_pitch(width * 4);
+	reader->local = win_spout_frame_pool_resize(reader->local, (size_t)reader->local_pitch * height);
+	if (!reader->local) {
+		return false;
+	}
+
+	reader->generation = generation;
+	reader->width = width;
+	reader->height = height;
+	reader->pitch = pitch;
+	// everything is new to a fresh local copy
+	reader->last_frame = 0;
+	return true;
+}
+
+bool win_spout_shm_reader_read(struct win_spout_shm_reader *reader, const uint8_t **pixels, uint32_t *pitch,
+			       uint32_t *width, uint32_t *height)
+{
+	struct shm_header *header = reader->header;
+
+	long before = os_atomic_load_long(&header->seq);
+	if (before & 1) {
+		return false;
+	}
+
+	uint64_t generation = header->generation;
+	uint64_t frame_number = header->frame_number;
+	if (!generation || (generation == reader->generation && frame_number == reader->last_frame)) {
+		return false;
+	}
+
+	if (generation != reader->generation) {
+		// one copy of each, the writer may change them under us
+		uint32_t new_width = header->width;
+		uint32_t new_height = header->height;
+		uint32_t new_pitch = header->pitch;
+		uint32_t tiles_x = header->tiles_x;
+		uint32_t tiles_y = header->tiles_y;
+
+		if (!shm_header_valid(new_width, new_height, new_pitch, tiles_x, tiles_y)) {
+			// a torn header settles by the next read, a corrupt one doesn't
+			if (os_atomic_load_long(&header->seq) == before && !reader->corrupt) {
+				blog(LOG_WARNING, "[%s] Ignoring memory share with a bad header (%ux%u, pitch %u)",
+				     reader->name, new_width, new_height, new_pitch);
+				reader->corrupt = true;
+			}
+			return false;
+		}
+		reader->corrupt = false;
+
+		if (!shm_reader_remap(reader, generation, new_width, new_height, new_pitch)) {
+			return false;
+		}
+	}
+
+	uint32_t tiles_x = (reader->width + SHM_TILE - 1) / SHM_TILE;
+	uint32_t tiles = tiles_x * ((reader->height + SHM_TILE - 1) / SHM_TILE);
+	uint64_t copied = 0;
+	bool full = reader->last_frame == 0;
+
+	if (full) {
+		uint32_t row_size = reader->width * 4;
+		for (uint32_t y = 0; y < reader->height; y++) {
+			memcpy(reader->local->data + (size_t)y * reader->local_pitch,
+			       reader->pixels + (size_t)y * reader->pitch, row_size);
+		}
+		copied = (uint64_t)row_size * reader->height;
+	} else {
+		for (uint32_t i = 0; i < tiles; i++) {
+			if (header->tile_frame[i] <= reader->last_frame)
+				continue;
+
+			uint32_t x = (i % tiles_x) * SHM_TILE;
+			uint32_t y = (i / tiles_x) * SHM_TILE;
+			shm_copy_tile(reader->local->data, reader->local_pitch, reader->pixels, reader->pitch, x, y,
+				      reader->width, reader->height);
+			copied += (uint64_t)min_u32(SHM_TILE, reader->width - x) * 4 *
+				  min_u32(SHM_TILE, reader->height - y);
+		}
+	}
+
+	// a write overlapped the copy: the torn tiles are still newer than
+	// last_frame, so the next read copies them again
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (os_atomic_load_long(&header->seq) != before) {
+		// the header may have been torn too, map it again to be sure
+		if (full) {
+			reader->generation = 0;
+		}
+		return false;
+	}
+
+	reader->last_frame = frame_number;
+	reader->stats.frames++;
+	reader->stats.full_frames += full ? 1 : 0;
+	reader->stats.bytes_copied += copied;
+	shm_report(reader->name, "received", &reader->stats);
+
+	*pixels = reader->local->data;
+	*pitch = reader->local_pitch;
+	*width = reader->width;
+	*height = reader->height;
+	return true;
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTSHMFRAME_H
+#define WINSPOUTSHMFRAME_H
+
+#include <stdint.h>
+
+#define WIN_SPOUT_SHM_FRAME_VERSION 1
+#define WIN_SPOUT_SHM_TILE_SIZE 64
+
+/**
+ * CPU frame shared next to a sender in named shared memory, for receivers
+ * that want the frame in system memory without a GPU readback.
+ *
+ * The frame is split into 64x64 tiles and the header records the frame
+ * number each tile last changed in. The writer only copies tiles that
+ * differ from the previous frame, or the whole frame when more than
+ * WIN_SPOUT_SHM_FULL_FRAME_PERCENT of them do, and readers only copy the
+ * tiles that changed since their last read into their local copy.
+ *
+ * Both ends log the average bytes copied per frame every few seconds.
+ */
+#define WIN_SPOUT_SHM_FULL_FRAME_PERCENT 50
+
+struct win_spout_shm_writer;
+struct win_spout_shm_reader;
+
+struct win_spout_shm_writer *win_spout_shm_writer_create(const char *sender_name);
+void win_spout_shm_writer_destroy(struct win_spout_shm_writer *writer);
+void win_spout_shm_writer_publish(struct win_spout_shm_writer *writer, const uint8_t *pixels, uint32_t pitch,
+				  uint32_t width, uint32_t height);
+
+// Returns nullptr if the sender doesn't share its frame in memory
+struct win_spout_shm_reader *win_spout_shm_reader_open(const char *sender_name);
+void win_spout_shm_reader_destroy(struct win_spout_shm_reader *reader);
+// False once the writer has gone away
+bool win_spout_shm_reader_alive(struct win_spout_shm_reader *reader);
+/**
+ * Brings the local copy up to date, returns true if it holds a new frame.
+ * The BGRA pixels stay valid until the next read.
+ */
+bool win_spout_shm_reader_read(struct win_spout_shm_reader *reader, const uint8_t **pixels, uint32_t *pitch,
+			       uint32_t *width, uint32_t *height);
+
+#endif // WINSPOUTSHMFRAME_H
@@ -0,0 +1,157 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include "win-spout.h"
+#include "win-spout-shm.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct win_spout_shm_section {
+#ifdef _WIN32
+	HANDLE mapping;
+#else
+	struct dstr name;
+	bool owner;
+#endif
+	void *data;
+	size_t size;
+};
+
+#ifdef _WIN32
+
+static struct win_spout_shm_section *shm_section_map(HANDLE mapping, size_t size, DWORD access)
+{
+	if (!mapping) {
+		return nullptr;
+	}
+
+	// fails if the section is shorter than size
+	void *view = MapViewOfFile(mapping, access, 0, 0, size);
+	if (!view) {
+		CloseHandle(mapping);
+		return nullptr;
+	}
+
+	struct win_spout_shm_section *section =
+		(win_spout_shm_section *)bzalloc(sizeof(struct win_spout_shm_section));
+	section->mapping = mapping;
+	section->data = view;
+	section->size = size;
+	return section;
+}
+
+struct win_spout_shm_section *win_spout_shm_section_create(const char *name, size_t size)
+{
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+					    (DWORD)size, name);
+	return shm_section_map(mapping, size, FILE_MAP_ALL_ACCESS);
+}
+
+struct win_spout_shm_section *win_spout_shm_section_open(const char *name, size_t size, bool writable)
+{
+	DWORD access = writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ;
+	return shm_section_map(OpenFileMappingA(access, FALSE, name), size, access);
+}
+
+void win_spout_shm_section_destroy(struct win_spout_shm_section *section)
+{
+	if (!section) {
+		return;
+	}
+
+	UnmapViewOfFile(section->data);
+	CloseHandle(section->mapping);
+	bfree(section);
+}
+
+#else
+
+// POSIX names are a single path component
+static void shm_section_name(struct dstr *dst, const char *name)
+{
+	dstr_printf(dst, "/%s", name);
+	for (size_t i = 1; i < dst->len; i++) {
+		if (dst->array[i] == '/')
+			dst->array[i] = '_';
+	}
+}
+
+static struct win_spout_shm_section *shm_section_map(const char *name, size_t size, bool writable, bool create)
+{
+	struct dstr path = {};
+	shm_section_name(&path, name);
+
+	int fd = shm_open(path.array, create ? O_RDWR | O_CREAT : writable ? O_RDWR : O_RDONLY, 0600);
+	if (fd < 0) {
+		dstr_free(&path);
+		return nullptr;
+	}
+
+	// a section is only ever grown, readers may still map the old size
+	struct stat st;
+	bool sized = fstat(fd, &st) == 0 && ((size_t)st.st_size >= size || (create && ftruncate(fd, size) == 0));
+	void *view = sized ? mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)
+			   : MAP_FAILED;
+	close(fd);
+
+	if (view == MAP_FAILED) {
+		if (create)
+			shm_unlink(path.array);
+		dstr_free(&path);
+		return nullptr;
+	}
+
+	struct win_spout_shm_section *section =
+		(win_spout_shm_section *)bzalloc(sizeof(struct win_spout_shm_section));
+	section->name = path;
+	section->owner = create;
+	section->data = view;
+	section->size = size;
+	return section;
+}
+
+struct win_spout_shm_section *win_spout_shm_section_create(const char *name, size_t size)
+{
+	return shm_section_map(name, size, true, true);
+}
+
+struct win_spout_shm_section *win_spout_shm_section_open(const char *name, size_t size, bool writable)
+{
+	return shm_section_map(name, size, writable, false);
+}
+
+void win_spout_shm_section_destroy(struct win_spout_shm_section *section)
+{
+	if (!section) {
+		return;
+	}
+
+	munmap(section->data, section->size);
+	if (section->owner) {
+		shm_unlink(section->name.array);
+	}
+	dstr_free(&section->name);
+	bfree(section);
+}
+
+#endif // _WIN32
+
+void *win_spout_shm_section_data(struct win_spout_shm_section *section)
+{
+	return section ? section->data : nullptr;
+}
@@ -0,0 +1,36 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTSHM_H
+#define WINSPOUTSHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Named shared memory sections, the blocks shared next to a sender are
+ * kept in. Windows file mappings in the plugin; elsewhere POSIX shared
+ * memory stands in for them, so the shared layouts and both ends of
+ * them can be exercised by the tests on Linux.
+ *
+ * A Windows section goes away with its last handle. A POSIX one is
+ * unlinked when the section that created it is destroyed, readers that
+ * have it open keep their mapping.
+ */
+struct win_spout_shm_section;
+
+// Creates the section, or takes over an existing one of the same name
+struct win_spout_shm_section *win_spout_shm_section_create(const char *name, size_t size);
+// Returns nullptr if there's no section of that name at least size long
+struct win_spout_shm_section *win_spout_shm_section_open(const char *name, size_t size, bool writable);
+void win_spout_shm_section_destroy(struct win_spout_shm_section *section);
+
+void *win_spout_shm_section_data(struct win_spout_shm_section *section);
+
+#endif // WINSPOUTSHM_H
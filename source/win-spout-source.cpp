@@ -8,7 +8,18 @@
  */
 
 #include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "win-spout.h"
+#include "win-spout-metadata.h"
+#include "win-spout-jitter.h"
+#include "win-spout-sync.h"
+#include "win-spout-trace.h"
+#include "win-spout-alloc-track.h"
+#include "win-spout-receiver.h"
+#include "win-spout-watchdog.h"
+#include "win-spout-gpu-budget.h"
+#include "win-spout-yuv.h"
 
 #include "SpoutLibrary.h"
 #pragma comment(lib, "SpoutLibrary.lib")
@@ -21,146 +32,494 @@
 #define USE_FIRST_AVAILABLE_SENDER "usefirstavailablesender"
 #define SPOUT_TICK_SPEED_LIMIT "tickspeedlimit"
 #define SPOUT_COMPOSITE_MODE "compositemode"
+#define SPOUT_BUFFER_FRAMES "bufferframes"
+#define SPOUT_SYNC_GROUP "syncgroup"
+#define SPOUT_SYNC_MAX_WAIT "syncmaxwait"
+#define SPOUT_STALL_TIMEOUT "stalltimeout"
+#define SPOUT_STALL_POLICY "stallpolicy"
+#define SPOUT_STALL_FALLBACK "stallfallback"
 
 #define COMPOSITE_MODE_OPAQUE 1
 #define COMPOSITE_MODE_ALPHA 2
 #define COMPOSITE_MODE_DEFAULT 3
 #define COMPOSITE_MODE_PREMULTIPLIED 4
 
+// time a stalled sender takes to fade to black
+#define STALL_FADE_NS 1000000000ULL
+// how often a missing Spout frame counter is looked for again
+#define FRAME_COUNT_RETRY_NS 1000000000ULL
+
+/**
+ * Spout's own frame counter, a named semaphore senders with frame
+ * counting enabled release once per frame. Lets the watchdog see
+ * senders that don't publish OBS metadata.
+ */
+struct spout_frame_count {
+	HANDLE semaphore;
+	uint64_t next_open;
+};
+
 struct spout_source {
 	obs_source_t *source;
-	char senderName[256];
-	bool useFirstSender;
 	gs_texture_t *texture;
-	HANDLE dxHandle;
-	DWORD dxFormat;
-	ULONGLONG lastCheckTick;
 	int width;
 	int height;
-	bool initialized;
-	ULONGLONG tick_speed_limit;
 	ULONGLONG composite_mode;
-	int spout_status;
 	int render_status;
-	int tick_status;
 	SPOUTHANDLE spout_receiver_ptr;
+
+	// connects to the sender through the Spout sender registry
+	struct win_spout_receiver receiver;
+	enum win_spout_receiver_state logged_state;
+
+	// frame metadata published by OBS senders, if any
+	struct win_spout_metadata *metadata;
+	uint64_t last_frame_number;
+	uint64_t frames_dropped;
+	uint64_t latency_ns;
+	// how the sender's metadata says its texture is laid out, unpacked with yuv_effect
+	uint32_t pixel_layout;
+	uint32_t yuv_matrix;
+	gs_effect_t *yuv_effect;
+	// the texture's format, read when it's opened so get_height needs no graphics context
+	enum gs_color_format texture_format;
+
+	// buffered receive: sender frames are copied into local textures
+	// and presented through a jitter buffer aligned to the video clock.
+	// buffer_frames is set by update() and picked up by the next tick,
+	// which owns applied_buffer_frames and the jitter buffer.
+	volatile long buffer_frames;
+	int applied_buffer_frames;
+	struct win_spout_jitter jitter;
+	gs_texture_t *buffer_textures[WIN_SPOUT_JITTER_MAX_SLOTS];
+	int buffer_slot;
+
+	// sync group: the frame is only latched into sync_texture once
+	// every member's sender is on the same video frame. sync_timestamp
+	// is the sender's OBS timestamp from the tick's metadata read,
+	// published to the group so it never reads our metadata itself.
+	char sync_group_name[256];
+	struct win_spout_sync_group *sync_group;
+	uint64_t sync_timestamp;
+	gs_texture_t *sync_texture;
+
+	// stall watchdog: the sender's frame counter hasn't moved for the
+	// stall timeout, handled as stall_policy says. The counter is the
+	// OBS metadata's or else Spout's, watch_active is 0 while the
+	// sender has neither.
+	struct win_spout_watchdog watchdog;
+	struct spout_frame_count frame_count;
+	volatile long watch_active;
+	int stall_policy;
+	char stall_fallback[256];
+	float stall_fade;
+	// while the fallback sender is shown, the stalled one is still
+	// watched through its metadata so we can switch back
+	bool fallback_active;
+	char primary_name[256];
+	bool primary_first;
+	struct win_spout_metadata *primary_metadata;
+	struct spout_frame_count primary_frame_count;
+
+	// local copies count as owned, the sender's texture as shared
+	struct win_spout_gpu_account *gpu_account;
 };
 
-/**
- * Writes sender texture details (width & height) to the context
- * @return bool success
- */
-static bool win_spout_source_store_sender_info(spout_source *context)
+/* Transport over the Spout sender registry */
+
+static int spout_registry_get_sender_count(void *data)
+{
+	return ((SPOUTHANDLE)data)->GetSenderCount();
+}
+
+static bool spout_registry_get_sender(void *data, int index, char *name, size_t size)
+{
+	return ((SPOUTHANDLE)data)->GetSender(index, name, (int)size);
+}
+
+static bool spout_registry_set_active_sender(void *data, const char *name)
+{
+	return ((SPOUTHANDLE)data)->SetActiveSender(name);
+}
+
+static bool spout_registry_get_sender_info(void *data, const char *name, struct win_spout_sender_desc *desc)
 {
 	unsigned int width, height;
-	// get info about this active sender:
-	if (!context->spout_receiver_ptr->GetSenderInfo(context->senderName, width, height, context->dxHandle,
-							context->dxFormat)) {
+	HANDLE dxHandle;
+	DWORD dxFormat;
+	if (!((SPOUTHANDLE)data)->GetSenderInfo(name, width, height, dxHandle, dxFormat)) {
 		return false;
 	}
 
-	context->width = width;
-	context->height = height;
+	desc->width = width;
+	desc->height = height;
+	desc->format = dxFormat;
+	desc->handle = (uint64_t)(uintptr_t)dxHandle;
 	return true;
 }
 
-static void win_spout_source_init(void *data, bool forced = false)
+static void spout_frame_count_close(struct spout_frame_count *count)
 {
-	struct spout_source *context = (spout_source *)data;
-	if (context->initialized) {
-		context->spout_status = 0;
-		return;
+	if (count->semaphore) {
+		CloseHandle(count->semaphore);
 	}
+	*count = {};
+}
 
-	ULONG64 tickDelta = GetTickCount64() - context->lastCheckTick;
-
-	if (tickDelta < context->tick_speed_limit && !forced) {
-		return;
-	}
-	context->lastCheckTick = GetTickCount64();
+/**
+ * Reads the sender's Spout frame counter the way Spout's receivers do:
+ * taking one from the semaphore and giving it back returns the count.
+ *
+ * @return bool the sender counts frames, the count in frame
+ */
+static bool spout_frame_count_read(struct spout_frame_count *count, const char *sender_name, uint64_t now,
+				   uint64_t *frame)
+{
+	if (!count->semaphore) {
+		if (now < count->next_open) {
+			return false;
+		}
+		count->next_open = now + FRAME_COUNT_RETRY_NS;
 
-	if (context->spout_receiver_ptr == NULL) {
-		if (context->spout_status != -1) {
-			warn("Spout pointer didn't exist");
-			context->spout_status = -1;
+		char name[256 + 16];
+		snprintf(name, sizeof(name), "%s_Count_Semaphore", sender_name);
+		count->semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, name);
+		if (!count->semaphore) {
+			return false;
 		}
-		return;
 	}
 
-	int totalSenders = context->spout_receiver_ptr->GetSenderCount();
+	// nothing to take before the first frame
+	LONG previous = 0;
+	if (WaitForSingleObject(count->semaphore, 0) == WAIT_OBJECT_0) {
+		ReleaseSemaphore(count->semaphore, 1, &previous);
+		previous++;
+	}
+	*frame = (uint64_t)previous;
+	return true;
+}
 
-	if (totalSenders == 0) {
-		if (context->spout_status != -2) {
-			info("No active Spout cameras");
-			context->spout_status = -2;
-		}
+/**
+ * Logs why the receiver isn't connected, once per state change
+ */
+static void win_spout_source_log_state(spout_source *context)
+{
+	enum win_spout_receiver_state state = context->receiver.state;
+	if (state == context->logged_state) {
 		return;
 	}
+	context->logged_state = state;
 
-	if (context->useFirstSender) {
-		if (context->spout_receiver_ptr->GetSender(0, context->senderName)) {
-			if (!context->spout_receiver_ptr->SetActiveSender(context->senderName)) {
-				if (context->spout_status != -4) {
-					info("WoW , i can't set active sender as %s", context->senderName);
-					context->spout_status = -4;
-				}
-				return;
-			}
-		} else {
-			if (context->spout_status != -3) {
-				info("Strange , there is a sender without name ?");
-				context->spout_status = -3;
-			}
-			return;
-		}
-	} else {
-		int index;
-		char senderName[256];
-		bool exists = false;
-		// then get the name of each sender from SPOUT
-		for (index = 0; index < totalSenders; index++) {
-			context->spout_receiver_ptr->GetSender(index, senderName);
-			if (strcmp(senderName, context->senderName) == 0) {
-				exists = true;
-				break;
-			}
-		}
-		if (!exists) {
-			if (context->spout_status != -5) {
-				info("Sorry, Sender Name %s not found", context->senderName);
-				context->spout_status = -5;
-			}
-			return;
-		} else {
-			context->spout_status = 0;
-		}
+	const char *senderName = context->receiver.sender_name;
+	switch (state) {
+	case WIN_SPOUT_RECEIVER_NO_TRANSPORT:
+		warn("Spout pointer didn't exist");
+		break;
+	case WIN_SPOUT_RECEIVER_NO_SENDERS:
+		info("No active Spout cameras");
+		break;
+	case WIN_SPOUT_RECEIVER_UNNAMED_SENDER:
+		info("Strange , there is a sender without name ?");
+		break;
+	case WIN_SPOUT_RECEIVER_ACTIVATE_FAILED:
+		info("WoW , i can't set active sender as %s", senderName);
+		break;
+	case WIN_SPOUT_RECEIVER_NOT_FOUND:
+		info("Sorry, Sender Name %s not found", senderName);
+		break;
+	case WIN_SPOUT_RECEIVER_NO_INFO:
+		warn("Named %s sender not found", senderName);
+		break;
+	case WIN_SPOUT_RECEIVER_REBINDING:
+		warn("Can't open resized texture for sender %s yet, holding last frame", senderName);
+		break;
+	default:
+		break;
 	}
+}
 
-	info("Getting info for sender %s", context->senderName);
-	if (!win_spout_source_store_sender_info(context)) {
-		warn("Named %s sender not found", context->senderName);
-	} else {
-		info("Sender %s is of dimensions %d x %d", context->senderName, context->width, context->height);
-	};
+/**
+ * Updates the texture memory accounted to the source
+ */
+static void win_spout_source_account(spout_source *context)
+{
+	obs_enter_graphics();
+	uint64_t owned = win_spout_gpu_texture_bytes(context->sync_texture);
+	for (int i = 0; i < WIN_SPOUT_JITTER_MAX_SLOTS; i++) {
+		owned += win_spout_gpu_texture_bytes(context->buffer_textures[i]);
+	}
+	uint64_t shared = win_spout_gpu_texture_bytes(context->texture);
+	obs_leave_graphics();
+
+	win_spout_gpu_account_set(context->gpu_account, owned, shared);
+}
+
+/**
+ * (Re)opens the sender's metadata section. A rebind can mean a new
+ * sender under the same name, whose section and frame counter are new.
+ */
+static void win_spout_source_open_metadata(spout_source *context)
+{
+	win_spout_metadata_destroy(context->metadata);
+	context->metadata = win_spout_metadata_open(context->receiver.sender_name);
+	context->last_frame_number = 0;
+	context->pixel_layout = 0;
+	context->sync_timestamp = 0;
+	spout_frame_count_close(&context->frame_count);
+}
+
+/**
+ * Whether the texture is packed YUV, by the metadata and in a format
+ * that can be: a sender that doesn't say so is shown as it is
+ */
+static bool win_spout_source_packed(spout_source *context)
+{
+	if (context->pixel_layout != WIN_SPOUT_YUV_NV12 && context->pixel_layout != WIN_SPOUT_YUV_P010)
+		return false;
+	return context->texture_format ==
+	       win_spout_yuv_texture_format((enum win_spout_yuv_format)context->pixel_layout);
+}
+
+// The height shown: a packed texture's chroma rows are under its picture
+static int win_spout_source_display_height(spout_source *context)
+{
+	if (win_spout_source_packed(context))
+		return (int)win_spout_yuv_luma_height((uint32_t)context->height);
+	return context->height;
+}
+
+/**
+ * Opens the shared texture and metadata of the sender the receiver
+ * has just connected to
+ */
+static void win_spout_source_open(spout_source *context, const struct win_spout_sender_desc *desc)
+{
+	WIN_SPOUT_TRACE_SCOPE("win_spout_source_open");
+
+	const char *senderName = context->receiver.sender_name;
+	context->width = desc->width;
+	context->height = desc->height;
+	info("Sender %s is of dimensions %d x %d", senderName, context->width, context->height);
 
 	obs_enter_graphics();
 	gs_texture_destroy(context->texture);
-	context->texture = gs_texture_open_shared((uint32_t)(uintptr_t)context->dxHandle);
+	context->texture = gs_texture_open_shared((uint32_t)desc->handle);
+	context->texture_format = context->texture ? gs_texture_get_color_format(context->texture) : GS_UNKNOWN;
 	obs_leave_graphics();
+	win_spout_source_account(context);
 
-	context->initialized = true;
+	win_spout_source_open_metadata(context);
+
+	// the stalled sender keeps its watchdog while the fallback is shown
+	if (!context->fallback_active) {
+		win_spout_watchdog_reset(&context->watchdog);
+		context->stall_fade = 0.0f;
+	}
+}
+
+static void win_spout_source_release_buffer(spout_source *context)
+{
+	obs_enter_graphics();
+	for (int i = 0; i < WIN_SPOUT_JITTER_MAX_SLOTS; i++) {
+		gs_texture_destroy(context->buffer_textures[i]);
+		context->buffer_textures[i] = NULL;
+	}
+	obs_leave_graphics();
+	win_spout_jitter_reset(&context->jitter);
+	context->buffer_slot = -1;
+	win_spout_source_account(context);
 }
 
 static void win_spout_source_deinit(void *data)
 {
 	struct spout_source *context = (spout_source *)data;
-	context->initialized = false;
+	win_spout_receiver_reset(&context->receiver);
 	if (context->texture) {
 		obs_enter_graphics();
 		gs_texture_destroy(context->texture);
 		obs_leave_graphics();
 		context->texture = NULL;
+		context->texture_format = GS_UNKNOWN;
+	}
+	win_spout_metadata_destroy(context->metadata);
+	context->metadata = nullptr;
+	spout_frame_count_close(&context->frame_count);
+	win_spout_source_release_buffer(context);
+}
+
+/**
+ * Opens the sender's new shared handle and swaps it in place of the
+ * current texture. The previous texture is kept (and keeps being drawn)
+ * if the new one can't be opened yet.
+ *
+ * @return bool success
+ */
+static bool win_spout_source_rebind(spout_source *context, const struct win_spout_sender_desc *desc)
+{
+	obs_enter_graphics();
+	gs_texture_t *texture = gs_texture_open_shared((uint32_t)desc->handle);
+	if (texture) {
+		gs_texture_destroy(context->texture);
+		context->texture = texture;
+		context->texture_format = gs_texture_get_color_format(texture);
+	}
+	obs_leave_graphics();
+	win_spout_source_account(context);
+
+	if (!texture) {
+		return false;
 	}
+
+	context->width = desc->width;
+	context->height = desc->height;
+	return true;
+}
+
+/**
+ * Polls the receiver and opens, rebinds or drops the sender's texture
+ * as it says
+ *
+ * @return bool the texture can be sampled this tick
+ */
+static bool win_spout_source_poll(spout_source *context, bool forced)
+{
+	struct win_spout_sender_desc desc;
+	enum win_spout_receiver_event event =
+		win_spout_receiver_poll(&context->receiver, GetTickCount64(), forced, &desc);
+
+	// nothing to keep showing while the new texture opens
+	if (event == WIN_SPOUT_RECEIVER_EVENT_REBIND && !context->texture) {
+		event = WIN_SPOUT_RECEIVER_EVENT_LOST;
+	}
+
+	switch (event) {
+	case WIN_SPOUT_RECEIVER_EVENT_CONNECT:
+		win_spout_source_open(context, &desc);
+		break;
+	case WIN_SPOUT_RECEIVER_EVENT_REBIND:
+		// Sender is still there but was resized / reformatted: rebind the
+		// new shared handle without tearing down, keeping the last frame
+		// on screen until the new texture is valid.
+		if (win_spout_source_rebind(context, &desc)) {
+			win_spout_receiver_bound(&context->receiver, &desc);
+			win_spout_source_open_metadata(context);
+			info("Sender %s is now of dimensions %d x %d", context->receiver.sender_name, context->width,
+			     context->height);
+		}
+		win_spout_source_log_state(context);
+		return false;
+	case WIN_SPOUT_RECEIVER_EVENT_LOST:
+		info("Sender %s has changed / gone away. Resetting ", context->receiver.sender_name);
+		win_spout_source_deinit(context);
+		if (win_spout_receiver_poll(&context->receiver, GetTickCount64(), false, &desc) ==
+		    WIN_SPOUT_RECEIVER_EVENT_CONNECT) {
+			win_spout_source_open(context, &desc);
+		}
+		win_spout_source_log_state(context);
+		return false;
+	default:
+		break;
+	}
+
+	win_spout_source_log_state(context);
+	return context->receiver.state == WIN_SPOUT_RECEIVER_CONNECTED;
+}
+
+/**
+ * Reads the sender's frame metadata and works out end-to-end latency
+ * and how many frames were skipped since the last read
+ *
+ * @return bool the sender has sent a new frame, its send time in timestamp
+ */
+static bool win_spout_source_read_metadata(spout_source *context, uint64_t &timestamp)
+{
+	struct win_spout_frame_metadata meta;
+	if (!win_spout_metadata_read(context->metadata, &meta)) {
+		return false;
+	}
+
+	context->pixel_layout = meta.pixel_layout;
+	context->yuv_matrix = meta.yuv_matrix;
+	context->sync_timestamp = meta.obs_timestamp;
+
+	if (meta.frame_number == context->last_frame_number) {
+		return false;
+	}
+
+	if (context->last_frame_number && meta.frame_number > context->last_frame_number + 1) {
+		context->frames_dropped += meta.frame_number - context->last_frame_number - 1;
+	}
+	context->last_frame_number = meta.frame_number;
+
+	uint64_t now = os_gettime_ns();
+	context->latency_ns = now > meta.send_time ? now - meta.send_time : 0;
+	timestamp = meta.send_time;
+	return true;
+}
+
+/**
+ * Copies the current shared texture into a local texture,
+ * (re)creating it when the sender size or format has changed
+ */
+static void win_spout_source_copy_texture(spout_source *context, gs_texture_t **dst)
+{
+	obs_enter_graphics();
+	enum gs_color_format format = gs_texture_get_color_format(context->texture);
+	uint32_t width = gs_texture_get_width(context->texture);
+	uint32_t height = gs_texture_get_height(context->texture);
+
+	if (!*dst || gs_texture_get_width(*dst) != width || gs_texture_get_height(*dst) != height ||
+	    gs_texture_get_color_format(*dst) != format) {
+		gs_texture_destroy(*dst);
+		*dst = gs_texture_create(width, height, format, 1, NULL, GS_RENDER_TARGET);
+		win_spout_source_account(context);
+	}
+
+	if (*dst) {
+		gs_copy_texture(*dst, context->texture);
+	}
+	obs_leave_graphics();
+}
+
+/**
+ * Copies the current sender frame into a free buffer slot
+ */
+static void win_spout_source_buffer_frame(spout_source *context, uint64_t timestamp)
+{
+	int slot = win_spout_jitter_push(&context->jitter, timestamp);
+	win_spout_source_copy_texture(context, &context->buffer_textures[slot]);
+}
+
+static void win_spout_source_get_stats(void *data, calldata_t *cd)
+{
+	struct spout_source *context = (spout_source *)data;
+	calldata_set_int(cd, "latency_us", (long long)(context->latency_ns / 1000));
+	calldata_set_int(cd, "frame_number", (long long)context->last_frame_number);
+	calldata_set_int(cd, "frames_dropped", (long long)context->frames_dropped);
+	calldata_set_int(cd, "buffer_depth", (long long)win_spout_jitter_depth(&context->jitter));
+	calldata_set_int(cd, "buffer_late", (long long)context->jitter.late);
+	calldata_set_int(cd, "buffer_early", (long long)context->jitter.early);
+
+	struct win_spout_sync_stats sync_stats;
+	win_spout_sync_get_stats(context->sync_group, &sync_stats);
+	calldata_set_int(cd, "sync_misses", (long long)sync_stats.misses);
+
+	const struct win_spout_receiver_stats *receiver_stats = &context->receiver.stats;
+	calldata_set_int(cd, "reconnects", (long long)receiver_stats->reconnects);
+	calldata_set_int(cd, "reconnect_avg_ms",
+			 receiver_stats->reconnects
+				 ? (long long)(receiver_stats->reconnect_total_ms / receiver_stats->reconnects)
+				 : 0);
+	calldata_set_int(cd, "reconnect_max_ms", (long long)receiver_stats->reconnect_max_ms);
+	calldata_set_int(cd, "poll_avg_ns",
+			 receiver_stats->polls
+				 ? (long long)(receiver_stats->poll_total_ns / receiver_stats->polls)
+				 : 0);
+
+	calldata_set_int(cd, "stalls", (long long)context->watchdog.stalls);
+	calldata_set_int(cd, "stall_total_ms", (long long)(context->watchdog.stall_total_ns / 1000000));
+	calldata_set_int(cd, "stall_max_ms", (long long)(context->watchdog.stall_max_ns / 1000000));
+	calldata_set_bool(cd, "watchdog_active", os_atomic_load_long(&context->watch_active) != 0);
 }
 
 static void win_spout_source_update(void *data, obs_data_t *settings)
@@ -170,22 +529,47 @@ static void win_spout_source_update(void *data, obs_data_t *settings)
 	auto selectedSender = obs_data_get_string(settings, SPOUT_SENDER_LIST);
 
 	if (strcmp(selectedSender, USE_FIRST_AVAILABLE_SENDER) == 0) {
-		context->useFirstSender = true;
+		win_spout_receiver_set_sender(&context->receiver, nullptr);
 	} else {
-		context->useFirstSender = false;
-		memset(context->senderName, 0, 256);
-		strcpy(context->senderName, selectedSender);
+		win_spout_receiver_set_sender(&context->receiver, selectedSender);
+	}
+
+	// settings pick the sender again, so any fallback is over
+	if (context->fallback_active) {
+		context->fallback_active = false;
+		win_spout_metadata_destroy(context->primary_metadata);
+		context->primary_metadata = nullptr;
+		spout_frame_count_close(&context->primary_frame_count);
+		win_spout_watchdog_reset(&context->watchdog);
 	}
 
+	context->watchdog.timeout_ns = (uint64_t)obs_data_get_int(settings, SPOUT_STALL_TIMEOUT) * 1000000;
+	context->stall_policy = (int)obs_data_get_int(settings, SPOUT_STALL_POLICY);
+	memset(context->stall_fallback, 0, sizeof(context->stall_fallback));
+	strncpy(context->stall_fallback, obs_data_get_string(settings, SPOUT_STALL_FALLBACK),
+		sizeof(context->stall_fallback) - 1);
+
 	auto selectedSpeed = obs_data_get_int(settings, SPOUT_TICK_SPEED_LIMIT);
-	context->tick_speed_limit = selectedSpeed;
+	context->receiver.retry_ms = selectedSpeed;
 
 	auto compositeMode = obs_data_get_int(settings, SPOUT_COMPOSITE_MODE);
 	context->composite_mode = compositeMode;
 
-	if (context->initialized) {
+	os_atomic_set_long(&context->buffer_frames, (long)obs_data_get_int(settings, SPOUT_BUFFER_FRAMES));
+
+	const char *syncGroup = obs_data_get_string(settings, SPOUT_SYNC_GROUP);
+	uint64_t syncMaxWait = (uint64_t)obs_data_get_int(settings, SPOUT_SYNC_MAX_WAIT) * 1000000;
+	if (!context->sync_group || strcmp(syncGroup, context->sync_group_name) != 0) {
+		win_spout_sync_leave(context->sync_group, context);
+		strncpy(context->sync_group_name, syncGroup, sizeof(context->sync_group_name) - 1);
+		context->sync_group = win_spout_sync_join(syncGroup, context, syncMaxWait);
+	} else {
+		win_spout_sync_set_max_wait(context->sync_group, syncMaxWait);
+	}
+
+	if (win_spout_receiver_connected(&context->receiver)) {
 		win_spout_source_deinit(data);
-		win_spout_source_init(data);
+		win_spout_source_poll(context, false);
 	}
 }
 
@@ -203,12 +587,28 @@ static void *win_spout_source_create(obs_data_t *settings, obs_source_t *source)
 	info("initialising spout source");
 	context->spout_receiver_ptr = GetSpout();
 	context->source = source;
-	context->useFirstSender = true;
-	context->initialized = false;
-	context->tick_speed_limit = 0;
 	context->texture = NULL;
-	context->dxHandle = NULL;
-	context->initialized = false;
+	context->metadata = nullptr;
+
+	struct win_spout_transport transport = {};
+	transport.data = context->spout_receiver_ptr;
+	transport.get_sender_count = spout_registry_get_sender_count;
+	transport.get_sender = spout_registry_get_sender;
+	transport.set_active_sender = spout_registry_set_active_sender;
+	transport.get_sender_info = spout_registry_get_sender_info;
+	win_spout_receiver_init(&context->receiver, &transport);
+	context->logged_state = WIN_SPOUT_RECEIVER_IDLE;
+	context->buffer_slot = -1;
+	context->gpu_account = win_spout_gpu_account_create("source", obs_source_get_name(source), true);
+	win_spout_jitter_init(&context->jitter, 2, 0);
+	win_spout_watchdog_init(&context->watchdog, 0);
+
+	proc_handler_add(obs_source_get_proc_handler(source),
+			 "void get_spout_stats(out int latency_us, out int frame_number, out int frames_dropped, "
+			 "out int buffer_depth, out int buffer_late, out int buffer_early, out int sync_misses, "
+			 "out int reconnects, out int reconnect_avg_ms, out int reconnect_max_ms, out int poll_avg_ns, "
+			 "out int stalls, out int stall_total_ms, out int stall_max_ms, out bool watchdog_active)",
+			 win_spout_source_get_stats, context);
 
 	// set the initial size as 100x100 until we
 	// have the actual dimensions from SPOUT
@@ -223,6 +623,16 @@ static void win_spout_source_destroy(void *data)
 	struct spout_source *context = (spout_source *)data;
 
 	win_spout_source_deinit(data);
+	win_spout_metadata_destroy(context->primary_metadata);
+	spout_frame_count_close(&context->primary_frame_count);
+
+	win_spout_sync_leave(context->sync_group, context);
+	context->sync_group = nullptr;
+	obs_enter_graphics();
+	gs_texture_destroy(context->sync_texture);
+	gs_effect_destroy(context->yuv_effect);
+	obs_leave_graphics();
+	win_spout_gpu_account_destroy(context->gpu_account);
 
 	if (context->spout_receiver_ptr != NULL) {
 		context->spout_receiver_ptr->Release();
@@ -236,11 +646,18 @@ static void win_spout_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, SPOUT_SENDER_LIST, USE_FIRST_AVAILABLE_SENDER);
 	obs_data_set_default_int(settings, "tickspeedlimit", 100);
+	obs_data_set_default_int(settings, SPOUT_BUFFER_FRAMES, 0);
+	obs_data_set_default_string(settings, SPOUT_SYNC_GROUP, "");
+	obs_data_set_default_int(settings, SPOUT_SYNC_MAX_WAIT, 40);
+	obs_data_set_default_int(settings, SPOUT_STALL_TIMEOUT, 2000);
+	obs_data_set_default_int(settings, SPOUT_STALL_POLICY, WIN_SPOUT_STALL_HOLD);
+	obs_data_set_default_string(settings, SPOUT_STALL_FALLBACK, "");
 }
 
 static void win_spout_source_show(void *data)
 {
-	win_spout_source_init(data, true); // When showing do forced init without delay
+	struct spout_source *context = (spout_source *)data;
+	win_spout_source_poll(context, true); // When showing do forced init without delay
 }
 
 static void win_spout_source_hide(void *data)
@@ -257,16 +674,34 @@ static uint32_t win_spout_source_getwidth(void *data)
 static uint32_t win_spout_source_getheight(void *data)
 {
 	struct spout_source *context = (spout_source *)data;
-	return context->height;
+	return (uint32_t)win_spout_source_display_height(context);
+}
+
+/**
+ * Darkens the held frame of a stalled sender by stall_fade
+ */
+static void win_spout_source_draw_fade(spout_source *context)
+{
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	struct vec4 color;
+	vec4_set(&color, 0.0f, 0.0f, 0.0f, context->stall_fade);
+	gs_effect_set_vec4(gs_effect_get_param_by_name(solid, "color"), &color);
+
+	while (gs_effect_loop(solid, "Solid")) {
+		gs_draw_sprite(nullptr, 0, context->width, win_spout_source_display_height(context));
+	}
 }
 
 static void win_spout_source_render(void *data, gs_effect_t *effect)
 {
 	struct spout_source *context = (spout_source *)data;
 
+	WIN_SPOUT_TRACE_SCOPE("win_spout_source_render");
+	WIN_SPOUT_ALLOC_SCOPE("win_spout_source_render");
+
 	// tried to initialise again
 	// but failed, so we exit
-	if (!context->initialized) {
+	if (!win_spout_receiver_connected(&context->receiver)) {
 		if (context->render_status != -1) {
 			debug("uninit'd");
 			context->render_status = -1;
@@ -286,6 +721,7 @@ static void win_spout_source_render(void *data, gs_effect_t *effect)
 		info("rendering context->texture");
 		context->render_status = 0;
 	}
+	win_spout_gpu_account_touch(context->gpu_account);
 
 	switch (context->composite_mode) {
 	case COMPOSITE_MODE_OPAQUE:
@@ -309,36 +745,129 @@ static void win_spout_source_render(void *data, gs_effect_t *effect)
 		break;
 	}
 
-	while (gs_effect_loop(effect, "Draw")) {
-		obs_source_draw(context->texture, 0, 0, 0, 0, false);
+	gs_texture_t *texture = context->texture;
+	if (context->sync_group && context->sync_texture) {
+		texture = context->sync_texture;
+	} else if (context->applied_buffer_frames && context->buffer_slot >= 0 &&
+		   context->buffer_textures[context->buffer_slot]) {
+		texture = context->buffer_textures[context->buffer_slot];
+	}
+
+	if (win_spout_source_packed(context)) {
+		if (!context->yuv_effect)
+			context->yuv_effect = win_spout_yuv_effect_create();
+		// unpacked colors are opaque, which every composite mode draws as they are
+		if (context->yuv_effect)
+			win_spout_yuv_draw(context->yuv_effect, texture,
+					   (enum win_spout_yuv_format)context->pixel_layout,
+					   (enum win_spout_yuv_matrix)context->yuv_matrix);
+	} else {
+		while (gs_effect_loop(effect, "Draw")) {
+			obs_source_draw(texture, 0, 0, 0, 0, false);
+		}
 	}
 
 	if (context->composite_mode == COMPOSITE_MODE_PREMULTIPLIED) {
 		gs_blend_state_pop();
 	}
+
+	if (context->stall_fade > 0.0f) {
+		win_spout_source_draw_fade(context);
+	}
 }
 
 /**
- * Updates sender texture details on the context
- * and works out whether any of this data has changed
- *
- * @return bool sender data has changed
+ * Receives from the fallback sender in place of the stalled one
+ */
+static void win_spout_source_fall_back(spout_source *context)
+{
+	memset(context->primary_name, 0, sizeof(context->primary_name));
+	strncpy(context->primary_name, context->receiver.sender_name, sizeof(context->primary_name) - 1);
+	context->primary_first = context->receiver.use_first_sender;
+	context->fallback_active = true;
+
+	info("Switching from stalled sender %s to fallback sender %s", context->primary_name,
+	     context->stall_fallback);
+	win_spout_source_deinit(context);
+	win_spout_receiver_set_sender(&context->receiver, context->stall_fallback);
+	win_spout_source_poll(context, true);
+}
+
+/**
+ * Goes back to the sender that stalled once it sends frames again
+ */
+static void win_spout_source_restore(spout_source *context)
+{
+	info("Switching back to sender %s", context->primary_name);
+	context->fallback_active = false;
+	win_spout_metadata_destroy(context->primary_metadata);
+	context->primary_metadata = nullptr;
+	spout_frame_count_close(&context->primary_frame_count);
+
+	win_spout_source_deinit(context);
+	win_spout_receiver_set_sender(&context->receiver, context->primary_first ? nullptr : context->primary_name);
+	win_spout_source_poll(context, true);
+}
+
+/**
+ * Feeds the watchdog with the sender's frame counter and applies the
+ * stall policy. The counter comes from the OBS metadata, or Spout's
+ * frame counter for other senders. A sender with neither can't be
+ * told apart from a static picture, so it's never considered stalled
+ * and the properties say the watchdog is inactive.
  */
-static bool win_spout_sender_has_changed(spout_source *context)
+static void win_spout_source_watch(spout_source *context, bool connected)
 {
-	DWORD oldFormat = context->dxFormat;
-	auto oldWidth = context->width;
-	auto oldHeight = context->height;
+	uint64_t now = os_gettime_ns();
+	enum win_spout_watchdog_event event;
+	const char *senderName;
+	uint64_t frame_number;
+
+	if (context->fallback_active) {
+		if (!context->primary_metadata) {
+			context->primary_metadata = win_spout_metadata_open(context->primary_name);
+		}
+		struct win_spout_frame_metadata meta;
+		if (win_spout_metadata_read(context->primary_metadata, &meta)) {
+			frame_number = meta.frame_number;
+		} else if (!spout_frame_count_read(&context->primary_frame_count, context->primary_name, now,
+						   &frame_number)) {
+			frame_number = context->watchdog.frame_number;
+		}
+		event = win_spout_watchdog_update(&context->watchdog, frame_number, now);
+		senderName = context->primary_name;
+	} else if (connected && context->metadata) {
+		event = win_spout_watchdog_update(&context->watchdog, context->last_frame_number, now);
+		senderName = context->receiver.sender_name;
+	} else if (connected &&
+		   spout_frame_count_read(&context->frame_count, context->receiver.sender_name, now, &frame_number)) {
+		event = win_spout_watchdog_update(&context->watchdog, frame_number, now);
+		senderName = context->receiver.sender_name;
+	} else {
+		os_atomic_set_long(&context->watch_active, 0);
+		return;
+	}
+	os_atomic_set_long(&context->watch_active, 1);
 
-	if (!win_spout_source_store_sender_info(context)) {
-		// assume that if it fails, it has changed
-		// ie sender no longer exists
-		return true;
+	if (event == WIN_SPOUT_WATCHDOG_STALLED) {
+		warn("Sender %s stalled, no new frame for %llu ms", senderName,
+		     (unsigned long long)(context->watchdog.timeout_ns / 1000000));
+		if (context->stall_policy == WIN_SPOUT_STALL_FALLBACK && *context->stall_fallback) {
+			win_spout_source_fall_back(context);
+		}
+	} else if (event == WIN_SPOUT_WATCHDOG_RESUMED) {
+		info("Sender %s resumed after %llu ms", senderName,
+		     (unsigned long long)(context->watchdog.last_stall_ns / 1000000));
+		if (context->fallback_active) {
+			win_spout_source_restore(context);
+		}
 	}
-	if (context->width != oldWidth || context->height != oldHeight || oldFormat != context->dxFormat) {
-		return true;
+
+	context->stall_fade = 0.0f;
+	if (context->stall_policy == WIN_SPOUT_STALL_FADE && context->watchdog.stalled) {
+		uint64_t fading = win_spout_watchdog_stall_time(&context->watchdog, now) - context->watchdog.timeout_ns;
+		context->stall_fade = fading >= STALL_FADE_NS ? 1.0f : (float)fading / (float)STALL_FADE_NS;
 	}
-	return false;
 }
 
 static void win_spout_source_tick(void *data, float seconds)
@@ -347,24 +876,53 @@ static void win_spout_source_tick(void *data, float seconds)
 
 	struct spout_source *context = (spout_source *)data;
 
-	if (win_spout_sender_has_changed(context)) {
-		if (context->tick_status != -1) {
-			info("Sender %s has changed / gone away. Resetting ", context->senderName);
-			context->tick_status = -1;
-		}
-		context->initialized = false;
-		win_spout_source_deinit(data);
-		win_spout_source_init(data);
-		return;
+	WIN_SPOUT_TRACE_SCOPE("win_spout_source_tick");
+	WIN_SPOUT_ALLOC_SCOPE("win_spout_source_tick");
+
+	// while rebinding the last frame is held as it is
+	bool connected = win_spout_source_poll(context, false);
+
+	uint64_t timestamp = 0;
+	bool new_frame = context->metadata && win_spout_source_read_metadata(context, timestamp);
+
+	win_spout_source_watch(context, connected);
+
+	// the local copies are made again on the next buffered or synced frame
+	if (win_spout_gpu_account_evict_requested(context->gpu_account)) {
+		win_spout_source_release_buffer(context);
+		obs_enter_graphics();
+		gs_texture_destroy(context->sync_texture);
+		context->sync_texture = NULL;
+		obs_leave_graphics();
+		win_spout_source_account(context);
 	}
-	if (!context->initialized) {
-		if (context->tick_status != -2) {
-			context->tick_status = -2;
+
+	int buffer_frames = (int)os_atomic_load_long(&context->buffer_frames);
+	if (buffer_frames != context->applied_buffer_frames) {
+		win_spout_source_release_buffer(context);
+		uint64_t frame_time = video_output_get_frame_time(obs_get_video());
+		win_spout_jitter_init(&context->jitter, buffer_frames + 2, (uint64_t)buffer_frames * frame_time);
+		context->applied_buffer_frames = buffer_frames;
+	}
+
+	if (buffer_frames && connected && context->texture) {
+		// without sender metadata we can't tell new frames apart, so
+		// sample the shared texture every tick
+		if (!context->metadata) {
+			new_frame = true;
+			timestamp = os_gettime_ns();
+		}
+		if (new_frame) {
+			win_spout_source_buffer_frame(context, timestamp);
 		}
-		win_spout_source_init(data);
+		context->buffer_slot = win_spout_jitter_present(&context->jitter, obs_get_video_frame_time());
 	}
-	if (context->tick_status != 0) {
-		context->tick_status = 0;
+
+	win_spout_sync_publish(context->sync_group, context, context->metadata ? context->sync_timestamp : 0);
+	if (context->sync_group && connected && context->texture &&
+	    win_spout_sync_ready(context->sync_group, obs_get_video_frame_time(),
+				 video_output_get_frame_time(obs_get_video()))) {
+		win_spout_source_copy_texture(context, &context->sync_texture);
 	}
 }
 
@@ -417,6 +975,25 @@ static obs_properties_t *win_spout_properties(void *data)
 	obs_property_list_add_int(tick_speed_limit_list, obs_module_text("tickspeednormal"), 500);
 	obs_property_list_add_int(tick_speed_limit_list, obs_module_text("tickspeedslow"), 1000);
 
+	obs_properties_add_int(props, SPOUT_BUFFER_FRAMES, obs_module_text("bufferframes"), 0,
+			       WIN_SPOUT_JITTER_MAX_SLOTS - 2, 1);
+
+	obs_properties_add_text(props, SPOUT_SYNC_GROUP, obs_module_text("syncgroup"), OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, SPOUT_SYNC_MAX_WAIT, obs_module_text("syncmaxwait"), 0, 1000, 1);
+
+	obs_properties_add_int(props, SPOUT_STALL_TIMEOUT, obs_module_text("stalltimeout"), 0, 60000, 100);
+	obs_property_t *stall_policy_list = obs_properties_add_list(props, SPOUT_STALL_POLICY,
+								    obs_module_text("stallpolicy"), OBS_COMBO_TYPE_LIST,
+								    OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(stall_policy_list, obs_module_text("stallpolicyhold"), WIN_SPOUT_STALL_HOLD);
+	obs_property_list_add_int(stall_policy_list, obs_module_text("stallpolicyfade"), WIN_SPOUT_STALL_FADE);
+	obs_property_list_add_int(stall_policy_list, obs_module_text("stallpolicyfallback"), WIN_SPOUT_STALL_FALLBACK);
+	obs_properties_add_text(props, SPOUT_STALL_FALLBACK, obs_module_text("stallfallback"), OBS_TEXT_DEFAULT);
+	if (win_spout_receiver_connected(&context->receiver) && context->watchdog.timeout_ns &&
+	    !os_atomic_load_long(&context->watch_active)) {
+		obs_properties_add_text(props, "stallinactive", obs_module_text("stallinactive"), OBS_TEXT_INFO);
+	}
+
 	return props;
 }
 
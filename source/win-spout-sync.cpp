@@ -0,0 +1,199 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-sync.h"
+
+struct sync_member {
+	void *member;
+	// 0 until the member publishes a frame with metadata
+	uint64_t timestamp;
+};
+
+struct win_spout_sync_group {
+	char *name;
+	DARRAY(struct sync_member) members;
+	uint64_t max_wait_ns;
+	// members left out of the last check for having no metadata, logged when it changes
+	size_t untimed;
+
+	// result for the current video frame
+	uint64_t last_video_time;
+	bool ready;
+	uint64_t wait_start;
+
+	struct win_spout_sync_stats stats;
+};
+
+// guards the group list and everything inside the groups
+static pthread_mutex_t groups_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct win_spout_sync_group *) groups;
+
+struct win_spout_sync_group *win_spout_sync_join(const char *name, void *member, uint64_t max_wait_ns)
+{
+	if (!name || !*name) {
+		return nullptr;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+
+	struct win_spout_sync_group *group = nullptr;
+	for (size_t i = 0; i < groups.num; i++) {
+		if (strcmp(groups.array[i]->name, name) == 0) {
+			group = groups.array[i];
+			break;
+		}
+	}
+
+	if (!group) {
+		group = (win_spout_sync_group *)bzalloc(sizeof(win_spout_sync_group));
+		group->name = bstrdup(name);
+		da_push_back(groups, &group);
+		blog(LOG_INFO, "Created sync group %s", name);
+	}
+
+	struct sync_member entry = {member, 0};
+	da_push_back(group->members, &entry);
+	group->max_wait_ns = max_wait_ns;
+
+	pthread_mutex_unlock(&groups_mutex);
+	return group;
+}
+
+void win_spout_sync_leave(struct win_spout_sync_group *group, void *member)
+{
+	if (!group) {
+		return;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+
+	for (size_t i = 0; i < group->members.num; i++) {
+		if (group->members.array[i].member == member) {
+			da_erase(group->members, i);
+			break;
+		}
+	}
+
+	if (!group->members.num) {
+		blog(LOG_INFO, "Sync group %s: %llu aligned, %llu misses (%llu ms waited)", group->name,
+		     (unsigned long long)group->stats.aligned, (unsigned long long)group->stats.misses,
+		     (unsigned long long)(group->stats.miss_wait_ns / 1000000));
+		da_erase_item(groups, &group);
+		da_free(group->members);
+		bfree(group->name);
+		bfree(group);
+	}
+
+	pthread_mutex_unlock(&groups_mutex);
+}
+
+void win_spout_sync_publish(struct win_spout_sync_group *group, void *member, uint64_t timestamp)
+{
+	if (!group) {
+		return;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+	for (size_t i = 0; i < group->members.num; i++) {
+		if (group->members.array[i].member == member) {
+			group->members.array[i].timestamp = timestamp;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&groups_mutex);
+}
+
+void win_spout_sync_set_max_wait(struct win_spout_sync_group *group, uint64_t max_wait_ns)
+{
+	if (!group) {
+		return;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+	group->max_wait_ns = max_wait_ns;
+	pthread_mutex_unlock(&groups_mutex);
+}
+
+static bool win_spout_sync_aligned(struct win_spout_sync_group *group, uint64_t tolerance)
+{
+	uint64_t min_time = UINT64_MAX;
+	uint64_t max_time = 0;
+	size_t untimed = 0;
+	for (size_t i = 0; i < group->members.num; i++) {
+		uint64_t timestamp = group->members.array[i].timestamp;
+		if (!timestamp) {
+			untimed++;
+			continue;
+		}
+		min_time = timestamp < min_time ? timestamp : min_time;
+		max_time = timestamp > max_time ? timestamp : max_time;
+	}
+
+	if (untimed != group->untimed) {
+		blog(LOG_INFO, "Sync group %s: %zu of %zu members have no frame metadata and aren't aligned",
+		     group->name, untimed, group->members.num);
+		group->untimed = untimed;
+	}
+
+	// nothing timed to wait for
+	if (untimed == group->members.num) {
+		return true;
+	}
+	return max_time - min_time <= tolerance;
+}
+
+bool win_spout_sync_ready(struct win_spout_sync_group *group, uint64_t video_time, uint64_t frame_time)
+{
+	if (!group) {
+		return true;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+
+	if (group->last_video_time != video_time) {
+		group->last_video_time = video_time;
+
+		if (win_spout_sync_aligned(group, frame_time / 2)) {
+			group->ready = true;
+			group->wait_start = 0;
+			group->stats.aligned++;
+		} else if (!group->wait_start) {
+			group->ready = false;
+			group->wait_start = video_time;
+		} else if (video_time - group->wait_start >= group->max_wait_ns) {
+			// waited long enough, present what we have
+			group->ready = true;
+			group->stats.misses++;
+			group->stats.miss_wait_ns += video_time - group->wait_start;
+			group->wait_start = 0;
+		} else {
+			group->ready = false;
+		}
+	}
+
+	bool ready = group->ready;
+	pthread_mutex_unlock(&groups_mutex);
+	return ready;
+}
+
+void win_spout_sync_get_stats(struct win_spout_sync_group *group, struct win_spout_sync_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if (!group) {
+		return;
+	}
+
+	pthread_mutex_lock(&groups_mutex);
+	*stats = group->stats;
+	pthread_mutex_unlock(&groups_mutex);
+}
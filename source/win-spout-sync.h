@@ -0,0 +1,52 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTSYNC_H
+#define WINSPOUTSYNC_H
+
+#include <stdint.h>
+
+/**
+ * Named groups of receivers that only latch a new frame once every
+ * member's sender is on the same frame, going by the OBS video timestamp
+ * in the frame metadata. Senders on the same OBS instance stamp a frame
+ * with the same time, others match if they're within half a video frame.
+ * If they don't line up within max_wait_ns the group presents anyway
+ * and counts an alignment miss.
+ *
+ * Members whose sender publishes no metadata have nothing to align on,
+ * so they don't hold the group up: they're left out of the comparison
+ * and a group without any timed member is always ready.
+ *
+ * Each member publishes the timestamp of the frame it holds from its own
+ * tick, the group only compares the published values under its lock and
+ * never reaches into a member, which may be updating or going away.
+ */
+
+struct win_spout_sync_stats {
+	uint64_t aligned;
+	uint64_t misses;
+	uint64_t miss_wait_ns;
+};
+
+struct win_spout_sync_group;
+
+// A member that joins is untimed until it publishes
+struct win_spout_sync_group *win_spout_sync_join(const char *name, void *member, uint64_t max_wait_ns);
+void win_spout_sync_leave(struct win_spout_sync_group *group, void *member);
+// The OBS timestamp of the member's current frame, 0 if it has none (no metadata)
+void win_spout_sync_publish(struct win_spout_sync_group *group, void *member, uint64_t timestamp);
+// The group's wait, shared by its members, the last one set applies
+void win_spout_sync_set_max_wait(struct win_spout_sync_group *group, uint64_t max_wait_ns);
+
+// Evaluated once per video frame of frame_time ns, every member gets the same answer
+bool win_spout_sync_ready(struct win_spout_sync_group *group, uint64_t video_time, uint64_t frame_time);
+void win_spout_sync_get_stats(struct win_spout_sync_group *group, struct win_spout_sync_stats *stats);
+
+#endif // WINSPOUTSYNC_H
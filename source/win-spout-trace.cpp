@@ -0,0 +1,88 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "win-spout-trace.h"
+
+#ifdef WIN_SPOUT_ENABLE_TRACE
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include <windows.h>
+#include "win-spout.h"
+
+#define TRACE_FILE "trace.json"
+// ~40MB of events, further spans still reach OBS's profiler
+#define TRACE_MAX_EVENTS 1000000
+
+struct trace_event {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+	DWORD tid;
+};
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct trace_event) trace_events;
+static uint64_t trace_origin;
+
+void win_spout_trace_begin(const char *name, uint64_t *start)
+{
+	profile_start(name);
+	*start = os_gettime_ns();
+}
+
+void win_spout_trace_end(const char *name, uint64_t start)
+{
+	uint64_t end = os_gettime_ns();
+	profile_end(name);
+
+	struct trace_event event = {name, start, end - start, GetCurrentThreadId()};
+
+	pthread_mutex_lock(&trace_mutex);
+	if (!trace_origin)
+		trace_origin = start;
+	if (trace_events.num < TRACE_MAX_EVENTS)
+		da_push_back(trace_events, &event);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void win_spout_trace_flush()
+{
+	pthread_mutex_lock(&trace_mutex);
+
+	char *path = obs_module_config_path(TRACE_FILE);
+	FILE *file = path ? os_fopen(path, "wb") : NULL;
+	if (!file) {
+		blog(LOG_WARNING, "Unable to write trace to %s", path ? path : TRACE_FILE);
+	} else {
+		DWORD pid = GetCurrentProcessId();
+		fputs("{\"traceEvents\":[\n", file);
+		for (size_t i = 0; i < trace_events.num; i++) {
+			struct trace_event *event = &trace_events.array[i];
+			// Chrome traces are in microseconds
+			fprintf(file,
+				"%s{\"name\":\"%s\",\"cat\":\"win_spout\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+				"\"pid\":%lu,\"tid\":%lu}\n",
+				i ? "," : "", event->name, (double)(int64_t)(event->start - trace_origin) / 1000.0,
+				(double)event->duration / 1000.0, pid, event->tid);
+		}
+		fputs("]}\n", file);
+		fclose(file);
+		blog(LOG_INFO, "Wrote %zu trace events to %s", trace_events.num, path);
+	}
+	bfree(path);
+
+	da_free(trace_events);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+#endif // WIN_SPOUT_ENABLE_TRACE
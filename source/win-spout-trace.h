@@ -0,0 +1,51 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTTRACE_H
+#define WINSPOUTTRACE_H
+
+/**
+ * Optional tracing of the plugin's hot paths, enabled with the ENABLE_TRACING
+ * build option. Spans show up in OBS's profiler and are written out as a
+ * Chrome trace (chrome://tracing, Perfetto) to the plugin config directory
+ * on unload. Compiled out completely otherwise.
+ *
+ * Span names must be string literals, OBS's profiler keeps the pointer.
+ */
+#ifdef WIN_SPOUT_ENABLE_TRACE
+
+#include <stdint.h>
+
+void win_spout_trace_begin(const char *name, uint64_t *start);
+void win_spout_trace_end(const char *name, uint64_t start);
+void win_spout_trace_flush();
+
+class win_spout_trace_scope {
+public:
+	explicit win_spout_trace_scope(const char *name) : name(name) { win_spout_trace_begin(name, &start); }
+	~win_spout_trace_scope() { win_spout_trace_end(name, start); }
+
+private:
+	const char *name;
+	uint64_t start;
+};
+
+#define WIN_SPOUT_TRACE_CONCAT_(a, b) a##b
+#define WIN_SPOUT_TRACE_CONCAT(a, b) WIN_SPOUT_TRACE_CONCAT_(a, b)
+#define WIN_SPOUT_TRACE_SCOPE(name) win_spout_trace_scope WIN_SPOUT_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define WIN_SPOUT_TRACE_FLUSH() win_spout_trace_flush()
+
+#else
+
+#define WIN_SPOUT_TRACE_SCOPE(name) ((void)0)
+#define WIN_SPOUT_TRACE_FLUSH() ((void)0)
+
+#endif // WIN_SPOUT_ENABLE_TRACE
+
+#endif // WINSPOUTTRACE_H
@@ -0,0 +1,406 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "win-spout.h"
+#include "win-spout-metadata.h"
+#include "win-spout-render.h"
+#include "win-spout-view-sender.h"
+#include "win-spout-yuv.h"
+
+#include "SpoutDX.h"
+
+struct win_spout_view_sender {
+	char *sender_name;
+	uint32_t width;
+	uint32_t height;
+	uint32_t divisor;
+	// packed NV12 / P010 rather than BGRA
+	enum win_spout_yuv_format yuv_format;
+	enum win_spout_yuv_matrix yuv_matrix;
+
+	// the view keeps the source active while it's being sent. Without
+	// one (the preview sender) the source is only marked as showing and
+	// rendered directly, so it isn't activated as if it were on program.
+	obs_view_t *view;
+
+	// [SHARED] shown source when there's no view, guarded by mutex
+	pthread_mutex_t mutex;
+	obs_source_t *source;
+
+	// [RENDER] only accessed on the render thread after creation
+	spoutDX *sender;
+	gs_texrender_t *texrender_intermediate;
+	gs_texrender_t *texrender_curr;
+	gs_texrender_t *texrender_prev;
+	gs_texrender_t *texrender_rgb;
+	gs_effect_t *yuv_effect;
+	struct win_spout_metadata *metadata;
+	// metadata of the frame in texrender_prev, published when that is sent
+	struct win_spout_frame_metadata meta_prev;
+	uint64_t frame_count;
+	uint64_t frame_number;
+	bool is_initialised;
+	bool init_failed;
+};
+
+static bool win_spout_view_sender_init(struct win_spout_view_sender *context)
+{
+	if (context->is_initialised) {
+		return true;
+	}
+	if (context->init_failed) {
+		return false;
+	}
+
+	context->texrender_intermediate = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	if (context->yuv_format != WIN_SPOUT_YUV_NONE) {
+		context->yuv_effect = win_spout_yuv_effect_create();
+		if (!context->yuv_effect) {
+			context->init_failed = true;
+			return false;
+		}
+		enum gs_color_format format = win_spout_yuv_texture_format(context->yuv_format);
+		context->texrender_rgb = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
+		context->texrender_curr = gs_texrender_create(format, GS_ZS_NONE);
+		context->texrender_prev = gs_texrender_create(format, GS_ZS_NONE);
+	} else {
+		context->texrender_curr = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
+		context->texrender_prev = gs_texrender_create(GS_BGRA_UNORM, GS_ZS_NONE);
+	}
+
+	context->sender = new spoutDX;
+	context->sender->SetMaxSenders(255);
+
+	// Share OBS's device, same as the filter
+	ID3D11Device *const d3d_device = (ID3D11Device *)gs_get_device_obj();
+	if (!d3d_device || !context->sender->OpenDirectX11(d3d_device)) {
+		blog(LOG_ERROR, "Failed to Open DX11 for sender %s", context->sender_name);
+		context->init_failed = true;
+		return false;
+	}
+
+	context->sender->SetSenderName(context->sender_name);
+	context->metadata = win_spout_metadata_create(context->sender_name);
+	context->is_initialised = true;
+	return true;
+}
+
+// Returns a reference to the source being sent, nullptr if there's none
+static obs_source_t *win_spout_view_sender_get_source(struct win_spout_view_sender *context)
+{
+	if (context->view) {
+		return obs_view_get_source(context->view, 0);
+	}
+
+	pthread_mutex_lock(&context->mutex);
+	obs_source_t *source = obs_source_get_ref(context->source);
+	pthread_mutex_unlock(&context->mutex);
+	return source;
+}
+
+static void win_spout_view_sender_render(void *data, uint32_t cx, uint32_t cy)
+{
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+	struct win_spout_view_sender *context = (win_spout_view_sender *)data;
+
+	obs_source_t *source = win_spout_view_sender_get_source(context);
+	if (!source) {
+		return;
+	}
+
+	uint32_t base_width = obs_source_get_base_width(source);
+	uint32_t base_height = obs_source_get_base_height(source);
+
+	struct win_spout_frame_metadata meta = {};
+	strncpy(meta.scene_name, obs_source_get_name(source), sizeof(meta.scene_name) - 1);
+
+	if (context->frame_count++ % context->divisor != 0 || !base_width || !base_height ||
+	    !win_spout_view_sender_init(context)) {
+		obs_source_release(source);
+		return;
+	}
+
+	uint32_t width = context->width ? context->width : base_width;
+	uint32_t height = context->height ? context->height : base_height;
+	if (context->yuv_format != WIN_SPOUT_YUV_NONE) {
+		width = win_spout_yuv_even(width);
+		height = win_spout_yuv_even(height);
+		meta.pixel_layout = context->yuv_format;
+		meta.yuv_matrix = context->yuv_matrix;
+	}
+
+	meta.obs_timestamp = obs_get_video_frame_time();
+	struct obs_video_info ovi;
+	if (obs_get_video_info(&ovi)) {
+		meta.fps_num = ovi.fps_num;
+		meta.fps_den = ovi.fps_den;
+	}
+
+	// Render the view in sRGB-aware format, scaling to the output size
+	gs_texrender_reset(context->texrender_intermediate);
+	if (gs_texrender_begin(context->texrender_intermediate, width, height)) {
+		struct vec4 background;
+		vec4_zero(&background);
+
+		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+		gs_ortho(0.0f, (float)base_width, 0.0f, (float)base_height, -100.0f, 100.0f);
+
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+		if (context->view) {
+			obs_view_render(context->view);
+		} else {
+			obs_source_video_render(source);
+		}
+
+		gs_blend_state_pop();
+		gs_texrender_end(context->texrender_intermediate);
+	}
+	obs_source_release(source);
+
+	struct win_spout_region region = {};
+	win_spout_region_clamp(&region, width, height);
+
+	gs_texture_t *tex = gs_texrender_get_texture(context->texrender_intermediate);
+	if (context->yuv_format != WIN_SPOUT_YUV_NONE) {
+		if (!win_spout_render_to_spout(context->texrender_rgb, tex, &region, width, height) ||
+		    !win_spout_yuv_render(context->texrender_curr, context->yuv_effect,
+					  gs_texrender_get_texture(context->texrender_rgb), context->yuv_format,
+					  context->yuv_matrix)) {
+			return;
+		}
+	} else if (!win_spout_render_to_spout(context->texrender_curr, tex, &region, width, height)) {
+		return;
+	}
+
+	// Double-buffered, as in the filter
+	gs_texture_t *prev_tex = gs_texrender_get_texture(context->texrender_prev);
+	if (prev_tex) {
+		if (!context->sender->SendTexture((ID3D11Texture2D *)gs_texture_get_obj(prev_tex))) {
+			blog(LOG_ERROR, "Error calling SendTexture() for %s!", context->sender_name);
+		}
+
+		context->meta_prev.frame_number = ++context->frame_number;
+		context->meta_prev.send_time = os_gettime_ns();
+		win_spout_metadata_write(context->metadata, &context->meta_prev);
+	}
+
+	gs_texrender_t *tmp = context->texrender_prev;
+	context->texrender_prev = context->texrender_curr;
+	context->texrender_curr = tmp;
+	context->meta_prev = meta;
+}
+
+struct win_spout_view_sender *win_spout_view_sender_create(const char *sender_name, uint32_t width, uint32_t height,
+							   uint32_t divisor, enum win_spout_yuv_format yuv_format,
+							   enum win_spout_yuv_matrix yuv_matrix, bool activate)
+{
+	struct win_spout_view_sender *context = (win_spout_view_sender *)bzalloc(sizeof(win_spout_view_sender));
+	context->sender_name = bstrdup(sender_name);
+	context->width = width;
+	context->height = height;
+	context->divisor = divisor ? divisor : 1;
+	context->yuv_format = yuv_format;
+	context->yuv_matrix = yuv_matrix;
+	context->view = activate ? obs_view_create() : nullptr;
+	pthread_mutex_init_value(&context->mutex);
+	pthread_mutex_init(&context->mutex, NULL);
+
+	obs_add_main_render_callback(win_spout_view_sender_render, context);
+	return context;
+}
+
+void win_spout_view_sender_destroy(struct win_spout_view_sender *context)
+{
+	if (!context) {
+		return;
+	}
+
+	obs_remove_main_render_callback(win_spout_view_sender_render, context);
+
+	win_spout_view_sender_set_source(context, nullptr);
+	obs_view_destroy(context->view);
+	pthread_mutex_destroy(&context->mutex);
+
+	obs_enter_graphics();
+	if (context->sender) {
+		context->sender->ReleaseSender();
+		context->sender->CloseDirectX11();
+		delete context->sender;
+	}
+	gs_texrender_destroy(context->texrender_intermediate);
+	gs_texrender_destroy(context->texrender_curr);
+	gs_texrender_destroy(context->texrender_prev);
+	gs_texrender_destroy(context->texrender_rgb);
+	gs_effect_destroy(context->yuv_effect);
+	obs_leave_graphics();
+
+	win_spout_metadata_destroy(context->metadata);
+	bfree(context->sender_name);
+	bfree(context);
+}
+
+void win_spout_view_sender_set_source(struct win_spout_view_sender *context, obs_source_t *source)
+{
+	if (context->view) {
+		obs_view_set_source(context->view, 0, source);
+		return;
+	}
+
+	source = obs_source_get_ref(source);
+	if (source) {
+		obs_source_inc_showing(source);
+	}
+
+	pthread_mutex_lock(&context->mutex);
+	obs_source_t *prev = context->source;
+	context->source = source;
+	pthread_mutex_unlock(&context->mutex);
+
+	if (prev) {
+		obs_source_dec_showing(prev);
+		obs_source_release(prev);
+	}
+}
+
+/**
+ * Creates a sender from "Sender[:WIDTHxHEIGHT[:divisor[:nv12|p010[:709|2020]]]]", modifies str
+ */
+static struct win_spout_view_sender *win_spout_view_sender_parse(char *str, bool activate)
+{
+	uint32_t width = 0, height = 0, divisor = 1;
+	enum win_spout_yuv_format yuv_format = WIN_SPOUT_YUV_NONE;
+	enum win_spout_yuv_matrix yuv_matrix = WIN_SPOUT_YUV_709;
+	char *options = strchr(str, ':');
+	if (options) {
+		*options++ = '\0';
+		if (sscanf(options, "%ux%u:%u", &width, &height, &divisor) < 2) {
+			width = height = 0;
+		}
+
+		// the format and matrix follow the divisor
+		char *format = strchr(options, ':');
+		format = format ? strchr(format + 1, ':') : nullptr;
+		if (format) {
+			*format++ = '\0';
+			char *matrix = strchr(format, ':');
+			if (matrix)
+				*matrix++ = '\0';
+			if (!win_spout_yuv_parse_format(format, &yuv_format) && _stricmp(format, "bgra") != 0)
+				blog(LOG_WARNING, "Unknown format %s for sender %s, sending BGRA", format, str);
+			if (matrix && !win_spout_yuv_parse_matrix(matrix, &yuv_matrix))
+				blog(LOG_WARNING, "Unknown matrix %s for sender %s, using Rec. 709", matrix, str);
+		}
+	}
+
+	if (!*str)
+		return nullptr;
+
+	return win_spout_view_sender_create(str, width, height, divisor, yuv_format, yuv_matrix, activate);
+}
+
+struct scene_sender {
+	char *scene_name;
+	struct win_spout_view_sender *sender;
+};
+
+static DARRAY(struct scene_sender) scene_senders;
+
+void win_spout_scene_senders_load(const char *config)
+{
+	win_spout_scene_senders_unload();
+
+	char *buf = bstrdup(config);
+	char *save = NULL;
+	for (char *entry = strtok_s(buf, ";\r\n", &save); entry; entry = strtok_s(NULL, ";\r\n", &save)) {
+		char *sender_name = strchr(entry, '=');
+		if (!sender_name)
+			continue;
+		*sender_name++ = '\0';
+
+		if (!*entry)
+			continue;
+
+		struct scene_sender item;
+		item.sender = win_spout_view_sender_parse(sender_name, true);
+		if (!item.sender)
+			continue;
+		item.scene_name = bstrdup(entry);
+		da_push_back(scene_senders, &item);
+
+		blog(LOG_INFO, "Sending scene %s as %s", item.scene_name, sender_name);
+	}
+	bfree(buf);
+
+	win_spout_scene_senders_refresh();
+}
+
+void win_spout_scene_senders_refresh()
+{
+	for (size_t i = 0; i < scene_senders.num; i++) {
+		struct scene_sender *item = &scene_senders.array[i];
+		obs_source_t *source = obs_get_source_by_name(item->scene_name);
+		win_spout_view_sender_set_source(item->sender, source);
+		obs_source_release(source);
+	}
+}
+
+void win_spout_scene_senders_unload()
+{
+	for (size_t i = 0; i < scene_senders.num; i++) {
+		win_spout_view_sender_destroy(scene_senders.array[i].sender);
+		bfree(scene_senders.array[i].scene_name);
+	}
+	da_free(scene_senders);
+}
+
+static struct win_spout_view_sender *preview_sender;
+
+void win_spout_preview_sender_load(const char *config)
+{
+	win_spout_preview_sender_unload();
+
+	char *buf = bstrdup(config);
+	// preview isn't program, so its scene is only shown
+	preview_sender = win_spout_view_sender_parse(buf, false);
+	bfree(buf);
+
+	if (preview_sender) {
+		blog(LOG_INFO, "Sending studio mode preview as %s", preview_sender->sender_name);
+	}
+
+	win_spout_preview_sender_refresh();
+}
+
+void win_spout_preview_sender_refresh()
+{
+	if (!preview_sender) {
+		return;
+	}
+
+	// Outside studio mode there's no preview scene, so nothing is shown
+	// and the render callback returns straight away
+	obs_source_t *source = obs_frontend_preview_program_mode_active() ? obs_frontend_get_current_preview_scene()
+									   : nullptr;
+	win_spout_view_sender_set_source(preview_sender, source);
+	obs_source_release(source);
+}
+
+void win_spout_preview_sender_unload()
+{
+	win_spout_view_sender_destroy(preview_sender);
+	preview_sender = nullptr;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTVIEWSENDER_H
+#define WINSPOUTVIEWSENDER_H
+
+#include <obs-module.h>
+#include "win-spout-yuv.h"
+
+/**
+ * Sends any source (typically a scene) from the main render callback,
+ * independent of what is on program.
+ * width / height of 0 send at the source's size, divisor sends every Nth frame,
+ * yuv_format other than WIN_SPOUT_YUV_NONE sends packed NV12 / P010.
+ * activate renders through the sender's own obs_view, which activates the
+ * source as program would; otherwise it's only shown and rendered directly.
+ */
+struct win_spout_view_sender;
+
+struct win_spout_view_sender *win_spout_view_sender_create(const char *sender_name, uint32_t width, uint32_t height,
+							   uint32_t divisor, enum win_spout_yuv_format yuv_format,
+							   enum win_spout_yuv_matrix yuv_matrix, bool activate);
+void win_spout_view_sender_destroy(struct win_spout_view_sender *sender);
+
+// nullptr stops sending until a source is set again
+void win_spout_view_sender_set_source(struct win_spout_view_sender *sender, obs_source_t *source);
+
+/**
+ * Scene senders configured as "Scene=Sender[:WIDTHxHEIGHT[:divisor[:nv12|p010[:709|2020]]]]",
+ * separated by semicolons
+ */
+void win_spout_scene_senders_load(const char *config);
+// (re)binds the configured scenes by name, eg. after a scene collection change
+void win_spout_scene_senders_refresh();
+void win_spout_scene_senders_unload();
+
+/**
+ * Studio mode preview sender configured as "Sender[:WIDTHxHEIGHT[:divisor[:nv12|p010[:709|2020]]]]",
+ * follows the preview scene and sends nothing outside studio mode
+ */
+void win_spout_preview_sender_load(const char *config);
+void win_spout_preview_sender_refresh();
+void win_spout_preview_sender_unload();
+
+#endif // WINSPOUTVIEWSENDER_H
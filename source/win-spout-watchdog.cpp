@@ -0,0 +1,69 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <string.h>
+#include "win-spout-watchdog.h"
+
+void win_spout_watchdog_init(struct win_spout_watchdog *watchdog, uint64_t timeout_ns)
+{
+	memset(watchdog, 0, sizeof(*watchdog));
+	watchdog->timeout_ns = timeout_ns;
+}
+
+void win_spout_watchdog_reset(struct win_spout_watchdog *watchdog)
+{
+	watchdog->frame_number = 0;
+	watchdog->last_change = 0;
+	watchdog->stalled = false;
+}
+
+enum win_spout_watchdog_event win_spout_watchdog_update(struct win_spout_watchdog *watchdog, uint64_t frame_number,
+							uint64_t now)
+{
+	if (!watchdog->last_change || frame_number != watchdog->frame_number) {
+		uint64_t stall_time = win_spout_watchdog_stall_time(watchdog, now);
+		bool was_stalled = watchdog->stalled;
+
+		watchdog->frame_number = frame_number;
+		watchdog->last_change = now;
+		watchdog->stalled = false;
+
+		if (!was_stalled) {
+			return WIN_SPOUT_WATCHDOG_NONE;
+		}
+		watchdog->last_stall_ns = stall_time;
+		watchdog->stall_total_ns += stall_time;
+		if (stall_time > watchdog->stall_max_ns) {
+			watchdog->stall_max_ns = stall_time;
+		}
+		return WIN_SPOUT_WATCHDOG_RESUMED;
+	}
+
+	if (watchdog->stalled || !watchdog->timeout_ns || now - watchdog->last_change < watchdog->timeout_ns) {
+		return WIN_SPOUT_WATCHDOG_NONE;
+	}
+
+	watchdog->stalled = true;
+	watchdog->stalls++;
+	return WIN_SPOUT_WATCHDOG_STALLED;
+}
+
+bool win_spout_send_watch_record(struct win_spout_send_watch *watch, uint64_t duration_ns)
+{
+	watch->sends++;
+	if (!watch->budget_ns || duration_ns <= watch->budget_ns) {
+		return false;
+	}
+
+	watch->over_budget++;
+	if (duration_ns > watch->over_budget_max_ns) {
+		watch->over_budget_max_ns = duration_ns;
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTWATCHDOG_H
+#define WINSPOUTWATCHDOG_H
+
+#include <stdint.h>
+
+/**
+ * Stall detection for both ends of a sender.
+ *
+ * Receivers feed the sender's frame counter every tick and the watchdog
+ * reports when it hasn't moved for longer than the timeout, so a hung
+ * sender isn't mistaken for a static picture forever. Senders time each
+ * send against a budget so that sends which block the render thread show
+ * up in the log and stats.
+ */
+enum win_spout_stall_policy {
+	WIN_SPOUT_STALL_HOLD,	  // keep showing the last frame
+	WIN_SPOUT_STALL_FADE,	  // fade the last frame to black
+	WIN_SPOUT_STALL_FALLBACK, // receive from the fallback sender until it resumes
+};
+
+enum win_spout_watchdog_event {
+	WIN_SPOUT_WATCHDOG_NONE,
+	WIN_SPOUT_WATCHDOG_STALLED,
+	WIN_SPOUT_WATCHDOG_RESUMED,
+};
+
+struct win_spout_watchdog {
+	uint64_t timeout_ns;
+	uint64_t frame_number;
+	uint64_t last_change;
+	bool stalled;
+
+	// stats
+	uint64_t stalls;
+	uint64_t stall_total_ns;
+	uint64_t stall_max_ns;
+	uint64_t last_stall_ns;
+};
+
+struct win_spout_send_watch {
+	uint64_t budget_ns;
+
+	// stats
+	uint64_t sends;
+	uint64_t over_budget;
+	uint64_t over_budget_max_ns;
+};
+
+void win_spout_watchdog_init(struct win_spout_watchdog *watchdog, uint64_t timeout_ns);
+
+// Forgets the current frame counter, keeping the stats
+void win_spout_watchdog_reset(struct win_spout_watchdog *watchdog);
+
+// Feeds the sender's frame counter at time now, a timeout of 0 never stalls
+enum win_spout_watchdog_event win_spout_watchdog_update(struct win_spout_watchdog *watchdog, uint64_t frame_number,
+							uint64_t now);
+
+// How long the sender has been stalled for, 0 if it isn't
+static inline uint64_t win_spout_watchdog_stall_time(const struct win_spout_watchdog *watchdog, uint64_t now)
+{
+	return watchdog->stalled && now > watchdog->last_change ? now - watchdog->last_change : 0;
+}
+
+// Records how long a send took, returns true if it went over budget
+bool win_spout_send_watch_record(struct win_spout_send_watch *watch, uint64_t duration_ns);
+
+#endif // WINSPOUTWATCHDOG_H
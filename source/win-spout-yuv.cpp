@@ -0,0 +1,311 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <math.h>
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include "win-spout.h"
+#include "win-spout-yuv.h"
+
+void win_spout_yuv_get_coeffs(enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix,
+			      struct win_spout_yuv_coeffs *coeffs)
+{
+	const float kr = matrix == WIN_SPOUT_YUV_2020 ? 0.2627f : 0.2126f;
+	const float kb = matrix == WIN_SPOUT_YUV_2020 ? 0.0593f : 0.0722f;
+	const float kg = 1.0f - kr - kb;
+
+	// limited range: luma 16-235 and chroma 16-240 at 8 bits, times 4 at 10
+	const bool p010 = format == WIN_SPOUT_YUV_P010;
+	const float y_range = p010 ? 876.0f : 219.0f;
+	const float c_range = p010 ? 896.0f : 224.0f;
+	const float u_scale = c_range / (2.0f * (1.0f - kb));
+	const float v_scale = c_range / (2.0f * (1.0f - kr));
+
+	coeffs->y[0] = y_range * kr;
+	coeffs->y[1] = y_range * kg;
+	coeffs->y[2] = y_range * kb;
+	coeffs->u[0] = -u_scale * kr;
+	coeffs->u[1] = -u_scale * kg;
+	coeffs->u[2] = u_scale * (1.0f - kb);
+	coeffs->v[0] = v_scale * (1.0f - kr);
+	coeffs->v[1] = -v_scale * kg;
+	coeffs->v[2] = -v_scale * kb;
+	coeffs->offsets[0] = p010 ? 64.0f : 16.0f;
+	coeffs->offsets[1] = coeffs->offsets[2] = p010 ? 512.0f : 128.0f;
+	// P010 keeps the 10 bits at the top of each 16 bit sample
+	coeffs->out_scale = p010 ? 64.0f / 65535.0f : 1.0f / 255.0f;
+	coeffs->max_code = p010 ? 1023 : 255;
+}
+
+void win_spout_yuv_get_unpack_coeffs(enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix,
+				     struct win_spout_yuv_unpack_coeffs *coeffs)
+{
+	struct win_spout_yuv_coeffs pack;
+	win_spout_yuv_get_coeffs(format, matrix, &pack);
+
+	// inverse of the rows y u v by cofactors
+	const float *m[3] = {pack.y, pack.u, pack.v};
+	float *rows[3] = {coeffs->r, coeffs->g, coeffs->b};
+	const float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+			  m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+			  m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	for (int i = 0; i < 3; i++) {
+		const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++) {
+			const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+			rows[i][j] = (m[j1][i1] * m[j2][i2] - m[j1][i2] * m[j2][i1]) / det;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		coeffs->offsets[i] = pack.offsets[i];
+	coeffs->in_scale = 1.0f / pack.out_scale;
+}
+
+bool win_spout_yuv_parse_format(const char *str, enum win_spout_yuv_format *format)
+{
+	if (astrcmpi(str, "nv12") == 0)
+		*format = WIN_SPOUT_YUV_NV12;
+	else if (astrcmpi(str, "p010") == 0)
+		*format = WIN_SPOUT_YUV_P010;
+	else
+		return false;
+	return true;
+}
+
+bool win_spout_yuv_parse_matrix(const char *str, enum win_spout_yuv_matrix *matrix)
+{
+	if (strcmp(str, "709") == 0)
+		*matrix = WIN_SPOUT_YUV_709;
+	else if (strcmp(str, "2020") == 0)
+		*matrix = WIN_SPOUT_YUV_2020;
+	else
+		return false;
+	return true;
+}
+
+static inline float yuv_dot(const float *coeffs, const float *rgb)
+{
+	return coeffs[0] * rgb[0] + coeffs[1] * rgb[1] + coeffs[2] * rgb[2];
+}
+
+static inline void yuv_store(uint8_t *dst, bool p010, float code, uint32_t max_code)
+{
+	float rounded = floorf(code + 0.5f);
+	uint32_t value = rounded <= 0.0f ? 0 : rounded >= (float)max_code ? max_code : (uint32_t)rounded;
+	if (p010) {
+		value <<= 6;
+		dst[0] = (uint8_t)value;
+		dst[1] = (uint8_t)(value >> 8);
+	} else {
+		dst[0] = (uint8_t)value;
+	}
+}
+
+// Adds the pixel's rgb (0..1) times weight to sum, clamping the column as the sampler does
+static inline void yuv_add(const uint8_t *row, int x, uint32_t width, float weight, float *sum)
+{
+	const uint8_t *px = row + (size_t)(x < 0 ? 0 : (uint32_t)x >= width ? width - 1 : (uint32_t)x) * 4;
+	sum[0] += weight * px[2] / 255.0f;
+	sum[1] += weight * px[1] / 255.0f;
+	sum[2] += weight * px[0] / 255.0f;
+}
+
+void win_spout_yuv_pack(const uint8_t *bgra, uint32_t bgra_linesize, uint32_t width, uint32_t height,
+			enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix, uint8_t *dst,
+			uint32_t dst_linesize)
+{
+	struct win_spout_yuv_coeffs coeffs;
+	win_spout_yuv_get_coeffs(format, matrix, &coeffs);
+	const bool p010 = format == WIN_SPOUT_YUV_P010;
+	const uint32_t sample_size = p010 ? 2 : 1;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = bgra + (size_t)y * bgra_linesize;
+		uint8_t *out = dst + (size_t)y * dst_linesize;
+		for (uint32_t x = 0; x < width; x++) {
+			float rgb[3] = {};
+			yuv_add(row, (int)x, width, 1.0f, rgb);
+			yuv_store(out + x * sample_size, p010, coeffs.offsets[0] + yuv_dot(coeffs.y, rgb),
+				  coeffs.max_code);
+		}
+	}
+
+	for (uint32_t r = 0; r < height / 2; r++) {
+		const uint8_t *top = bgra + (size_t)r * 2 * bgra_linesize;
+		const uint8_t *bottom = top + bgra_linesize;
+		uint8_t *out = dst + (size_t)(height + r) * dst_linesize;
+		for (uint32_t c = 0; c < width / 2; c++) {
+			// left sited: columns 2c - 1, 2c, 2c + 1 weighted 1 2 1, rows 2r and 2r + 1
+			const int x = (int)c * 2;
+			float rgb[3] = {};
+			yuv_add(top, x - 1, width, 0.125f, rgb);
+			yuv_add(top, x, width, 0.25f, rgb);
+			yuv_add(top, x + 1, width, 0.125f, rgb);
+			yuv_add(bottom, x - 1, width, 0.125f, rgb);
+			yuv_add(bottom, x, width, 0.25f, rgb);
+			yuv_add(bottom, x + 1, width, 0.125f, rgb);
+
+			yuv_store(out + (size_t)x * sample_size, p010, coeffs.offsets[1] + yuv_dot(coeffs.u, rgb),
+				  coeffs.max_code);
+			yuv_store(out + (size_t)(x + 1) * sample_size, p010, coeffs.offsets[2] + yuv_dot(coeffs.v, rgb),
+				  coeffs.max_code);
+		}
+	}
+}
+
+static inline float yuv_load(const uint8_t *row, uint32_t x, bool p010)
+{
+	if (p010) {
+		const uint8_t *sample = row + (size_t)x * 2;
+		return (float)((sample[0] | (sample[1] << 8)) >> 6);
+	}
+	return (float)row[x];
+}
+
+static inline uint8_t yuv_unorm8(float v)
+{
+	float rounded = floorf(v * 255.0f + 0.5f);
+	return rounded <= 0.0f ? 0 : rounded >= 255.0f ? 255 : (uint8_t)rounded;
+}
+
+void win_spout_yuv_unpack(const uint8_t *packed, uint32_t packed_linesize, uint32_t width, uint32_t height,
+			  enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix, uint8_t *bgra,
+			  uint32_t bgra_linesize)
+{
+	struct win_spout_yuv_unpack_coeffs coeffs;
+	win_spout_yuv_get_unpack_coeffs(format, matrix, &coeffs);
+	const bool p010 = format == WIN_SPOUT_YUV_P010;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *luma = packed + (size_t)y * packed_linesize;
+		const uint8_t *chroma = packed + (size_t)(height + y / 2) * packed_linesize;
+		uint8_t *out = bgra + (size_t)y * bgra_linesize;
+		for (uint32_t x = 0; x < width; x++, out += 4) {
+			const uint32_t c = x & ~1U;
+			const float code[3] = {yuv_load(luma, x, p010) - coeffs.offsets[0],
+					       yuv_load(chroma, c, p010) - coeffs.offsets[1],
+					       yuv_load(chroma, c + 1, p010) - coeffs.offsets[2]};
+			out[0] = yuv_unorm8(yuv_dot(coeffs.b, code));
+			out[1] = yuv_unorm8(yuv_dot(coeffs.g, code));
+			out[2] = yuv_unorm8(yuv_dot(coeffs.r, code));
+			out[3] = 255;
+		}
+	}
+}
+
+gs_effect_t *win_spout_yuv_effect_create()
+{
+	char *path = obs_module_file("spout-yuv.effect");
+	if (!path) {
+		blog(LOG_ERROR, "Can't find spout-yuv.effect");
+		return nullptr;
+	}
+
+	char *errors = nullptr;
+	gs_effect_t *effect = gs_effect_create_from_file(path, &errors);
+	if (!effect) {
+		blog(LOG_ERROR, "Failed to load %s: %s", path, errors ? errors : "unknown error");
+	}
+
+	bfree(errors);
+	bfree(path);
+	return effect;
+}
+
+static void yuv_set_vec3(gs_effect_t *effect, const char *name, const float *values)
+{
+	struct vec3 v;
+	vec3_set(&v, values[0], values[1], values[2]);
+	gs_effect_set_vec3(gs_effect_get_param_by_name(effect, name), &v);
+}
+
+bool win_spout_yuv_render(gs_texrender_t *dst, gs_effect_t *effect, gs_texture_t *rgb,
+			  enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix)
+{
+	if (!effect || !rgb) {
+		return false;
+	}
+
+	uint32_t width = gs_texture_get_width(rgb);
+	uint32_t height = gs_texture_get_height(rgb);
+	uint32_t packed_height = height / 2 * 3;
+
+	gs_texrender_reset(dst);
+	if (!gs_texrender_begin(dst, width, packed_height)) {
+		return false;
+	}
+
+	gs_ortho(0.0f, (float)width, 0.0f, (float)packed_height, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+
+	struct win_spout_yuv_coeffs coeffs;
+	win_spout_yuv_get_coeffs(format, matrix, &coeffs);
+
+	struct vec2 luma_size;
+	vec2_set(&luma_size, (float)width, (float)height);
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), rgb);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(effect, "luma_size"), &luma_size);
+	yuv_set_vec3(effect, "coeff_y", coeffs.y);
+	yuv_set_vec3(effect, "coeff_u", coeffs.u);
+	yuv_set_vec3(effect, "coeff_v", coeffs.v);
+	yuv_set_vec3(effect, "offsets", coeffs.offsets);
+	gs_effect_set_float(gs_effect_get_param_by_name(effect, "out_scale"), coeffs.out_scale);
+
+	while (gs_effect_loop(effect, "Pack"))
+		gs_draw_sprite(nullptr, 0, width, packed_height);
+
+	gs_enable_framebuffer_srgb(previous);
+
+	gs_blend_state_pop();
+	gs_texrender_end(dst);
+
+	return true;
+}
+
+void win_spout_yuv_draw(gs_effect_t *effect, gs_texture_t *packed, enum win_spout_yuv_format format,
+			enum win_spout_yuv_matrix matrix)
+{
+	if (!effect || !packed) {
+		return;
+	}
+
+	uint32_t width = gs_texture_get_width(packed);
+	uint32_t height = win_spout_yuv_luma_height(gs_texture_get_height(packed));
+
+	struct win_spout_yuv_unpack_coeffs coeffs;
+	win_spout_yuv_get_unpack_coeffs(format, matrix, &coeffs);
+
+	struct vec2 luma_size;
+	vec2_set(&luma_size, (float)width, (float)height);
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), packed);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(effect, "luma_size"), &luma_size);
+	yuv_set_vec3(effect, "unpack_r", coeffs.r);
+	yuv_set_vec3(effect, "unpack_g", coeffs.g);
+	yuv_set_vec3(effect, "unpack_b", coeffs.b);
+	yuv_set_vec3(effect, "offsets", coeffs.offsets);
+	gs_effect_set_float(gs_effect_get_param_by_name(effect, "in_scale"), coeffs.in_scale);
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+
+	while (gs_effect_loop(effect, "Unpack"))
+		gs_draw_sprite(packed, 0, width, height);
+
+	gs_enable_framebuffer_srgb(previous);
+}
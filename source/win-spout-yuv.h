@@ -0,0 +1,133 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#ifndef WINSPOUTYUV_H
+#define WINSPOUTYUV_H
+
+#include <stdint.h>
+#include <obs-module.h>
+
+/**
+ * YUV senders for consumers that encode: the frame is converted and
+ * packed on the GPU in the NV12 (8-bit) or P010 (10-bit) memory layout,
+ * in a single channel texture (GS_R8 / GS_R16) of width x height * 3 / 2.
+ * Rows 0 to height - 1 are luma, the rest interleaved Cb Cr at half size,
+ * P010 samples are in the top 10 bits.
+ *
+ * Limited range, with chroma sited left (co-sited horizontally, between
+ * rows vertically) as H.264 / HEVC default to, filtered [1 2 1] across
+ * and [1 1] down. The matrix is applied to the rendered (sRGB encoded)
+ * values, there is no transfer or primaries conversion.
+ *
+ * The GPU work is done by data/spout-yuv.effect. win_spout_yuv_pack is
+ * the scalar reference for its math, using the same coefficients, and
+ * matches it to within one code value. Senders say a texture is packed
+ * in their frame metadata, and the Spout source unpacks it with the
+ * same effect (win_spout_yuv_unpack being the reference for that).
+ */
+enum win_spout_yuv_format {
+	WIN_SPOUT_YUV_NONE,
+	WIN_SPOUT_YUV_NV12,
+	WIN_SPOUT_YUV_P010,
+};
+
+enum win_spout_yuv_matrix {
+	WIN_SPOUT_YUV_709,
+	WIN_SPOUT_YUV_2020,
+};
+
+// Code value = offset + dot(coefficients, rgb) for rgb in 0..1
+struct win_spout_yuv_coeffs {
+	float y[3];
+	float u[3];
+	float v[3];
+	float offsets[3];
+	// code value to the texture's unorm value
+	float out_scale;
+	uint32_t max_code;
+};
+
+void win_spout_yuv_get_coeffs(enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix,
+			      struct win_spout_yuv_coeffs *coeffs);
+
+// The inverse: rgb in 0..1 = dot(row, code values - offsets)
+struct win_spout_yuv_unpack_coeffs {
+	float r[3];
+	float g[3];
+	float b[3];
+	float offsets[3];
+	// the texture's unorm value to a code value
+	float in_scale;
+};
+
+void win_spout_yuv_get_unpack_coeffs(enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix,
+				     struct win_spout_yuv_unpack_coeffs *coeffs);
+
+static inline enum gs_color_format win_spout_yuv_texture_format(enum win_spout_yuv_format format)
+{
+	return format == WIN_SPOUT_YUV_P010 ? GS_R16 : GS_R8;
+}
+
+// Luma rows of a packed texture height rows high
+static inline uint32_t win_spout_yuv_luma_height(uint32_t packed_height)
+{
+	return packed_height / 3 * 2;
+}
+
+// Chroma is subsampled in pairs, so sizes are rounded down to even
+static inline uint32_t win_spout_yuv_even(uint32_t size)
+{
+	return size > 2 ? size & ~1U : 2;
+}
+
+// "nv12" / "p010", false for anything else
+bool win_spout_yuv_parse_format(const char *str, enum win_spout_yuv_format *format);
+// "709" / "2020", false for anything else
+bool win_spout_yuv_parse_matrix(const char *str, enum win_spout_yuv_matrix *matrix);
+
+/**
+ * Scalar reference: packs even sized BGRA into dst as the GPU does, P010
+ * samples little endian. dst_linesize is the packed texture's row pitch.
+ */
+void win_spout_yuv_pack(const uint8_t *bgra, uint32_t bgra_linesize, uint32_t width, uint32_t height,
+			enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix, uint8_t *dst,
+			uint32_t dst_linesize);
+
+/**
+ * Scalar reference for unpacking: a packed frame of width x height (the
+ * luma size) to opaque BGRA. Each pixel takes the chroma of its pair
+ * of columns and rows as it is, without interpolation.
+ */
+void win_spout_yuv_unpack(const uint8_t *packed, uint32_t packed_linesize, uint32_t width, uint32_t height,
+			  enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix, uint8_t *bgra,
+			  uint32_t bgra_linesize);
+
+/* Rendering, on the render thread */
+
+// Loads the packing effect, nullptr if it can't be
+gs_effect_t *win_spout_yuv_effect_create();
+
+/**
+ * Packs rgb (GS_BGRA_UNORM, even sized) into dst, a texrender of
+ * win_spout_yuv_texture_format(format)
+ *
+ * @return bool dst was rendered
+ */
+bool win_spout_yuv_render(gs_texrender_t *dst, gs_effect_t *effect, gs_texture_t *rgb,
+			  enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix);
+
+/**
+ * Draws packed (a texture of win_spout_yuv_texture_format(format)) as
+ * RGB at its luma size, values written as they are, like the source's
+ * opaque draw
+ */
+void win_spout_yuv_draw(gs_effect_t *effect, gs_texture_t *packed, enum win_spout_yuv_format format,
+			enum win_spout_yuv_matrix matrix);
+
+#endif // WINSPOUTYUV_H
@@ -10,12 +10,22 @@
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 #include <sys/stat.h>
-#include <QAction>
-#include <QMainWindow>
 
 #include "win-spout.h"
-#include "ui/win-spout-output-settings.h"
 #include "win-spout-config.h"
+#include "win-spout-view-sender.h"
+#include "win-spout-trace.h"
+#include "win-spout-alloc-track.h"
+#include "win-spout-frame-pool.h"
+#include "win-spout-send-pool.h"
+#include "win-spout-gpu-budget.h"
+#include "win-spout-yuv.h"
+
+#ifdef WIN_SPOUT_ENABLE_QT
+#include <QAction>
+#include <QMainWindow>
+#include "ui/win-spout-output-settings.h"
+#endif
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_AUTHOR("Off World Live")
@@ -24,25 +34,76 @@ OBS_MODULE_USE_DEFAULT_LOCALE("win-spout", "en-US")
 extern struct obs_source_info create_spout_source_info();
 struct obs_source_info spout_source_info;
 
+extern struct obs_source_info create_spout_mosaic_info();
+struct obs_source_info spout_mosaic_info;
+
+extern struct obs_source_info create_spout_memory_source_info();
+struct obs_source_info spout_memory_source_info;
+
+extern struct obs_source_info create_spout_audio_source_info();
+struct obs_source_info spout_audio_source_info;
+
 extern struct obs_output_info create_spout_output_info();
 struct obs_output_info spout_output_info;
 
 extern struct obs_source_info create_spout_filter_info();
 struct obs_source_info spout_filter_info;
 
+#ifdef WIN_SPOUT_ENABLE_QT
 win_spout_output_settings *spout_output_settings;
+#endif
 obs_output_t *win_spout_out;
 
+// Without the frontend there are no frontend events, so the scene
+// senders are bound as the host creates and renames its scenes
+static bool headless;
+
+static void spout_scene_signal(void *, calldata_t *calldata)
+{
+	obs_source_t *source = (obs_source_t *)calldata_ptr(calldata, "source");
+	if (source && obs_source_get_type(source) == OBS_SOURCE_TYPE_SCENE) {
+		win_spout_scene_senders_refresh();
+	}
+}
+
+static void spout_stop_output()
+{
+	if (!win_spout_out) {
+		return;
+	}
+
+	obs_output_stop(win_spout_out);
+	obs_output_release(win_spout_out);
+	win_spout_out = nullptr;
+}
+
 static void spout_obs_event(enum obs_frontend_event event, void *)
 {
-	if (event == OBS_FRONTEND_EVENT_EXIT) {
-		if (!win_spout_out) {
-			return;
-		}
-
-		obs_output_stop(win_spout_out);
-		obs_output_release(win_spout_out);
-		win_spout_out = nullptr;
+	switch (event) {
+	case OBS_FRONTEND_EVENT_FINISHED_LOADING:
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGED:
+		win_spout_scene_senders_load(win_spout_config::get()->scene_senders.c_str());
+		win_spout_preview_sender_load(win_spout_config::get()->preview_sender.c_str());
+		break;
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_ENABLED:
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_DISABLED:
+	case OBS_FRONTEND_EVENT_PREVIEW_SCENE_CHANGED:
+		win_spout_preview_sender_refresh();
+		break;
+	case OBS_FRONTEND_EVENT_SCENE_LIST_CHANGED:
+		win_spout_scene_senders_refresh();
+		break;
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CLEANUP:
+		win_spout_scene_senders_unload();
+		win_spout_preview_sender_unload();
+		break;
+	case OBS_FRONTEND_EVENT_EXIT:
+		win_spout_scene_senders_unload();
+		win_spout_preview_sender_unload();
+		spout_stop_output();
+		break;
+	default:
+		break;
 	}
 }
 
@@ -52,16 +113,25 @@ bool obs_module_load(void)
 	spout_source_info = create_spout_source_info();
 	obs_register_source(&spout_source_info);
 
-	// load spout output
-	QMainWindow *main_window = (QMainWindow *)obs_frontend_get_main_window();
+	// load spout - mosaic source
+	spout_mosaic_info = create_spout_mosaic_info();
+	obs_register_source(&spout_mosaic_info);
 
-	if (!main_window) {
-		blog(LOG_ERROR, "Can't get main window!");
-		return false;
-	}
+	// load spout - memory receive source
+	spout_memory_source_info = create_spout_memory_source_info();
+	obs_register_source(&spout_memory_source_info);
 
+	// load spout - shared audio source
+	spout_audio_source_info = create_spout_audio_source_info();
+	obs_register_source(&spout_audio_source_info);
+
+	// load spout output
 	win_spout_config *config = win_spout_config::get();
 	config->load();
+	win_spout_frame_pool_set_large_pages(config->large_pages);
+	win_spout_send_pool_start(config->send_threads > 0 ? (uint32_t)config->send_threads : 0, config->send_affinity,
+				  (enum win_spout_send_priority)config->send_priority);
+	win_spout_gpu_budget_set(config->gpu_budget_mb > 0 ? (uint64_t)config->gpu_budget_mb * 1024 * 1024 : 0);
 
 	spout_output_info = create_spout_output_info();
 	obs_register_output(&spout_output_info);
@@ -70,18 +140,34 @@ bool obs_module_load(void)
 	win_spout_out = obs_output_create("spout_output", "OBS Spout Output", settings, NULL);
 	obs_data_release(settings);
 
-	QAction *menu_action = (QAction *)obs_frontend_add_tools_menu_qaction(obs_module_text("toolslabel"));
+	obs_frontend_add_event_callback(spout_obs_event, nullptr);
 
-	obs_frontend_push_ui_translation(obs_module_get_string);
-	spout_output_settings = new win_spout_output_settings(main_window);
-	obs_frontend_pop_ui_translation();
+	// auto-start doesn't depend on the settings dialog, so headless
+	// instances start their output from config alone
+	if (config->auto_start) {
+		spout_output_start(config->spout_output_name.c_str());
+	}
 
-	auto menu_cb = [] {
-		spout_output_settings->toggle_show_hide();
-	};
-	menu_action->connect(menu_action, &QAction::triggered, menu_cb);
+#ifdef WIN_SPOUT_ENABLE_QT
+	// the settings dialog is optional
+	QMainWindow *main_window = (QMainWindow *)obs_frontend_get_main_window();
 
-	obs_frontend_add_event_callback(spout_obs_event, nullptr);
+	if (main_window) {
+		QAction *menu_action =
+			(QAction *)obs_frontend_add_tools_menu_qaction(obs_module_text("toolslabel"));
+
+		obs_frontend_push_ui_translation(obs_module_get_string);
+		spout_output_settings = new win_spout_output_settings(main_window);
+		obs_frontend_pop_ui_translation();
+
+		auto menu_cb = [] {
+			spout_output_settings->toggle_show_hide();
+		};
+		menu_action->connect(menu_action, &QAction::triggered, menu_cb);
+	} else {
+		blog(LOG_INFO, "No main window, Spout output settings dialog disabled");
+	}
+#endif
 
 	// load spout filter
 	spout_filter_info = create_spout_filter_info();
@@ -92,8 +178,43 @@ bool obs_module_load(void)
 	return true;
 }
 
+void obs_module_post_load(void)
+{
+	if (obs_frontend_get_main_window()) {
+		return;
+	}
+
+	headless = true;
+	signal_handler_t *handler = obs_get_signal_handler();
+	signal_handler_connect(handler, "source_create", spout_scene_signal, nullptr);
+	signal_handler_connect(handler, "source_rename", spout_scene_signal, nullptr);
+
+	win_spout_config *config = win_spout_config::get();
+	win_spout_scene_senders_load(config->scene_senders.c_str());
+	if (!config->preview_sender.empty()) {
+		blog(LOG_WARNING, "No frontend, the studio mode preview sender is disabled");
+	}
+}
+
 void obs_module_unload()
 {
+	if (headless) {
+		signal_handler_t *handler = obs_get_signal_handler();
+		signal_handler_disconnect(handler, "source_create", spout_scene_signal, nullptr);
+		signal_handler_disconnect(handler, "source_rename", spout_scene_signal, nullptr);
+	}
+
+	// OBS_FRONTEND_EVENT_EXIT has done this already unless headless
+	win_spout_scene_senders_unload();
+	win_spout_preview_sender_unload();
+	spout_stop_output();
+	win_spout_config::release();
+
+	WIN_SPOUT_TRACE_FLUSH();
+	WIN_SPOUT_ALLOC_REPORT();
+	win_spout_send_pool_stop();
+	win_spout_frame_pool_free_idle();
+	win_spout_gpu_budget_log();
 	blog(LOG_INFO, "win-spout unloaded!");
 }
 
@@ -111,6 +232,21 @@ void spout_output_start(const char *SpoutName)
 {
 	obs_data_t *settings = obs_output_get_settings(win_spout_out);
 	obs_data_set_string(settings, "senderName", SpoutName);
+	win_spout_config *config = win_spout_config::get();
+	obs_data_set_bool(settings, "shareDevice", config->share_device);
+	obs_data_set_bool(settings, "shareAudio", config->share_audio);
+	obs_data_set_int(settings, "bridgePort", config->bridge_port);
+	obs_data_set_string(settings, "bridgeAddress", config->bridge_address.c_str());
+	obs_data_set_bool(settings, "memoryShare", config->memory_share);
+	obs_data_set_string(settings, "crop", config->output_crop.c_str());
+	obs_data_set_string(settings, "regions", config->output_regions.c_str());
+	// anything but nv12 / p010 sends BGRA, anything but 2020 is Rec. 709
+	enum win_spout_yuv_format yuv_format = WIN_SPOUT_YUV_NONE;
+	enum win_spout_yuv_matrix yuv_matrix = WIN_SPOUT_YUV_709;
+	win_spout_yuv_parse_format(config->output_yuv_format.c_str(), &yuv_format);
+	win_spout_yuv_parse_matrix(config->output_yuv_matrix.c_str(), &yuv_matrix);
+	obs_data_set_int(settings, "yuvFormat", yuv_format);
+	obs_data_set_int(settings, "yuvMatrix", yuv_matrix);
 	obs_output_update(win_spout_out, settings);
 	obs_data_release(settings);
 	obs_output_start(win_spout_out);
@@ -120,3 +256,8 @@ void spout_output_stop()
 {
 	obs_output_stop(win_spout_out);
 }
+
+bool spout_output_active()
+{
+	return win_spout_out && obs_output_active(win_spout_out);
+}
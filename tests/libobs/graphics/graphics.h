@@ -0,0 +1,140 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/**
+ * Stand-in for the libobs header of the same name, see tests/README.md.
+ * There's no device: textures only remember their size and format and
+ * drawing does nothing.
+ */
+
+#include "../util/c99defs.h"
+#include "vec2.h"
+#include "vec3.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum gs_color_format {
+	GS_UNKNOWN,
+	GS_A8,
+	GS_R8,
+	GS_RGBA,
+	GS_BGRX,
+	GS_BGRA,
+	GS_R10G10B10A2,
+	GS_RGBA16,
+	GS_R16,
+	GS_RGBA16F,
+	GS_RGBA32F,
+	GS_RG16F,
+	GS_RG32F,
+	GS_R16F,
+	GS_R32F,
+	GS_DXT1,
+	GS_DXT3,
+	GS_DXT5,
+	GS_R8G8,
+	GS_RGBA_UNORM,
+	GS_BGRX_UNORM,
+	GS_BGRA_UNORM,
+	GS_RG16,
+};
+
+enum gs_zstencil_format {
+	GS_ZS_NONE,
+	GS_Z16,
+	GS_Z24_S8,
+	GS_Z32F,
+	GS_Z32F_S8X24,
+};
+
+enum gs_blend_type {
+	GS_BLEND_ZERO,
+	GS_BLEND_ONE,
+	GS_BLEND_SRCCOLOR,
+	GS_BLEND_INVSRCCOLOR,
+	GS_BLEND_SRCALPHA,
+	GS_BLEND_INVSRCALPHA,
+	GS_BLEND_DSTCOLOR,
+	GS_BLEND_INVDSTCOLOR,
+	GS_BLEND_DSTALPHA,
+	GS_BLEND_INVDSTALPHA,
+	GS_BLEND_SRCALPHASAT,
+};
+
+typedef struct gs_texture gs_texture_t;
+typedef struct gs_effect gs_effect_t;
+typedef struct gs_effect_param gs_eparam_t;
+typedef struct gs_texture_render gs_texrender_t;
+
+static inline uint32_t gs_get_format_bpp(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+		return 8;
+	case GS_R16:
+	case GS_R16F:
+	case GS_R8G8:
+		return 16;
+	case GS_RGBA16:
+	case GS_RGBA16F:
+	case GS_RG32F:
+		return 64;
+	case GS_RGBA32F:
+		return 128;
+	case GS_DXT1:
+		return 4;
+	case GS_DXT3:
+	case GS_DXT5:
+		return 8;
+	case GS_UNKNOWN:
+		return 0;
+	default:
+		return 32;
+	}
+}
+
+EXPORT gs_texture_t *gs_texture_create(uint32_t width, uint32_t height, enum gs_color_format color_format,
+				       uint32_t levels, const uint8_t **data, uint32_t flags);
+EXPORT void gs_texture_destroy(gs_texture_t *tex);
+EXPORT uint32_t gs_texture_get_width(const gs_texture_t *tex);
+EXPORT uint32_t gs_texture_get_height(const gs_texture_t *tex);
+EXPORT enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex);
+
+EXPORT gs_texrender_t *gs_texrender_create(enum gs_color_format format, enum gs_zstencil_format zsformat);
+EXPORT void gs_texrender_destroy(gs_texrender_t *texrender);
+EXPORT bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy);
+EXPORT void gs_texrender_end(gs_texrender_t *texrender);
+EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
+EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
+
+EXPORT gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string);
+EXPORT void gs_effect_destroy(gs_effect_t *effect);
+EXPORT bool gs_effect_loop(gs_effect_t *effect, const char *name);
+EXPORT gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name);
+EXPORT void gs_effect_set_float(gs_eparam_t *param, float val);
+EXPORT void gs_effect_set_vec2(gs_eparam_t *param, const struct vec2 *val);
+EXPORT void gs_effect_set_vec3(gs_eparam_t *param, const struct vec3 *val);
+EXPORT void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val);
+
+EXPORT void gs_ortho(float left, float right, float top, float bottom, float znear, float zfar);
+EXPORT void gs_blend_state_push(void);
+EXPORT void gs_blend_state_pop(void);
+EXPORT void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest);
+EXPORT bool gs_framebuffer_srgb_enabled(void);
+EXPORT void gs_enable_framebuffer_srgb(bool enable);
+EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width, uint32_t height);
+
+#ifdef __cplusplus
+}
+#endif
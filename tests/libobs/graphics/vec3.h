@@ -0,0 +1,24 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+struct vec3 {
+	float x, y, z, w;
+};
+
+static inline void vec3_set(struct vec3 *dst, float x, float y, float z)
+{
+	dst->x = x;
+	dst->y = y;
+	dst->z = z;
+	dst->w = 0.0f;
+}
@@ -0,0 +1,570 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+/* The stand-in libobs the tests link against, see tests/README.md */
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <atomic>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include "../test.h"
+
+/* bmem, counted the way libobs counts them plus every call */
+
+static std::atomic<long> bmem_outstanding;
+static std::atomic<uint64_t> bmem_calls;
+
+void *bmalloc(size_t size)
+{
+	bmem_outstanding++;
+	bmem_calls++;
+	return malloc(size ? size : 1);
+}
+
+void *brealloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		bmem_outstanding++;
+	bmem_calls++;
+	return realloc(ptr, size ? size : 1);
+}
+
+void bfree(void *ptr)
+{
+	if (ptr)
+		bmem_outstanding--;
+	free(ptr);
+}
+
+long bnum_allocs(void)
+{
+	return bmem_outstanding;
+}
+
+uint64_t test_bmem_calls()
+{
+	return bmem_calls;
+}
+
+/* logging */
+
+static std::atomic<int> log_level{LOG_WARNING};
+
+void test_log_level(int level)
+{
+	log_level = level;
+}
+
+void blog(int level, const char *format, ...)
+{
+	if (level > log_level)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+/* clock */
+
+static std::atomic<bool> clock_mocked;
+static std::atomic<uint64_t> clock_now;
+
+void test_clock_set(uint64_t ns)
+{
+	clock_now = ns;
+	clock_mocked = true;
+}
+
+void test_clock_advance(uint64_t ns)
+{
+	clock_now += ns;
+}
+
+void test_clock_real()
+{
+	clock_mocked = false;
+}
+
+uint64_t os_gettime_ns(void)
+{
+	if (clock_mocked)
+		return clock_now;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+bool os_sleepto_ns(uint64_t time_target)
+{
+	uint64_t now = os_gettime_ns();
+	if (time_target < now)
+		return false;
+
+	if (clock_mocked) {
+		clock_now = time_target;
+		return true;
+	}
+
+	struct timespec ts = {(time_t)(time_target / 1000000000ULL), (long)(time_target % 1000000000ULL)};
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	return true;
+}
+
+void os_sleep_ms(uint32_t duration)
+{
+	if (clock_mocked) {
+		clock_now += (uint64_t)duration * 1000000ULL;
+		return;
+	}
+
+	struct timespec ts = {(time_t)(duration / 1000), (long)(duration % 1000) * 1000000L};
+	nanosleep(&ts, NULL);
+}
+
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
+int astrcmpi(const char *str1, const char *str2)
+{
+	return strcasecmp(str1 ? str1 : "", str2 ? str2 : "");
+}
+
+/* threading */
+
+struct os_event_data {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	volatile bool signalled;
+	bool manual;
+};
+
+int os_event_init(os_event_t **event, enum os_event_type type)
+{
+	struct os_event_data *data = (os_event_data *)bzalloc(sizeof(struct os_event_data));
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->cond, NULL);
+	data->manual = type == OS_EVENT_TYPE_MANUAL;
+	*event = data;
+	return 0;
+}
+
+void os_event_destroy(os_event_t *event)
+{
+	if (!event)
+		return;
+
+	pthread_mutex_destroy(&event->mutex);
+	pthread_cond_destroy(&event->cond);
+	bfree(event);
+}
+
+int os_event_wait(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled)
+		pthread_cond_wait(&event->cond, &event->mutex);
+	if (!event->manual)
+		event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
+
+int os_event_timedwait(os_event_t *event, unsigned long milliseconds)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)milliseconds * 1000000ULL;
+	ts.tv_sec += (time_t)(ns / 1000000000ULL);
+	ts.tv_nsec = (long)(ns % 1000000000ULL);
+
+	int code = 0;
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled && code != ETIMEDOUT)
+		code = pthread_cond_timedwait(&event->cond, &event->mutex, &ts);
+	if (event->signalled) {
+		code = 0;
+		if (!event->manual)
+			event->signalled = false;
+	}
+	pthread_mutex_unlock(&event->mutex);
+	return code;
+}
+
+int os_event_try(os_event_t *event)
+{
+	int code = EAGAIN;
+	pthread_mutex_lock(&event->mutex);
+	if (event->signalled) {
+		if (!event->manual)
+			event->signalled = false;
+		code = 0;
+	}
+	pthread_mutex_unlock(&event->mutex);
+	return code;
+}
+
+int os_event_signal(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = true;
+	pthread_cond_broadcast(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
+
+void os_event_reset(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+}
+
+struct os_sem_data {
+	sem_t sem;
+};
+
+int os_sem_init(os_sem_t **sem, int value)
+{
+	struct os_sem_data *data = (os_sem_data *)bzalloc(sizeof(struct os_sem_data));
+	sem_init(&data->sem, 0, (unsigned int)value);
+	*sem = data;
+	return 0;
+}
+
+void os_sem_destroy(os_sem_t *sem)
+{
+	if (!sem)
+		return;
+
+	sem_destroy(&sem->sem);
+	bfree(sem);
+}
+
+int os_sem_post(os_sem_t *sem)
+{
+	return sem_post(&sem->sem);
+}
+
+int os_sem_wait(os_sem_t *sem)
+{
+	while (sem_wait(&sem->sem) != 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+void os_set_thread_name(const char *name)
+{
+	char truncated[16] = {};
+	strncpy(truncated, name, sizeof(truncated) - 1);
+	pthread_setname_np(pthread_self(), truncated);
+}
+
+/* dstr */
+
+void dstr_free(struct dstr *dst)
+{
+	bfree(dst->array);
+	dstr_init(dst);
+}
+
+static void dstr_vcatf(struct dstr *dst, const char *format, va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+	int len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (len < 0)
+		return;
+
+	size_t needed = dst->len + (size_t)len + 1;
+	if (needed > dst->capacity) {
+		dst->array = (char *)brealloc(dst->array, needed);
+		dst->capacity = needed;
+	}
+	vsnprintf(dst->array + dst->len, (size_t)len + 1, format, args);
+	dst->len += (size_t)len;
+}
+
+void dstr_copy(struct dstr *dst, const char *array)
+{
+	dst->len = 0;
+	dstr_cat(dst, array);
+}
+
+void dstr_cat(struct dstr *dst, const char *array)
+{
+	dstr_catf(dst, "%s", array ? array : "");
+}
+
+void dstr_printf(struct dstr *dst, const char *format, ...)
+{
+	dst->len = 0;
+	va_list args;
+	va_start(args, format);
+	dstr_vcatf(dst, format, args);
+	va_end(args);
+}
+
+void dstr_catf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	dstr_vcatf(dst, format, args);
+	va_end(args);
+}
+
+/* graphics, without a device */
+
+struct gs_texture {
+	uint32_t width;
+	uint32_t height;
+	enum gs_color_format format;
+};
+
+struct gs_texture_render {
+	enum gs_color_format format;
+	gs_texture_t *target;
+};
+
+struct gs_effect {
+	int unused;
+};
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height, enum gs_color_format color_format, uint32_t levels,
+				const uint8_t **data, uint32_t flags)
+{
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+
+	gs_texture_t *tex = (gs_texture_t *)bzalloc(sizeof(gs_texture_t));
+	tex->width = width;
+	tex->height = height;
+	tex->format = color_format;
+	return tex;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex ? tex->width : 0;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex ? tex->height : 0;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex ? tex->format : GS_UNKNOWN;
+}
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format format, enum gs_zstencil_format zsformat)
+{
+	UNUSED_PARAMETER(zsformat);
+
+	gs_texrender_t *texrender = (gs_texrender_t *)bzalloc(sizeof(gs_texrender_t));
+	texrender->format = format;
+	return texrender;
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	if (texrender)
+		gs_texture_destroy(texrender->target);
+	bfree(texrender);
+}
+
+bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+	if (!texrender || !cx || !cy)
+		return false;
+
+	if (!texrender->target || texrender->target->width != cx || texrender->target->height != cy) {
+		gs_texture_destroy(texrender->target);
+		texrender->target = gs_texture_create(cx, cy, texrender->format, 1, NULL, 0);
+	}
+	return true;
+}
+
+void gs_texrender_end(gs_texrender_t *texrender)
+{
+	UNUSED_PARAMETER(texrender);
+}
+
+void gs_texrender_reset(gs_texrender_t *texrender)
+{
+	UNUSED_PARAMETER(texrender);
+}
+
+gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
+{
+	return texrender ? texrender->target : NULL;
+}
+
+gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
+{
+	FILE *f = fopen(file, "rb");
+	if (!f) {
+		if (error_string)
+			*error_string = bstrdup("file not found");
+		return NULL;
+	}
+	fclose(f);
+	return (gs_effect_t *)bzalloc(sizeof(gs_effect_t));
+}
+
+void gs_effect_destroy(gs_effect_t *effect)
+{
+	bfree(effect);
+}
+
+bool gs_effect_loop(gs_effect_t *effect, const char *name)
+{
+	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(name);
+	return false;
+}
+
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name)
+{
+	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(name);
+	return NULL;
+}
+
+void gs_effect_set_float(gs_eparam_t *param, float val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+void gs_effect_set_vec2(gs_eparam_t *param, const struct vec2 *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+void gs_effect_set_vec3(gs_eparam_t *param, const struct vec3 *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+void gs_ortho(float left, float right, float top, float bottom, float znear, float zfar)
+{
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	UNUSED_PARAMETER(top);
+	UNUSED_PARAMETER(bottom);
+	UNUSED_PARAMETER(znear);
+	UNUSED_PARAMETER(zfar);
+}
+
+void gs_blend_state_push(void) {}
+
+void gs_blend_state_pop(void) {}
+
+void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+static bool framebuffer_srgb;
+
+bool gs_framebuffer_srgb_enabled(void)
+{
+	return framebuffer_srgb;
+}
+
+void gs_enable_framebuffer_srgb(bool enable)
+{
+	framebuffer_srgb = enable;
+}
+
+void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width, uint32_t height)
+{
+	UNUSED_PARAMETER(tex);
+	UNUSED_PARAMETER(flip);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+}
+
+/* sources */
+
+obs_source_t *obs_get_output_source(uint32_t channel)
+{
+	UNUSED_PARAMETER(channel);
+	return nullptr;
+}
+
+enum obs_source_type obs_source_get_type(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return OBS_SOURCE_TYPE_INPUT;
+}
+
+obs_source_t *obs_transition_get_active_source(obs_source_t *transition)
+{
+	UNUSED_PARAMETER(transition);
+	return nullptr;
+}
+
+const char *obs_source_get_name(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return nullptr;
+}
+
+void obs_source_release(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+}
+
+/* module */
+
+char *obs_module_file(const char *file)
+{
+	struct dstr path = {};
+	dstr_printf(&path, "%s/%s", TEST_DATA_DIR, file);
+	return path.array;
+}
+
+const char *obs_module_text(const char *lookup_string)
+{
+	return lookup_string;
+}
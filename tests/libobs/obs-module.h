@@ -0,0 +1,49 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/**
+ * Stand-in for libobs's obs-module.h with just enough of the API for the
+ * plugin's platform independent parts to build on Linux, see tests/README.md
+ */
+
+#include "util/c99defs.h"
+#include "util/bmem.h"
+#include "util/base.h"
+#include "graphics/graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct obs_source obs_source_t;
+typedef struct obs_data obs_data_t;
+
+enum obs_source_type {
+	OBS_SOURCE_TYPE_INPUT,
+	OBS_SOURCE_TYPE_FILTER,
+	OBS_SOURCE_TYPE_TRANSITION,
+	OBS_SOURCE_TYPE_SCENE,
+};
+
+// there are no sources, nothing is on the program output
+EXPORT obs_source_t *obs_get_output_source(uint32_t channel);
+EXPORT enum obs_source_type obs_source_get_type(const obs_source_t *source);
+EXPORT obs_source_t *obs_transition_get_active_source(obs_source_t *transition);
+EXPORT const char *obs_source_get_name(const obs_source_t *source);
+EXPORT void obs_source_release(obs_source_t *source);
+
+// module files are looked up in the tests' data directory (the repo's data/)
+EXPORT char *obs_module_file(const char *file);
+EXPORT const char *obs_module_text(const char *lookup_string);
+
+#ifdef __cplusplus
+}
+#endif
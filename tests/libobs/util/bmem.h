@@ -0,0 +1,54 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+#include <string.h>
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+EXPORT void *bmalloc(size_t size);
+EXPORT void *brealloc(void *ptr, size_t size);
+EXPORT void bfree(void *ptr);
+
+// outstanding allocations, as libobs counts them
+EXPORT long bnum_allocs(void);
+
+static inline void *bzalloc(size_t size)
+{
+	void *mem = bmalloc(size);
+	if (mem)
+		memset(mem, 0, size);
+	return mem;
+}
+
+static inline char *bstrdup_n(const char *str, size_t n)
+{
+	if (!str)
+		return NULL;
+
+	char *dup = (char *)bmalloc(n + 1);
+	memcpy(dup, str, n);
+	dup[n] = 0;
+	return dup;
+}
+
+static inline char *bstrdup(const char *str)
+{
+	return str ? bstrdup_n(str, strlen(str)) : NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EXPORT
+#define UNUSED_PARAMETER(param) (void)param
+#define MAX_AV_PLANES 8
@@ -0,0 +1,153 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+#include <string.h>
+#include "bmem.h"
+
+#define DARRAY_INVALID ((size_t)-1)
+
+struct darray {
+	void *array;
+	size_t num;
+	size_t capacity;
+};
+
+static inline void darray_init(struct darray *dst)
+{
+	dst->array = NULL;
+	dst->num = 0;
+	dst->capacity = 0;
+}
+
+static inline void darray_free(struct darray *dst)
+{
+	bfree(dst->array);
+	darray_init(dst);
+}
+
+static inline void *darray_item(size_t element_size, const struct darray *da, size_t idx)
+{
+	return (void *)(((uint8_t *)da->array) + element_size * idx);
+}
+
+static inline void darray_reserve(size_t element_size, struct darray *dst, size_t capacity)
+{
+	if (capacity == 0 || capacity <= dst->capacity)
+		return;
+
+	void *ptr = bmalloc(element_size * capacity);
+	if (dst->array) {
+		if (dst->num)
+			memcpy(ptr, dst->array, element_size * dst->num);
+		bfree(dst->array);
+	}
+	dst->array = ptr;
+	dst->capacity = capacity;
+}
+
+static inline void darray_ensure_capacity(size_t element_size, struct darray *dst, size_t new_size)
+{
+	if (new_size <= dst->capacity)
+		return;
+
+	size_t new_cap = !dst->capacity ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+	darray_reserve(element_size, dst, new_cap);
+}
+
+static inline void darray_resize(size_t element_size, struct darray *dst, size_t size)
+{
+	if (size == dst->num)
+		return;
+	if (size == 0) {
+		dst->num = 0;
+		return;
+	}
+
+	bool b_clear = size > dst->num;
+	size_t old_num = dst->num;
+
+	darray_ensure_capacity(element_size, dst, size);
+	dst->num = size;
+
+	if (b_clear)
+		memset(darray_item(element_size, dst, old_num), 0, element_size * (dst->num - old_num));
+}
+
+static inline size_t darray_find(size_t element_size, const struct darray *da, const void *item, size_t idx)
+{
+	for (size_t i = idx; i < da->num; i++) {
+		if (memcmp(darray_item(element_size, da, i), item, element_size) == 0)
+			return i;
+	}
+	return DARRAY_INVALID;
+}
+
+static inline size_t darray_push_back(size_t element_size, struct darray *dst, const void *item)
+{
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	memcpy(darray_item(element_size, dst, dst->num - 1), item, element_size);
+	return dst->num - 1;
+}
+
+static inline void *darray_push_back_new(size_t element_size, struct darray *dst)
+{
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	void *last = darray_item(element_size, dst, dst->num - 1);
+	memset(last, 0, element_size);
+	return last;
+}
+
+static inline void darray_erase(size_t element_size, struct darray *dst, size_t idx)
+{
+	if (idx >= dst->num || !--dst->num)
+		return;
+
+	memmove(darray_item(element_size, dst, idx), darray_item(element_size, dst, idx + 1),
+		element_size * (dst->num - idx));
+}
+
+static inline void darray_erase_item(size_t element_size, struct darray *dst, const void *item)
+{
+	size_t idx = darray_find(element_size, dst, item, 0);
+	if (idx != DARRAY_INVALID)
+		darray_erase(element_size, dst, idx);
+}
+
+static inline void darray_pop_back(size_t element_size, struct darray *dst)
+{
+	if (dst->num)
+		darray_erase(element_size, dst, dst->num - 1);
+}
+
+#define DARRAY(type)                     \
+	union {                          \
+		struct darray da;        \
+		struct {                 \
+			type *array;     \
+			size_t num;      \
+			size_t capacity; \
+		};                       \
+	}
+
+#define da_init(v) darray_init(&(v).da)
+#define da_free(v) darray_free(&(v).da)
+#define da_reserve(v, capacity) darray_reserve(sizeof(*(v).array), &(v).da, capacity)
+#define da_resize(v, size) darray_resize(sizeof(*(v).array), &(v).da, size)
+#define da_find(v, item, idx) darray_find(sizeof(*(v).array), &(v).da, item, idx)
+#define da_push_back(v, item) darray_push_back(sizeof(*(v).array), &(v).da, item)
+#define da_push_back_new(v) darray_push_back_new(sizeof(*(v).array), &(v).da)
+#define da_erase(v, idx) darray_erase(sizeof(*(v).array), &(v).da, idx)
+#define da_erase_item(v, item) darray_erase_item(sizeof(*(v).array), &(v).da, item)
+#define da_pop_back(v) darray_pop_back(sizeof(*(v).array), &(v).da)
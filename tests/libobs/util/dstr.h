@@ -0,0 +1,43 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dstr {
+	char *array;
+	size_t len;
+	size_t capacity;
+};
+
+EXPORT void dstr_free(struct dstr *dst);
+EXPORT void dstr_copy(struct dstr *dst, const char *array);
+EXPORT void dstr_cat(struct dstr *dst, const char *array);
+EXPORT void dstr_printf(struct dstr *dst, const char *format, ...);
+EXPORT void dstr_catf(struct dstr *dst, const char *format, ...);
+
+EXPORT int astrcmpi(const char *str1, const char *str2);
+
+static inline void dstr_init(struct dstr *dst)
+{
+	dst->array = NULL;
+	dst->len = 0;
+	dst->capacity = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
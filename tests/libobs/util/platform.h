@@ -0,0 +1,28 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+/* Stand-in for the libobs header of the same name, see tests/README.md */
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the tests' clock, see test_clock_set in ../test.h
+EXPORT uint64_t os_gettime_ns(void);
+EXPORT bool os_sleepto_ns(uint64_t time_target);
+EXPORT void os_sleep_ms(uint32_t duration);
+EXPORT int os_get_logical_cores(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,198 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <string.h>
+#include <vector>
+#include <util/bmem.h>
+#include "win-spout-alloc-track.h"
+#include "win-spout-audio.h"
+#include "win-spout-convert.h"
+#include "win-spout-governor.h"
+#include "win-spout-jitter.h"
+#include "win-spout-shm-frame.h"
+#include "win-spout-sync.h"
+#include "test.h"
+
+/**
+ * The per-frame paths that build headless, run for thousands of frames
+ * once warmed up: none of them may allocate, through the plugin's own
+ * operator new (counted by the allocation tracker this test is built
+ * with) or through libobs. Everything runs on this one thread, so
+ * libobs's process wide counts are this frame's.
+ */
+#define FRAMES 5000
+#define FRAME_NS 16666667ULL
+
+struct alloc_counts {
+	uint64_t plugin;
+	uint64_t bmem;
+	long outstanding;
+};
+
+static struct alloc_counts alloc_counts_now()
+{
+	return {win_spout_alloc_thread_count(), test_bmem_calls(), bnum_allocs()};
+}
+
+// Warms frame() up, then runs it FRAMES times and returns whether any of those allocated
+template<typename F> static bool frames_allocate(F frame)
+{
+	uint64_t n = 0;
+	for (; n < WIN_SPOUT_ALLOC_WARMUP_FRAMES; n++)
+		frame(n);
+
+	const struct alloc_counts start = alloc_counts_now();
+	for (; n < WIN_SPOUT_ALLOC_WARMUP_FRAMES + FRAMES; n++)
+		frame(n);
+	const struct alloc_counts end = alloc_counts_now();
+
+	if (end.plugin != start.plugin || end.bmem != start.bmem || end.outstanding != start.outstanding) {
+		printf("%llu plugin allocations, %llu bmalloc / brealloc calls, %ld more outstanding\n",
+		       (unsigned long long)(end.plugin - start.plugin), (unsigned long long)(end.bmem - start.bmem),
+		       end.outstanding - start.outstanding);
+		return true;
+	}
+	return false;
+}
+
+TEST(the_tracker_sees_plugin_allocations)
+{
+	const struct alloc_counts start = alloc_counts_now();
+	int *value = new int(1);
+	delete value;
+	void *block = bmalloc(16);
+	bfree(block);
+	const struct alloc_counts end = alloc_counts_now();
+
+	CHECK(end.plugin == start.plugin + 1);
+	CHECK(end.bmem == start.bmem + 1);
+	CHECK(end.outstanding == start.outstanding);
+}
+
+TEST(memory_share_frames_dont_allocate)
+{
+	const uint32_t width = 256, height = 144, pitch = width * 4;
+	std::vector<uint8_t> pixels((size_t)pitch * height);
+	struct win_spout_shm_writer *writer = win_spout_shm_writer_create("test-alloc-shm");
+	struct win_spout_shm_reader *reader = win_spout_shm_reader_open("test-alloc-shm");
+	CHECK(writer && reader);
+	if (!writer || !reader)
+		return;
+
+	uint64_t reads = 0;
+	CHECK(!frames_allocate([&](uint64_t n) {
+		// a tile changes every frame, all of it every so often
+		if (n % 60 == 0)
+			memset(pixels.data(), (int)n, pixels.size());
+		pixels[(n * 64) % pixels.size()] = (uint8_t)n;
+		win_spout_shm_writer_publish(writer, pixels.data(), pitch, width, height);
+
+		const uint8_t *read_pixels;
+		uint32_t read_pitch, read_width, read_height;
+		if (win_spout_shm_reader_read(reader, &read_pixels, &read_pitch, &read_width, &read_height))
+			reads++;
+	}));
+	CHECK(reads == WIN_SPOUT_ALLOC_WARMUP_FRAMES + FRAMES);
+
+	win_spout_shm_reader_destroy(reader);
+	win_spout_shm_writer_destroy(writer);
+}
+
+TEST(conversion_doesnt_allocate)
+{
+	const uint32_t width = 320, height = 180;
+	std::vector<uint8_t> src((size_t)width * 4 * height, 0x80);
+	std::vector<uint8_t> y((size_t)width * height), u((size_t)width * height / 2), v((size_t)width * height / 4);
+	uint8_t *const planes[3] = {y.data(), u.data(), v.data()};
+	const uint32_t nv12_linesizes[3] = {width, width, 0};
+	const uint32_t i420_linesizes[3] = {width, width / 2, width / 2};
+
+	CHECK(!frames_allocate([&](uint64_t n) {
+		src[n % src.size()] = (uint8_t)n;
+		if (n % 2)
+			win_spout_convert(WIN_SPOUT_CONVERT_NV12, src.data(), width * 4, false, width, height, planes,
+					  nv12_linesizes);
+		else
+			win_spout_convert(WIN_SPOUT_CONVERT_I420, src.data(), width * 4, false, width, height, planes,
+					  i420_linesizes);
+	}));
+}
+
+TEST(audio_packets_dont_allocate)
+{
+	struct win_spout_audio *writer = win_spout_audio_create("test-alloc-audio", 48000, 2);
+	struct win_spout_audio *audio = win_spout_audio_open("test-alloc-audio");
+	CHECK(writer && audio);
+	if (!writer || !audio)
+		return;
+
+	float samples[480] = {};
+	const float *in[2] = {samples, samples};
+	std::vector<float> out[2] = {std::vector<float>(1024), std::vector<float>(1024)};
+	float *out_planes[2] = {out[0].data(), out[1].data()};
+	struct win_spout_audio_reader reader = {};
+
+	uint64_t frames_read = 0;
+	CHECK(!frames_allocate([&](uint64_t n) {
+		win_spout_audio_shared_write(win_spout_audio_get_shared(writer), in, 480, n * 10000000ULL);
+		uint64_t timestamp;
+		frames_read += win_spout_audio_shared_read(win_spout_audio_get_shared(audio), &reader, out_planes,
+							   1024, &timestamp);
+	}));
+	CHECK(frames_read > 0);
+
+	win_spout_audio_destroy(audio);
+	win_spout_audio_destroy(writer);
+}
+
+TEST(receiver_pacing_doesnt_allocate)
+{
+	struct win_spout_jitter jitter;
+	win_spout_jitter_init(&jitter, 4, 2 * FRAME_NS);
+
+	int a = 0, b = 0;
+	struct win_spout_sync_group *group = win_spout_sync_join("test-alloc", &a, FRAME_NS * 2);
+	win_spout_sync_join("test-alloc", &b, FRAME_NS * 2);
+
+	uint64_t presented = 0;
+	CHECK(!frames_allocate([&](uint64_t n) {
+		const uint64_t now = (n + 1) * FRAME_NS;
+		win_spout_jitter_push(&jitter, now - FRAME_NS / 2);
+		presented += win_spout_jitter_present(&jitter, now) >= 0 ? 1 : 0;
+
+		win_spout_sync_publish(group, &a, now);
+		win_spout_sync_publish(group, &b, now);
+		win_spout_sync_ready(group, now, FRAME_NS);
+	}));
+	CHECK(presented > FRAMES);
+
+	win_spout_sync_leave(group, &a);
+	win_spout_sync_leave(group, &b);
+}
+
+TEST(governor_ticks_dont_allocate)
+{
+	struct win_spout_governor_member *members[3];
+	for (int i = 0; i < 3; i++)
+		members[i] = win_spout_governor_join("test-alloc", i + 1, false);
+
+	uint64_t lagged = 0;
+	CHECK(!frames_allocate([&](uint64_t n) {
+		// lagging on and off, so levels go both ways
+		lagged += (n / 600) % 2 ? 1 : 0;
+		win_spout_governor_tick(n * FRAME_NS, n, lagged);
+		for (int i = 0; i < 3; i++) {
+			win_spout_governor_level(members[i]);
+			win_spout_governor_record(members[i], 4000000);
+		}
+	}));
+
+	for (int i = 0; i < 3; i++)
+		win_spout_governor_leave(members[i]);
+}
@@ -0,0 +1,238 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <vector>
+#include <util/bmem.h>
+#include "win-spout-audio.h"
+#include "test.h"
+
+#define RATE 48000
+#define CHANNELS 2
+#define PACKET 480
+#define START_NS 5000000000ULL
+
+// Sample values carry their position and channel, so any misplaced copy shows up
+static float sample_at(uint64_t pos, uint32_t ch)
+{
+	return (float)(pos % 1000000) + (float)ch * 1000000.0f;
+}
+
+static uint64_t time_at(uint64_t pos)
+{
+	return START_NS + pos * 1000000000ULL / RATE;
+}
+
+struct ring {
+	struct win_spout_audio_shared *shared;
+	uint64_t written;
+
+	ring(uint64_t session = 1)
+	{
+		shared = (struct win_spout_audio_shared *)bzalloc(win_spout_audio_shared_size());
+		win_spout_audio_shared_init(shared, RATE, CHANNELS, session);
+		written = 0;
+	}
+	~ring() { bfree(shared); }
+
+	// frames from the writer's position on, stamped at time
+	void write(uint32_t frames, uint64_t time)
+	{
+		std::vector<float> data[CHANNELS];
+		const float *planes[CHANNELS];
+		for (uint32_t ch = 0; ch < CHANNELS; ch++) {
+			data[ch].resize(frames);
+			for (uint32_t i = 0; i < frames; i++)
+				data[ch][i] = sample_at(written + i, ch);
+			planes[ch] = data[ch].data();
+		}
+		win_spout_audio_shared_write(shared, planes, frames, time);
+		written += frames;
+	}
+
+	void write(uint32_t frames) { write(frames, time_at(written)); }
+};
+
+struct reader {
+	struct win_spout_audio_reader state = {};
+	std::vector<float> data[CHANNELS];
+	float *planes[CHANNELS];
+
+	reader()
+	{
+		for (uint32_t ch = 0; ch < CHANNELS; ch++) {
+			data[ch].resize(WIN_SPOUT_AUDIO_CAPACITY);
+			planes[ch] = data[ch].data();
+		}
+	}
+
+	uint32_t read(struct ring &r, uint32_t max_frames, uint64_t *timestamp)
+	{
+		return win_spout_audio_shared_read(r.shared, &state, planes, max_frames, timestamp);
+	}
+
+	// the frames just read are the ones written at pos
+	bool holds(uint64_t pos, uint32_t frames) const
+	{
+		for (uint32_t ch = 0; ch < CHANNELS; ch++) {
+			for (uint32_t i = 0; i < frames; i++) {
+				if (data[ch][i] != sample_at(pos + i, ch))
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+TEST(samples_and_times_survive_the_wrap)
+{
+	struct ring r;
+	struct reader rd;
+	uint64_t timestamp;
+
+	uint32_t format_rate, format_channels;
+	CHECK(win_spout_audio_shared_format(r.shared, &format_rate, &format_channels));
+	CHECK(format_rate == RATE && format_channels == CHANNELS);
+
+	// a new reader starts at the newest sample
+	r.write(PACKET);
+	CHECK(rd.read(r, 1024, &timestamp) == 0);
+	CHECK(rd.state.read_pos == PACKET);
+
+	bool ordered = true;
+	bool aligned = true;
+	uint64_t pos = PACKET;
+	for (int packet = 0; packet < 1000; packet++) {
+		r.write(PACKET);
+		uint32_t frames;
+		while ((frames = rd.read(r, 1024, &timestamp))) {
+			ordered = ordered && rd.holds(pos, frames);
+			aligned = aligned && timestamp == time_at(pos);
+			pos += frames;
+		}
+	}
+
+	// several times round the ring
+	CHECK(r.written > WIN_SPOUT_AUDIO_CAPACITY * 5);
+	CHECK(pos == r.written);
+	CHECK(ordered);
+	CHECK(aligned);
+	CHECK(rd.state.overruns == 0);
+}
+
+TEST(a_timestamp_jump_splits_the_read)
+{
+	struct ring r;
+	struct reader rd;
+	uint64_t timestamp;
+
+	r.write(PACKET);
+	rd.read(r, 1024, &timestamp);
+
+	// OBS's audio times follow the sample count to within a millisecond
+	r.write(PACKET, time_at(r.written) + 1000000);
+	// then jump a second
+	const uint64_t jump_pos = r.written;
+	const uint64_t jump_time = time_at(jump_pos) + 1000000000ULL;
+	r.write(PACKET, jump_time);
+	r.write(PACKET, jump_time + PACKET * 1000000000ULL / RATE);
+
+	CHECK(rd.read(r, 4096, &timestamp) == PACKET);
+	CHECK(timestamp == time_at(PACKET));
+	CHECK(rd.holds(PACKET, PACKET));
+
+	CHECK(rd.read(r, 4096, &timestamp) == PACKET * 2);
+	CHECK(timestamp == jump_time);
+	CHECK(rd.holds(jump_pos, PACKET * 2));
+}
+
+TEST(a_reader_that_falls_behind_skips_ahead)
+{
+	struct ring r;
+	struct reader rd;
+	uint64_t timestamp;
+
+	r.write(PACKET);
+	rd.read(r, 1024, &timestamp);
+	for (int packet = 0; packet < 120; packet++)
+		r.write(PACKET);
+
+	uint32_t frames = rd.read(r, 1024, &timestamp);
+	uint64_t pos = r.written - WIN_SPOUT_AUDIO_CAPACITY / 4;
+	CHECK(rd.state.overruns == 1);
+	CHECK(frames == 1024);
+	CHECK(rd.holds(pos, frames));
+	CHECK(timestamp == time_at(pos));
+}
+
+TEST(an_oversized_packet_keeps_its_newest_samples)
+{
+	struct ring r;
+	struct reader rd;
+	uint64_t timestamp;
+
+	rd.read(r, 1024, &timestamp);
+	r.write(WIN_SPOUT_AUDIO_CAPACITY + 1000);
+
+	// whatever is kept is where it was written and timed as such, to
+	// within the rounding of the skipped samples' time
+	uint32_t frames = rd.read(r, WIN_SPOUT_AUDIO_CAPACITY, &timestamp);
+	CHECK(frames > 0);
+	CHECK(frames < WIN_SPOUT_AUDIO_CAPACITY);
+	uint64_t pos = r.written - frames;
+	CHECK(rd.holds(pos, frames));
+	CHECK(timestamp + 1 >= time_at(pos) && timestamp <= time_at(pos));
+	// that's still more than a reader may be behind by
+	CHECK(rd.state.overruns == 1);
+}
+
+TEST(a_new_session_restarts_readers)
+{
+	struct ring r(1);
+	struct reader rd;
+	uint64_t timestamp;
+
+	r.write(PACKET);
+	rd.read(r, 1024, &timestamp);
+	r.write(PACKET);
+
+	win_spout_audio_shared_init(r.shared, RATE, CHANNELS, 2);
+	r.written = 0;
+	r.write(PACKET);
+	CHECK(rd.read(r, 1024, &timestamp) == 0);
+	CHECK(rd.state.session == 2);
+
+	r.write(PACKET);
+	CHECK(rd.read(r, 1024, &timestamp) == PACKET);
+	CHECK(rd.holds(PACKET, PACKET));
+}
+
+TEST(readers_see_the_writer_go)
+{
+	struct win_spout_audio *writer = win_spout_audio_create("test-audio-liveness", RATE, CHANNELS);
+	CHECK(writer != nullptr);
+	struct win_spout_audio *audio = win_spout_audio_open("test-audio-liveness");
+	CHECK(audio != nullptr);
+	if (!writer || !audio)
+		return;
+
+	struct win_spout_audio_shared *shared = win_spout_audio_get_shared(audio);
+	CHECK(win_spout_audio_shared_alive(shared));
+
+	float samples[PACKET] = {};
+	const float *planes[CHANNELS] = {samples, samples};
+	win_spout_audio_shared_write(win_spout_audio_get_shared(writer), planes, PACKET, START_NS);
+	CHECK(win_spout_audio_shared_write_pos(shared) == PACKET);
+
+	win_spout_audio_destroy(writer);
+	CHECK(!win_spout_audio_shared_alive(shared));
+	CHECK(win_spout_audio_open("test-audio-liveness") == nullptr);
+
+	win_spout_audio_destroy(audio);
+	CHECK(win_spout_audio_open("test-audio-missing") == nullptr);
+}
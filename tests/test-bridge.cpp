@@ -0,0 +1,128 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <util/platform.h>
+#include "win-spout-bridge.h"
+#include "test.h"
+
+/**
+ * The bridge end to end over loopback: a sender and a receiver on this
+ * host, frames checked pixel for pixel, with the throughput and added
+ * latency reported (timing isn't checked, it depends on the machine).
+ */
+#define WIDTH 1280
+#define HEIGHT 720
+#define PITCH (WIDTH * 4 + 64)
+#define FRAMES 60
+
+// A frame that's mostly flat with a moving bar and some noise, so slices code differently
+static void fill_frame(std::vector<uint8_t> &pixels, uint32_t n)
+{
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		for (uint32_t x = 0; x < WIDTH; x++) {
+			uint8_t *px = &pixels[(size_t)y * PITCH + x * 4];
+			bool bar = (x + n * 16) % WIDTH < 64;
+			bool noisy = y < 32 && x < 256;
+			px[0] = noisy ? (uint8_t)rand() : bar ? 255 : (uint8_t)(x / 8);
+			px[1] = noisy ? (uint8_t)rand() : (uint8_t)(y / 4);
+			px[2] = (uint8_t)n;
+			px[3] = 255;
+		}
+	}
+}
+
+static bool frame_matches(const std::vector<uint8_t> &pixels, const struct win_spout_bridge_frame *frame)
+{
+	if (frame->width != WIDTH || frame->height != HEIGHT)
+		return false;
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		if (memcmp(&pixels[(size_t)y * PITCH], frame->pixels + (size_t)y * WIDTH * 4, WIDTH * 4) != 0)
+			return false;
+	}
+	return true;
+}
+
+TEST(frames_cross_loopback_intact)
+{
+	srand(40);
+	const uint16_t port = (uint16_t)(20000 + getpid() % 20000);
+	struct win_spout_bridge_sender *sender = win_spout_bridge_sender_create("test-bridge", "127.0.0.1", port);
+	CHECK(sender != nullptr);
+	if (!sender)
+		return;
+
+	char address[32];
+	snprintf(address, sizeof(address), "127.0.0.1:%u", port);
+	struct win_spout_bridge_receiver *receiver = win_spout_bridge_receiver_create(address);
+	CHECK(receiver != nullptr);
+
+	std::vector<uint8_t> pixels((size_t)PITCH * HEIGHT);
+	struct win_spout_bridge_frame frame = {};
+
+	// frames only go out once the sender has accepted the receiver
+	bool connected = false;
+	for (int i = 0; i < 50 && receiver && !connected; i++) {
+		fill_frame(pixels, 0);
+		win_spout_bridge_sender_send(sender, pixels.data(), PITCH, WIDTH, HEIGHT);
+		connected = win_spout_bridge_receiver_read(receiver, &frame, 100);
+	}
+	CHECK(connected);
+
+	// one frame in flight at a time, so none are skipped
+	uint32_t received = 0;
+	uint64_t latency_ns = 0, worst_ns = 0;
+	bool intact = true;
+	uint64_t last_frame_number = frame.frame_number;
+	const uint64_t start = os_gettime_ns();
+	for (uint32_t n = 1; connected && n <= FRAMES; n++) {
+		fill_frame(pixels, n);
+		win_spout_bridge_sender_send(sender, pixels.data(), PITCH, WIDTH, HEIGHT);
+		if (!win_spout_bridge_receiver_read(receiver, &frame, 2000))
+			continue;
+
+		uint64_t now = os_gettime_ns();
+		uint64_t latency = now - frame.send_time;
+		latency_ns += latency;
+		worst_ns = latency > worst_ns ? latency : worst_ns;
+		intact = intact && frame_matches(pixels, &frame) && frame.frame_number == last_frame_number + 1;
+		last_frame_number = frame.frame_number;
+		received++;
+	}
+	const uint64_t elapsed = os_gettime_ns() - start;
+
+	CHECK(received == FRAMES);
+	CHECK(intact);
+	if (received) {
+		printf("bridge loopback %ux%u: %u frames, %.1f fps one at a time, latency avg %.2f ms max %.2f ms\n",
+		       WIDTH, HEIGHT, received, received / ((double)elapsed / 1000000000.0),
+		       (double)latency_ns / received / 1000000.0, (double)worst_ns / 1000000.0);
+	}
+
+	win_spout_bridge_receiver_destroy(receiver);
+	win_spout_bridge_sender_destroy(sender);
+}
+
+TEST(receiver_without_a_sender_waits)
+{
+	// nothing listens on the port, reads time out and keep retrying
+	struct win_spout_bridge_receiver *receiver = win_spout_bridge_receiver_create("127.0.0.1:1");
+	CHECK(receiver != nullptr);
+	if (!receiver)
+		return;
+	struct win_spout_bridge_frame frame = {};
+	CHECK(!win_spout_bridge_receiver_read(receiver, &frame, 10));
+	CHECK(!win_spout_bridge_receiver_read(receiver, &frame, 10));
+	win_spout_bridge_receiver_destroy(receiver);
+
+	CHECK(win_spout_bridge_receiver_create("") == nullptr);
+}
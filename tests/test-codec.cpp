@@ -0,0 +1,268 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <util/platform.h>
+#include "win-spout-codec.h"
+#include "test.h"
+
+enum pattern {
+	PATTERN_FLAT,
+	PATTERN_NOISE,
+	PATTERN_GRADIENT,
+	// flat areas, gradients, a noisy patch and alpha changes, like a desktop or an overlay
+	PATTERN_MIXED,
+};
+
+// BGRA pixels at a line pitch with padding, which the encoder must skip
+struct frame {
+	uint32_t width, height, pitch;
+	std::vector<uint8_t> pixels;
+
+	frame(uint32_t w, uint32_t h, enum pattern p) : width(w), height(h), pitch(w * 4 + 12)
+	{
+		pixels.resize((size_t)pitch * h, 0xcd);
+		for (uint32_t y = 0; y < h; y++) {
+			for (uint32_t x = 0; x < w; x++) {
+				uint8_t *px = &pixels[(size_t)y * pitch + x * 4];
+				switch (p) {
+				case PATTERN_FLAT:
+					px[0] = 40, px[1] = 80, px[2] = 120, px[3] = 255;
+					break;
+				case PATTERN_NOISE:
+					for (int c = 0; c < 4; c++)
+						px[c] = (uint8_t)rand();
+					break;
+				case PATTERN_GRADIENT:
+					px[0] = (uint8_t)x, px[1] = (uint8_t)(x + y), px[2] = (uint8_t)y, px[3] = 255;
+					break;
+				case PATTERN_MIXED: {
+					bool noisy = x > w / 2 && x < w / 2 + w / 16 && y < h / 4;
+					px[0] = noisy ? (uint8_t)rand() : (uint8_t)(x / 8);
+					px[1] = noisy ? (uint8_t)rand() : (uint8_t)(y < h / 2 ? 30 : y / 4);
+					px[2] = noisy ? (uint8_t)rand() : (uint8_t)(x < w / 3 ? 200 : 60);
+					px[3] = y > h - h / 8 ? (uint8_t)(x * 255 / w) : 255;
+					break;
+				}
+				}
+			}
+		}
+	}
+
+	const uint8_t *row(uint32_t y) const { return &pixels[(size_t)y * pitch]; }
+};
+
+// Slices laid out as the bridge does, coded independently
+struct slice_job {
+	const struct frame *src;
+	uint32_t rows_per_slice;
+	std::vector<std::vector<uint8_t>> coded;
+	std::vector<size_t> sizes;
+	std::vector<uint8_t> decoded;
+	std::vector<bool> ok;
+	std::vector<uint64_t> encode_ns, decode_ns;
+
+	slice_job(const struct frame *f, uint32_t count)
+		: src(f),
+		  rows_per_slice((f->height + count - 1) / count),
+		  coded(count),
+		  sizes(count),
+		  decoded((size_t)f->width * f->height * 4 + 4, 0),
+		  ok(count),
+		  encode_ns(count),
+		  decode_ns(count)
+	{
+	}
+
+	uint32_t first_row(uint32_t slice) const { return slice * rows_per_slice; }
+	uint32_t rows(uint32_t slice) const
+	{
+		uint32_t first = first_row(slice);
+		uint32_t left = first < src->height ? src->height - first : 0;
+		return left < rows_per_slice ? left : rows_per_slice;
+	}
+};
+
+static void encode_slice(void *param, uint32_t slice)
+{
+	struct slice_job *job = (slice_job *)param;
+	uint32_t first = job->first_row(slice), rows = job->rows(slice);
+	job->coded[slice].resize(win_spout_codec_max_size(job->src->width, rows));
+	uint64_t start = os_gettime_ns();
+	job->sizes[slice] = win_spout_codec_encode(rows ? job->src->row(first) : nullptr, job->src->pitch,
+						   job->src->width, rows, job->coded[slice].data());
+	job->encode_ns[slice] = os_gettime_ns() - start;
+}
+
+static void decode_slice(void *param, uint32_t slice)
+{
+	struct slice_job *job = (slice_job *)param;
+	uint32_t first = job->first_row(slice), rows = job->rows(slice);
+	uint64_t start = os_gettime_ns();
+	job->ok[slice] = win_spout_codec_decode(job->coded[slice].data(), job->sizes[slice], job->src->width, rows,
+						&job->decoded[(size_t)first * job->src->width * 4]);
+	job->decode_ns[slice] = os_gettime_ns() - start;
+}
+
+static bool matches(const struct slice_job &job)
+{
+	const struct frame *f = job.src;
+	for (uint32_t y = 0; y < f->height; y++) {
+		if (memcmp(f->row(y), &job.decoded[(size_t)y * f->width * 4], (size_t)f->width * 4) != 0)
+			return false;
+	}
+	// nothing past the frame was written
+	const uint8_t *guard = &job.decoded[(size_t)f->width * f->height * 4];
+	return guard[0] == 0 && guard[1] == 0 && guard[2] == 0 && guard[3] == 0;
+}
+
+TEST(slices_round_trip)
+{
+	srand(40);
+	struct win_spout_slice_pool *pool = win_spout_slice_pool_create(3);
+	CHECK(pool != nullptr);
+	if (!pool)
+		return;
+
+	const uint32_t sizes[][2] = {{1, 1}, {3, 2}, {17, 5}, {63, 64}, {640, 37}, {1281, 33}};
+	const uint32_t slice_counts[] = {1, 3, 16};
+	const enum pattern patterns[] = {PATTERN_FLAT, PATTERN_NOISE, PATTERN_GRADIENT, PATTERN_MIXED};
+	bool all_ok = true, all_match = true, within_max = true;
+	for (const auto &size : sizes) {
+		for (enum pattern p : patterns) {
+			struct frame f(size[0], size[1], p);
+			for (uint32_t count : slice_counts) {
+				struct slice_job job(&f, count);
+				win_spout_slice_pool_run(pool, encode_slice, &job, count);
+				win_spout_slice_pool_run(pool, decode_slice, &job, count);
+				for (uint32_t i = 0; i < count; i++) {
+					all_ok = all_ok && job.ok[i];
+					within_max = within_max &&
+						     job.sizes[i] <= win_spout_codec_max_size(f.width, job.rows(i));
+				}
+				all_match = all_match && matches(job);
+			}
+		}
+	}
+	CHECK(all_ok);
+	CHECK(all_match);
+	CHECK(within_max);
+
+	win_spout_slice_pool_destroy(pool);
+}
+
+TEST(flat_frames_are_runs)
+{
+	struct frame f(256, 64, PATTERN_FLAT);
+	std::vector<uint8_t> coded(win_spout_codec_max_size(f.width, f.height));
+	size_t size = win_spout_codec_encode(f.row(0), f.pitch, f.width, f.height, coded.data());
+	// one literal, then runs of 62
+	CHECK(size <= 5 + (f.width * f.height) / 62 + 1);
+}
+
+TEST(malformed_streams_are_rejected)
+{
+	srand(41);
+	struct frame f(97, 13, PATTERN_MIXED);
+	std::vector<uint8_t> coded(win_spout_codec_max_size(f.width, f.height) + 1);
+	size_t size = win_spout_codec_encode(f.row(0), f.pitch, f.width, f.height, coded.data());
+	std::vector<uint8_t> out((size_t)f.width * f.height * 4 + 4, 0);
+	CHECK(win_spout_codec_decode(coded.data(), size, f.width, f.height, out.data()));
+
+	// every truncation
+	bool truncated_rejected = true;
+	for (size_t len = 0; len < size; len++)
+		truncated_rejected = truncated_rejected &&
+				     !win_spout_codec_decode(coded.data(), len, f.width, f.height, out.data());
+	CHECK(truncated_rejected);
+
+	// bytes left over after the last pixel
+	coded[size] = 0xc0;
+	CHECK(!win_spout_codec_decode(coded.data(), size + 1, f.width, f.height, out.data()));
+
+	// a run past the end of the slice
+	const uint8_t overrun[] = {0xc0 | 61, 0xc0 | 61};
+	CHECK(!win_spout_codec_decode(overrun, sizeof(overrun), 100, 1, out.data()));
+	// a literal cut short
+	const uint8_t short_literal[] = {0xff, 1, 2};
+	CHECK(!win_spout_codec_decode(short_literal, sizeof(short_literal), 1, 1, out.data()));
+	CHECK(!win_spout_codec_decode(nullptr, 0, 1, 1, out.data()));
+
+	// random corruption is either rejected or decodes to something, never writes past the slice
+	bool guarded = true;
+	std::vector<uint8_t> corrupt(coded.begin(), coded.begin() + size);
+	for (int i = 0; i < 2000; i++) {
+		std::vector<uint8_t> damaged = corrupt;
+		for (int n = 1 + rand() % 4; n > 0; n--)
+			damaged[(size_t)rand() % damaged.size()] = (uint8_t)rand();
+		memset(out.data(), 0, out.size());
+		win_spout_codec_decode(damaged.data(), damaged.size(), f.width, f.height, out.data());
+		const uint8_t *guard = &out[(size_t)f.width * f.height * 4];
+		guarded = guarded && !guard[0] && !guard[1] && !guard[2] && !guard[3];
+	}
+	CHECK(guarded);
+
+	// and so is noise
+	for (int i = 0; i < 2000; i++) {
+		std::vector<uint8_t> noise(1 + rand() % 64);
+		for (uint8_t &b : noise)
+			b = (uint8_t)rand();
+		memset(out.data(), 0, out.size());
+		win_spout_codec_decode(noise.data(), noise.size(), f.width, f.height, out.data());
+		const uint8_t *guard = &out[(size_t)f.width * f.height * 4];
+		guarded = guarded && !guard[0] && !guard[1] && !guard[2] && !guard[3];
+	}
+	CHECK(guarded);
+}
+
+/**
+ * Benchmark: a 1080p frame in the bridge's 16 slices on this host.
+ * Timing isn't checked, it depends on the machine; the ratio is.
+ */
+TEST(benchmark_1080p)
+{
+	srand(42);
+	struct win_spout_slice_pool *pool = win_spout_slice_pool_create(0);
+	const enum pattern patterns[] = {PATTERN_MIXED, PATTERN_GRADIENT, PATTERN_NOISE};
+	const char *names[] = {"mixed", "gradient", "noise"};
+	const int iterations = 20;
+	const uint32_t count = 16;
+	double mixed_ratio = 0.0;
+
+	for (int p = 0; p < 3; p++) {
+		struct frame f(1920, 1080, patterns[p]);
+		struct slice_job job(&f, count);
+		uint64_t encode_ns = 0, decode_ns = 0;
+		size_t coded = 0;
+		bool ok = true;
+		for (int i = 0; i < iterations; i++) {
+			win_spout_slice_pool_run(pool, encode_slice, &job, count);
+			win_spout_slice_pool_run(pool, decode_slice, &job, count);
+			for (uint32_t s = 0; s < count; s++) {
+				encode_ns += job.encode_ns[s];
+				decode_ns += job.decode_ns[s];
+				ok = ok && job.ok[s];
+				coded += i == 0 ? job.sizes[s] : 0;
+			}
+		}
+		CHECK(ok && matches(job));
+
+		double ratio = (double)f.width * f.height * 4 / (double)coded;
+		if (patterns[p] == PATTERN_MIXED)
+			mixed_ratio = ratio;
+		printf("codec %s 1920x1080: ratio %.2f:1, encode %.0f us/slice, decode %.0f us/slice\n", names[p],
+		       ratio, (double)encode_ns / (iterations * count) / 1000.0,
+		       (double)decode_ns / (iterations * count) / 1000.0);
+	}
+
+	CHECK(mixed_ratio > 4.0);
+	win_spout_slice_pool_destroy(pool);
+}
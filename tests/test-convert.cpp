@@ -0,0 +1,146 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "win-spout-convert.h"
+#include "test.h"
+
+// The formulas from win-spout-convert.h, pixel by pixel
+static uint8_t ref_dot(const int *coeffs, int r, int g, int b, int offset)
+{
+	return (uint8_t)(((coeffs[0] * r + coeffs[1] * g + coeffs[2] * b + 128) >> 8) + offset);
+}
+
+static const int ref_y[3] = {47, 157, 16};
+static const int ref_u[3] = {-26, -86, 112};
+static const int ref_v[3] = {112, -102, -10};
+
+struct planes {
+	std::vector<uint8_t> y, u, v;
+};
+
+static void ref_convert(const std::vector<uint8_t> &src, uint32_t pitch, bool rgba, uint32_t width, uint32_t height,
+			struct planes *out)
+{
+	const int ri = rgba ? 0 : 2;
+	const int bi = rgba ? 2 : 0;
+	uint32_t cw = (width + 1) / 2;
+	uint32_t ch = (height + 1) / 2;
+	out->y.resize((size_t)width * height);
+	out->u.resize((size_t)cw * ch);
+	out->v.resize((size_t)cw * ch);
+
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t *p = &src[(size_t)y * pitch + x * 4];
+			out->y[(size_t)y * width + x] = ref_dot(ref_y, p[ri], p[1], p[bi], 16);
+		}
+	}
+
+	for (uint32_t by = 0; by < ch; by++) {
+		for (uint32_t bx = 0; bx < cw; bx++) {
+			int sum[4] = {};
+			for (uint32_t dy = 0; dy < 2; dy++) {
+				for (uint32_t dx = 0; dx < 2; dx++) {
+					uint32_t x = bx * 2 + dx < width ? bx * 2 + dx : width - 1;
+					uint32_t y = by * 2 + dy < height ? by * 2 + dy : height - 1;
+					for (int c = 0; c < 3; c++)
+						sum[c] += src[(size_t)y * pitch + x * 4 + c];
+				}
+			}
+			int avg[3] = {(sum[0] + 2) >> 2, (sum[1] + 2) >> 2, (sum[2] + 2) >> 2};
+			out->u[(size_t)by * cw + bx] = ref_dot(ref_u, avg[ri], avg[1], avg[bi], 128);
+			out->v[(size_t)by * cw + bx] = ref_dot(ref_v, avg[ri], avg[1], avg[bi], 128);
+		}
+	}
+}
+
+static std::vector<uint8_t> random_frame(uint32_t pitch, uint32_t height)
+{
+	std::vector<uint8_t> frame((size_t)pitch * height);
+	for (auto &byte : frame)
+		byte = (uint8_t)rand();
+	return frame;
+}
+
+// Converts with the plugin into padded planes and checks them against the reference
+static bool convert_matches(enum win_spout_convert_format format, uint32_t width, uint32_t height, bool rgba)
+{
+	uint32_t pitch = width * 4 + 12;
+	std::vector<uint8_t> src = random_frame(pitch, height);
+	struct planes ref;
+	ref_convert(src, pitch, rgba, width, height, &ref);
+
+	uint32_t cw = win_spout_convert_chroma_size(width);
+	uint32_t ch = win_spout_convert_chroma_size(height);
+	bool nv12 = format == WIN_SPOUT_CONVERT_NV12;
+	uint32_t linesizes[3] = {width + 5, (nv12 ? cw * 2 : cw) + 3, cw + 7};
+	std::vector<uint8_t> y((size_t)linesizes[0] * height), u((size_t)linesizes[1] * ch),
+		v((size_t)linesizes[2] * ch);
+	uint8_t *planes[3] = {y.data(), u.data(), v.data()};
+	win_spout_convert(format, src.data(), pitch, rgba, width, height, planes, linesizes);
+
+	bool match = true;
+	for (uint32_t row = 0; row < height; row++) {
+		match &= memcmp(&y[(size_t)row * linesizes[0]], &ref.y[(size_t)row * width], width) == 0;
+	}
+	for (uint32_t row = 0; row < ch; row++) {
+		for (uint32_t c = 0; c < cw; c++) {
+			const uint8_t *u_row = &u[(size_t)row * linesizes[1]];
+			uint8_t got_u = nv12 ? u_row[c * 2] : u_row[c];
+			uint8_t got_v = nv12 ? u_row[c * 2 + 1] : v[(size_t)row * linesizes[2] + c];
+			match &= got_u == ref.u[(size_t)row * cw + c] && got_v == ref.v[(size_t)row * cw + c];
+		}
+	}
+	return match;
+}
+
+TEST(matches_reference_at_every_size)
+{
+	srand(1);
+	const uint32_t sizes[][2] = {{1, 1}, {2, 2},  {3, 5},   {7, 3},   {8, 2},
+				     {9, 9}, {16, 4}, {17, 31}, {64, 36}, {1282, 5}};
+	for (const auto &size : sizes) {
+		for (bool rgba : {false, true}) {
+			CHECK(convert_matches(WIN_SPOUT_CONVERT_NV12, size[0], size[1], rgba));
+			CHECK(convert_matches(WIN_SPOUT_CONVERT_I420, size[0], size[1], rgba));
+		}
+	}
+}
+
+TEST(limited_range_extremes)
+{
+	// BGRA: white, black, blue, red
+	const uint8_t colors[][4] = {{255, 255, 255, 255}, {0, 0, 0, 255}, {255, 0, 0, 255}, {0, 0, 255, 255}};
+	const uint8_t expected[][3] = {{235, 128, 128}, {16, 128, 128}, {32, 240, 118}, {63, 102, 240}};
+
+	for (size_t i = 0; i < 4; i++) {
+		std::vector<uint8_t> src(16 * 2 * 4);
+		for (size_t px = 0; px < 32; px++)
+			memcpy(&src[px * 4], colors[i], 4);
+
+		uint8_t y[32], uv[16];
+		uint8_t *planes[2] = {y, uv};
+		uint32_t linesizes[2] = {16, 16};
+		win_spout_convert(WIN_SPOUT_CONVERT_NV12, src.data(), 64, false, 16, 2, planes, linesizes);
+
+		CHECK(y[0] == expected[i][0] && y[31] == expected[i][0]);
+		CHECK(uv[0] == expected[i][1] && uv[14] == expected[i][1]);
+		CHECK(uv[1] == expected[i][2] && uv[15] == expected[i][2]);
+	}
+}
+
+TEST(frame_size)
+{
+	CHECK(win_spout_convert_frame_size(WIN_SPOUT_CONVERT_NV12, 1920, 1080) == 1920 * 1080 * 3 / 2);
+	CHECK(win_spout_convert_frame_size(WIN_SPOUT_CONVERT_I420, 3, 3) == 9 + 2 * 2 * 2);
+	CHECK(win_spout_convert_frame_size(WIN_SPOUT_CONVERT_NONE, 4, 2) == 32);
+}
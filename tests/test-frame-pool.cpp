@@ -0,0 +1,205 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include "win-spout-frame-pool.h"
+#include "test.h"
+
+#define PAGE 4096
+#define MB (1024ULL * 1024)
+
+// The pool is plugin wide, so every test starts from an empty one
+static struct win_spout_frame_pool_stats fresh_pool()
+{
+	win_spout_frame_pool_free_idle();
+	struct win_spout_frame_pool_stats stats;
+	win_spout_frame_pool_get_stats(&stats);
+	return stats;
+}
+
+static struct win_spout_frame_pool_stats pool_stats()
+{
+	struct win_spout_frame_pool_stats stats;
+	win_spout_frame_pool_get_stats(&stats);
+	return stats;
+}
+
+TEST(pitch_is_whole_cache_lines)
+{
+	CHECK(win_spout_frame_pool_pitch(1) == 64);
+	CHECK(win_spout_frame_pool_pitch(64) == 64);
+	CHECK(win_spout_frame_pool_pitch(1920 * 4) == 1920 * 4);
+	CHECK(win_spout_frame_pool_pitch(1366 * 4) == 5504);
+}
+
+TEST(buffers_are_page_aligned_whole_pages)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+
+	struct win_spout_frame_buffer *buffer = win_spout_frame_pool_acquire(1000);
+	CHECK(buffer != nullptr);
+	if (!buffer)
+		return;
+	CHECK(buffer->size == PAGE);
+	CHECK((uintptr_t)buffer->data % PAGE == 0);
+	memset(buffer->data, 0xab, buffer->size);
+	CHECK(pool_stats().resident_bytes == start.resident_bytes + PAGE);
+
+	win_spout_frame_pool_release(buffer);
+	CHECK(win_spout_frame_pool_acquire(0) == nullptr);
+}
+
+TEST(released_buffers_are_reused_by_the_same_size)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+	const size_t size = 1920 * 1080 * 4;
+
+	struct win_spout_frame_buffer *first = win_spout_frame_pool_acquire(size);
+	uint8_t *data = first->data;
+	win_spout_frame_pool_release(first);
+
+	struct win_spout_frame_pool_stats idle = pool_stats();
+	CHECK(idle.misses == start.misses + 1);
+	CHECK(idle.idle_bytes == first->size);
+
+	// any request that rounds to the same pages is a hit
+	struct win_spout_frame_buffer *again = win_spout_frame_pool_acquire(size - 100);
+	struct win_spout_frame_pool_stats hit = pool_stats();
+	CHECK(again->data == data);
+	CHECK(hit.hits == start.hits + 1);
+	CHECK(hit.misses == idle.misses);
+	CHECK(hit.idle_bytes == 0);
+	CHECK(hit.resident_bytes == idle.resident_bytes);
+
+	// a different size is not
+	struct win_spout_frame_buffer *other = win_spout_frame_pool_acquire(size * 2);
+	CHECK(pool_stats().misses == start.misses + 2);
+
+	win_spout_frame_pool_release(again);
+	win_spout_frame_pool_release(other);
+	CHECK(pool_stats().idle_bytes == again->size + other->size);
+	CHECK(fresh_pool().resident_bytes == start.resident_bytes);
+}
+
+TEST(idle_buffers_are_capped_per_size)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+	const size_t size = 64 * PAGE;
+
+	struct win_spout_frame_buffer *buffers[6];
+	for (int i = 0; i < 6; i++)
+		buffers[i] = win_spout_frame_pool_acquire(size);
+	CHECK(pool_stats().resident_bytes == start.resident_bytes + 6 * size);
+
+	for (int i = 0; i < 6; i++)
+		win_spout_frame_pool_release(buffers[i]);
+
+	// four are kept for reuse, the rest freed straight away
+	struct win_spout_frame_pool_stats idle = pool_stats();
+	CHECK(idle.idle_bytes == 4 * size);
+	CHECK(idle.resident_bytes == start.resident_bytes + 4 * size);
+
+	CHECK(fresh_pool().resident_bytes == start.resident_bytes);
+}
+
+TEST(idle_bytes_are_capped)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+
+	// untouched anonymous pages, so this costs address space only
+	const size_t sizes[3] = {200 * MB, 200 * MB + PAGE, 200 * MB + 2 * PAGE};
+	struct win_spout_frame_buffer *buffers[3];
+	for (int i = 0; i < 3; i++)
+		buffers[i] = win_spout_frame_pool_acquire(sizes[i]);
+	for (int i = 0; i < 3; i++)
+		win_spout_frame_pool_release(buffers[i]);
+
+	// the third doesn't fit under 512 MB idle
+	struct win_spout_frame_pool_stats idle = pool_stats();
+	CHECK(idle.idle_bytes == sizes[0] + sizes[1]);
+	CHECK(idle.resident_bytes == start.resident_bytes + sizes[0] + sizes[1]);
+
+	CHECK(fresh_pool().resident_bytes == start.resident_bytes);
+}
+
+TEST(resize_keeps_buffers_that_are_big_enough)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+
+	struct win_spout_frame_buffer *buffer = win_spout_frame_pool_resize(nullptr, 10 * PAGE);
+	CHECK(buffer && buffer->size == 10 * PAGE);
+	CHECK(win_spout_frame_pool_resize(buffer, 5 * PAGE) == buffer);
+
+	// growing swaps it for a bigger one and keeps the old one idle
+	struct win_spout_frame_buffer *bigger = win_spout_frame_pool_resize(buffer, 20 * PAGE);
+	CHECK(bigger->size == 20 * PAGE);
+	struct win_spout_frame_pool_stats stats = pool_stats();
+	CHECK(stats.misses == start.misses + 2);
+	CHECK(stats.idle_bytes == 10 * PAGE);
+
+	win_spout_frame_pool_release(bigger);
+	fresh_pool();
+}
+
+TEST(large_pages_round_to_the_large_page_size)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+	win_spout_frame_pool_set_large_pages(true);
+
+	// falls back to normal pages when no huge pages are reserved
+	struct win_spout_frame_buffer *buffer = win_spout_frame_pool_acquire(3 * MB);
+	CHECK(buffer && buffer->size == 4 * MB);
+	if (buffer) {
+		memset(buffer->data, 0, buffer->size);
+		CHECK(pool_stats().large_page_bytes == start.large_page_bytes + (buffer->large_pages ? 4 * MB : 0));
+	}
+
+	// smaller than a large page stays in normal pages
+	struct win_spout_frame_buffer *small = win_spout_frame_pool_acquire(PAGE);
+	CHECK(small && small->size == PAGE && !small->large_pages);
+
+	win_spout_frame_pool_release(buffer);
+	win_spout_frame_pool_release(small);
+	win_spout_frame_pool_set_large_pages(false);
+	struct win_spout_frame_pool_stats end = fresh_pool();
+	CHECK(end.resident_bytes == start.resident_bytes);
+	CHECK(end.large_page_bytes == start.large_page_bytes);
+}
+
+#define THREADS 4
+#define ROUNDS 2000
+
+static void *churn(void *data)
+{
+	size_t base = (size_t)(uintptr_t)data;
+	for (int i = 0; i < ROUNDS; i++) {
+		struct win_spout_frame_buffer *buffer = win_spout_frame_pool_acquire(base + (size_t)(i % 3) * PAGE);
+		buffer->data[0] = (uint8_t)i;
+		win_spout_frame_pool_release(buffer);
+	}
+	return NULL;
+}
+
+TEST(threads_share_the_pool)
+{
+	struct win_spout_frame_pool_stats start = fresh_pool();
+
+	pthread_t threads[THREADS];
+	for (int i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, churn, (void *)(uintptr_t)(PAGE * 16));
+	for (int i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	struct win_spout_frame_pool_stats stats = pool_stats();
+	CHECK(stats.hits + stats.misses == start.hits + start.misses + THREADS * ROUNDS);
+	// at most one buffer a thread for each of the three sizes is ever made
+	CHECK(stats.misses - start.misses <= THREADS * 3);
+	CHECK(fresh_pool().resident_bytes == start.resident_bytes);
+}
@@ -0,0 +1,153 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "win-spout-governor.h"
+#include "test.h"
+
+#define FPS 60
+#define FRAME_NS 16666667ULL
+#define MS 1000000ULL
+
+// Feeds one period's counters to the policy and applies its answer, returns the index changed
+static int run_period(struct win_spout_governor_policy *policy, uint64_t *total, uint64_t *lagged,
+		      uint64_t period_lagged, struct win_spout_governor_candidate *candidates, size_t count)
+{
+	*total += FPS;
+	*lagged += period_lagged;
+	int delta = 0;
+	int index = win_spout_governor_evaluate(policy, *total, *lagged, candidates, count, &delta);
+	if (index >= 0)
+		candidates[index].level += delta;
+	return index;
+}
+
+TEST(lag_lowers_the_least_important_first_and_restores_the_most_important_first)
+{
+	struct win_spout_governor_candidate candidates[4] = {
+		{2, false, 4 * MS, 0},
+		{2, false, 6 * MS, 0},
+		{8, false, 3 * MS, 0},
+		{1, true, 10 * MS, 0},
+	};
+	struct win_spout_governor_policy policy = {};
+	uint64_t total = 0, lagged = 0;
+
+	// the first period only primes the counters
+	CHECK(run_period(&policy, &total, &lagged, 10, candidates, 4) == -1);
+
+	// the pricier of the two lowest, then the other, then the important one, never the exempt one
+	const int lowered[10] = {1, 1, 1, 0, 0, 0, 2, 2, 2, -1};
+	for (int i = 0; i < 10; i++)
+		CHECK(run_period(&policy, &total, &lagged, 10, candidates, 4) == lowered[i]);
+	CHECK(candidates[3].level == 0);
+
+	// calm has to last, a lagged period starts the count again
+	CHECK(run_period(&policy, &total, &lagged, 0, candidates, 4) == -1);
+	CHECK(run_period(&policy, &total, &lagged, 0, candidates, 4) == -1);
+	CHECK(run_period(&policy, &total, &lagged, 1, candidates, 4) == -1);
+
+	// a level every few calm periods, the cheaper first among equals
+	const int restored[10] = {2, 2, 2, 0, 0, 0, 1, 1, 1, -1};
+	for (int i = 0; i < 10; i++) {
+		CHECK(run_period(&policy, &total, &lagged, 0, candidates, 4) == -1);
+		CHECK(run_period(&policy, &total, &lagged, 0, candidates, 4) == -1);
+		CHECK(run_period(&policy, &total, &lagged, 0, candidates, 4) == restored[i]);
+	}
+	for (int i = 0; i < 4; i++)
+		CHECK(candidates[i].level == 0);
+}
+
+TEST(counters_going_backwards_prime_again)
+{
+	struct win_spout_governor_candidate candidate = {5, false, MS, 0};
+	struct win_spout_governor_policy policy = {};
+	int delta = 0;
+
+	CHECK(win_spout_governor_evaluate(&policy, 600, 0, &candidate, 1, &delta) == -1);
+	CHECK(win_spout_governor_evaluate(&policy, 660, 30, &candidate, 1, &delta) == 0);
+	CHECK(delta == 1);
+	// OBS reset its video, which isn't lag
+	CHECK(win_spout_governor_evaluate(&policy, 60, 0, &candidate, 1, &delta) == -1);
+	CHECK(win_spout_governor_evaluate(&policy, 120, 0, &candidate, 1, &delta) == -1);
+}
+
+/**
+ * A simulated OBS whose render thread does the senders' work every
+ * frame: what goes over the frame budget is lagged. The governor is
+ * ticked every frame with OBS's counters, as the filters do, until the
+ * senders fit.
+ */
+struct sim_sender {
+	int priority;
+	bool exempt;
+	uint64_t cost_ns; // at full quality
+	struct win_spout_governor_member *member;
+};
+
+static uint64_t sim_cost(const struct sim_sender *s, int level)
+{
+	return s->cost_ns / win_spout_governor_divisor(level) / (win_spout_governor_half_size(level) ? 2 : 1);
+}
+
+TEST(simulated_lag_settles_on_the_least_important_sender)
+{
+	struct sim_sender senders[4] = {
+		{1, true, 6 * MS, nullptr},
+		{8, false, 4 * MS, nullptr},
+		{5, false, 5 * MS, nullptr},
+		{2, false, 8 * MS, nullptr},
+	};
+	for (struct sim_sender &s : senders)
+		s.member = win_spout_governor_join("sim", s.priority, s.exempt);
+
+	uint64_t total = 0, lagged = 0;
+	uint64_t over_ns = 0;
+	uint64_t lagged_late = 0;
+	bool ordered = true;
+	const uint64_t seconds = 60;
+	for (uint64_t frame = 1; frame <= seconds * FPS; frame++) {
+		win_spout_governor_tick(frame * FRAME_NS, total, lagged);
+
+		uint64_t load = 0;
+		int levels[4];
+		for (int i = 0; i < 4; i++) {
+			struct sim_sender *s = &senders[i];
+			levels[i] = win_spout_governor_level(s->member);
+			// a send at half size costs less, at a lower rate there are fewer of them
+			const uint64_t send_ns = s->cost_ns / (win_spout_governor_half_size(levels[i]) ? 2 : 1);
+			if (frame % win_spout_governor_divisor(levels[i]) == 0)
+				win_spout_governor_record(s->member, send_ns);
+			load += sim_cost(s, levels[i]);
+		}
+		// the more important keeps the better quality, the exempt one its full quality
+		ordered = ordered && levels[0] == 0 && levels[1] <= levels[2] && levels[2] <= levels[3];
+
+		// the render thread falls a frame behind for each frame's worth of overrun
+		total++;
+		over_ns = load > FRAME_NS ? over_ns + load - FRAME_NS : 0;
+		if (over_ns >= FRAME_NS) {
+			over_ns -= FRAME_NS;
+			lagged++;
+			if (frame > seconds * FPS / 2)
+				lagged_late++;
+		}
+	}
+
+	// it did lag to begin with
+	CHECK(lagged > FPS);
+	CHECK(ordered);
+	// only the priority 2 sender has to give anything up, and its restores are probes that lag briefly
+	CHECK(win_spout_governor_level(senders[1].member) == 0);
+	CHECK(win_spout_governor_level(senders[2].member) == 0);
+	CHECK(win_spout_governor_level(senders[3].member) >= 2);
+	CHECK(lagged_late <= (seconds / 2) / (WIN_SPOUT_GOVERNOR_CALM_PERIODS + 1) + 1);
+
+	for (struct sim_sender &s : senders)
+		win_spout_governor_leave(s.member);
+}
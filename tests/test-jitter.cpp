@@ -0,0 +1,155 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include "win-spout-jitter.h"
+#include "test.h"
+
+/**
+ * A synthetic sender on its own cadence feeding a receiver ticking on
+ * the video clock, as the Spout source does: each tick queues every
+ * frame that has arrived by then and presents the one due. Frames are
+ * stamped on the sender's cadence and arrive up to max_latency later.
+ */
+struct stream {
+	uint32_t send_num, send_den;
+	uint32_t video_num, video_den;
+	int buffer_frames;
+	uint64_t max_latency;
+	uint64_t seconds;
+};
+
+struct stream_result {
+	uint64_t shown;	  // video frames with a sender frame on them
+	uint64_t repeats; // the same frame again
+	uint64_t skips;	  // sender frames never shown
+	bool ordered;
+	bool on_time; // never shown before its timestamp + the delay
+	struct win_spout_jitter jitter;
+};
+
+static uint64_t frame_time(uint64_t i, uint32_t num, uint32_t den)
+{
+	return i * 1000000000ULL * den / num;
+}
+
+static void run_stream(const struct stream *s, struct stream_result *r)
+{
+	*r = {};
+	r->ordered = true;
+	r->on_time = true;
+
+	const uint64_t video_period = frame_time(1, s->video_num, s->video_den);
+	const uint64_t delay = (uint64_t)s->buffer_frames * video_period;
+	win_spout_jitter_init(&r->jitter, s->buffer_frames + 2, delay);
+
+	// half a sender frame in, so the cadences don't start in phase
+	const uint64_t start = frame_time(1, s->send_num, s->send_den) / 2;
+	uint64_t slot_frame[WIN_SPOUT_JITTER_MAX_SLOTS] = {};
+	uint64_t next = 0;
+	int64_t last = -1;
+	srand(7);
+
+	for (uint64_t tick = 1; tick <= s->seconds * s->video_num / s->video_den; tick++) {
+		const uint64_t now = tick * video_period;
+		while (true) {
+			uint64_t timestamp = start + frame_time(next, s->send_num, s->send_den);
+			uint64_t latency = s->max_latency ? (uint64_t)rand() % s->max_latency : 0;
+			if (timestamp + latency > now)
+				break;
+			slot_frame[win_spout_jitter_push(&r->jitter, timestamp)] = next++;
+		}
+
+		int slot = win_spout_jitter_present(&r->jitter, now);
+		if (slot < 0)
+			continue;
+
+		int64_t frame = (int64_t)slot_frame[slot];
+		uint64_t timestamp = start + frame_time((uint64_t)frame, s->send_num, s->send_den);
+		if (timestamp + delay > now)
+			r->on_time = false;
+		if (frame < last)
+			r->ordered = false;
+		else if (frame == last)
+			r->repeats++;
+		else if (last >= 0)
+			r->skips += (uint64_t)(frame - last - 1);
+		last = frame;
+		r->shown++;
+	}
+}
+
+TEST(same_rate_shows_every_frame_once)
+{
+	struct stream s = {60, 1, 60, 1, 2, 8000000, 60};
+	struct stream_result r;
+	run_stream(&s, &r);
+
+	CHECK(r.shown > 3590);
+	CHECK(r.ordered);
+	CHECK(r.on_time);
+	CHECK(r.repeats == 0);
+	CHECK(r.skips == 0);
+	CHECK(r.jitter.late == 0);
+}
+
+TEST(slow_sender_repeats_at_the_drift_rate)
+{
+	// 59.94 into 60 falls behind by a frame every 16.7 s
+	struct stream s = {60000, 1001, 60, 1, 2, 8000000, 100};
+	struct stream_result r;
+	run_stream(&s, &r);
+
+	CHECK(r.ordered);
+	CHECK(r.on_time);
+	CHECK(r.repeats >= 5 && r.repeats <= 7);
+	CHECK(r.skips == 0);
+	CHECK(r.jitter.late == 0);
+	CHECK(r.jitter.early == r.repeats);
+}
+
+TEST(fast_sender_skips_at_the_drift_rate)
+{
+	struct stream s = {60, 1, 60000, 1001, 2, 8000000, 100};
+	struct stream_result r;
+	run_stream(&s, &r);
+
+	CHECK(r.ordered);
+	CHECK(r.on_time);
+	CHECK(r.skips >= 5 && r.skips <= 7);
+	CHECK(r.repeats == 0);
+	CHECK(r.jitter.late == r.skips);
+	CHECK(r.jitter.early == 0);
+}
+
+TEST(latency_beyond_the_delay_is_not_absorbed)
+{
+	// up to two and a half frames late into a one frame buffer
+	struct stream s = {60, 1, 60, 1, 1, 42000000, 60};
+	struct stream_result r;
+	run_stream(&s, &r);
+
+	CHECK(r.ordered);
+	CHECK(r.on_time);
+	CHECK(r.repeats > 0);
+	CHECK(r.skips > 0);
+}
+
+TEST(out_of_order_timestamps_restart_the_queue)
+{
+	struct win_spout_jitter jitter;
+	win_spout_jitter_init(&jitter, 4, 0);
+	win_spout_jitter_push(&jitter, 100);
+	win_spout_jitter_push(&jitter, 200);
+	int slot = win_spout_jitter_push(&jitter, 150);
+
+	CHECK(win_spout_jitter_depth(&jitter) == 1);
+	CHECK(jitter.late == 2);
+	CHECK(win_spout_jitter_present(&jitter, 150) == slot);
+}
@@ -0,0 +1,156 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <util/bmem.h>
+#include "win-spout-key.h"
+#include "test.h"
+
+/* data/spout-key.effect's math in floats, written out to a unorm target */
+
+static uint8_t unorm(float v)
+{
+	return (uint8_t)lrintf(fminf(fmaxf(v, 0.0f), 1.0f) * 255.0f);
+}
+
+static uint8_t shader_key(enum win_spout_key_mode mode, const uint8_t *bgra)
+{
+	if (mode == WIN_SPOUT_KEY_LUMA)
+		return unorm(bgra[2] / 255.0f * 0.2126f + bgra[1] / 255.0f * 0.7152f + bgra[0] / 255.0f * 0.0722f);
+	return bgra[3];
+}
+
+static uint8_t shader_fill(uint8_t c, uint8_t a, bool premultiply)
+{
+	return unorm(c / 255.0f * (premultiply ? a / 255.0f : 1.0f));
+}
+
+static int diff(uint8_t a, uint8_t b)
+{
+	return abs((int)a - (int)b);
+}
+
+TEST(the_reference_matches_the_effect)
+{
+	int worst_luma = 0;
+	int worst_fill = 0;
+	bool alpha_exact = true;
+
+	// every channel value against every other, in steps that keep it quick
+	for (int b = 0; b < 256; b += 3) {
+		for (int g = 0; g < 256; g += 5) {
+			for (int r = 0; r < 256; r += 7) {
+				const uint8_t a = (uint8_t)((r + g + b) % 256);
+				const uint8_t px[4] = {(uint8_t)b, (uint8_t)g, (uint8_t)r, a};
+
+				int d = diff(win_spout_key_value(WIN_SPOUT_KEY_LUMA, px),
+					     shader_key(WIN_SPOUT_KEY_LUMA, px));
+				worst_luma = d > worst_luma ? d : worst_luma;
+				alpha_exact = alpha_exact && win_spout_key_value(WIN_SPOUT_KEY_ALPHA, px) == a;
+			}
+		}
+	}
+
+	for (int c = 0; c < 256; c++) {
+		for (int a = 0; a < 256; a++) {
+			int d = diff(win_spout_key_premultiply((uint8_t)c, (uint8_t)a),
+				     shader_fill((uint8_t)c, (uint8_t)a, true));
+			worst_fill = d > worst_fill ? d : worst_fill;
+		}
+	}
+
+	CHECK(alpha_exact);
+	CHECK(worst_luma <= 1);
+	CHECK(worst_fill <= 1);
+}
+
+TEST(luma_keys_span_the_full_range)
+{
+	const uint8_t black[4] = {0, 0, 0, 255};
+	const uint8_t white[4] = {255, 255, 255, 0};
+	const uint8_t green[4] = {0, 255, 0, 255};
+	CHECK(win_spout_key_value(WIN_SPOUT_KEY_LUMA, black) == 0);
+	CHECK(win_spout_key_value(WIN_SPOUT_KEY_LUMA, white) == 255);
+	CHECK(win_spout_key_value(WIN_SPOUT_KEY_LUMA, green) == 182);
+	// the alpha key ignores the color
+	CHECK(win_spout_key_value(WIN_SPOUT_KEY_ALPHA, white) == 0);
+}
+
+TEST(extract_and_fill_keep_to_their_rows)
+{
+	const uint32_t width = 13, height = 7;
+	const uint32_t bgra_linesize = width * 4 + 12, key_linesize = width + 3;
+	std::vector<uint8_t> bgra((size_t)bgra_linesize * height);
+	for (size_t i = 0; i < bgra.size(); i++)
+		bgra[i] = (uint8_t)(i * 37 + 11);
+
+	std::vector<uint8_t> key((size_t)key_linesize * height, 0xee);
+	win_spout_key_extract(bgra.data(), bgra_linesize, key.data(), key_linesize, width, height,
+			      WIN_SPOUT_KEY_ALPHA);
+
+	std::vector<uint8_t> fill((size_t)bgra_linesize * height, 0xee);
+	win_spout_key_fill(bgra.data(), bgra_linesize, fill.data(), bgra_linesize, width, height, true);
+
+	bool keyed = true, padded = true, filled = true;
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < key_linesize; x++) {
+			const uint8_t *px = &bgra[(size_t)y * bgra_linesize + x * 4];
+			uint8_t k = key[(size_t)y * key_linesize + x];
+			if (x < width)
+				keyed = keyed && k == px[3];
+			else
+				padded = padded && k == 0xee;
+		}
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t *px = &bgra[(size_t)y * bgra_linesize + x * 4];
+			const uint8_t *out = &fill[(size_t)y * bgra_linesize + x * 4];
+			for (int c = 0; c < 3; c++)
+				filled = filled && out[c] == win_spout_key_premultiply(px[c], px[3]);
+			filled = filled && out[3] == 255;
+		}
+		padded = padded && fill[(size_t)y * bgra_linesize + width * 4] == 0xee;
+	}
+	CHECK(keyed);
+	CHECK(padded);
+	CHECK(filled);
+
+	// a straight fill is the color as it is, still opaque
+	win_spout_key_fill(bgra.data(), bgra_linesize, fill.data(), bgra_linesize, width, height, false);
+	CHECK(memcmp(fill.data(), bgra.data(), 3) == 0 && fill[3] == 255);
+}
+
+TEST(the_effect_has_every_technique)
+{
+	gs_effect_t *effect = win_spout_key_effect_create();
+	CHECK(effect != nullptr);
+	gs_effect_destroy(effect);
+
+	char *path = obs_module_file("spout-key.effect");
+	FILE *f = fopen(path, "rb");
+	bfree(path);
+	CHECK(f != nullptr);
+	if (!f)
+		return;
+	std::string text;
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		text.append(buffer, read);
+	fclose(f);
+
+	const char *techniques[4] = {win_spout_key_technique(WIN_SPOUT_KEY_ALPHA),
+				     win_spout_key_technique(WIN_SPOUT_KEY_LUMA), win_spout_key_fill_technique(false),
+				     win_spout_key_fill_technique(true)};
+	for (const char *technique : techniques)
+		CHECK(text.find(std::string("technique ") + technique + "\n") != std::string::npos);
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "test.h"
+
+static struct test_case *test_first;
+static struct test_case **test_last = &test_first;
+static int test_failures;
+
+void test_register(struct test_case *test)
+{
+	*test_last = test;
+	test_last = &test->next;
+}
+
+void test_fail(const char *file, int line, const char *expr)
+{
+	fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+	test_failures++;
+}
+
+int main()
+{
+	int failed_cases = 0;
+	for (struct test_case *test = test_first; test; test = test->next) {
+		int before = test_failures;
+		test->run();
+		bool passed = test_failures == before;
+		failed_cases += passed ? 0 : 1;
+		printf("%s %s\n", passed ? "PASS" : "FAIL", test->name);
+	}
+	return failed_cases ? 1 : 0;
+}
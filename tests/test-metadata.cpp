@@ -0,0 +1,171 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "win-spout-shm.h"
+#include "win-spout-metadata.h"
+#include "test.h"
+
+/**
+ * The start of the shared block in win-spout-metadata.cpp, as a sender
+ * in another process would write it
+ */
+struct shared_metadata {
+	volatile long seq;
+	struct win_spout_frame_metadata frame;
+};
+
+// Frame n, every field derived from n so a torn copy shows
+static struct win_spout_frame_metadata make_metadata(uint64_t n)
+{
+	struct win_spout_frame_metadata frame = {};
+	frame.fps_num = 60000;
+	frame.fps_den = 1001;
+	frame.frame_number = n;
+	frame.obs_timestamp = n * 16683333;
+	frame.send_time = n * 3 + 1;
+	snprintf(frame.scene_name, sizeof(frame.scene_name), "Scene %llu", (unsigned long long)n);
+	frame.pixel_layout = (uint32_t)(n % 3);
+	frame.yuv_matrix = (uint32_t)(n % 2);
+	return frame;
+}
+
+static bool metadata_consistent(const struct win_spout_frame_metadata *frame)
+{
+	struct win_spout_frame_metadata expected = make_metadata(frame->frame_number);
+	expected.version = WIN_SPOUT_METADATA_VERSION;
+	return memcmp(&expected, frame, sizeof(expected)) == 0;
+}
+
+static void sender_name(char *name, size_t size, const char *test)
+{
+	snprintf(name, size, "metadata-test-%s-%d", test, (int)getpid());
+}
+
+TEST(frames_round_trip)
+{
+	char name[64];
+	sender_name(name, sizeof(name), "round-trip");
+	struct win_spout_metadata *sender = win_spout_metadata_create(name);
+	struct win_spout_metadata *receiver = win_spout_metadata_open(name);
+	CHECK(sender != nullptr && receiver != nullptr);
+
+	struct win_spout_frame_metadata frame = make_metadata(7);
+	win_spout_metadata_write(sender, &frame);
+
+	struct win_spout_frame_metadata read = {};
+	CHECK(win_spout_metadata_read(receiver, &read));
+	CHECK(read.version == WIN_SPOUT_METADATA_VERSION);
+	CHECK(metadata_consistent(&read));
+
+	win_spout_metadata_destroy(receiver);
+	win_spout_metadata_destroy(sender);
+}
+
+TEST(missing_sender)
+{
+	CHECK(win_spout_metadata_open("metadata-test-nobody") == nullptr);
+	CHECK(win_spout_metadata_open("") == nullptr);
+	CHECK(win_spout_metadata_open(nullptr) == nullptr);
+
+	struct win_spout_frame_metadata read = {};
+	CHECK(!win_spout_metadata_read(nullptr, &read));
+
+	// a sender that has gone can't be opened
+	char name[64];
+	sender_name(name, sizeof(name), "gone");
+	win_spout_metadata_destroy(win_spout_metadata_create(name));
+	CHECK(win_spout_metadata_open(name) == nullptr);
+
+	// one that never wrote has no version
+	struct win_spout_metadata *sender = win_spout_metadata_create(name);
+	struct win_spout_metadata *receiver = win_spout_metadata_open(name);
+	CHECK(!win_spout_metadata_read(receiver, &read));
+	win_spout_metadata_destroy(receiver);
+	win_spout_metadata_destroy(sender);
+}
+
+TEST(a_torn_write_is_retried)
+{
+	char name[64];
+	sender_name(name, sizeof(name), "torn");
+	struct win_spout_metadata *sender = win_spout_metadata_create(name);
+	struct win_spout_metadata *receiver = win_spout_metadata_open(name);
+	CHECK(sender != nullptr && receiver != nullptr);
+	if (!sender || !receiver)
+		return;
+
+	struct win_spout_frame_metadata frame = make_metadata(1);
+	win_spout_metadata_write(sender, &frame);
+
+	char section_name[80];
+	snprintf(section_name, sizeof(section_name), "%s_OBSMeta", name);
+	struct win_spout_shm_section *section =
+		win_spout_shm_section_open(section_name, sizeof(struct shared_metadata), true);
+	struct shared_metadata *shared = (struct shared_metadata *)win_spout_shm_section_data(section);
+	CHECK(shared != nullptr);
+	if (!shared)
+		return;
+
+	// a writer stopped half way through frame 2: the reader gives up rather than return it
+	struct win_spout_frame_metadata read = {};
+	shared->seq++;
+	shared->frame.frame_number = 2;
+	CHECK(!win_spout_metadata_read(receiver, &read));
+
+	// and sees frame 2 whole once the write is done
+	shared->frame = make_metadata(2);
+	shared->frame.version = WIN_SPOUT_METADATA_VERSION;
+	shared->seq++;
+	CHECK(win_spout_metadata_read(receiver, &read));
+	CHECK(read.frame_number == 2 && metadata_consistent(&read));
+	win_spout_shm_section_destroy(section);
+
+	// with a writer going flat out, what's read is always one whole frame
+	std::atomic<bool> stop(false);
+	std::thread writer([&]() {
+		for (uint64_t n = 3; !stop; n++) {
+			struct win_spout_frame_metadata next = make_metadata(n);
+			win_spout_metadata_write(sender, &next);
+		}
+	});
+
+	int reads = 0, whole = 0;
+	uint64_t last = 0;
+	bool in_order = true;
+	for (int i = 0; i < 200000; i++) {
+		if (!win_spout_metadata_read(receiver, &read))
+			continue;
+		reads++;
+		whole += metadata_consistent(&read) ? 1 : 0;
+		in_order = in_order && read.frame_number >= last;
+		last = read.frame_number;
+	}
+	stop = true;
+	writer.join();
+
+	CHECK(reads > 0);
+	CHECK(whole == reads);
+	CHECK(in_order);
+
+	win_spout_metadata_destroy(receiver);
+	win_spout_metadata_destroy(sender);
+}
+
+TEST(program_name_is_empty_without_a_program)
+{
+	char name[256];
+	memset(name, 'x', sizeof(name));
+	win_spout_metadata_get_program_name(name, sizeof(name));
+	CHECK(name[0] == '\0');
+}
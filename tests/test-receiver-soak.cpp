@@ -0,0 +1,278 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <util/bmem.h>
+#include "win-spout-receiver.h"
+#include "test.h"
+
+/**
+ * Soak: receivers polled on the video clock, as the Spout source does,
+ * against a mock sender registry where hundreds of senders are created,
+ * resized, renamed and destroyed at random. A receiver has to follow
+ * its sender through all of it and connect within a retry of the
+ * sender being there, without the polls allocating anything.
+ */
+#define TICK_MS 16
+#define RETRY_MS 100
+#define SOAK_MINUTES 5
+#define NAMES 400
+#define MAX_SENDERS 300
+#define RECEIVERS 32
+
+struct mock_sender {
+	std::string name;
+	struct win_spout_sender_desc desc;
+};
+
+struct mock_registry {
+	std::vector<mock_sender> senders;
+	uint64_t next_handle = 1;
+	bool in_use[NAMES] = {};
+
+	const mock_sender *find(const char *name) const
+	{
+		for (const mock_sender &sender : senders) {
+			if (sender.name == name)
+				return &sender;
+		}
+		return nullptr;
+	}
+
+	void new_texture(struct win_spout_sender_desc *desc)
+	{
+		desc->width = 64 + (uint32_t)(rand() % 64) * 32;
+		desc->height = 64 + (uint32_t)(rand() % 64) * 16;
+		desc->format = rand() % 4 ? 87 : 28;
+		desc->handle = next_handle++;
+	}
+
+	// a free name, -1 if they're all taken
+	int free_name() const
+	{
+		int start = rand() % NAMES;
+		for (int i = 0; i < NAMES; i++) {
+			if (!in_use[(start + i) % NAMES])
+				return (start + i) % NAMES;
+		}
+		return -1;
+	}
+
+	void create()
+	{
+		int name = free_name();
+		if (name < 0 || senders.size() >= MAX_SENDERS)
+			return;
+		mock_sender sender;
+		sender.name = "sender-" + std::to_string(name);
+		new_texture(&sender.desc);
+		in_use[name] = true;
+		senders.push_back(sender);
+	}
+
+	void destroy(size_t index)
+	{
+		in_use[atoi(senders[index].name.c_str() + 7)] = false;
+		senders[index] = senders.back();
+		senders.pop_back();
+	}
+
+	// Spout has no rename, a sender taking a new name is a new sender
+	void rename(size_t index)
+	{
+		int name = free_name();
+		if (name < 0)
+			return;
+		in_use[atoi(senders[index].name.c_str() + 7)] = false;
+		in_use[name] = true;
+		senders[index].name = "sender-" + std::to_string(name);
+		new_texture(&senders[index].desc);
+	}
+
+	void churn()
+	{
+		for (int ops = rand() % 4; ops > 0; ops--) {
+			int op = rand() % 4;
+			if (op == 0 || senders.empty()) {
+				create();
+				continue;
+			}
+			size_t index = (size_t)rand() % senders.size();
+			if (op == 1)
+				destroy(index);
+			else if (op == 2)
+				new_texture(&senders[index].desc);
+			else
+				rename(index);
+		}
+	}
+};
+
+static int mock_get_sender_count(void *data)
+{
+	return (int)((mock_registry *)data)->senders.size();
+}
+
+static bool mock_get_sender(void *data, int index, char *name, size_t size)
+{
+	mock_registry *registry = (mock_registry *)data;
+	if (index < 0 || (size_t)index >= registry->senders.size())
+		return false;
+	strncpy(name, registry->senders[index].name.c_str(), size - 1);
+	name[size - 1] = 0;
+	return true;
+}
+
+static bool mock_set_active_sender(void *data, const char *name)
+{
+	return ((mock_registry *)data)->find(name) != nullptr;
+}
+
+static bool mock_get_sender_info(void *data, const char *name, struct win_spout_sender_desc *desc)
+{
+	const mock_sender *sender = ((mock_registry *)data)->find(name);
+	if (!sender)
+		return false;
+	*desc = sender->desc;
+	return true;
+}
+
+struct soak_receiver {
+	struct win_spout_receiver receiver;
+	char target[32]; // "" follows the first sender
+	struct win_spout_sender_desc texture;
+	uint64_t available_ms; // the sender has been there since, while not connected
+};
+
+// What win_spout_source_poll does with the events, a rebind failing now and then
+static void soak_poll(struct soak_receiver *r, uint64_t now_ms)
+{
+	struct win_spout_sender_desc desc;
+	enum win_spout_receiver_event event = win_spout_receiver_poll(&r->receiver, now_ms, false, &desc);
+
+	switch (event) {
+	case WIN_SPOUT_RECEIVER_EVENT_CONNECT:
+		r->texture = desc;
+		break;
+	case WIN_SPOUT_RECEIVER_EVENT_REBIND:
+		if (rand() % 10) {
+			r->texture = desc;
+			win_spout_receiver_bound(&r->receiver, &desc);
+		}
+		break;
+	case WIN_SPOUT_RECEIVER_EVENT_LOST:
+		r->texture = {};
+		if (win_spout_receiver_poll(&r->receiver, now_ms, false, &desc) == WIN_SPOUT_RECEIVER_EVENT_CONNECT)
+			r->texture = desc;
+		break;
+	default:
+		break;
+	}
+}
+
+TEST(receivers_follow_a_churning_registry)
+{
+	srand(43);
+	mock_registry registry;
+	for (int i = 0; i < MAX_SENDERS / 2; i++)
+		registry.create();
+
+	struct win_spout_transport transport = {&registry, mock_get_sender_count, mock_get_sender,
+						mock_set_active_sender, mock_get_sender_info};
+
+	const long allocs = bnum_allocs();
+	struct soak_receiver *receivers = (struct soak_receiver *)bzalloc(sizeof(struct soak_receiver) * RECEIVERS);
+	for (int i = 0; i < RECEIVERS; i++) {
+		struct soak_receiver *r = &receivers[i];
+		win_spout_receiver_init(&r->receiver, &transport);
+		r->receiver.retry_ms = RETRY_MS;
+		// a few follow the first sender, the rest one name each
+		if (i % 8)
+			snprintf(r->target, sizeof(r->target), "sender-%d", i * (NAMES / RECEIVERS));
+		win_spout_receiver_set_sender(&r->receiver, r->target);
+	}
+
+	uint64_t worst_ms = 0;
+	uint64_t latency_total_ms = 0;
+	uint64_t latency_count = 0;
+	bool consistent = true;
+
+	test_clock_set(1000000000ULL);
+	const uint64_t bmem_calls = test_bmem_calls();
+	const uint64_t ticks = SOAK_MINUTES * 60 * 1000 / TICK_MS;
+	for (uint64_t tick = 1; tick <= ticks; tick++) {
+		const uint64_t now_ms = tick * TICK_MS;
+		registry.churn();
+
+		for (int i = 0; i < RECEIVERS; i++) {
+			struct soak_receiver *r = &receivers[i];
+			soak_poll(r, now_ms);
+
+			// a bound texture is the sender's current one
+			if (r->receiver.state == WIN_SPOUT_RECEIVER_CONNECTED) {
+				const mock_sender *sender = registry.find(r->receiver.sender_name);
+				consistent = consistent && sender && sender->desc.handle == r->texture.handle &&
+					     sender->desc.width == r->texture.width;
+			}
+
+			bool available = *r->target ? registry.find(r->target) != nullptr : !registry.senders.empty();
+			if (win_spout_receiver_connected(&r->receiver) || !available) {
+				if (r->available_ms && win_spout_receiver_connected(&r->receiver)) {
+					uint64_t latency = now_ms - r->available_ms;
+					latency_total_ms += latency;
+					latency_count++;
+					if (latency > worst_ms)
+						worst_ms = latency;
+				}
+				r->available_ms = 0;
+			} else if (!r->available_ms) {
+				r->available_ms = now_ms;
+			}
+		}
+		test_clock_advance(TICK_MS * 1000000ULL);
+	}
+	test_clock_real();
+
+	// polling never allocates
+	CHECK(test_bmem_calls() == bmem_calls);
+	CHECK(consistent);
+
+	struct win_spout_receiver_stats totals = {};
+	for (int i = 0; i < RECEIVERS; i++) {
+		const struct win_spout_receiver_stats *stats = &receivers[i].receiver.stats;
+		totals.connects += stats->connects;
+		totals.rebinds += stats->rebinds;
+		totals.losses += stats->losses;
+		totals.reconnects += stats->reconnects;
+		totals.reconnect_total_ms += stats->reconnect_total_ms;
+		if (stats->reconnect_max_ms > totals.reconnect_max_ms)
+			totals.reconnect_max_ms = stats->reconnect_max_ms;
+	}
+
+	printf("soak: %llu connects, %llu rebinds, %llu losses, reconnect avg %llu ms max %llu ms, "
+	       "connect after the sender appears avg %llu ms max %llu ms\n",
+	       (unsigned long long)totals.connects, (unsigned long long)totals.rebinds,
+	       (unsigned long long)totals.losses, (unsigned long long)(totals.reconnect_total_ms / totals.reconnects),
+	       (unsigned long long)totals.reconnect_max_ms,
+	       (unsigned long long)(latency_count ? latency_total_ms / latency_count : 0),
+	       (unsigned long long)worst_ms);
+
+	// the churn reached every path
+	CHECK(totals.rebinds > 100);
+	CHECK(totals.losses > 100);
+	CHECK(totals.reconnects > 100);
+	// one retry at most, and the poll that makes it
+	CHECK(worst_ms <= RETRY_MS + TICK_MS);
+
+	bfree(receivers);
+	CHECK(bnum_allocs() == allocs);
+}
@@ -0,0 +1,243 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "win-spout-shm.h"
+#include "win-spout-shm-frame.h"
+#include "test.h"
+
+/**
+ * The memory share between processes: a forked stand-in sender publishes
+ * frames through POSIX shared memory, in lock step with this process
+ * reading them.
+ */
+#define FRAMES 40
+
+struct frame_size {
+	uint32_t width;
+	uint32_t height;
+};
+
+// resizes part way, and isn't a whole number of tiles
+static struct frame_size size_for(int frame)
+{
+	return frame < FRAMES / 2 ? frame_size{200, 130} : frame_size{97, 260};
+}
+
+/**
+ * Frame n: a background that only changes on resize, with one tile
+ * worth of pixels changed per frame so the deltas get exercised, and
+ * every eighth frame changed all over
+ */
+static std::vector<uint8_t> make_frame(int frame, uint32_t pitch)
+{
+	struct frame_size size = size_for(frame);
+	std::vector<uint8_t> pixels((size_t)pitch * size.height);
+	for (uint32_t y = 0; y < size.height; y++) {
+		for (uint32_t x = 0; x < size.width; x++) {
+			uint8_t *px = &pixels[(size_t)y * pitch + x * 4];
+			uint32_t tile = (y / WIN_SPOUT_SHM_TILE_SIZE) * 8 + x / WIN_SPOUT_SHM_TILE_SIZE;
+			int changed = frame % 8 == 7 ? frame : (tile <= (uint32_t)frame % 8 ? frame : 0);
+			px[0] = (uint8_t)(x + changed);
+			px[1] = (uint8_t)(y * 3);
+			px[2] = (uint8_t)(changed * 7);
+			px[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+static void send_byte(int fd)
+{
+	char byte = 0;
+	if (write(fd, &byte, 1) != 1)
+		exit(2);
+}
+
+static bool wait_byte(int fd)
+{
+	char byte;
+	return read(fd, &byte, 1) == 1;
+}
+
+static void stand_in_sender(const char *name, int to_reader, int from_reader)
+{
+	struct win_spout_shm_writer *writer = win_spout_shm_writer_create(name);
+	if (!writer)
+		exit(3);
+
+	send_byte(to_reader);
+	for (int frame = 0; frame < FRAMES; frame++) {
+		wait_byte(from_reader);
+		struct frame_size size = size_for(frame);
+		uint32_t pitch = size.width * 4 + 16;
+		std::vector<uint8_t> pixels = make_frame(frame, pitch);
+		win_spout_shm_writer_publish(writer, pixels.data(), pitch, size.width, size.height);
+		send_byte(to_reader);
+	}
+
+	wait_byte(from_reader);
+	win_spout_shm_writer_destroy(writer);
+	send_byte(to_reader);
+	exit(0);
+}
+
+TEST(frames_cross_processes)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "shm-frame-test-%d", (int)getpid());
+
+	int to_reader[2], from_reader[2];
+	CHECK(pipe(to_reader) == 0 && pipe(from_reader) == 0);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		stand_in_sender(name, to_reader[1], from_reader[0]);
+	}
+
+	CHECK(wait_byte(to_reader[0]));
+	struct win_spout_shm_reader *reader = win_spout_shm_reader_open(name);
+	CHECK(reader != nullptr);
+	CHECK(win_spout_shm_reader_alive(reader));
+
+	const uint8_t *pixels;
+	uint32_t pitch, width, height;
+	CHECK(!win_spout_shm_reader_read(reader, &pixels, &pitch, &width, &height));
+
+	int matching = 0;
+	for (int frame = 0; frame < FRAMES && reader; frame++) {
+		send_byte(from_reader[1]);
+		CHECK(wait_byte(to_reader[0]));
+
+		struct frame_size size = size_for(frame);
+		if (!win_spout_shm_reader_read(reader, &pixels, &pitch, &width, &height)) {
+			continue;
+		}
+
+		std::vector<uint8_t> expected = make_frame(frame, size.width * 4);
+		bool same = width == size.width && height == size.height;
+		for (uint32_t y = 0; y < height && same; y++) {
+			same = memcmp(pixels + (size_t)y * pitch, &expected[(size_t)y * width * 4], width * 4) == 0;
+		}
+		matching += same ? 1 : 0;
+
+		// nothing new until the next publish
+		CHECK(!win_spout_shm_reader_read(reader, &pixels, &pitch, &width, &height));
+	}
+	CHECK(matching == FRAMES);
+
+	send_byte(from_reader[1]);
+	CHECK(wait_byte(to_reader[0]));
+	CHECK(!win_spout_shm_reader_alive(reader));
+	win_spout_shm_reader_destroy(reader);
+
+	// the sender's section is gone with it
+	CHECK(win_spout_shm_reader_open(name) == nullptr);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+TEST(missing_sender)
+{
+	CHECK(win_spout_shm_reader_open("shm-frame-test-nobody") == nullptr);
+	CHECK(win_spout_shm_reader_open("") == nullptr);
+}
+
+/**
+ * The start of the shared header in win-spout-shm-frame.cpp, as a sender
+ * in another process (or a broken one) would write it
+ */
+struct shared_header {
+	volatile long seq;
+	uint32_t version;
+	volatile long active;
+	uint64_t generation;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+};
+
+TEST(corrupt_header_is_ignored)
+{
+	const char *name = "shm-frame-test-corrupt";
+	struct win_spout_shm_writer *writer = win_spout_shm_writer_create(name);
+	CHECK(writer != nullptr);
+	if (!writer)
+		return;
+
+	std::vector<uint8_t> frame = make_frame(0, 200 * 4);
+	win_spout_shm_writer_publish(writer, frame.data(), 200 * 4, 200, 130);
+
+	struct win_spout_shm_section *section =
+		win_spout_shm_section_open("shm-frame-test-corrupt_OBSFrame", sizeof(struct shared_header), true);
+	struct shared_header *header = (struct shared_header *)win_spout_shm_section_data(section);
+	CHECK(header != nullptr);
+	if (!header)
+		return;
+	const struct shared_header good = *header;
+
+	// a header that points a valid looking frame past its pixel section
+	// or tile counts past the shared tile table
+	struct shared_header bad[] = {good, good, good, good, good, good, good, good};
+	bad[0].width = 9000;
+	bad[0].tiles_x = (9000 + 63) / 64;
+	bad[1].height = 0;
+	bad[1].tiles_y = 0;
+	bad[2].pitch = 200 * 4 - 4;
+	bad[3].pitch = 0xffffffff;
+	bad[4].tiles_x = 128;
+	bad[5].tiles_y = 200;
+	bad[6].width = 8192;
+	bad[6].height = 8192;
+	bad[6].tiles_x = 128;
+	bad[6].tiles_y = 128;
+	bad[6].pitch = 8192 * 4;
+	bad[7].width = 0xffffffff;
+	bad[7].pitch = 0xfffffffc;
+
+	const uint8_t *pixels;
+	uint32_t pitch, width, height;
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		struct win_spout_shm_reader *reader = win_spout_shm_reader_open(name);
+		CHECK(reader != nullptr);
+
+		header->seq++;
+		header->width = bad[i].width;
+		header->height = bad[i].height;
+		header->pitch = bad[i].pitch;
+		header->tiles_x = bad[i].tiles_x;
+		header->tiles_y = bad[i].tiles_y;
+		header->seq++;
+		CHECK(!win_spout_shm_reader_read(reader, &pixels, &pitch, &width, &height));
+
+		// and picks the frame up once the header is sound again
+		header->seq++;
+		header->width = good.width;
+		header->height = good.height;
+		header->pitch = good.pitch;
+		header->tiles_x = good.tiles_x;
+		header->tiles_y = good.tiles_y;
+		header->seq++;
+		CHECK(win_spout_shm_reader_read(reader, &pixels, &pitch, &width, &height));
+		CHECK(width == 200 && height == 130);
+
+		win_spout_shm_reader_destroy(reader);
+	}
+
+	win_spout_shm_section_destroy(section);
+	win_spout_shm_writer_destroy(writer);
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "win-spout-sync.h"
+#include "test.h"
+
+#define FRAME_NS 16666667ULL
+#define MAX_WAIT_NS 40000000ULL
+
+// A receiver, only its address is used to tell members apart
+struct member {
+	int unused;
+};
+
+// Both members' current frames, 0 for a sender without metadata
+static void publish(struct win_spout_sync_group *group, struct member *a, uint64_t a_time, struct member *b,
+		    uint64_t b_time)
+{
+	win_spout_sync_publish(group, a, a_time);
+	win_spout_sync_publish(group, b, b_time);
+}
+
+TEST(senders_on_the_same_frame_are_ready_straight_away)
+{
+	// frame numbers of independent senders never match, their timestamps do
+	struct member a = {}, b = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("same", &a, MAX_WAIT_NS);
+	CHECK(win_spout_sync_join("same", &b, MAX_WAIT_NS) == group);
+
+	for (uint64_t frame = 1; frame <= 600; frame++) {
+		publish(group, &a, frame * FRAME_NS, &b, frame * FRAME_NS);
+		CHECK(win_spout_sync_ready(group, frame * FRAME_NS, FRAME_NS));
+	}
+
+	struct win_spout_sync_stats stats;
+	win_spout_sync_get_stats(group, &stats);
+	CHECK(stats.aligned == 600);
+	CHECK(stats.misses == 0);
+
+	win_spout_sync_leave(group, &a);
+	win_spout_sync_leave(group, &b);
+}
+
+TEST(a_member_a_frame_behind_holds_the_group_for_a_frame)
+{
+	struct member a = {}, b = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("behind", &a, MAX_WAIT_NS);
+	win_spout_sync_join("behind", &b, MAX_WAIT_NS);
+
+	publish(group, &a, 2 * FRAME_NS, &b, FRAME_NS);
+	CHECK(!win_spout_sync_ready(group, 2 * FRAME_NS, FRAME_NS));
+	// every member gets the same answer for the video frame
+	CHECK(!win_spout_sync_ready(group, 2 * FRAME_NS, FRAME_NS));
+
+	win_spout_sync_publish(group, &b, 2 * FRAME_NS);
+	CHECK(win_spout_sync_ready(group, 3 * FRAME_NS, FRAME_NS));
+
+	struct win_spout_sync_stats stats;
+	win_spout_sync_get_stats(group, &stats);
+	CHECK(stats.misses == 0);
+
+	win_spout_sync_leave(group, &a);
+	win_spout_sync_leave(group, &b);
+}
+
+TEST(other_clocks_match_within_half_a_frame)
+{
+	struct member a = {}, b = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("clocks", &a, MAX_WAIT_NS);
+	win_spout_sync_join("clocks", &b, MAX_WAIT_NS);
+
+	publish(group, &a, 100 * FRAME_NS, &b, 100 * FRAME_NS + FRAME_NS / 3);
+	CHECK(win_spout_sync_ready(group, 101 * FRAME_NS, FRAME_NS));
+
+	win_spout_sync_publish(group, &b, 100 * FRAME_NS + FRAME_NS * 2 / 3);
+	CHECK(!win_spout_sync_ready(group, 102 * FRAME_NS, FRAME_NS));
+
+	win_spout_sync_leave(group, &a);
+	win_spout_sync_leave(group, &b);
+}
+
+TEST(members_without_metadata_dont_stall_the_group)
+{
+	struct member timed = {}, untimed = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("untimed", &timed, MAX_WAIT_NS);
+	win_spout_sync_join("untimed", &untimed, MAX_WAIT_NS);
+
+	for (uint64_t frame = 1; frame <= 100; frame++) {
+		publish(group, &timed, frame * FRAME_NS, &untimed, 0);
+		CHECK(win_spout_sync_ready(group, frame * FRAME_NS, FRAME_NS));
+	}
+
+	// nobody timed at all
+	win_spout_sync_publish(group, &timed, 0);
+	CHECK(win_spout_sync_ready(group, 101 * FRAME_NS, FRAME_NS));
+
+	struct win_spout_sync_stats stats;
+	win_spout_sync_get_stats(group, &stats);
+	CHECK(stats.misses == 0);
+
+	win_spout_sync_leave(group, &timed);
+	win_spout_sync_leave(group, &untimed);
+}
+
+TEST(misaligned_group_presents_after_max_wait)
+{
+	struct member a = {}, b = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("wait", &a, MAX_WAIT_NS);
+	win_spout_sync_join("wait", &b, MAX_WAIT_NS);
+
+	publish(group, &a, 10 * FRAME_NS, &b, 5 * FRAME_NS);
+	uint64_t frame = 1;
+	while (!win_spout_sync_ready(group, frame * FRAME_NS, FRAME_NS)) {
+		frame++;
+	}
+	CHECK((frame - 1) * FRAME_NS >= MAX_WAIT_NS);
+	CHECK((frame - 2) * FRAME_NS < MAX_WAIT_NS);
+
+	// a shorter wait applies to the group straight away
+	win_spout_sync_set_max_wait(group, FRAME_NS);
+	uint64_t start = ++frame;
+	while (!win_spout_sync_ready(group, frame * FRAME_NS, FRAME_NS)) {
+		frame++;
+	}
+	CHECK(frame - start == 1);
+
+	struct win_spout_sync_stats stats;
+	win_spout_sync_get_stats(group, &stats);
+	CHECK(stats.misses == 2);
+	CHECK(stats.aligned == 0);
+
+	win_spout_sync_leave(group, &a);
+	win_spout_sync_leave(group, &b);
+}
+
+TEST(members_count_from_their_first_publish_to_leaving)
+{
+	struct member a = {}, b = {};
+	struct win_spout_sync_group *group = win_spout_sync_join("publish", &a, MAX_WAIT_NS);
+	win_spout_sync_publish(group, &a, 10 * FRAME_NS);
+
+	// b has joined but not published, so it doesn't hold a up
+	win_spout_sync_join("publish", &b, MAX_WAIT_NS);
+	CHECK(win_spout_sync_ready(group, FRAME_NS, FRAME_NS));
+
+	win_spout_sync_publish(group, &b, 5 * FRAME_NS);
+	CHECK(!win_spout_sync_ready(group, 2 * FRAME_NS, FRAME_NS));
+
+	// once b has left what it published is gone with it, later publishes are ignored
+	win_spout_sync_leave(group, &b);
+	win_spout_sync_publish(group, &b, 5 * FRAME_NS);
+	CHECK(win_spout_sync_ready(group, 3 * FRAME_NS, FRAME_NS));
+
+	win_spout_sync_leave(group, &a);
+}
+
+TEST(no_group_is_always_ready)
+{
+	struct member a = {};
+	CHECK(win_spout_sync_join("", &a, MAX_WAIT_NS) == nullptr);
+	CHECK(win_spout_sync_ready(nullptr, FRAME_NS, FRAME_NS));
+	win_spout_sync_publish(nullptr, &a, FRAME_NS);
+}
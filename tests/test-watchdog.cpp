@@ -0,0 +1,143 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include "win-spout-watchdog.h"
+#include "test.h"
+
+#define FRAME_NS 16666667ULL
+#define TIMEOUT_NS 500000000ULL
+
+// A sender that sends frames until stop, then nothing; returns the time of its last frame
+static uint64_t run_until(struct win_spout_watchdog *watchdog, uint64_t frame, uint64_t stop)
+{
+	uint64_t now = frame * FRAME_NS;
+	for (; now < stop; frame++, now += FRAME_NS)
+		CHECK(win_spout_watchdog_update(watchdog, frame, now) == WIN_SPOUT_WATCHDOG_NONE);
+	return now - FRAME_NS;
+}
+
+TEST(a_sender_stalls_once_the_timeout_passes)
+{
+	struct win_spout_watchdog watchdog;
+	win_spout_watchdog_init(&watchdog, TIMEOUT_NS);
+
+	uint64_t last = run_until(&watchdog, 1, 60 * FRAME_NS);
+	uint64_t frame = watchdog.frame_number;
+	CHECK(!watchdog.stalled);
+
+	// the same frame right up to the timeout is a static picture
+	CHECK(win_spout_watchdog_update(&watchdog, frame, last + TIMEOUT_NS - 1) == WIN_SPOUT_WATCHDOG_NONE);
+	CHECK(win_spout_watchdog_stall_time(&watchdog, last + TIMEOUT_NS - 1) == 0);
+
+	CHECK(win_spout_watchdog_update(&watchdog, frame, last + TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+	CHECK(watchdog.stalled);
+	CHECK(watchdog.stalls == 1);
+	CHECK(win_spout_watchdog_stall_time(&watchdog, last + TIMEOUT_NS) == TIMEOUT_NS);
+
+	// reported once, not every tick it stays stalled
+	CHECK(win_spout_watchdog_update(&watchdog, frame, last + 2 * TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_NONE);
+	CHECK(watchdog.stalls == 1);
+	CHECK(win_spout_watchdog_stall_time(&watchdog, last + 2 * TIMEOUT_NS) == 2 * TIMEOUT_NS);
+}
+
+TEST(a_timeout_of_0_never_stalls)
+{
+	struct win_spout_watchdog watchdog;
+	win_spout_watchdog_init(&watchdog, 0);
+
+	CHECK(win_spout_watchdog_update(&watchdog, 1, FRAME_NS) == WIN_SPOUT_WATCHDOG_NONE);
+	bool quiet = true;
+	for (uint64_t now = FRAME_NS; now < 3600ULL * 1000000000ULL; now += 1000000000ULL)
+		quiet = quiet && win_spout_watchdog_update(&watchdog, 1, now) == WIN_SPOUT_WATCHDOG_NONE;
+	CHECK(quiet);
+	CHECK(!watchdog.stalled);
+	CHECK(watchdog.stalls == 0);
+}
+
+TEST(resuming_accounts_for_the_stall)
+{
+	struct win_spout_watchdog watchdog;
+	win_spout_watchdog_init(&watchdog, TIMEOUT_NS);
+
+	// stalled for 2 s
+	uint64_t last = run_until(&watchdog, 1, 10 * FRAME_NS);
+	uint64_t frame = watchdog.frame_number;
+	CHECK(win_spout_watchdog_update(&watchdog, frame, last + TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+	uint64_t resume = last + 2000000000ULL;
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 1, resume) == WIN_SPOUT_WATCHDOG_RESUMED);
+	CHECK(!watchdog.stalled);
+	CHECK(watchdog.last_stall_ns == 2000000000ULL);
+	CHECK(watchdog.stall_total_ns == 2000000000ULL);
+	CHECK(watchdog.stall_max_ns == 2000000000ULL);
+
+	// then for 1 s: the total adds up, the max stays
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 1, resume + TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 2, resume + 1000000000ULL) ==
+	      WIN_SPOUT_WATCHDOG_RESUMED);
+	CHECK(watchdog.stalls == 2);
+	CHECK(watchdog.last_stall_ns == 1000000000ULL);
+	CHECK(watchdog.stall_total_ns == 3000000000ULL);
+	CHECK(watchdog.stall_max_ns == 2000000000ULL);
+
+	// a new frame that wasn't preceded by a stall isn't a resume
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 3, resume + 1000000000ULL + FRAME_NS) ==
+	      WIN_SPOUT_WATCHDOG_NONE);
+	CHECK(watchdog.stall_total_ns == 3000000000ULL);
+}
+
+TEST(reset_forgets_the_sender_but_keeps_the_stats)
+{
+	struct win_spout_watchdog watchdog;
+	win_spout_watchdog_init(&watchdog, TIMEOUT_NS);
+
+	uint64_t last = run_until(&watchdog, 1, 10 * FRAME_NS);
+	uint64_t frame = watchdog.frame_number;
+	CHECK(win_spout_watchdog_update(&watchdog, frame, last + TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 1, last + 2 * TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_RESUMED);
+	CHECK(win_spout_watchdog_update(&watchdog, frame + 1, last + 3 * TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+
+	// e.g. switching to another sender, whose counter starts elsewhere
+	win_spout_watchdog_reset(&watchdog);
+	CHECK(!watchdog.stalled);
+	CHECK(watchdog.frame_number == 0);
+	CHECK(watchdog.timeout_ns == TIMEOUT_NS);
+	CHECK(watchdog.stalls == 2);
+	CHECK(watchdog.last_stall_ns == 2 * TIMEOUT_NS);
+	CHECK(watchdog.stall_total_ns == 2 * TIMEOUT_NS);
+	CHECK(watchdog.stall_max_ns == 2 * TIMEOUT_NS);
+
+	// the new sender's first frame isn't a resume, and it gets a full timeout
+	uint64_t now = last + 4 * TIMEOUT_NS;
+	CHECK(win_spout_watchdog_update(&watchdog, 7, now) == WIN_SPOUT_WATCHDOG_NONE);
+	CHECK(win_spout_watchdog_update(&watchdog, 7, now + TIMEOUT_NS - 1) == WIN_SPOUT_WATCHDOG_NONE);
+	CHECK(win_spout_watchdog_update(&watchdog, 7, now + TIMEOUT_NS) == WIN_SPOUT_WATCHDOG_STALLED);
+	CHECK(watchdog.stalls == 3);
+}
+
+TEST(only_sends_over_budget_count)
+{
+	struct win_spout_send_watch watch = {};
+	watch.budget_ns = FRAME_NS;
+
+	CHECK(!win_spout_send_watch_record(&watch, 1000000));
+	CHECK(!win_spout_send_watch_record(&watch, FRAME_NS));
+	CHECK(win_spout_send_watch_record(&watch, FRAME_NS + 1));
+	CHECK(win_spout_send_watch_record(&watch, 3 * FRAME_NS));
+	CHECK(win_spout_send_watch_record(&watch, 2 * FRAME_NS));
+	CHECK(watch.sends == 5);
+	CHECK(watch.over_budget == 3);
+	CHECK(watch.over_budget_max_ns == 3 * FRAME_NS);
+
+	// no budget, nothing is over it
+	struct win_spout_send_watch unbudgeted = {};
+	CHECK(!win_spout_send_watch_record(&unbudgeted, 10 * FRAME_NS));
+	CHECK(unbudgeted.sends == 1);
+	CHECK(unbudgeted.over_budget == 0);
+	CHECK(unbudgeted.over_budget_max_ns == 0);
+}
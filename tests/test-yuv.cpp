@@ -0,0 +1,173 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <util/bmem.h>
+#include "win-spout-yuv.h"
+#include "test.h"
+
+#define WIDTH 8
+#define HEIGHT 4
+
+static const enum win_spout_yuv_format formats[2] = {WIN_SPOUT_YUV_NV12, WIN_SPOUT_YUV_P010};
+static const enum win_spout_yuv_matrix matrices[2] = {WIN_SPOUT_YUV_709, WIN_SPOUT_YUV_2020};
+
+// A WIDTH x HEIGHT frame of one color, packed
+struct packed_frame {
+	std::vector<uint8_t> bgra;
+	std::vector<uint8_t> packed;
+	uint32_t linesize;
+
+	packed_frame(const uint8_t *color, enum win_spout_yuv_format format, enum win_spout_yuv_matrix matrix)
+	{
+		bgra.resize(WIDTH * HEIGHT * 4);
+		for (size_t i = 0; i < bgra.size(); i++)
+			bgra[i] = color[i % 4];
+		linesize = WIDTH * (format == WIN_SPOUT_YUV_P010 ? 2 : 1);
+		packed.resize((size_t)linesize * HEIGHT / 2 * 3);
+		win_spout_yuv_pack(bgra.data(), WIDTH * 4, WIDTH, HEIGHT, format, matrix, packed.data(), linesize);
+	}
+
+	uint32_t sample(uint32_t x, uint32_t y) const
+	{
+		const uint8_t *row = &packed[(size_t)y * linesize];
+		return linesize == WIDTH ? row[x] : (uint32_t)(row[x * 2] | (row[x * 2 + 1] << 8));
+	}
+};
+
+TEST(reference_colors_pack_to_their_code_values)
+{
+	const uint8_t red[4] = {0, 0, 255, 255};
+	const uint8_t white[4] = {255, 255, 255, 255};
+	const uint8_t black[4] = {0, 0, 0, 255};
+
+	struct packed_frame r(red, WIN_SPOUT_YUV_NV12, WIN_SPOUT_YUV_709);
+	CHECK(r.sample(3, 1) == 63);
+	CHECK(r.sample(2, HEIGHT) == 102);
+	CHECK(r.sample(3, HEIGHT + 1) == 240);
+
+	struct packed_frame w(white, WIN_SPOUT_YUV_NV12, WIN_SPOUT_YUV_2020);
+	CHECK(w.sample(0, 0) == 235);
+	CHECK(w.sample(0, HEIGHT) == 128 && w.sample(1, HEIGHT) == 128);
+
+	// P010's ten bits are at the top of each sample
+	struct packed_frame w10(white, WIN_SPOUT_YUV_P010, WIN_SPOUT_YUV_709);
+	CHECK(w10.sample(5, 3) == 940 << 6);
+	struct packed_frame b10(black, WIN_SPOUT_YUV_P010, WIN_SPOUT_YUV_709);
+	CHECK(b10.sample(5, 3) == 64 << 6);
+	CHECK(b10.sample(4, HEIGHT + 1) == 512 << 6);
+}
+
+TEST(unpacking_inverts_the_matrix)
+{
+	bool inverse = true;
+	for (enum win_spout_yuv_format format : formats) {
+		for (enum win_spout_yuv_matrix matrix : matrices) {
+			struct win_spout_yuv_coeffs pack;
+			struct win_spout_yuv_unpack_coeffs unpack;
+			win_spout_yuv_get_coeffs(format, matrix, &pack);
+			win_spout_yuv_get_unpack_coeffs(format, matrix, &unpack);
+
+			const float *forward[3] = {pack.y, pack.u, pack.v};
+			const float *back[3] = {unpack.r, unpack.g, unpack.b};
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					float sum = 0.0f;
+					for (int k = 0; k < 3; k++)
+						sum += back[i][k] * forward[k][j];
+					inverse = inverse && fabsf(sum - (i == j ? 1.0f : 0.0f)) < 1e-5f;
+				}
+			}
+			inverse = inverse && fabsf(unpack.in_scale * pack.out_scale - 1.0f) < 1e-6f;
+		}
+	}
+	CHECK(inverse);
+}
+
+TEST(colors_survive_a_round_trip)
+{
+	srand(50);
+	int worst[2] = {};
+	for (int i = 0; i < 500; i++) {
+		const uint8_t color[4] = {(uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand(), 255};
+		for (int f = 0; f < 2; f++) {
+			for (enum win_spout_yuv_matrix matrix : matrices) {
+				struct packed_frame frame(color, formats[f], matrix);
+				std::vector<uint8_t> out(WIDTH * HEIGHT * 4);
+				win_spout_yuv_unpack(frame.packed.data(), frame.linesize, WIDTH, HEIGHT, formats[f],
+						     matrix, out.data(), WIDTH * 4);
+				for (size_t p = 0; p < out.size(); p++) {
+					int d = abs((int)out[p] - (int)(p % 4 == 3 ? 255 : color[p % 4]));
+					worst[f] = d > worst[f] ? d : worst[f];
+				}
+			}
+		}
+	}
+
+	// 8-bit limited range costs a step or so, 10-bit nothing that survives rounding to 8
+	CHECK(worst[0] <= 2);
+	CHECK(worst[1] <= 1);
+}
+
+TEST(chroma_belongs_to_its_pair_of_pixels)
+{
+	// left half red, right half blue, split on a pair boundary
+	std::vector<uint8_t> bgra(WIDTH * HEIGHT * 4);
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		for (uint32_t x = 0; x < WIDTH; x++) {
+			uint8_t *px = &bgra[(y * WIDTH + x) * 4];
+			px[0] = x < WIDTH / 2 ? 0 : 255;
+			px[1] = 0;
+			px[2] = x < WIDTH / 2 ? 255 : 0;
+			px[3] = 255;
+		}
+	}
+	std::vector<uint8_t> packed(WIDTH * HEIGHT / 2 * 3);
+	win_spout_yuv_pack(bgra.data(), WIDTH * 4, WIDTH, HEIGHT, WIN_SPOUT_YUV_NV12, WIN_SPOUT_YUV_709,
+			   packed.data(), WIDTH);
+	std::vector<uint8_t> out(WIDTH * HEIGHT * 4);
+	win_spout_yuv_unpack(packed.data(), WIDTH, WIDTH, HEIGHT, WIN_SPOUT_YUV_NV12, WIN_SPOUT_YUV_709, out.data(),
+			     WIDTH * 4);
+
+	// the pairs away from the edge keep their color, each pixel of a pair gets the same chroma
+	CHECK(out[2] > 240 && out[0] < 16);
+	CHECK(out[(WIDTH - 1) * 4] > 240 && out[(WIDTH - 1) * 4 + 2] < 16);
+	CHECK(out[(WIDTH + 2) * 4 + 2] == out[(WIDTH + 3) * 4 + 2]);
+	CHECK(win_spout_yuv_luma_height(HEIGHT / 2 * 3) == HEIGHT);
+}
+
+TEST(the_effect_packs_and_unpacks)
+{
+	gs_effect_t *effect = win_spout_yuv_effect_create();
+	CHECK(effect != nullptr);
+	gs_effect_destroy(effect);
+
+	char *path = obs_module_file("spout-yuv.effect");
+	FILE *f = fopen(path, "rb");
+	bfree(path);
+	CHECK(f != nullptr);
+	if (!f)
+		return;
+	std::string text;
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		text.append(buffer, read);
+	fclose(f);
+
+	CHECK(text.find("technique Pack\n") != std::string::npos);
+	CHECK(text.find("technique Unpack\n") != std::string::npos);
+	const char *params[6] = {"float3 unpack_r", "float3 unpack_g", "float3 unpack_b",
+				 "float3 offsets",  "float in_scale", "float2 luma_size"};
+	for (const char *param : params)
+		CHECK(text.find(std::string("uniform ") + param + ";") != std::string::npos);
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright Off World Live Ltd (https://offworld.live), 2019-2021
+ *
+ * and licenced under the GPL v2 (https://www.gnu.org/licenses/old-licenses/gpl-2.0.en.html)
+ *
+ * Many thanks to authors of https://github.com/baffler/OBS-OpenVR-Input-Plugin which
+ * was used as guidance to working with the OBS Studio APIs
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Minimal harness: TEST(name) registers a case, CHECK records a failure
+ * and carries on, each test executable runs all of its cases and fails
+ * if any check did.
+ */
+struct test_case {
+	const char *name;
+	void (*run)();
+	struct test_case *next;
+};
+
+void test_register(struct test_case *test);
+void test_fail(const char *file, int line, const char *expr);
+
+#define TEST(name)                                                                          \
+	static void name();                                                                 \
+	static struct test_case name##_case = {#name, name, nullptr};                       \
+	[[maybe_unused]] static const int name##_registered = (test_register(&name##_case), 0); \
+	static void name()
+
+#define CHECK(cond)                                     \
+	do {                                            \
+		if (!(cond))                            \
+			test_fail(__FILE__, __LINE__, #cond); \
+	} while (0)
+
+/* Hooks into the stand-in libobs */
+
+// os_gettime_ns() returns ns from now on, until test_clock_real()
+void test_clock_set(uint64_t ns);
+void test_clock_advance(uint64_t ns);
+void test_clock_real();
+
+// Calls to bmalloc / brealloc so far, bnum_allocs() only counts those not yet freed
+uint64_t test_bmem_calls();
+
+// blog() messages above level are dropped, LOG_WARNING by default
+void test_log_level(int level);